@@ -6,11 +6,20 @@
 #include <fcntl.h>
 #include <string.h>
 #include "scheduler.h"
+#include "hook.h"
 
 namespace sylar {
 
 static sylar::Logger::ptr IOManager_logger = SYLAR_LOG_NAME("system");
 
+// 所有fd上下文锁共用的竞争统计
+static LockStats s_fd_lock_stats("fd_context");
+
+IOManager::FdContext::FdContext(int fd_)
+    :fd(fd_)
+    ,mutex(&s_fd_lock_stats) {
+}
+
 IOManager::FdContext::EventContext &IOManager::FdContext::getContext(Event event) {
     switch(event) {
         case IOManager::READ:
@@ -60,53 +69,56 @@ IOManager::IOManager(size_t threads, bool use_caller, const std::string &name)
     rt = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_tickleFds[0], &event);
     SYLAR_ASSERT(rt == 0);
 
-    contextResize(32);
+    m_wakeupsMetric.reset(new Counter);
+    m_eventsMetric.reset(new Counter);
+    // owner和Scheduler注册时用的一致
+    const void *owner = static_cast<Scheduler*>(this);
+    MetricsRegistry::Labels labels = getMetricLabels();
+    MetricsRegistry *metrics = MetricsMgr::GetInstance();
+    metrics->add("sylar_iomanager_epoll_wakeups_total", labels, "epoll_wait returns.", m_wakeupsMetric, owner);
+    metrics->add("sylar_iomanager_epoll_events_total", labels, "Events returned by epoll_wait."
+            , m_eventsMetric, owner);
+    metrics->add("sylar_iomanager_pending_events", labels, "Registered fd events not yet fired."
+            , std::make_shared<CallbackMetric>(Metric::GAUGE, [this]() {
+                return (double)m_pendingEventCount;
+            }), owner);
+    registerTimerMetrics(labels, owner);
 
     start();
 }
 
 IOManager::~IOManager(){
     stop();
+    // 定时器的回调指标要在TimerManager析构前摘掉
+    MetricsMgr::GetInstance()->remove(static_cast<Scheduler*>(this));
     close(m_epoll_fd);
     close(m_tickleFds[0]);
     close(m_tickleFds[1]);
-
-    for(size_t i = 0; i < m_fdContexts.size(); i++) {
-        if(m_fdContexts[i]) {
-            delete m_fdContexts[i];
-        }
-    }
 }
 
-void IOManager::contextResize(size_t size) {
-    m_fdContexts.resize(size);
+// 0 success, -1 error
+int IOManager::addEvent(int fd, Event event, std::function<void()> cb){
+    return doAddEvent(fd, event, cb, false);
+}
 
-    for(size_t i = 0; i<m_fdContexts.size(); i++) {
-        if(!m_fdContexts[i]) {
-            m_fdContexts[i] = new FdContext;
-            m_fdContexts[i]->fd = i;
-        }
-    }
+int IOManager::tryAddEvent(int fd, Event event, std::function<void()> cb){
+    return doAddEvent(fd, event, cb, true);
 }
 
-// 0 success, -1 error
-int IOManager::addEvent(int fd, Event event, std::function<void()> cb){
-    FdContext *fd_ctx = nullptr;
-    RWMutexType::ReadLock lock(m_mutex);
-    if((int)m_fdContexts.size() > fd) {
-        fd_ctx = m_fdContexts[fd];
-        lock.unlock();
-    } else {
-        lock.unlock();
-        RWMutexType::WriteLock lock2(m_mutex);
-        contextResize(fd * 1.5);
-        fd_ctx = m_fdContexts[fd];
+int IOManager::doAddEvent(int fd, Event event, std::function<void()> cb, bool allow_busy){
+    FdContext *fd_ctx = m_fdContexts.getOrCreate(fd);
+    if(!fd_ctx) {
+        SYLAR_LOG_ERROR(IOManager_logger) << "addEvent invalid fd = " << fd;
+        return -1;
     }
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     // #   define SYLAR_UNLIKELY(x)     __builtin_expect(!!(x), 0)
     // if(SYLAR_UNLIKELY(fd_ctx->m_events & event)) {
     if((fd_ctx->m_events & event)) {
+        if(allow_busy) {
+            return 1;
+        }
         SYLAR_LOG_ERROR(IOManager_logger) << "addEvent assert fd = " << fd << ", event = " << event << ", fd_ctx.event" << fd_ctx->m_events;
         SYLAR_ASSERT(!(fd_ctx->m_events & event));
     }
@@ -140,12 +152,10 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb){
 }
 
 bool IOManager::delEvent(int fd, Event event) {
-    RWMutexType::ReadLock lock(m_mutex);
-    if ((int)m_fdContexts.size() <= fd) {
+    FdContext *fd_ctx = m_fdContexts.get(fd);
+    if(!fd_ctx) {
         return false;
     }
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     if(!(fd_ctx->m_events & event)) {
@@ -156,7 +166,7 @@ bool IOManager::delEvent(int fd, Event event) {
     int op = new_events != 0 ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
     epoll_event epevent;
     epevent.events = EPOLLET | new_events;
-    epevent.data.ptr = &fd_ctx;
+    epevent.data.ptr = fd_ctx;
 
     int rt = epoll_ctl(m_epoll_fd, op, fd, &epevent);
     if(rt) {
@@ -172,12 +182,10 @@ bool IOManager::delEvent(int fd, Event event) {
 }
 
 bool IOManager::cancelEvent(int fd, Event event) {
-    RWMutexType::ReadLock lock(m_mutex);
-    if ((int)m_fdContexts.size() <= fd) {
+    FdContext *fd_ctx = m_fdContexts.get(fd);
+    if(!fd_ctx) {
         return false;
     }
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
 
     FdContext::MutexType::Lock lcok(fd_ctx->mutex);
     if(!(fd_ctx->m_events & event)) {
@@ -188,7 +196,7 @@ bool IOManager::cancelEvent(int fd, Event event) {
     int op = new_events != 0 ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
     epoll_event epevent;
     epevent.events = EPOLLET | new_events;
-    epevent.data.ptr = &fd_ctx;
+    epevent.data.ptr = fd_ctx;
 
     int rt = epoll_ctl(m_epoll_fd, op, fd, &epevent);
     if(rt) {
@@ -201,12 +209,10 @@ bool IOManager::cancelEvent(int fd, Event event) {
 }
 
 bool IOManager::cancelAll(int fd) {
-    RWMutexType::ReadLock lock(m_mutex);
-    if ((int)m_fdContexts.size() <= fd) {
+    FdContext *fd_ctx = m_fdContexts.get(fd);
+    if(!fd_ctx) {
         return false;
     }
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     if(!fd_ctx->m_events) {
@@ -216,7 +222,7 @@ bool IOManager::cancelAll(int fd) {
     int op = EPOLL_CTL_DEL;
     epoll_event epevent;
     epevent.events = 0;
-    epevent.data.ptr = &fd_ctx;
+    epevent.data.ptr = fd_ctx;
 
     int rt = epoll_ctl(m_epoll_fd, op, fd, &epevent);
     if(rt) {
@@ -243,7 +249,7 @@ IOManager* IOManager::GetThis() {
 }
 
 void IOManager::tickle() {
-    if(hasIdleThreads()) {
+    if(!hasIdleThreads()) {
         return;
     }
     int rt = write(m_tickleFds[1], "T", 1);
@@ -282,7 +288,7 @@ void IOManager::idle() {
             } else {
                 next_timeout = MAX_TIMEOUT;
             }
-            rt = epoll_wait(m_epoll_fd, events, 64, (int)next_timeout);
+            rt = epoll_wait_f(m_epoll_fd, events, 64, (int)next_timeout);
 
             if (rt < 0 && errno == EINTR) {
 
@@ -290,6 +296,10 @@ void IOManager::idle() {
                 break;
             }
         } while(true);
+        if(rt >= 0) {
+            m_wakeupsMetric->add();
+            m_eventsMetric->add(rt);
+        }
     
         std::vector<std::function<void()>> cbs;
         listExpiredCb(cbs);
@@ -310,7 +320,7 @@ void IOManager::idle() {
             FdContext::MutexType::Lock lock(fd_ctx->mutex);
 
             if(event.events & (EPOLLERR | EPOLLHUP)) {
-                event.events |= EPOLLIN | EPOLLOUT;
+                event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->m_events;
             }
             int real_events = NONE;
             if (event.events & EPOLLIN) {
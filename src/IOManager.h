@@ -5,6 +5,8 @@
 #include "thread.h"
 #include <atomic>
 #include "timer.h"
+#include "fd_slab.h"
+#include <stddef.h>
 
 
 namespace sylar {
@@ -21,23 +23,34 @@ public :
     };
 
 private:
-    struct FdContext {
-        typedef Mutex MutexType;
+    // 每个fd的记录按cache line对齐，连续放在slab里
+    // 开头是每次事件都要访问的fd、m_events和mutex，回调用的EventContext放在后面的cache line
+    struct alignas(SYLAR_CACHELINE_SIZE) FdContext {
+        typedef AdaptiveMutex MutexType;
         struct EventContext {
             Scheduler *scheduler = nullptr;        // 事件执行的Scheduler
             Fiber::ptr fiber;                      // 事件协程
             std::function<void()> cb;              // 事件的回调函数
         };
+        FdContext(int fd_);
         EventContext &getContext(Event event);
         void resetContext(EventContext &ctx);
         void triggerEvent(Event event);
 
         int fd = 0;
-        EventContext read;
-        EventContext write;
         Event m_events = Event::NONE;
         MutexType mutex;
+        // 每个EventContext单独占一条cache line，不和上面的热字段挤在一起
+        alignas(SYLAR_CACHELINE_SIZE) EventContext read;
+        alignas(SYLAR_CACHELINE_SIZE) EventContext write;
     };
+    static_assert(sizeof(FdContext::EventContext) <= SYLAR_CACHELINE_SIZE, "EventContext must fit in one cache line");
+    // FdContext里有std::function，不是standard-layout，gcc对offsetof的支持是确定的，只关掉这个警告
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+    static_assert(offsetof(FdContext, read) == SYLAR_CACHELINE_SIZE, "FdContext::read must start the second cache line");
+    static_assert(offsetof(FdContext, write) == 2 * SYLAR_CACHELINE_SIZE, "FdContext::write must start the third cache line");
+#pragma GCC diagnostic pop
 
 public:
     IOManager(size_t threads = 1, bool use_caller = true, const std::string &name = "");
@@ -46,6 +59,8 @@ public:
 
     // 0 success, -1 error
     int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+    // 和addEvent一样，但事件已经被别人注册时不断言，返回1
+    int tryAddEvent(int fd, Event event, std::function<void()> cb = nullptr);
     bool delEvent(int fd, Event event);
     bool cancelEvent(int fd, Event event);
 
@@ -60,16 +75,18 @@ protected:
     void idle() override;
 
     void onTimerInsertedAtFront() override; 
-
-    void contextResize(size_t size);
 private:
+    int doAddEvent(int fd, Event event, std::function<void()> cb, bool allow_busy);
     int m_epoll_fd = 0;
     int m_tickleFds[2];
 
     std::atomic<size_t> m_pendingEventCount = {0};
-    RWMutexType m_mutex;
+    // epoll_wait返回的次数和拿到的事件数，两者相除是每次唤醒处理的事件数
+    Counter::ptr m_wakeupsMetric;
+    Counter::ptr m_eventsMetric;
 
-    std::vector<FdContext*> m_fdContexts;
+    // 段地址不变，查找不需要加锁
+    FdSlab<FdContext> m_fdContexts;
 
 };
 
@@ -1,6 +1,13 @@
 #include "address.h"
 #include "log.h"
+#include "dns.h"
+#include "hook.h"
+#include "IOManager.h"
+#include "config.h"
+#include "util.h"
 #include <sstream>
+#include <atomic>
+#include <unordered_map>
 #include <netdb.h>
 #include <ifaddrs.h>
 #include <stddef.h>
@@ -52,8 +59,12 @@ IPAddress::ptr Address::LookupAnyIPAddress(const std::string& host,
 }
 
 
-bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
-                     int family, int type, int protocol) {
+// ttl_ms返回结果最多能缓存多久，DnsResolver给的是记录的TTL，getaddrinfo不知道TTL返回-1
+static bool DoLookup(std::vector<Address::ptr>& result, const std::string& host,
+                     int family, int type, int protocol, uint64_t* ttl_ms = nullptr) {
+    if(ttl_ms) {
+        *ttl_ms = (uint64_t)-1;
+    }
     addrinfo hints, *results, *next;
     hints.ai_flags = 0;
     hints.ai_family = family;
@@ -93,6 +104,25 @@ bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
     if(node.empty()) {
         node = host;
     }
+
+    //协程里用DnsResolver解析，等应答时只挂起当前协程; 非数字的service还是交给getaddrinfo
+    if(IOManager::GetThis() && is_hook_enable()
+            && (family == AF_INET || family == AF_INET6 || family == AF_UNSPEC)
+            && (!service || (*service && strspn(service, "0123456789") == strlen(service)))) {
+        std::vector<IPAddress::ptr> addrs;
+        if(!DnsMgr::GetInstance()->resolve(addrs, node, family, ttl_ms)) {
+            SYLAR_LOG_DEBUG(address_logger) << "Address::Lookup resolve(" << host << ", "
+                << family << ") fail";
+            return false;
+        }
+        uint16_t port = service ? atoi(service) : 0;
+        for(auto& i : addrs) {
+            i->setPort(port);
+            result.push_back(i);
+        }
+        return !result.empty();
+    }
+
     int error = getaddrinfo(node.c_str(), service, &hints, &results);
     if(error) {
         SYLAR_LOG_DEBUG(address_logger) << "Address::Lookup getaddress(" << host << ", "
@@ -103,7 +133,7 @@ bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
 
     next = results;
     while(next) {
-        result.push_back(Create(next->ai_addr, (socklen_t)next->ai_addrlen));
+        result.push_back(Address::Create(next->ai_addr, (socklen_t)next->ai_addrlen));
         //SYLAR_LOG_INFO(address_logger) << ((sockaddr_in*)next->ai_addr)->sin_addr.s_addr;
         next = next->ai_next;
     }
@@ -112,7 +142,7 @@ bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
     return !result.empty();
 }
 
-bool Address::GetInterfaceAddresses(std::multimap<std::string
+static bool DoGetInterfaceAddresses(std::multimap<std::string
                     ,std::pair<Address::ptr, uint32_t> >& result,
                     int family) {
     struct ifaddrs *next, *results;
@@ -132,14 +162,14 @@ bool Address::GetInterfaceAddresses(std::multimap<std::string
             switch(next->ifa_addr->sa_family) {
                 case AF_INET:
                     {
-                        addr = Create(next->ifa_addr, sizeof(sockaddr_in));
+                        addr = Address::Create(next->ifa_addr, sizeof(sockaddr_in));
                         uint32_t netmask = ((sockaddr_in*)next->ifa_netmask)->sin_addr.s_addr;
                         prefix_len = CountBytes(netmask);
                     }
                     break;
                 case AF_INET6:
                     {
-                        addr = Create(next->ifa_addr, sizeof(sockaddr_in6));
+                        addr = Address::Create(next->ifa_addr, sizeof(sockaddr_in6));
                         in6_addr& netmask = ((sockaddr_in6*)next->ifa_netmask)->sin6_addr;
                         prefix_len = 0;
                         for(int i = 0; i < 16; ++i) {
@@ -165,6 +195,235 @@ bool Address::GetInterfaceAddresses(std::multimap<std::string
     return !result.empty();
 }
 
+static sylar::ConfigVar<uint32_t>::ptr g_lookup_cache_ttl =
+    sylar::Config::Lookup("address.cache.ttl", (uint32_t)30000, "address lookup cache ttl ms, 0 means no cache");
+static sylar::ConfigVar<uint32_t>::ptr g_lookup_cache_negative_ttl =
+    sylar::Config::Lookup("address.cache.negative_ttl", (uint32_t)5000, "address lookup failure cache ttl ms");
+static sylar::ConfigVar<uint32_t>::ptr g_lookup_cache_max_size =
+    sylar::Config::Lookup("address.cache.max_size", (uint32_t)16384, "address lookup cache max entries");
+static sylar::ConfigVar<uint32_t>::ptr g_interface_cache_ttl =
+    sylar::Config::Lookup("address.cache.interface_ttl", (uint32_t)10000, "interface address cache ttl ms, 0 means no cache");
+
+static std::atomic<uint32_t> s_lookup_cache_ttl = {0};
+static std::atomic<uint32_t> s_lookup_cache_negative_ttl = {0};
+static std::atomic<uint32_t> s_lookup_cache_max_size = {0};
+static std::atomic<uint32_t> s_interface_cache_ttl = {0};
+
+struct _AddressCacheIniter {
+    _AddressCacheIniter() {
+        s_lookup_cache_ttl = g_lookup_cache_ttl->getValue();
+        s_lookup_cache_negative_ttl = g_lookup_cache_negative_ttl->getValue();
+        s_lookup_cache_max_size = g_lookup_cache_max_size->getValue();
+        s_interface_cache_ttl = g_interface_cache_ttl->getValue();
+        g_lookup_cache_ttl->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_lookup_cache_ttl = new_value;
+        });
+        g_lookup_cache_negative_ttl->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_lookup_cache_negative_ttl = new_value;
+        });
+        g_lookup_cache_max_size->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_lookup_cache_max_size = new_value;
+        });
+        g_interface_cache_ttl->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_interface_cache_ttl = new_value;
+        });
+    }
+};
+static _AddressCacheIniter s_address_cache_initer;
+
+//调用方可能会改端口，缓存里的地址每次都拷贝一份出去
+static void CopyAddresses(std::vector<Address::ptr>& result, const std::vector<Address::ptr>& addrs) {
+    for(auto& i : addrs) {
+        result.push_back(Address::Create(i->getAddr(), i->getAddrLen()));
+    }
+}
+
+//同一个key正在解析时，后来的协程/线程挂在这里等结果
+struct LookupFlight {
+    bool ok = false;
+    std::vector<Address::ptr> addrs;
+    std::vector<std::pair<Scheduler*, Fiber::ptr> > fibers;
+    std::vector<Semaphore*> threads;
+};
+
+struct LookupEntry {
+    bool ok = false;
+    std::vector<Address::ptr> addrs;
+    uint64_t expire = 0;
+    std::shared_ptr<LookupFlight> flight;
+};
+
+struct LookupShard {
+    Mutex mutex;
+    std::unordered_map<std::string, LookupEntry> entries;
+};
+
+static const size_t LOOKUP_SHARD_COUNT = 16;
+
+static LookupShard* GetLookupShards() {
+    static LookupShard s_shards[LOOKUP_SHARD_COUNT];
+    return s_shards;
+}
+
+//超过上限时先清过期的，还不够就把不在解析中的都清掉
+static void ShrinkLookupShard(LookupShard& shard, uint64_t now) {
+    size_t max_size = s_lookup_cache_max_size / LOOKUP_SHARD_COUNT + 1;
+    if(shard.entries.size() < max_size) {
+        return;
+    }
+    for(auto it = shard.entries.begin(); it != shard.entries.end();) {
+        if(!it->second.flight && it->second.expire <= now) {
+            it = shard.entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if(shard.entries.size() < max_size) {
+        return;
+    }
+    for(auto it = shard.entries.begin(); it != shard.entries.end();) {
+        if(!it->second.flight) {
+            it = shard.entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
+                     int family, int type, int protocol) {
+    if(s_lookup_cache_ttl == 0) {
+        return DoLookup(result, host, family, type, protocol);
+    }
+
+    std::string key = host + "|" + std::to_string(family) + "|"
+        + std::to_string(type) + "|" + std::to_string(protocol);
+    LookupShard& shard = GetLookupShards()[std::hash<std::string>()(key) % LOOKUP_SHARD_COUNT];
+    std::shared_ptr<LookupFlight> flight;
+    {
+        Mutex::Lock lock(shard.mutex);
+        uint64_t now = GetCurrentMS();
+        auto it = shard.entries.find(key);
+        if(it != shard.entries.end()) {
+            LookupEntry& entry = it->second;
+            if(!entry.flight && entry.expire > now) {
+                CopyAddresses(result, entry.addrs);
+                return entry.ok;
+            }
+            if(entry.flight) {
+                //已经有人在解析，挂起等它的结果
+                flight = entry.flight;
+                Fiber::ptr fiber = Fiber::GetThis();
+                if(Scheduler::GetThis() && fiber) {
+                    flight->fibers.push_back(std::make_pair(Scheduler::GetThis(), fiber));
+                    lock.unlock();
+                    Fiber::YieldToHold(Fiber::PARK_EXTERNAL);
+                } else {
+                    Semaphore sem;
+                    flight->threads.push_back(&sem);
+                    lock.unlock();
+                    sem.wait();
+                }
+                CopyAddresses(result, flight->addrs);
+                return flight->ok;
+            }
+        } else {
+            ShrinkLookupShard(shard, now);
+        }
+        flight.reset(new LookupFlight);
+        shard.entries[key].flight = flight;
+    }
+
+    std::vector<Address::ptr> addrs;
+    uint64_t ttl_ms = (uint64_t)-1;
+    bool ok = DoLookup(addrs, host, family, type, protocol, &ttl_ms);
+
+    std::vector<std::pair<Scheduler*, Fiber::ptr> > fibers;
+    std::vector<Semaphore*> threads;
+    {
+        Mutex::Lock lock(shard.mutex);
+        flight->ok = ok;
+        flight->addrs = addrs;
+        fibers.swap(flight->fibers);
+        threads.swap(flight->threads);
+
+        LookupEntry& entry = shard.entries[key];
+        entry.ok = ok;
+        entry.addrs.swap(addrs);
+        // 成功的结果不能比DNS记录的TTL活得久，否则短TTL的切换会被这层缓存挡住
+        uint64_t ttl = ok ? std::min((uint64_t)s_lookup_cache_ttl, ttl_ms) : (uint64_t)s_lookup_cache_negative_ttl;
+        entry.expire = GetCurrentMS() + ttl;
+        entry.flight.reset();
+    }
+    for(auto& i : fibers) {
+        i.first->schedule(i.second);
+    }
+    for(auto& i : threads) {
+        i->notify();
+    }
+    CopyAddresses(result, flight->addrs);
+    return ok;
+}
+
+void Address::ClearLookupCache() {
+    LookupShard* shards = GetLookupShards();
+    for(size_t i = 0; i < LOOKUP_SHARD_COUNT; ++i) {
+        Mutex::Lock lock(shards[i].mutex);
+        for(auto it = shards[i].entries.begin(); it != shards[i].entries.end();) {
+            if(!it->second.flight) {
+                it = shards[i].entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+//网卡地址按family整体缓存
+struct InterfaceCacheEntry {
+    bool ok = false;
+    std::multimap<std::string, std::pair<Address::ptr, uint32_t> > addrs;
+    uint64_t expire = 0;
+};
+
+static Mutex s_interface_cache_mutex;
+static std::map<int, InterfaceCacheEntry> s_interface_cache;
+
+bool Address::GetInterfaceAddresses(std::multimap<std::string
+                    ,std::pair<Address::ptr, uint32_t> >& result,
+                    int family) {
+    if(s_interface_cache_ttl == 0) {
+        return DoGetInterfaceAddresses(result, family);
+    }
+    {
+        Mutex::Lock lock(s_interface_cache_mutex);
+        auto it = s_interface_cache.find(family);
+        if(it != s_interface_cache.end() && it->second.expire > GetCurrentMS()) {
+            for(auto& i : it->second.addrs) {
+                result.insert(std::make_pair(i.first, std::make_pair(
+                        Address::Create(i.second.first->getAddr(), i.second.first->getAddrLen()),
+                        i.second.second)));
+            }
+            return it->second.ok;
+        }
+    }
+
+    std::multimap<std::string, std::pair<Address::ptr, uint32_t> > addrs;
+    bool ok = DoGetInterfaceAddresses(addrs, family);
+    for(auto& i : addrs) {
+        result.insert(std::make_pair(i.first, std::make_pair(
+                Address::Create(i.second.first->getAddr(), i.second.first->getAddrLen()),
+                i.second.second)));
+    }
+
+    Mutex::Lock lock(s_interface_cache_mutex);
+    InterfaceCacheEntry& entry = s_interface_cache[family];
+    entry.ok = ok;
+    entry.addrs.swap(addrs);
+    entry.expire = GetCurrentMS() + (ok ? s_interface_cache_ttl : s_lookup_cache_negative_ttl);
+    return ok;
+}
+
 bool Address::GetInterfaceAddresses(std::vector<std::pair<Address::ptr, uint32_t> >&result
                     ,const std::string& iface, int family) {
     if(iface.empty() || iface == "*") {
@@ -47,6 +47,7 @@ public:
      * @param[in] type socketl类型SOCK_STREAM、SOCK_DGRAM 等
      * @param[in] protocol 协议,IPPROTO_TCP、IPPROTO_UDP 等
      * @return 返回是否转换成功
+     * @details 结果(包括失败)按address.cache.*配置缓存, 同一个host并发查询时只解析一次
      */
     static bool Lookup(std::vector<Address::ptr>& result, const std::string& host,
             int family = AF_INET, int type = 0, int protocol = 0);
@@ -71,6 +72,11 @@ public:
     static std::shared_ptr<IPAddress> LookupAnyIPAddress(const std::string& host,
             int family = AF_INET, int type = 0, int protocol = 0);
 
+    /**
+     * @brief 清空Lookup的结果缓存(正在解析中的不受影响)
+     */
+    static void ClearLookupCache();
+
     /**
      * @brief 返回本机所有网卡的<网卡名, 地址, 子网掩码位数>
      * @param[out] result 保存本机所有地址
@@ -0,0 +1,619 @@
+#include "bytearray.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string.h>
+#include "util.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr bytearray_logger = SYLAR_LOG_NAME("system");
+
+ByteArray::Node::Node(size_t s)
+    :ptr(new char[s])
+    ,next(nullptr)
+    ,size(s) {
+}
+
+ByteArray::Node::Node()
+    :ptr(nullptr)
+    ,next(nullptr)
+    ,size(0) {
+}
+
+ByteArray::Node::~Node() {
+    if(ptr) {
+        delete[] ptr;
+    }
+}
+
+ByteArray::ByteArray(size_t base_size)
+    :m_baseSize(base_size ? base_size : 4096)
+    ,m_position(0)
+    ,m_capacity(m_baseSize)
+    ,m_size(0)
+    ,m_endian(SYLAR_BIG_ENDIAN)
+    ,m_root(new Node(m_baseSize))
+    ,m_cur(m_root) {
+}
+
+ByteArray::~ByteArray() {
+    Node* tmp = m_root;
+    while(tmp) {
+        m_cur = tmp;
+        tmp = tmp->next;
+        delete m_cur;
+    }
+}
+
+bool ByteArray::isLittleEndian() const {
+    return m_endian == SYLAR_LITTLE_ENDIAN;
+}
+
+void ByteArray::setIsLittleEndian(bool val) {
+    m_endian = val ? SYLAR_LITTLE_ENDIAN : SYLAR_BIG_ENDIAN;
+}
+
+static uint32_t EncodeZigzag32(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static uint64_t EncodeZigzag64(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int32_t DecodeZigzag32(uint32_t v) {
+    return (int32_t)((v >> 1) ^ -(v & 1));
+}
+
+static int64_t DecodeZigzag64(uint64_t v) {
+    return (int64_t)((v >> 1) ^ -(v & 1));
+}
+
+void ByteArray::writeFint8(int8_t value) {
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFuint8(uint8_t value) {
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFint16(int16_t value) {
+    if(m_endian != SYLAR_BYTE_ORDER) {
+        value = byteswap(value);
+    }
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFuint16(uint16_t value) {
+    if(m_endian != SYLAR_BYTE_ORDER) {
+        value = byteswap(value);
+    }
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFint32(int32_t value) {
+    if(m_endian != SYLAR_BYTE_ORDER) {
+        value = byteswap(value);
+    }
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFuint32(uint32_t value) {
+    if(m_endian != SYLAR_BYTE_ORDER) {
+        value = byteswap(value);
+    }
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFint64(int64_t value) {
+    if(m_endian != SYLAR_BYTE_ORDER) {
+        value = byteswap(value);
+    }
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFuint64(uint64_t value) {
+    if(m_endian != SYLAR_BYTE_ORDER) {
+        value = byteswap(value);
+    }
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeVarint(uint64_t value) {
+    // 当前块剩余空间够放最长的varint就直接编码进去，省掉一次临时缓冲和memcpy
+    if(getContiguous() >= 10) {
+        uint8_t* p = (uint8_t*)m_cur->ptr + m_position % m_baseSize;
+        size_t i = 0;
+        while(value >= 0x80) {
+            p[i++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        p[i++] = value;
+        advance(i);
+        return;
+    }
+    uint8_t tmp[10];
+    size_t i = 0;
+    while(value >= 0x80) {
+        tmp[i++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    tmp[i++] = value;
+    write(tmp, i);
+}
+
+void ByteArray::writeInt32(int32_t value) {
+    writeVarint(EncodeZigzag32(value));
+}
+
+void ByteArray::writeUint32(uint32_t value) {
+    writeVarint(value);
+}
+
+void ByteArray::writeInt64(int64_t value) {
+    writeVarint(EncodeZigzag64(value));
+}
+
+void ByteArray::writeUint64(uint64_t value) {
+    writeVarint(value);
+}
+
+void ByteArray::writeFloat(float value) {
+    uint32_t v;
+    memcpy(&v, &value, sizeof(value));
+    writeFuint32(v);
+}
+
+void ByteArray::writeDouble(double value) {
+    uint64_t v;
+    memcpy(&v, &value, sizeof(value));
+    writeFuint64(v);
+}
+
+void ByteArray::writeStringF16(const std::string& value) {
+    writeFuint16(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringF32(const std::string& value) {
+    writeFuint32(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringF64(const std::string& value) {
+    writeFuint64(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringVint(const std::string& value) {
+    writeUint64(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringWithoutLength(const std::string& value) {
+    write(value.c_str(), value.size());
+}
+
+int8_t ByteArray::readFint8() {
+    int8_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+
+uint8_t ByteArray::readFuint8() {
+    uint8_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+
+#define XX(type) \
+    type v; \
+    read(&v, sizeof(v)); \
+    if(m_endian == SYLAR_BYTE_ORDER) { \
+        return v; \
+    } else { \
+        return byteswap(v); \
+    }
+
+int16_t ByteArray::readFint16() {
+    XX(int16_t);
+}
+uint16_t ByteArray::readFuint16() {
+    XX(uint16_t);
+}
+
+int32_t ByteArray::readFint32() {
+    XX(int32_t);
+}
+
+uint32_t ByteArray::readFuint32() {
+    XX(uint32_t);
+}
+
+int64_t ByteArray::readFint64() {
+    XX(int64_t);
+}
+
+uint64_t ByteArray::readFuint64() {
+    XX(uint64_t);
+}
+
+#undef XX
+
+uint64_t ByteArray::readVarint(size_t max_bytes) {
+    uint64_t result = 0;
+    // 整个varint都在当前块里时直接解码，不逐字节走read
+    size_t avail = std::min(getContiguous(), getReadSize());
+    const uint8_t* p = m_cur ? (const uint8_t*)m_cur->ptr + m_position % m_baseSize : nullptr;
+    size_t n = std::min(avail, max_bytes);
+    for(size_t i = 0; i < n; ++i) {
+        result |= ((uint64_t)(p[i] & 0x7F)) << (7 * i);
+        if(p[i] < 0x80) {
+            advance(i + 1);
+            return result;
+        }
+    }
+    if(n == max_bytes) {
+        throw std::out_of_range("varint too long");
+    }
+
+    result = 0;
+    for(size_t i = 0; i < max_bytes; ++i) {
+        uint8_t b = readFuint8();
+        result |= ((uint64_t)(b & 0x7F)) << (7 * i);
+        if(b < 0x80) {
+            return result;
+        }
+    }
+    throw std::out_of_range("varint too long");
+}
+
+int32_t ByteArray::readInt32() {
+    return DecodeZigzag32(readUint32());
+}
+
+uint32_t ByteArray::readUint32() {
+    return readVarint(5);
+}
+
+int64_t ByteArray::readInt64() {
+    return DecodeZigzag64(readUint64());
+}
+
+uint64_t ByteArray::readUint64() {
+    return readVarint(10);
+}
+
+float ByteArray::readFloat() {
+    uint32_t v = readFuint32();
+    float value;
+    memcpy(&value, &v, sizeof(v));
+    return value;
+}
+
+double ByteArray::readDouble() {
+    uint64_t v = readFuint64();
+    double value;
+    memcpy(&value, &v, sizeof(v));
+    return value;
+}
+
+std::string ByteArray::readStringF16() {
+    uint16_t len = readFuint16();
+    if(len > getReadSize()) {
+        throw std::out_of_range("not enough len");
+    }
+    std::string buff;
+    buff.resize(len);
+    read(&buff[0], len);
+    return buff;
+}
+
+std::string ByteArray::readStringF32() {
+    uint32_t len = readFuint32();
+    if(len > getReadSize()) {
+        throw std::out_of_range("not enough len");
+    }
+    std::string buff;
+    buff.resize(len);
+    read(&buff[0], len);
+    return buff;
+}
+
+std::string ByteArray::readStringF64() {
+    uint64_t len = readFuint64();
+    if(len > getReadSize()) {
+        throw std::out_of_range("not enough len");
+    }
+    std::string buff;
+    buff.resize(len);
+    read(&buff[0], len);
+    return buff;
+}
+
+std::string ByteArray::readStringVint() {
+    uint64_t len = readUint64();
+    if(len > getReadSize()) {
+        throw std::out_of_range("not enough len");
+    }
+    std::string buff;
+    buff.resize(len);
+    read(&buff[0], len);
+    return buff;
+}
+
+void ByteArray::clear() {
+    m_position = m_size = 0;
+    m_capacity = m_baseSize;
+    Node* tmp = m_root->next;
+    while(tmp) {
+        m_cur = tmp;
+        tmp = tmp->next;
+        delete m_cur;
+    }
+    m_cur = m_root;
+    m_root->next = nullptr;
+}
+
+size_t ByteArray::getContiguous() const {
+    return m_cur ? m_cur->size - m_position % m_baseSize : 0;
+}
+
+void ByteArray::advance(size_t size) {
+    m_position += size;
+    if(m_position % m_baseSize == 0) {
+        m_cur = m_cur->next;
+    }
+    if(m_position > m_size) {
+        m_size = m_position;
+    }
+}
+
+void ByteArray::write(const void* buf, size_t size) {
+    if(size == 0) {
+        return;
+    }
+    // 定长整数这类小写入基本都落在当前块里
+    if(getContiguous() >= size) {
+        memcpy(m_cur->ptr + m_position % m_baseSize, buf, size);
+        advance(size);
+        return;
+    }
+    addCapacity(size);
+
+    size_t npos = m_position % m_baseSize;
+    size_t ncap = m_cur->size - npos;
+    size_t bpos = 0;
+
+    while(size > 0) {
+        size_t n = std::min(ncap, size);
+        memcpy(m_cur->ptr + npos, (const char*)buf + bpos, n);
+        bpos += n;
+        size -= n;
+        advance(n);
+        npos = 0;
+        ncap = m_cur ? m_cur->size : 0;
+    }
+}
+
+void ByteArray::read(void* buf, size_t size) {
+    if(size > getReadSize()) {
+        throw std::out_of_range("not enough len");
+    }
+    if(size == 0) {
+        return;
+    }
+    if(getContiguous() >= size) {
+        memcpy(buf, m_cur->ptr + m_position % m_baseSize, size);
+        advance(size);
+        return;
+    }
+
+    size_t npos = m_position % m_baseSize;
+    size_t ncap = m_cur->size - npos;
+    size_t bpos = 0;
+    while(size > 0) {
+        size_t n = std::min(ncap, size);
+        memcpy((char*)buf + bpos, m_cur->ptr + npos, n);
+        bpos += n;
+        size -= n;
+        advance(n);
+        npos = 0;
+        ncap = m_cur ? m_cur->size : 0;
+    }
+}
+
+void ByteArray::read(void* buf, size_t size, size_t position) const {
+    if(position > m_size || size > m_size - position) {
+        throw std::out_of_range("not enough len");
+    }
+
+    Node* cur = m_root;
+    size_t npos = position;
+    while(cur && npos >= cur->size) {
+        npos -= cur->size;
+        cur = cur->next;
+    }
+    size_t bpos = 0;
+    while(size > 0) {
+        size_t n = std::min(cur->size - npos, size);
+        memcpy((char*)buf + bpos, cur->ptr + npos, n);
+        bpos += n;
+        size -= n;
+        cur = cur->next;
+        npos = 0;
+    }
+}
+
+void ByteArray::setPosition(size_t v) {
+    if(v > m_capacity) {
+        throw std::out_of_range("set_position out of range");
+    }
+    m_position = v;
+    if(m_position > m_size) {
+        m_size = m_position;
+    }
+    m_cur = m_root;
+    while(m_cur && v >= m_cur->size) {
+        v -= m_cur->size;
+        m_cur = m_cur->next;
+    }
+}
+
+bool ByteArray::writeToFile(const std::string& name) const {
+    std::ofstream ofs;
+    ofs.open(name, std::ios::trunc | std::ios::binary);
+    if(!ofs) {
+        SYLAR_LOG_ERROR(bytearray_logger) << "writeToFile name=" << name
+            << " error , errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    std::vector<iovec> iovs;
+    getReadBuffers(iovs);
+    for(auto& i : iovs) {
+        ofs.write((const char*)i.iov_base, i.iov_len);
+    }
+    return (bool)ofs;
+}
+
+bool ByteArray::readFromFile(const std::string& name) {
+    std::ifstream ifs;
+    ifs.open(name, std::ios::binary);
+    if(!ifs) {
+        SYLAR_LOG_ERROR(bytearray_logger) << "readFromFile name=" << name
+            << " error, errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    std::unique_ptr<char[]> buff(new char[m_baseSize]);
+    while(!ifs.eof()) {
+        ifs.read(buff.get(), m_baseSize);
+        write(buff.get(), ifs.gcount());
+    }
+    return true;
+}
+
+void ByteArray::addCapacity(size_t size) {
+    if(size == 0) {
+        return;
+    }
+    size_t old_cap = getCapacity();
+    if(old_cap >= size) {
+        return;
+    }
+
+    size = size - old_cap;
+    size_t count = (size + m_baseSize - 1) / m_baseSize;
+    // 从当前块往后找尾巴，不用每次从头遍历
+    Node* tmp = m_cur ? m_cur : m_root;
+    while(tmp->next) {
+        tmp = tmp->next;
+    }
+
+    Node* first = nullptr;
+    for(size_t i = 0; i < count; ++i) {
+        tmp->next = new Node(m_baseSize);
+        if(first == nullptr) {
+            first = tmp->next;
+        }
+        tmp = tmp->next;
+        m_capacity += m_baseSize;
+    }
+
+    if(old_cap == 0) {
+        m_cur = first;
+    }
+}
+
+std::string ByteArray::toString() const {
+    std::string str;
+    str.resize(getReadSize());
+    if(str.empty()) {
+        return str;
+    }
+    read(&str[0], str.size(), m_position);
+    return str;
+}
+
+std::string ByteArray::toHexString() const {
+    std::string str = toString();
+    std::stringstream ss;
+
+    for(size_t i = 0; i < str.size(); ++i) {
+        if(i > 0 && i % 32 == 0) {
+            ss << std::endl;
+        }
+        ss << std::setw(2) << std::setfill('0') << std::hex
+           << (int)(uint8_t)str[i] << " ";
+    }
+
+    return ss.str();
+}
+
+uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len) const {
+    return getReadBuffers(buffers, len, m_position);
+}
+
+uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers
+                                ,uint64_t len, uint64_t position) const {
+    if(position >= m_size) {
+        return 0;
+    }
+    len = std::min(len, (uint64_t)(m_size - position));
+    if(len == 0) {
+        return 0;
+    }
+
+    uint64_t size = len;
+    // 当前位置对应的块就是m_cur，不用从头找
+    Node* cur = m_cur;
+    size_t npos = position % m_baseSize;
+    if(position != m_position) {
+        cur = m_root;
+        npos = position;
+        while(npos >= cur->size) {
+            npos -= cur->size;
+            cur = cur->next;
+        }
+    }
+
+    while(len > 0) {
+        size_t n = std::min((uint64_t)(cur->size - npos), len);
+        iovec iov;
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = n;
+        buffers.push_back(iov);
+        len -= n;
+        cur = cur->next;
+        npos = 0;
+    }
+    return size;
+}
+
+uint64_t ByteArray::getWriteBuffers(std::vector<iovec>& buffers, uint64_t len) {
+    if(len == 0) {
+        return 0;
+    }
+    addCapacity(len);
+    uint64_t size = len;
+
+    Node* cur = m_cur;
+    size_t npos = m_position % m_baseSize;
+    while(len > 0) {
+        size_t n = std::min((uint64_t)(cur->size - npos), len);
+        iovec iov;
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = n;
+        buffers.push_back(iov);
+        len -= n;
+        cur = cur->next;
+        npos = 0;
+    }
+    return size;
+}
+
+}
@@ -0,0 +1,349 @@
+/**
+ * @file bytearray.h
+ * @brief 二进制序列化缓冲区
+ */
+#ifndef __SYLAR_BYTEARRAY_H__
+#define __SYLAR_BYTEARRAY_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace sylar {
+
+/**
+ * @brief 二进制数组, 提供基础类型的序列化和反序列化
+ * @details 内存由固定大小的块串成链表, 扩容不搬数据
+ *          Fint/Fuint是定长编码, 按setIsLittleEndian指定的字节序(默认网络字节序)
+ *          Int/Uint是varint编码, 有符号数先做zigzag
+ *          getReadBuffers/getWriteBuffers把块直接导出成iovec给readv/writev用, 不拷贝
+ */
+class ByteArray {
+public:
+    typedef std::shared_ptr<ByteArray> ptr;
+
+    /**
+     * @brief ByteArray的存储节点
+     */
+    struct Node {
+        /**
+         * @brief 构造指定大小的内存块
+         * @param[in] s 内存块字节数
+         */
+        Node(size_t s);
+
+        /**
+         * @brief 无参构造函数
+         */
+        Node();
+
+        /**
+         * @brief 析构函数, 释放内存
+         */
+        ~Node();
+
+        /// 内存块地址指针
+        char* ptr;
+        /// 下一个内存块地址
+        Node* next;
+        /// 内存块大小
+        size_t size;
+    };
+
+    /**
+     * @brief 使用指定长度的内存块构造ByteArray
+     * @param[in] base_size 内存块大小
+     */
+    ByteArray(size_t base_size = 4096);
+
+    /**
+     * @brief 析构函数
+     */
+    ~ByteArray();
+
+    /**
+     * @brief 写入固定长度int8_t类型的数据
+     * @post m_position += sizeof(value)
+     *       如果m_position > m_size 则 m_size = m_position
+     */
+    void writeFint8  (int8_t value);
+    void writeFuint8 (uint8_t value);
+    void writeFint16 (int16_t value);
+    void writeFuint16(uint16_t value);
+    void writeFint32 (int32_t value);
+    void writeFuint32(uint32_t value);
+    void writeFint64 (int64_t value);
+    void writeFuint64(uint64_t value);
+
+    /**
+     * @brief 写入有符号Varint32类型的数据(zigzag)
+     * @post m_position += 实际占用内存(1 ~ 5)
+     */
+    void writeInt32  (int32_t value);
+
+    /**
+     * @brief 写入无符号Varint32类型的数据
+     * @post m_position += 实际占用内存(1 ~ 5)
+     */
+    void writeUint32 (uint32_t value);
+
+    /**
+     * @brief 写入有符号Varint64类型的数据(zigzag)
+     * @post m_position += 实际占用内存(1 ~ 10)
+     */
+    void writeInt64  (int64_t value);
+
+    /**
+     * @brief 写入无符号Varint64类型的数据
+     * @post m_position += 实际占用内存(1 ~ 10)
+     */
+    void writeUint64 (uint64_t value);
+
+    /**
+     * @brief 写入float类型的数据
+     */
+    void writeFloat  (float value);
+
+    /**
+     * @brief 写入double类型的数据
+     */
+    void writeDouble (double value);
+
+    /**
+     * @brief 写入std::string类型的数据, 用uint16_t作为长度类型
+     * @post m_position += 2 + value.size()
+     */
+    void writeStringF16(const std::string& value);
+
+    /**
+     * @brief 写入std::string类型的数据, 用uint32_t作为长度类型
+     */
+    void writeStringF32(const std::string& value);
+
+    /**
+     * @brief 写入std::string类型的数据, 用uint64_t作为长度类型
+     */
+    void writeStringF64(const std::string& value);
+
+    /**
+     * @brief 写入std::string类型的数据, 用无符号Varint64作为长度类型
+     */
+    void writeStringVint(const std::string& value);
+
+    /**
+     * @brief 写入std::string类型的数据, 无长度
+     */
+    void writeStringWithoutLength(const std::string& value);
+
+    /**
+     * @brief 读取定长数据
+     * @pre getReadSize() >= sizeof(返回类型)
+     * @exception 如果getReadSize() < sizeof(返回类型) 抛出 std::out_of_range
+     */
+    int8_t   readFint8();
+    uint8_t  readFuint8();
+    int16_t  readFint16();
+    uint16_t readFuint16();
+    int32_t  readFint32();
+    uint32_t readFuint32();
+    int64_t  readFint64();
+    uint64_t readFuint64();
+
+    /**
+     * @brief 读取varint数据
+     * @exception 数据不完整或者超出类型范围时抛出 std::out_of_range
+     */
+    int32_t  readInt32();
+    uint32_t readUint32();
+    int64_t  readInt64();
+    uint64_t readUint64();
+
+    /**
+     * @brief 读取float类型的数据
+     */
+    float    readFloat();
+
+    /**
+     * @brief 读取double类型的数据
+     */
+    double   readDouble();
+
+    /**
+     * @brief 读取std::string类型的数据, 用uint16_t作为长度
+     */
+    std::string readStringF16();
+
+    /**
+     * @brief 读取std::string类型的数据, 用uint32_t作为长度
+     */
+    std::string readStringF32();
+
+    /**
+     * @brief 读取std::string类型的数据, 用uint64_t作为长度
+     */
+    std::string readStringF64();
+
+    /**
+     * @brief 读取std::string类型的数据, 用无符号Varint64作为长度
+     */
+    std::string readStringVint();
+
+    /**
+     * @brief 清空ByteArray
+     * @post m_position = 0, m_size = 0, 只保留第一个内存块
+     */
+    void clear();
+
+    /**
+     * @brief 写入size长度的数据
+     * @param[in] buf 内存缓存指针
+     * @param[in] size 数据大小
+     * @post m_position += size, 如果m_position > m_size 则 m_size = m_position
+     */
+    void write(const void* buf, size_t size);
+
+    /**
+     * @brief 读取size长度的数据
+     * @post m_position += size
+     * @exception 如果getReadSize() < size 则抛出 std::out_of_range
+     */
+    void read(void* buf, size_t size);
+
+    /**
+     * @brief 从position开始读取size长度的数据, 不改变当前位置
+     * @exception 如果 (m_size - position) < size 则抛出 std::out_of_range
+     */
+    void read(void* buf, size_t size, size_t position) const;
+
+    /**
+     * @brief 返回ByteArray当前位置
+     */
+    size_t getPosition() const { return m_position;}
+
+    /**
+     * @brief 设置ByteArray当前位置
+     * @post 如果m_position > m_size 则 m_size = m_position
+     * @exception 如果m_position > m_capacity 则抛出 std::out_of_range
+     */
+    void setPosition(size_t v);
+
+    /**
+     * @brief 把[m_position, m_size)的数据写入到文件中, 不改变当前位置
+     */
+    bool writeToFile(const std::string& name) const;
+
+    /**
+     * @brief 从文件中读取数据追加到当前位置
+     */
+    bool readFromFile(const std::string& name);
+
+    /**
+     * @brief 返回内存块的大小
+     */
+    size_t getBaseSize() const { return m_baseSize;}
+
+    /**
+     * @brief 返回可读取数据大小
+     */
+    size_t getReadSize() const { return m_size - m_position;}
+
+    /**
+     * @brief 是否是小端
+     */
+    bool isLittleEndian() const;
+
+    /**
+     * @brief 设置是否为小端
+     */
+    void setIsLittleEndian(bool val);
+
+    /**
+     * @brief 将[m_position, m_size)的数据转成std::string
+     */
+    std::string toString() const;
+
+    /**
+     * @brief 将[m_position, m_size)的数据转成16进制的std::string(格式:FF FF FF)
+     */
+    std::string toHexString() const;
+
+    /**
+     * @brief 获取可读取的缓存, 保存成iovec数组
+     * @param[out] buffers 保存可读取数据的iovec数组, 指向ByteArray内部的内存
+     * @param[in] len 读取数据的长度, 如果len > getReadSize() 则 len = getReadSize()
+     * @return 返回实际数据的长度
+     * @post 不改变m_position, writev成功之后再setPosition
+     */
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len = ~0ull) const;
+
+    /**
+     * @brief 从position位置开始获取可读取的缓存
+     */
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len, uint64_t position) const;
+
+    /**
+     * @brief 获取可写入的缓存, 保存成iovec数组
+     * @param[out] buffers 保存可写入的内存的iovec数组
+     * @param[in] len 写入的长度
+     * @return 返回实际的长度
+     * @post 如果(m_capacity - m_position) < len, 会扩容; 不改变m_position, readv之后再setPosition
+     */
+    uint64_t getWriteBuffers(std::vector<iovec>& buffers, uint64_t len);
+
+    /**
+     * @brief 返回数据的长度
+     */
+    size_t getSize() const { return m_size;}
+private:
+    /**
+     * @brief 扩容ByteArray, 使其可以容纳size个数据(原本就能容纳则不扩容)
+     */
+    void addCapacity(size_t size);
+
+    /**
+     * @brief 获取当前的可写入容量
+     */
+    size_t getCapacity() const { return m_capacity - m_position;}
+
+    /**
+     * @brief 当前块里从m_position开始连续可用的字节数
+     */
+    size_t getContiguous() const;
+
+    /**
+     * @brief m_position前进size, 都在当前块里
+     */
+    void advance(size_t size);
+
+    /**
+     * @brief 写入varint, 当前块放得下时直接编码进块里
+     */
+    void writeVarint(uint64_t value);
+
+    /**
+     * @brief 读取最多max_bytes字节的varint
+     */
+    uint64_t readVarint(size_t max_bytes);
+private:
+    /// 内存块的大小
+    size_t m_baseSize;
+    /// 当前操作位置
+    size_t m_position;
+    /// 当前的总容量
+    size_t m_capacity;
+    /// 当前数据的大小
+    size_t m_size;
+    /// 字节序,默认大端
+    int8_t m_endian;
+    /// 第一个内存块指针
+    Node* m_root;
+    /// 当前操作的内存块指针
+    Node* m_cur;
+};
+
+}
+
+#endif
@@ -0,0 +1,417 @@
+/**
+ * @file channel.h
+ * @brief 协程间的有界MPMC通道
+ */
+#ifndef __SYLAR_CHANNEL_H__
+#define __SYLAR_CHANNEL_H__
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include "fiber_sync.h"
+#include "IOManager.h"
+#include "util.h"
+
+namespace sylar {
+
+/**
+ * @brief 在通道上挂起的协程
+ * @details select时同一个等待者挂在多个通道上, fired保证只被唤醒一次
+ */
+struct ChannelWaiter {
+    typedef std::shared_ptr<ChannelWaiter> ptr;
+
+    ChannelWaiter()
+        :waiter(FiberWaiter::Current())
+        ,fired(false) {
+    }
+
+    /**
+     * @brief 抢到唤醒权就唤醒
+     * @return 已经被别人唤醒(或者已经取消)返回false
+     */
+    bool fire() {
+        if(fired.exchange(true)) {
+            return false;
+        }
+        waiter.wake();
+        return true;
+    }
+
+    FiberWaiter waiter;
+    std::atomic<bool> fired;
+};
+
+/**
+ * @brief 有界的多生产者多消费者通道
+ * @details 数据放在Vyukov的有界无锁环形队列里, 不满不空时send/recv只有几次原子操作, 不分配内存
+ *          满了或者空了才把协程挂到等待队列上; 对方在有等待者时(计数不为0)才去拿锁唤醒
+ *          被唤醒的协程重新去抢, 抢到之后如果还有数据/空位而且还有等待者, 接力唤醒下一个
+ *          超时由当前IOManager的定时器触发
+ * @pre 会挂起的接口只能在调度器的协程里调用, T可以默认构造并且可以移动赋值
+ */
+template<class T>
+class Channel : Noncopyable {
+public:
+    typedef std::shared_ptr<Channel> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] capacity 容量, 向上取整到2的幂
+     */
+    Channel(size_t capacity)
+        :m_closed(false)
+        ,m_sendWaiting(0)
+        ,m_recvWaiting(0) {
+        size_t cap = 2;
+        while(cap < capacity) {
+            cap <<= 1;
+        }
+        m_mask = cap - 1;
+        m_cells = new Cell[cap];
+        for(size_t i = 0; i < cap; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        m_enqueuePos.store(0, std::memory_order_relaxed);
+        m_dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ~Channel() {
+        delete[] m_cells;
+    }
+
+    /**
+     * @brief 不挂起地发送
+     * @return 满了或者已经关闭返回false
+     */
+    bool trySend(T v) {
+        if(m_closed || !push(v)) {
+            return false;
+        }
+        afterPush();
+        return true;
+    }
+
+    /**
+     * @brief 发送, 满了挂起等待
+     * @param[in] timeout_ms 超时时间, ~0ull表示一直等
+     * @return 超时或者通道关闭返回false
+     */
+    bool send(T v, uint64_t timeout_ms = ~0ull) {
+        uint64_t deadline = Deadline(timeout_ms);
+        while(true) {
+            if(m_closed) {
+                return false;
+            }
+            if(push(v)) {
+                afterPush();
+                return true;
+            }
+            if(Expired(deadline)) {
+                return false;
+            }
+            ChannelWaiter::ptr node(new ChannelWaiter);
+            addWaiter(m_sendq, m_sendWaiting, node);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_closed || size() < capacity()) {
+                Cancel(node, this, 1, true);
+                continue;
+            }
+            Park(node, deadline);
+            delWaiter(m_sendq, m_sendWaiting, node);
+        }
+    }
+
+    /**
+     * @brief 不挂起地接收
+     * @return 空的时候返回false
+     */
+    bool tryRecv(T& v) {
+        if(!pop(v)) {
+            return false;
+        }
+        afterPop();
+        return true;
+    }
+
+    /**
+     * @brief 接收, 空了挂起等待
+     * @param[in] timeout_ms 超时时间, ~0ull表示一直等
+     * @return 超时, 或者通道关闭并且数据已经取完返回false
+     */
+    bool recv(T& v, uint64_t timeout_ms = ~0ull) {
+        Channel* self = this;
+        return Select(&self, 1, v, timeout_ms) == 0;
+    }
+
+    /**
+     * @brief 从多个通道中的任意一个接收
+     * @param[in] chs 通道数组
+     * @param[in] n 通道个数
+     * @param[out] v 接收到的数据
+     * @param[in] timeout_ms 超时时间, ~0ull表示一直等
+     * @return 接收到数据的通道下标, 超时或者全部关闭并且取完返回-1
+     */
+    static int Select(Channel** chs, size_t n, T& v, uint64_t timeout_ms = ~0ull) {
+        uint64_t deadline = Deadline(timeout_ms);
+        // 起点轮转，避免总是先取第一个通道
+        static thread_local size_t s_start = 0;
+        size_t start = s_start++;
+        while(true) {
+            bool all_closed = true;
+            for(size_t k = 0; k < n; ++k) {
+                size_t i = (start + k) % n;
+                if(chs[i]->pop(v)) {
+                    chs[i]->afterPop();
+                    return i;
+                }
+                all_closed = all_closed && chs[i]->m_closed;
+            }
+            if(all_closed) {
+                // close之前已经放进去的数据还要取
+                for(size_t i = 0; i < n; ++i) {
+                    if(chs[i]->size() > 0) {
+                        all_closed = false;
+                    }
+                }
+                if(all_closed) {
+                    return -1;
+                }
+                continue;
+            }
+            if(Expired(deadline)) {
+                return -1;
+            }
+            ChannelWaiter::ptr node(new ChannelWaiter);
+            for(size_t i = 0; i < n; ++i) {
+                chs[i]->addWaiter(chs[i]->m_recvq, chs[i]->m_recvWaiting, node);
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool ready = false;
+            for(size_t i = 0; i < n && !ready; ++i) {
+                ready = chs[i]->m_closed || chs[i]->size() > 0;
+            }
+            if(ready) {
+                Cancel(node, chs, n, false);
+                continue;
+            }
+            Park(node, deadline);
+            for(size_t i = 0; i < n; ++i) {
+                chs[i]->delWaiter(chs[i]->m_recvq, chs[i]->m_recvWaiting, node);
+            }
+        }
+    }
+
+    /**
+     * @brief 关闭通道, 唤醒所有等待者
+     * @details 之后send失败, recv把剩下的数据取完之后失败
+     */
+    void close() {
+        std::deque<ChannelWaiter::ptr> nodes;
+        {
+            Spinlock::Lock lock(m_guard);
+            m_closed = true;
+            nodes.swap(m_sendq);
+            nodes.insert(nodes.end(), m_recvq.begin(), m_recvq.end());
+            m_recvq.clear();
+            m_sendWaiting = 0;
+            m_recvWaiting = 0;
+        }
+        for(auto& i : nodes) {
+            i->fire();
+        }
+    }
+
+    bool isClosed() const { return m_closed;}
+
+    /**
+     * @brief 当前数据个数(近似值)
+     */
+    size_t size() const {
+        size_t e = m_enqueuePos.load(std::memory_order_acquire);
+        size_t d = m_dequeuePos.load(std::memory_order_acquire);
+        return e > d ? e - d : 0;
+    }
+
+    size_t capacity() const { return m_mask + 1;}
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    static uint64_t Deadline(uint64_t timeout_ms) {
+        return timeout_ms == ~0ull ? ~0ull : GetCurrentMS() + timeout_ms;
+    }
+
+    static bool Expired(uint64_t deadline) {
+        return deadline != ~0ull && GetCurrentMS() >= deadline;
+    }
+
+    /**
+     * @brief 挂起直到被唤醒或者到达deadline
+     */
+    static void Park(ChannelWaiter::ptr node, uint64_t deadline) {
+        Timer::ptr timer;
+        if(deadline != ~0ull) {
+            uint64_t now = GetCurrentMS();
+            std::weak_ptr<ChannelWaiter> weak(node);
+            timer = IOManager::GetThis()->addConditionTimer(deadline > now ? deadline - now : 0, [weak](){
+                ChannelWaiter::ptr n = weak.lock();
+                if(n) {
+                    n->fire();
+                }
+            }, weak);
+        }
+        Fiber::YieldToHold(Fiber::PARK_CHANNEL);
+        if(timer) {
+            timer->cancel();
+        }
+    }
+
+    /**
+     * @brief 取消已经登记但是不打算挂起的等待
+     * @details 如果已经有人抢到了唤醒权, 调度请求一定会来, 要挂起一次把它消化掉
+     */
+    static void Cancel(ChannelWaiter::ptr node, Channel** chs, size_t n, bool send) {
+        bool fired = node->fired.exchange(true);
+        for(size_t i = 0; i < n; ++i) {
+            if(send) {
+                chs[i]->delWaiter(chs[i]->m_sendq, chs[i]->m_sendWaiting, node);
+            } else {
+                chs[i]->delWaiter(chs[i]->m_recvq, chs[i]->m_recvWaiting, node);
+            }
+        }
+        if(fired) {
+            Fiber::YieldToHold(Fiber::PARK_CHANNEL);
+        }
+    }
+
+    static void Cancel(ChannelWaiter::ptr node, Channel* ch, size_t n, bool send) {
+        Cancel(node, &ch, n, send);
+    }
+
+    bool push(T& v) {
+        Cell* cell;
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        while(true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if(dif == 0) {
+                if(m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if(dif < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(v);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& v) {
+        Cell* cell;
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        while(true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if(dif == 0) {
+                if(m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if(dif < 0) {
+                return false;
+            } else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        v = std::move(cell->data);
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 放入之后唤醒一个接收者, 还有空位再接力唤醒一个发送者
+     */
+    void afterPush() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(m_recvWaiting.load(std::memory_order_relaxed)) {
+            wakeOne(m_recvq, m_recvWaiting);
+        }
+        if(m_sendWaiting.load(std::memory_order_relaxed) && size() < capacity()) {
+            wakeOne(m_sendq, m_sendWaiting);
+        }
+    }
+
+    /**
+     * @brief 取出之后唤醒一个发送者, 还有数据再接力唤醒一个接收者
+     */
+    void afterPop() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(m_sendWaiting.load(std::memory_order_relaxed)) {
+            wakeOne(m_sendq, m_sendWaiting);
+        }
+        if(m_recvWaiting.load(std::memory_order_relaxed) && size() > 0) {
+            wakeOne(m_recvq, m_recvWaiting);
+        }
+    }
+
+    void addWaiter(std::deque<ChannelWaiter::ptr>& q, std::atomic<int>& waiting, ChannelWaiter::ptr node) {
+        Spinlock::Lock lock(m_guard);
+        q.push_back(node);
+        ++waiting;
+    }
+
+    void delWaiter(std::deque<ChannelWaiter::ptr>& q, std::atomic<int>& waiting, ChannelWaiter::ptr node) {
+        Spinlock::Lock lock(m_guard);
+        auto it = std::find(q.begin(), q.end(), node);
+        if(it != q.end()) {
+            q.erase(it);
+            --waiting;
+        }
+    }
+
+    void wakeOne(std::deque<ChannelWaiter::ptr>& q, std::atomic<int>& waiting) {
+        while(true) {
+            ChannelWaiter::ptr node;
+            {
+                Spinlock::Lock lock(m_guard);
+                if(q.empty()) {
+                    return;
+                }
+                node = q.front();
+                q.pop_front();
+                --waiting;
+            }
+            // select的等待者可能已经被别的通道唤醒，跳过找下一个
+            if(node->fire()) {
+                return;
+            }
+        }
+    }
+private:
+    Cell* m_cells;
+    size_t m_mask;
+    /// 生产和消费的位置中间隔开一个缓存行, 避免伪共享
+    char m_pad0[64];
+    std::atomic<size_t> m_enqueuePos;
+    char m_pad1[64];
+    std::atomic<size_t> m_dequeuePos;
+    char m_pad2[64];
+    std::atomic<bool> m_closed;
+    std::atomic<int> m_sendWaiting;
+    std::atomic<int> m_recvWaiting;
+    Spinlock m_guard;
+    std::deque<ChannelWaiter::ptr> m_sendq;
+    std::deque<ChannelWaiter::ptr> m_recvq;
+};
+
+}
+
+#endif
@@ -1,25 +1,30 @@
 #include "./config.h"
 #include "log.h"
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace sylar{
 
 ConfigVarBase::ptr Config::LookupBase(const std::string& name) {
-    RWMutexType::ReadLock lock(GetMutex());
-    auto it = GetDatas().find(name);
-    return it==GetDatas().end() ? nullptr : it->second;
+    return FindInShard(GetShard(name), name);
 }
 
 void Config::Visit(std::function<void(ConfigVarBase::ptr)> cb) {
-    RWMutexType::ReadLock lock(GetMutex());
-    ConfigVarMap &m = GetDatas();
-    for (auto it = m.begin(); it != m.end(); it++){
-        cb(it->second);
+    Shard *shards = GetShards();
+    for(size_t i = 0; i < SHARD_COUNT; i++) {
+        for(ConfigVarNode *node = shards[i].head.load(std::memory_order_acquire);
+                node; node = node->next) {
+            cb(node->var);
+        }
     }
 }
 
 static void ListAllMember(const std::string& prefix, const YAML::Node& node,
                         std::list<std::pair<std::string, const YAML::Node>>& output) {
-    if(prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._012345678") != std::string::npos) {
+    if(prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789") != std::string::npos) {
         SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config invalid name :" << prefix << " : " << node;
         return;
     }          
@@ -56,4 +61,128 @@ void Config::LoadFromYaml(const YAML::Node& root){
     }
 }
 
+// 快照格式(本机字节序):
+// magic(4) version(4) count(4)
+// 之后每项: name(len+data) typename(len+data) value(len+data)
+static const uint32_t s_snapshot_magic = 0x46435953; // "SYCF"
+static const uint32_t s_snapshot_version = 1;
+
+bool Config::SaveSnapshot(const std::string &path) {
+    std::string body;
+    uint32_t count = 0;
+    Visit([&body, &count](ConfigVarBase::ptr var){
+        std::string value;
+        var->toBinary(value);
+        BinaryCast<std::string>().encode(body, var->getName());
+        BinaryCast<std::string>().encode(body, var->getTypeName());
+        BinaryCast<std::string>().encode(body, value);
+        count++;
+    });
+
+    std::string header;
+    BinaryCast<uint32_t>().encode(header, s_snapshot_magic);
+    BinaryCast<uint32_t>().encode(header, s_snapshot_version);
+    BinaryCast<uint32_t>().encode(header, count);
+
+    // 先写临时文件再rename，避免别的进程读到写了一半的快照
+    std::string tmp = path + ".tmp";
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if(!ofs) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::SaveSnapshot open " << tmp << " fail";
+        return false;
+    }
+    ofs.write(header.c_str(), header.size());
+    ofs.write(body.c_str(), body.size());
+    ofs.close();
+    if(!ofs) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::SaveSnapshot write " << tmp << " fail";
+        unlink(tmp.c_str());
+        return false;
+    }
+    if(rename(tmp.c_str(), path.c_str())) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::SaveSnapshot rename " << tmp << " fail errno=" << errno;
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Config::LoadFromSnapshot(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromSnapshot open " << path << " fail errno=" << errno;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) || st.st_size == 0) {
+        close(fd);
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromSnapshot empty snapshot " << path;
+        return false;
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromSnapshot mmap " << path << " fail errno=" << errno;
+        return false;
+    }
+
+    const char *p = (const char*)addr;
+    const char *end = p + st.st_size;
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t count = 0;
+    bool ok = BinaryCast<uint32_t>().decode(p, end, magic)
+            && BinaryCast<uint32_t>().decode(p, end, version)
+            && BinaryCast<uint32_t>().decode(p, end, count)
+            && magic == s_snapshot_magic
+            && version == s_snapshot_version;
+    if(!ok) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromSnapshot invalid header " << path;
+    }
+
+    // 先把所有记录解码校验到staging里，整个文件都没问题才生效，避免只恢复一半
+    std::vector<std::pair<ConfigVarBase::ptr, std::function<void()>>> staging;
+    staging.reserve(ok ? count : 0);
+    std::string name;
+    std::string type;
+    std::string value;
+    for(uint32_t i = 0; ok && i < count; i++) {
+        if(!BinaryCast<std::string>().decode(p, end, name)
+                || !BinaryCast<std::string>().decode(p, end, type)
+                || !BinaryCast<std::string>().decode(p, end, value)) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromSnapshot truncated " << path;
+            ok = false;
+            break;
+        }
+        // 快照里有但是当前进程没注册的配置直接跳过
+        ConfigVarBase::ptr var = LookupBase(name);
+        if(!var) {
+            continue;
+        }
+        // 类型对不上说明快照和当前程序不配套，整个加载失败，调用方应该改走YAML
+        if(var->getTypeName() != type) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromSnapshot name=" << name
+                << " type mismatch " << type << " real type : " << var->getTypeName();
+            ok = false;
+            break;
+        }
+        std::function<void()> apply = var->prepareBinary(value.c_str(), value.size());
+        if(!apply) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromSnapshot corrupted value name=" << name
+                << " " << path;
+            ok = false;
+            break;
+        }
+        staging.push_back(std::make_pair(var, apply));
+    }
+    munmap(addr, st.st_size);
+
+    if(ok) {
+        for(auto &i : staging) {
+            i.second();
+        }
+    }
+    return ok;
+}
+
 }
\ No newline at end of file
@@ -12,6 +12,10 @@
 #include <unordered_set>
 #include <list>
 #include <functional>
+#include <atomic>
+#include <type_traits>
+#include <stdint.h>
+#include <string.h>
 #include "thread.h"
 
 namespace sylar{
@@ -31,6 +35,19 @@ public:
     virtual std::string toString() = 0;
     virtual bool fromString(const std::string &val) = 0;
     virtual std::string getTypeName() const = 0;
+
+    // 二进制序列化，配置快照使用，追加写入out
+    virtual void toBinary(std::string &out) = 0;
+    // 只解码校验不生效，成功时返回把值写进去的回调，失败返回空
+    virtual std::function<void()> prepareBinary(const char *data, size_t len) = 0;
+    bool fromBinary(const char *data, size_t len) {
+        std::function<void()> apply = prepareBinary(data, len);
+        if(!apply) {
+            return false;
+        }
+        apply();
+        return true;
+    }
 protected:
     std::string m_name;
     std::string m_description;
@@ -233,6 +250,208 @@ public:
     }
 };
 
+// 二进制编解码，用于配置快照，避免启动时走YAML解析
+// 只支持数值、string以及由它们组成的STL容器，其他类型由ConfigVar退化成ToStr/FromStr
+template<class T, class Enable = void>
+class BinaryCast;
+
+template<class T>
+struct IsBinaryCastable : public std::integral_constant<bool, std::is_arithmetic<T>::value> {};
+template<>
+struct IsBinaryCastable<std::string> : public std::true_type {};
+template<class T>
+struct IsBinaryCastable<std::vector<T>> : public IsBinaryCastable<T> {};
+template<class T>
+struct IsBinaryCastable<std::list<T>> : public IsBinaryCastable<T> {};
+template<class T>
+struct IsBinaryCastable<std::set<T>> : public IsBinaryCastable<T> {};
+template<class T>
+struct IsBinaryCastable<std::unordered_set<T>> : public IsBinaryCastable<T> {};
+template<class T>
+struct IsBinaryCastable<std::map<std::string, T>> : public IsBinaryCastable<T> {};
+template<class T>
+struct IsBinaryCastable<std::unordered_map<std::string, T>> : public IsBinaryCastable<T> {};
+
+template<>
+class BinaryCast<std::string>{
+public:
+    void encode(std::string &out, const std::string &v) {
+        uint32_t len = v.size();
+        out.append((const char*)&len, sizeof(len));
+        out.append(v);
+    }
+
+    bool decode(const char *&p, const char *end, std::string &v) {
+        uint32_t len = 0;
+        if(end - p < (ptrdiff_t)sizeof(len)) {
+            return false;
+        }
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        if(end - p < (ptrdiff_t)len) {
+            return false;
+        }
+        v.assign(p, len);
+        p += len;
+        return true;
+    }
+};
+
+// 数值类型直接按内存拷贝
+template<class T>
+class BinaryCast<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>{
+public:
+    void encode(std::string &out, const T &v) {
+        out.append((const char*)&v, sizeof(v));
+    }
+
+    bool decode(const char *&p, const char *end, T &v) {
+        if(end - p < (ptrdiff_t)sizeof(v)) {
+            return false;
+        }
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return true;
+    }
+};
+
+// vector list set unordered_set 编码都是 数量 + 每个元素
+template<class C, class T>
+class BinaryCastSequence{
+public:
+    void encode(std::string &out, const C &v) {
+        uint32_t size = v.size();
+        out.append((const char*)&size, sizeof(size));
+        for(auto &i : v) {
+            BinaryCast<T>().encode(out, i);
+        }
+    }
+
+    template<class Inserter>
+    bool decode(const char *&p, const char *end, Inserter ins) {
+        uint32_t size = 0;
+        if(!BinaryCast<uint32_t>().decode(p, end, size)) {
+            return false;
+        }
+        for(uint32_t i = 0; i < size; i++) {
+            T t;
+            if(!BinaryCast<T>().decode(p, end, t)) {
+                return false;
+            }
+            ins(t);
+        }
+        return true;
+    }
+};
+
+template<class T>
+class BinaryCast<std::vector<T>>{
+public:
+    void encode(std::string &out, const std::vector<T> &v) {
+        BinaryCastSequence<std::vector<T>, T>().encode(out, v);
+    }
+
+    bool decode(const char *&p, const char *end, std::vector<T> &v) {
+        v.clear();
+        return BinaryCastSequence<std::vector<T>, T>().decode(p, end, [&v](const T &t){ v.push_back(t); });
+    }
+};
+
+template<class T>
+class BinaryCast<std::list<T>>{
+public:
+    void encode(std::string &out, const std::list<T> &v) {
+        BinaryCastSequence<std::list<T>, T>().encode(out, v);
+    }
+
+    bool decode(const char *&p, const char *end, std::list<T> &v) {
+        v.clear();
+        return BinaryCastSequence<std::list<T>, T>().decode(p, end, [&v](const T &t){ v.push_back(t); });
+    }
+};
+
+template<class T>
+class BinaryCast<std::set<T>>{
+public:
+    void encode(std::string &out, const std::set<T> &v) {
+        BinaryCastSequence<std::set<T>, T>().encode(out, v);
+    }
+
+    bool decode(const char *&p, const char *end, std::set<T> &v) {
+        v.clear();
+        return BinaryCastSequence<std::set<T>, T>().decode(p, end, [&v](const T &t){ v.insert(t); });
+    }
+};
+
+template<class T>
+class BinaryCast<std::unordered_set<T>>{
+public:
+    void encode(std::string &out, const std::unordered_set<T> &v) {
+        BinaryCastSequence<std::unordered_set<T>, T>().encode(out, v);
+    }
+
+    bool decode(const char *&p, const char *end, std::unordered_set<T> &v) {
+        v.clear();
+        return BinaryCastSequence<std::unordered_set<T>, T>().decode(p, end, [&v](const T &t){ v.insert(t); });
+    }
+};
+
+// map unordered_map 编码是 数量 + 每个(key, value)
+template<class C, class T>
+class BinaryCastMapping{
+public:
+    void encode(std::string &out, const C &v) {
+        uint32_t size = v.size();
+        out.append((const char*)&size, sizeof(size));
+        for(auto &i : v) {
+            BinaryCast<std::string>().encode(out, i.first);
+            BinaryCast<T>().encode(out, i.second);
+        }
+    }
+
+    bool decode(const char *&p, const char *end, C &v) {
+        v.clear();
+        uint32_t size = 0;
+        if(!BinaryCast<uint32_t>().decode(p, end, size)) {
+            return false;
+        }
+        for(uint32_t i = 0; i < size; i++) {
+            std::string key;
+            T t;
+            if(!BinaryCast<std::string>().decode(p, end, key)
+                    || !BinaryCast<T>().decode(p, end, t)) {
+                return false;
+            }
+            v.insert(std::make_pair(key, t));
+        }
+        return true;
+    }
+};
+
+template<class T>
+class BinaryCast<std::map<std::string, T>>{
+public:
+    void encode(std::string &out, const std::map<std::string, T> &v) {
+        BinaryCastMapping<std::map<std::string, T>, T>().encode(out, v);
+    }
+
+    bool decode(const char *&p, const char *end, std::map<std::string, T> &v) {
+        return BinaryCastMapping<std::map<std::string, T>, T>().decode(p, end, v);
+    }
+};
+
+template<class T>
+class BinaryCast<std::unordered_map<std::string, T>>{
+public:
+    void encode(std::string &out, const std::unordered_map<std::string, T> &v) {
+        BinaryCastMapping<std::unordered_map<std::string, T>, T>().encode(out, v);
+    }
+
+    bool decode(const char *&p, const char *end, std::unordered_map<std::string, T> &v) {
+        return BinaryCastMapping<std::unordered_map<std::string, T>, T>().decode(p, end, v);
+    }
+};
+
 template<class T, class FromStr = LexicalCast<std::string, T>, class ToStr = LexicalCast<T, std::string>>
 class ConfigVar : public ConfigVarBase{
 public:
@@ -288,6 +507,27 @@ public:
 
     std::string getTypeName() const override { return typeid(T).name(); }
 
+    void toBinary(std::string &out) override {
+        RWMutexType::ReadLock lock(m_mutex);
+        encodeBinary(out, typename IsBinaryCastable<T>::type());
+    }
+
+    std::function<void()> prepareBinary(const char *data, size_t len) override {
+        try {
+            std::shared_ptr<T> v = std::make_shared<T>();
+            const char *p = data;
+            if(!decodeBinary(p, data + len, *v, typename IsBinaryCastable<T>::type()) || p != data + len) {
+                SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::prepareBinary corrupted value name=" << m_name;
+                return nullptr;
+            }
+            // 回调里用裸this，调用方要在执行前持有这个ConfigVar
+            return [this, v](){ setValue(*v); };
+        } catch (std::exception &e) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::prepareBinary exception " << e.what() << " convert: binary to " << typeid(m_val).name();
+        }
+        return nullptr;
+    }
+
     uint64_t addListener(on_change_callback cb) {
         static uint64_t s_fun_id = 0;
         RWMutexType::WriteLock lock(m_mutex);
@@ -311,6 +551,28 @@ public:
         RWMutexType::WriteLock lock(m_mutex);
         m_cbs.clear();
     }
+private:
+    void encodeBinary(std::string &out, std::true_type) {
+        BinaryCast<T>().encode(out, m_val);
+    }
+
+    // 自定义类型没有二进制编码，快照里存ToStr的结果
+    void encodeBinary(std::string &out, std::false_type) {
+        BinaryCast<std::string>().encode(out, ToStr()(m_val));
+    }
+
+    bool decodeBinary(const char *&p, const char *end, T &v, std::true_type) {
+        return BinaryCast<T>().decode(p, end, v);
+    }
+
+    bool decodeBinary(const char *&p, const char *end, T &v, std::false_type) {
+        std::string str;
+        if(!BinaryCast<std::string>().decode(p, end, str)) {
+            return false;
+        }
+        v = FromStr()(str);
+        return true;
+    }
 private:
     RWMutexType m_mutex;
     T m_val;
@@ -319,61 +581,97 @@ private:
 
 class Config{
 public:
-    typedef std::unordered_map<std::string, ConfigVarBase::ptr> ConfigVarMap;
-    typedef RWMutex RWMutexType;
+    typedef Mutex MutexType;
 
     template<class T>
     static typename ConfigVar<T>::ptr Lookup(const std::string &name,
                 const T& default_value, const std::string &description=""){
-        RWMutexType::WriteLock lock(GetMutex());
-        auto it = GetDatas().find(name);
-        if(it != GetDatas().end()) {
-            auto tmp = std::dynamic_pointer_cast<ConfigVar<T>>(it->second);
-            if (tmp) {
-                SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Lookup name = " << name << "exists";
-            return tmp;
-            } else {
-                SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Lookup name = " << name << " exists but type not. " << typeid(T).name() << ", real type : " << it->second->getTypeName();
-                return nullptr;
+        Shard &shard = GetShard(name);
+        ConfigVarBase::ptr base = FindInShard(shard, name);
+        if(!base) {
+            // 只有注册新key才加锁，而且只锁这个分片，不影响其他读者
+            MutexType::Lock lock(shard.mutex);
+            base = FindInShard(shard, name);
+            if(!base) {
+                if(name.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789") != std::string::npos) {
+                    SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Lookup name invalid " << name;
+                    throw std::invalid_argument(name);
+                }
+                typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_value, description));
+                ConfigVarNode *node = new ConfigVarNode;
+                node->name = name;
+                node->var = v;
+                node->next = shard.head.load(std::memory_order_relaxed);
+                shard.head.store(node, std::memory_order_release);
+                return v;
             }
         }
-        if(name.find_first_not_of("abcdefghijklmnopqrstuvwxyz._012345678") != std::string::npos) {
-            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Lookup name invalid " << name;
-            throw std::invalid_argument(name);
+        auto tmp = std::dynamic_pointer_cast<ConfigVar<T>>(base);
+        if (tmp) {
+            SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Lookup name = " << name << "exists";
+            return tmp;
         }
-        typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_value, description));
-        GetDatas()[name] = v;
-        return v;
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Lookup name = " << name << " exists but type not. " << typeid(T).name() << ", real type : " << base->getTypeName();
+        return nullptr;
     }
 
     template<class T>
     static typename ConfigVar<T>::ptr Lookup(const std::string &name) {
-        RWMutexType::ReadLock lock(GetMutex());
-        auto it = GetDatas().find(name);
-        if ( it == GetDatas().end() ){
+        ConfigVarBase::ptr base = LookupBase(name);
+        if (!base){
             return nullptr;
         }
         // 转换失败也是nullptr 所以lookup返回nullptr有两种情况，一种是真没这个键，另一种是没法转换
-        return std::dynamic_pointer_cast<ConfigVar<T>>(it->second);
+        return std::dynamic_pointer_cast<ConfigVar<T>>(base);
     }
 
     static void LoadFromYaml(const YAML::Node& root);
 
+    // 把当前所有ConfigVar的值编译成二进制快照，启动时LoadFromSnapshot直接恢复，不走YAML解析
+    // 所有记录都解码校验通过才会生效，返回false时什么都没改，调用方改走LoadFromYaml
+    static bool SaveSnapshot(const std::string &path);
+    static bool LoadFromSnapshot(const std::string &path);
+
     static ConfigVarBase::ptr LookupBase(const std::string& name);
 
     static void Visit(std::function<void(ConfigVarBase::ptr)> cb);
 private:
-    static ConfigVarMap &GetDatas() {
-        static ConfigVarMap s_datas;
-        return s_datas;
+    // 注册表按名字hash分片，每个分片是一个只增不删的链表
+    // 节点发布之后不再修改，所以查找和遍历都不需要加锁
+    struct ConfigVarNode {
+        std::string name;
+        ConfigVarBase::ptr var;
+        ConfigVarNode *next = nullptr;
+    };
+
+    struct Shard {
+        MutexType mutex;
+        std::atomic<ConfigVarNode*> head;
+
+        Shard() :head(nullptr) {}
+    };
+
+    static const size_t SHARD_COUNT = 64;
+
+    static Shard *GetShards() {
+        static Shard s_shards[SHARD_COUNT];
+        return s_shards;
     }
 
-    static RWMutexType &GetMutex() {
-        static RWMutexType s_mutex;
-        return s_mutex;
+    static Shard &GetShard(const std::string &name) {
+        return GetShards()[std::hash<std::string>()(name) % SHARD_COUNT];
     }
-};
 
+    static ConfigVarBase::ptr FindInShard(Shard &shard, const std::string &name) {
+        for(ConfigVarNode *node = shard.head.load(std::memory_order_acquire);
+                node; node = node->next) {
+            if(node->name == name) {
+                return node->var;
+            }
+        }
+        return nullptr;
+    }
+};
 }
 
 
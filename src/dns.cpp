@@ -0,0 +1,530 @@
+#include "dns.h"
+#include "config.h"
+#include "log.h"
+#include "util.h"
+#include <fstream>
+#include <algorithm>
+#include <sstream>
+#include <random>
+#include <string.h>
+#include <sys/time.h>
+
+namespace sylar {
+
+static sylar::Logger::ptr dns_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<std::vector<std::string> >::ptr g_dns_servers =
+    sylar::Config::Lookup("dns.servers", std::vector<std::string>(), "dns servers, empty means resolv.conf");
+static sylar::ConfigVar<uint32_t>::ptr g_dns_timeout =
+    sylar::Config::Lookup("dns.timeout", (uint32_t)2000, "dns query timeout ms");
+static sylar::ConfigVar<uint32_t>::ptr g_dns_attempts =
+    sylar::Config::Lookup("dns.attempts", (uint32_t)2, "dns query attempts per server");
+
+static const uint16_t DNS_PORT = 53;
+static const size_t DNS_HEADER_SIZE = 12;
+static const size_t DNS_MAX_UDP_SIZE = 512;
+
+static std::string ToLowerName(const std::string &name) {
+    std::string rt(name);
+    for(auto &c : rt) {
+        c = tolower(c);
+    }
+    if(!rt.empty() && rt.back() == '.') {
+        rt.pop_back();
+    }
+    return rt;
+}
+
+// 1.2.3.4  1.2.3.4:53  ::1  [::1]:53
+static IPAddress::ptr ParseServer(const std::string &str) {
+    std::string host = str;
+    uint16_t port = DNS_PORT;
+    if(!str.empty() && str[0] == '[') {
+        size_t pos = str.find(']');
+        if(pos == std::string::npos) {
+            return nullptr;
+        }
+        host = str.substr(1, pos - 1);
+        if(pos + 1 < str.size() && str[pos + 1] == ':') {
+            port = atoi(str.c_str() + pos + 2);
+        }
+    } else if(std::count(str.begin(), str.end(), ':') == 1) {
+        size_t pos = str.find(':');
+        host = str.substr(0, pos);
+        port = atoi(str.c_str() + pos + 1);
+    }
+    return IPAddress::Create(host.c_str(), port);
+}
+
+// 调用方会改端口，缓存里的地址不能直接给出去
+static IPAddress::ptr CopyAddress(IPAddress::ptr addr) {
+    return std::dynamic_pointer_cast<IPAddress>(Address::Create(addr->getAddr(), addr->getAddrLen()));
+}
+
+static void PutUint16(std::string &out, uint16_t v) {
+    out.push_back((char)(v >> 8));
+    out.push_back((char)(v & 0xff));
+}
+
+static uint16_t GetUint16(const uint8_t *p) {
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static uint32_t GetUint32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// 请求: 头部 + 一个问题，带RD标志
+static bool BuildQuery(std::string &out, uint16_t id, const std::string &name, uint16_t qtype) {
+    PutUint16(out, id);
+    PutUint16(out, 0x0100);
+    PutUint16(out, 1);
+    PutUint16(out, 0);
+    PutUint16(out, 0);
+    PutUint16(out, 0);
+
+    size_t begin = 0;
+    while(begin < name.size()) {
+        size_t end = name.find('.', begin);
+        if(end == std::string::npos) {
+            end = name.size();
+        }
+        size_t len = end - begin;
+        if(len == 0 || len > 63) {
+            return false;
+        }
+        out.push_back((char)len);
+        out.append(name, begin, len);
+        begin = end + 1;
+    }
+    out.push_back(0);
+    if(out.size() - DNS_HEADER_SIZE > 255 + 1) {
+        return false;
+    }
+    PutUint16(out, qtype);
+    PutUint16(out, 1);
+    return true;
+}
+
+// 跳过一个可能带压缩指针的域名，p停在域名之后
+static bool SkipName(const uint8_t *&p, const uint8_t *end) {
+    while(p < end) {
+        uint8_t len = *p;
+        if(len == 0) {
+            ++p;
+            return true;
+        }
+        if((len & 0xc0) == 0xc0) {
+            if(p + 2 > end) {
+                return false;
+            }
+            p += 2;
+            return true;
+        }
+        if(len & 0xc0) {
+            return false;
+        }
+        p += len + 1;
+    }
+    return false;
+}
+
+// 返回值同DnsResolver::query
+static int ParseResponse(std::vector<IPAddress::ptr> &result, uint32_t &ttl, const uint8_t *buf, size_t size,
+                         uint16_t id, uint16_t qtype) {
+    if(size < DNS_HEADER_SIZE || GetUint16(buf) != id) {
+        return -1;
+    }
+    uint16_t flags = GetUint16(buf + 2);
+    if(!(flags & 0x8000)) {
+        return -1;
+    }
+    uint16_t rcode = flags & 0x000f;
+    if(rcode == 3) {
+        return 1;
+    }
+    if(rcode != 0) {
+        return -1;
+    }
+    uint16_t qdcount = GetUint16(buf + 4);
+    uint16_t ancount = GetUint16(buf + 6);
+
+    const uint8_t *p = buf + DNS_HEADER_SIZE;
+    const uint8_t *end = buf + size;
+    for(uint16_t i = 0; i < qdcount; i++) {
+        if(!SkipName(p, end) || p + 4 > end) {
+            return -1;
+        }
+        p += 4;
+    }
+
+    ttl = (uint32_t)-1;
+    size_t old_size = result.size();
+    for(uint16_t i = 0; i < ancount; i++) {
+        if(!SkipName(p, end) || p + 10 > end) {
+            return -1;
+        }
+        uint16_t type = GetUint16(p);
+        uint16_t cls = GetUint16(p + 2);
+        uint32_t rr_ttl = GetUint32(p + 4);
+        uint16_t rdlen = GetUint16(p + 8);
+        p += 10;
+        if(p + rdlen > end) {
+            return -1;
+        }
+        // CNAME之类的记录跳过，递归服务器会把目标的A/AAAA一起带回来
+        if(cls == 1 && type == qtype) {
+            if(type == DnsResolver::A && rdlen == 4) {
+                result.push_back(IPAddress::ptr(new IPv4Address(GetUint32(p))));
+                ttl = std::min(ttl, rr_ttl);
+            } else if(type == DnsResolver::AAAA && rdlen == 16) {
+                result.push_back(IPAddress::ptr(new IPv6Address(p)));
+                ttl = std::min(ttl, rr_ttl);
+            }
+        }
+        p += rdlen;
+    }
+    return result.size() > old_size ? 0 : 1;
+}
+
+static uint16_t NextQueryId() {
+    static thread_local std::mt19937 s_rand(std::random_device{}());
+    return (uint16_t)s_rand();
+}
+
+DnsResolver::DnsResolver()
+    :m_timeout(g_dns_timeout->getValue())
+    ,m_attempts(g_dns_attempts->getValue())
+    ,m_ndots(1)
+    ,m_queryCount(0) {
+    loadHosts();
+
+    auto apply_servers = [this](const std::vector<std::string> &servers) {
+        if(servers.empty()) {
+            loadResolvConf();
+            return;
+        }
+        std::vector<Address::ptr> addrs;
+        for(auto &i : servers) {
+            IPAddress::ptr addr = ParseServer(i);
+            if(addr) {
+                addrs.push_back(addr);
+            } else {
+                SYLAR_LOG_ERROR(dns_logger) << "invalid dns server " << i;
+            }
+        }
+        setServers(addrs);
+    };
+    // search/ndots总是从resolv.conf来，dns.servers只替换服务器
+    loadResolvConf();
+    if(!g_dns_servers->getValue().empty()) {
+        apply_servers(g_dns_servers->getValue());
+    }
+
+    g_dns_servers->addListener([apply_servers](const std::vector<std::string> &old_value,
+                                              const std::vector<std::string> &new_value) {
+        apply_servers(new_value);
+    });
+    g_dns_timeout->addListener([this](const uint32_t &old_value, const uint32_t &new_value) {
+        m_timeout = new_value;
+    });
+    g_dns_attempts->addListener([this](const uint32_t &old_value, const uint32_t &new_value) {
+        m_attempts = new_value;
+    });
+}
+
+void DnsResolver::setServers(const std::vector<Address::ptr> &servers) {
+    MutexType::Lock lock(m_mutex);
+    m_servers = servers;
+    m_cache.clear();
+}
+
+std::vector<Address::ptr> DnsResolver::getServers() {
+    MutexType::Lock lock(m_mutex);
+    return m_servers;
+}
+
+void DnsResolver::setSearch(const std::vector<std::string> &search) {
+    std::vector<std::string> domains;
+    for(auto &i : search) {
+        std::string domain = ToLowerName(i);
+        if(!domain.empty()) {
+            domains.push_back(domain);
+        }
+    }
+    MutexType::Lock lock(m_mutex);
+    m_search.swap(domains);
+}
+
+std::vector<std::string> DnsResolver::getSearch() {
+    MutexType::Lock lock(m_mutex);
+    return m_search;
+}
+
+bool DnsResolver::loadResolvConf(const std::string &path) {
+    std::ifstream ifs(path);
+    if(!ifs) {
+        SYLAR_LOG_ERROR(dns_logger) << "open " << path << " fail";
+        return false;
+    }
+    std::vector<Address::ptr> servers;
+    std::vector<std::string> search;
+    std::string line;
+    while(std::getline(ifs, line)) {
+        std::stringstream ss(line);
+        std::string key;
+        ss >> key;
+        // search和domain以最后出现的为准
+        if(key == "search" || key == "domain") {
+            search.clear();
+            std::string domain;
+            while(ss >> domain) {
+                search.push_back(domain);
+            }
+        } else if(key == "nameserver") {
+            std::string value;
+            ss >> value;
+            IPAddress::ptr addr = ParseServer(value);
+            if(addr) {
+                servers.push_back(addr);
+            }
+        } else if(key == "options") {
+            std::string opt;
+            while(ss >> opt) {
+                if(opt.compare(0, 8, "timeout:") == 0) {
+                    m_timeout = atoi(opt.c_str() + 8) * 1000;
+                } else if(opt.compare(0, 9, "attempts:") == 0) {
+                    m_attempts = atoi(opt.c_str() + 9);
+                } else if(opt.compare(0, 6, "ndots:") == 0) {
+                    m_ndots = std::min(atoi(opt.c_str() + 6), 15);
+                }
+            }
+        }
+    }
+    setSearch(search);
+    setServers(servers);
+    return !servers.empty();
+}
+
+bool DnsResolver::loadHosts(const std::string &path) {
+    std::ifstream ifs(path);
+    if(!ifs) {
+        return false;
+    }
+    std::map<std::string, std::vector<IPAddress::ptr> > hosts;
+    std::string line;
+    while(std::getline(ifs, line)) {
+        size_t pos = line.find('#');
+        if(pos != std::string::npos) {
+            line.resize(pos);
+        }
+        std::stringstream ss(line);
+        std::string ip;
+        if(!(ss >> ip)) {
+            continue;
+        }
+        IPAddress::ptr addr = IPAddress::Create(ip.c_str());
+        if(!addr) {
+            continue;
+        }
+        std::string name;
+        while(ss >> name) {
+            hosts[ToLowerName(name)].push_back(addr);
+        }
+    }
+    MutexType::Lock lock(m_mutex);
+    m_hosts.swap(hosts);
+    return true;
+}
+
+void DnsResolver::clearCache() {
+    MutexType::Lock lock(m_mutex);
+    m_cache.clear();
+}
+
+bool DnsResolver::resolve(std::vector<IPAddress::ptr> &result, const std::string &name, int family,
+                          uint64_t *ttl_ms) {
+    uint64_t ttl = (uint64_t)-1;
+    if(ttl_ms) {
+        *ttl_ms = ttl;
+    }
+    if(name.empty()) {
+        return false;
+    }
+    // 本身就是IP
+    IPAddress::ptr numeric;
+    if(family == AF_INET) {
+        numeric = IPv4Address::Create(name.c_str());
+    } else if(family == AF_INET6) {
+        numeric = IPv6Address::Create(name.c_str());
+    } else {
+        numeric = IPAddress::Create(name.c_str());
+    }
+    if(numeric) {
+        result.push_back(numeric);
+        return true;
+    }
+
+    std::string key = ToLowerName(name);
+    {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_hosts.find(key);
+        if(it != m_hosts.end()) {
+            size_t old_size = result.size();
+            for(auto &i : it->second) {
+                if(family == AF_UNSPEC || i->getFamily() == family) {
+                    result.push_back(CopyAddress(i));
+                }
+            }
+            if(result.size() > old_size) {
+                return true;
+            }
+        }
+    }
+
+    for(auto &i : expandName(name)) {
+        bool ok = false;
+        if(family == AF_INET || family == AF_UNSPEC) {
+            ok = resolveType(result, i, A, ttl) || ok;
+        }
+        if(family == AF_INET6 || family == AF_UNSPEC) {
+            ok = resolveType(result, i, AAAA, ttl) || ok;
+        }
+        if(ok) {
+            if(ttl_ms) {
+                *ttl_ms = ttl;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// 和res_search一样: .结尾的绝对域名只查自己; 点数不少于ndots先查自己再拼search; 否则先拼search最后查自己
+std::vector<std::string> DnsResolver::expandName(const std::string &name) {
+    std::string key = ToLowerName(name);
+    std::vector<std::string> names;
+    if(name.back() == '.') {
+        names.push_back(key);
+        return names;
+    }
+    bool enough_dots = (uint32_t)std::count(key.begin(), key.end(), '.') >= m_ndots;
+    if(enough_dots) {
+        names.push_back(key);
+    }
+    for(auto &i : getSearch()) {
+        names.push_back(key + "." + i);
+    }
+    if(!enough_dots) {
+        names.push_back(key);
+    }
+    return names;
+}
+
+// 成功时把ttl_ms收紧到这条记录剩余的有效期
+bool DnsResolver::resolveType(std::vector<IPAddress::ptr> &result, const std::string &name, QueryType type,
+                              uint64_t &ttl_ms) {
+    std::string key = name + (type == A ? "/A" : "/AAAA");
+    uint64_t now = GetCurrentMS();
+    {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_cache.find(key);
+        if(it != m_cache.end()) {
+            if(it->second.expire > now) {
+                for(auto &i : it->second.addrs) {
+                    result.push_back(CopyAddress(i));
+                }
+                ttl_ms = std::min(ttl_ms, it->second.expire - now);
+                return true;
+            }
+            m_cache.erase(it);
+        }
+    }
+
+    std::vector<IPAddress::ptr> addrs;
+    uint32_t ttl = 0;
+    if(query(addrs, ttl, name, type) != 0) {
+        return false;
+    }
+    if(ttl > 0) {
+        MutexType::Lock lock(m_mutex);
+        CacheEntry &entry = m_cache[key];
+        entry.addrs = addrs;
+        entry.expire = now + (uint64_t)ttl * 1000;
+    }
+    ttl_ms = std::min(ttl_ms, (uint64_t)ttl * 1000);
+    for(auto &i : addrs) {
+        result.push_back(CopyAddress(i));
+    }
+    return true;
+}
+
+int DnsResolver::query(std::vector<IPAddress::ptr> &result, uint32_t &ttl, const std::string &name, QueryType type) {
+    std::vector<Address::ptr> servers = getServers();
+    if(servers.empty()) {
+        SYLAR_LOG_ERROR(dns_logger) << "no dns server for " << name;
+        return -1;
+    }
+    uint32_t attempts = std::max(m_attempts.load(), (uint32_t)1);
+    for(uint32_t i = 0; i < attempts; i++) {
+        for(auto &server : servers) {
+            int rt = queryServer(result, ttl, name, type, server);
+            if(rt >= 0) {
+                return rt;
+            }
+        }
+    }
+    return -1;
+}
+
+int DnsResolver::queryServer(std::vector<IPAddress::ptr> &result, uint32_t &ttl, const std::string &name,
+                             QueryType type, Address::ptr server) {
+    std::string request;
+    uint16_t id = NextQueryId();
+    if(!BuildQuery(request, id, name, type)) {
+        return 1;
+    }
+
+    // 协程里socket/connect/send/recv都走hook，SO_RCVTIMEO变成定时器
+    int fd = socket(server->getFamily(), SOCK_DGRAM, 0);
+    if(fd < 0) {
+        return -1;
+    }
+    uint32_t timeout = m_timeout;
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = timeout % 1000 * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // connect之后内核只收这个服务器发来的包
+    if(connect(fd, server->getAddr(), server->getAddrLen())) {
+        close(fd);
+        return -1;
+    }
+    ++m_queryCount;
+    if(send(fd, request.c_str(), request.size(), 0) != (ssize_t)request.size()) {
+        close(fd);
+        return -1;
+    }
+
+    uint8_t buf[DNS_MAX_UDP_SIZE];
+    int rt = -1;
+    while(true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if(n < 0) {
+            SYLAR_LOG_DEBUG(dns_logger) << "dns query " << name << " server=" << *server
+                << " errno=" << errno << " errstr=" << strerror(errno);
+            break;
+        }
+        // id对不上的包是之前超时的应答，丢掉继续等
+        if((size_t)n >= 2 && GetUint16(buf) != id) {
+            continue;
+        }
+        rt = ParseResponse(result, ttl, buf, n, id, type);
+        break;
+    }
+    close(fd);
+    return rt;
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef __SYLAR_DNS_H__
+#define __SYLAR_DNS_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include "address.h"
+#include "thread.h"
+#include "singleton.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+// UDP DNS解析器
+// 在协程里调用时socket走hook，等待应答只挂起当前协程；不在协程里就是普通的阻塞查询
+// 先查/etc/hosts，再查缓存，最后依次问resolv.conf(或者dns.servers)里的服务器，应答按TTL缓存
+// 短域名按resolv.conf的search/ndots展开，和getaddrinfo的行为一致
+class DnsResolver : public Noncopyable {
+public:
+    typedef std::shared_ptr<DnsResolver> ptr;
+    typedef Mutex MutexType;
+
+    enum QueryType {
+        A = 1,
+        AAAA = 28
+    };
+
+    DnsResolver();
+
+    // family为AF_INET/AF_INET6/AF_UNSPEC，结果里地址的端口都是0
+    // ttl_ms返回结果还能用多久(记录TTL剩余的毫秒)，来自hosts或者本身是IP时是-1
+    bool resolve(std::vector<IPAddress::ptr> &result, const std::string &name, int family = AF_INET,
+                 uint64_t *ttl_ms = nullptr);
+
+    void setServers(const std::vector<Address::ptr> &servers);
+    std::vector<Address::ptr> getServers();
+
+    void setTimeout(uint32_t ms) { m_timeout = ms; }
+    void setAttempts(uint32_t v) { m_attempts = v; }
+
+    void setSearch(const std::vector<std::string> &search);
+    std::vector<std::string> getSearch();
+    void setNdots(uint32_t v) { m_ndots = v; }
+
+    bool loadResolvConf(const std::string &path = "/etc/resolv.conf");
+    bool loadHosts(const std::string &path = "/etc/hosts");
+
+    void clearCache();
+
+    // 实际发出去的查询数
+    uint64_t getQueryCount() const { return m_queryCount; }
+private:
+    // 返回0成功，1域名不存在或者没有该类型记录，-1超时或者服务器出错
+    int query(std::vector<IPAddress::ptr> &result, uint32_t &ttl, const std::string &name, QueryType type);
+    int queryServer(std::vector<IPAddress::ptr> &result, uint32_t &ttl, const std::string &name,
+                    QueryType type, Address::ptr server);
+    bool resolveType(std::vector<IPAddress::ptr> &result, const std::string &name, QueryType type,
+                     uint64_t &ttl_ms);
+    // 按search/ndots展开成依次要查的完整域名
+    std::vector<std::string> expandName(const std::string &name);
+private:
+    struct CacheEntry {
+        std::vector<IPAddress::ptr> addrs;
+        uint64_t expire = 0;
+    };
+
+    MutexType m_mutex;
+    std::vector<Address::ptr> m_servers;
+    std::vector<std::string> m_search;
+    std::map<std::string, std::vector<IPAddress::ptr> > m_hosts;
+    std::map<std::string, CacheEntry> m_cache;
+    // 配置监听器在别的线程里改，查询时不加锁读
+    std::atomic<uint32_t> m_timeout;
+    std::atomic<uint32_t> m_attempts;
+    std::atomic<uint32_t> m_ndots;
+    std::atomic<uint64_t> m_queryCount;
+};
+
+typedef sylar::Singleton<DnsResolver> DnsMgr;
+
+}
+
+#endif
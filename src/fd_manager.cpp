@@ -5,101 +5,168 @@
 #include <fcntl.h>
 #include "hook.h"
 #include "singleton.h"
+#include "IOManager.h"
 
 namespace sylar {
 FdCtx::FdCtx(int fd)
-    :m_isInit(false)
-    ,m_isSocket(false)
-    ,m_sysNonblock(false)
-    ,m_userNonblock(false)
-    ,m_isClosed(false)
+    :m_flags(0)
+    ,m_readReady(true)
+    ,m_writeReady(true)
+    ,m_cancelled(0)
     ,m_fd(fd)
     ,m_recvTimeout(-1)
     ,m_sendTimeout(-1) {
-    init();
+    // slab分配整段时批量构造，真正用到这个fd时FdManager才调用init
 }
 
 FdCtx::~FdCtx() {
 }
 
 bool FdCtx::init() {
-    if(m_isInit){
+    // 同一个fd关闭之后再创建会复用这个对象，需要重新初始化
+    uint8_t old_flags = m_flags.load(std::memory_order_acquire);
+    if((old_flags & FLAG_INIT) && !(old_flags & FLAG_CLOSED)){
         return true;
     }
-    m_recvTimeout = -1;
-    m_sendTimeout = -1;
-
+    // 新状态先在局部算好，超时和就绪标记写完之后再一次性发布标记
+    uint8_t flags = 0;
     struct stat fd_stat;
-    if(-1 == fstat(m_fd, &fd_stat)) {
-        m_isInit = false;
-        m_isSocket = false;
-    } else {
-        m_isInit = true;
-        m_isSocket = S_ISSOCK(fd_stat.st_mode);
+    if(-1 != fstat(m_fd, &fd_stat)) {
+        flags |= FLAG_INIT;
+        if(S_ISSOCK(fd_stat.st_mode)) {
+            flags |= FLAG_SOCKET;
+        }
+        if(S_ISREG(fd_stat.st_mode)) {
+            flags |= FLAG_FILE;
+        }
+        if(S_ISFIFO(fd_stat.st_mode)) {
+            flags |= FLAG_FIFO;
+        }
     }
 
-    if(m_isSocket) {
-        int flags = fcntl_f(m_fd, F_GETFL, 0);
-        if(!(flags & O_NONBLOCK)) {
-            fcntl_f(m_fd, F_SETFL, flags | O_NONBLOCK);
+    // socket和pipe/FIFO都能进epoll，系统层面设成非阻塞，IO走挂起协程的路径
+    if(flags & (FLAG_SOCKET | FLAG_FIFO)) {
+        int fl = fcntl_f(m_fd, F_GETFL, 0);
+        if(!(fl & O_NONBLOCK)) {
+            fcntl_f(m_fd, F_SETFL, fl | O_NONBLOCK);
+        } else {
+            // 用户自己打开时就是非阻塞的(比如open FIFO带O_NONBLOCK)，IO不替它挂起
+            flags |= FLAG_USER_NONBLOCK;
+        }
+        flags |= FLAG_SYS_NONBLOCK;
+    }
+    if(flags & FLAG_SOCKET) {
+        int type = 0;
+        socklen_t len = sizeof(type);
+        if(!getsockopt_f(m_fd, SOL_SOCKET, SO_TYPE, &type, &len) && type == SOCK_STREAM) {
+            flags |= FLAG_STREAM;
         }
-        m_sysNonblock = true;
-    } else {
-        m_sysNonblock = false;
     }
+    m_recvTimeout.store(-1, std::memory_order_relaxed);
+    m_sendTimeout.store(-1, std::memory_order_relaxed);
+    m_readReady.store(true, std::memory_order_relaxed);
+    m_writeReady.store(true, std::memory_order_relaxed);
+    m_cancelled.store(0, std::memory_order_relaxed);
+    m_flags.store(flags, std::memory_order_release);
+    return flags & FLAG_INIT;
+}
 
-    m_userNonblock = false;
-    m_isClosed = false;
-    return m_isInit;
+
+bool FdCtx::close() {
+    setFlag(FLAG_CLOSED, true);
+    return true;
 }
 
+void FdCtx::setFlag(uint8_t f, bool v) {
+    if(v) {
+        m_flags.fetch_or(f, std::memory_order_acq_rel);
+    } else {
+        m_flags.fetch_and((uint8_t)~f, std::memory_order_acq_rel);
+    }
+}
 
 void FdCtx::setTimeout(int type, uint64_t v) {
     if(type == SO_RCVTIMEO) {
-        m_recvTimeout = v;
+        m_recvTimeout.store(v, std::memory_order_relaxed);
     } else {
-        m_sendTimeout = v;
+        m_sendTimeout.store(v, std::memory_order_relaxed);
     }
 }
 
+void FdCtx::setReady(uint32_t event, bool v) {
+    if(event == IOManager::READ) {
+        m_readReady.store(v, std::memory_order_relaxed);
+    } else {
+        m_writeReady.store(v, std::memory_order_relaxed);
+    }
+}
+
+bool FdCtx::isReady(uint32_t event) const {
+    if(event == IOManager::READ) {
+        return m_readReady.load(std::memory_order_relaxed);
+    } else {
+        return m_writeReady.load(std::memory_order_relaxed);
+    }
+}
+
+void FdCtx::setCancelled(uint32_t event, bool v) {
+    if(v) {
+        m_cancelled.fetch_or((uint8_t)event);
+    } else {
+        m_cancelled.fetch_and((uint8_t)~event);
+    }
+}
+
+bool FdCtx::takeCancelled(uint32_t event) {
+    if(!(m_cancelled.load(std::memory_order_relaxed) & event)) {
+        return false;
+    }
+    return m_cancelled.fetch_and((uint8_t)~event) & event;
+}
+
 uint64_t FdCtx::getTimeout(int type) {
     if(type == SO_RCVTIMEO) {
-        return m_recvTimeout;
+        return m_recvTimeout.load(std::memory_order_relaxed);
     } else {
-        return m_sendTimeout;
+        return m_sendTimeout.load(std::memory_order_relaxed);
     }
 }
 
 
 FdManager::FdManager(){
-    m_datas.resize(64);
 }
 
-FdCtx::ptr FdManager::get(int fd, bool auto_create){
-    RWMutexType::ReadLock lock(m_mutex);
-    if((int)m_datas.size() <= fd) {
-        if(auto_create == false) {
-            return nullptr;
-        }
-    } else {
-        if(m_datas[fd] || !auto_create) {
-            return m_datas[fd];
-        }
+FdCtx *FdManager::get(int fd, bool auto_create){
+    Slot *slot = m_slots.get(fd);
+    if(slot && slot->live.load(std::memory_order_acquire)) {
+        return &slot->ctx;
+    }
+    if(!auto_create) {
+        return nullptr;
     }
-    lock.unlock();
 
-    RWMutexType::WriteLock lock2(m_mutex);
-    FdCtx::ptr ctx(new FdCtx(fd));
-    m_datas[fd] = ctx;
-    return ctx;
+    slot = m_slots.getOrCreate(fd);
+    if(!slot) {
+        return nullptr;
+    }
+    MutexType::Lock lock(m_mutex);
+    if(!slot->live.load(std::memory_order_relaxed)) {
+        slot->ctx.init();
+        slot->live.store(true, std::memory_order_release);
+    }
+    return &slot->ctx;
 }
 
 void FdManager::del(int fd){
-    RWMutexType::WriteLock lock(m_mutex);
-    if((int)m_datas.size() <= fd) {
+    Slot *slot = m_slots.get(fd);
+    if(!slot) {
         return;
     }
-    m_datas[fd].reset();
+    MutexType::Lock lock(m_mutex);
+    if(slot->live.load(std::memory_order_relaxed)) {
+        slot->ctx.close();
+        slot->live.store(false, std::memory_order_release);
+    }
 }
 
 
@@ -2,57 +2,100 @@
 #define __FD_MANAGER_H__
 
 #include <memory>
+#include <atomic>
 #include "thread.h"
 #include "log.h"
 #include "singleton.h"
+#include "fd_slab.h"
 
 namespace sylar {
 
-class FdCtx : public std::enable_shared_from_this<FdCtx> {
+// 字段都是每次hook IO都要读的热字段，整个对象放进FdManager slab的一条cache line里
+class FdCtx {
 public:
-    typedef std::shared_ptr<FdCtx> ptr;
-
     FdCtx(int fd);
     ~FdCtx();
 
     bool init();
-    bool isInit() const { return m_isInit; }
-    bool isSocket() const { return m_isSocket; }
-    bool isClose() const { return m_isClosed; }
+    bool isInit() const { return hasFlag(FLAG_INIT); }
+    bool isSocket() const { return hasFlag(FLAG_SOCKET); }
+    bool isFile() const { return hasFlag(FLAG_FILE); }
+    bool isFifo() const { return hasFlag(FLAG_FIFO); }
+    bool isClose() const { return hasFlag(FLAG_CLOSED); }
     bool close();
 
-    void setUserNonblock(bool v) { m_userNonblock = v; }
-    bool getUserNonblock() const { return m_userNonblock; }
+    void setUserNonblock(bool v) { setFlag(FLAG_USER_NONBLOCK, v); }
+    bool getUserNonblock() const { return hasFlag(FLAG_USER_NONBLOCK); }
 
-    void setSysNonblock(bool v) { m_sysNonblock = v; }
-    bool getSysNonblock() const { return m_sysNonblock; }
+    void setSysNonblock(bool v) { setFlag(FLAG_SYS_NONBLOCK, v); }
+    bool getSysNonblock() const { return hasFlag(FLAG_SYS_NONBLOCK); }
 
     void setTimeout(int type, uint64_t v);
     uint64_t getTimeout(int type);
+
+    bool isStream() const { return hasFlag(FLAG_STREAM); }
+
+    // 就绪提示，event是IOManager::READ/WRITE
+    // 系统调用EAGAIN或者流式socket读写不满时置为未就绪，epoll通知之后置为就绪
+    void setReady(uint32_t event, bool v);
+    bool isReady(uint32_t event) const;
+
+    // 主动取消标记，event是IOManager::READ/WRITE
+    // Socket::cancelRead/cancelWrite在唤醒等待的协程之前打上，被唤醒的IO看到后返回ECANCELED
+    void setCancelled(uint32_t event, bool v);
+    bool takeCancelled(uint32_t event);
 private:
-    bool m_isInit : 1;
-    bool m_isSocket : 1;
-    bool m_sysNonblock : 1;
-    bool m_userNonblock : 1;
-    bool m_isClosed : 1;
+    enum Flag {
+        FLAG_INIT           = 0x01,
+        FLAG_SOCKET         = 0x02,
+        FLAG_SYS_NONBLOCK   = 0x04,
+        FLAG_USER_NONBLOCK  = 0x08,
+        FLAG_CLOSED         = 0x10,
+        FLAG_STREAM         = 0x20,
+        FLAG_FILE           = 0x40,
+        FLAG_FIFO           = 0x80,
+    };
+
+    bool hasFlag(uint8_t f) const { return m_flags.load(std::memory_order_acquire) & f; }
+    void setFlag(uint8_t f, bool v);
+private:
+    // fd号复用时init会在别的线程还拿着借出指针的情况下重写状态
+    // 所以标记放在一个原子字节里，init先算好再整体发布，读的一方看到的要么全是旧的要么全是新的
+    std::atomic<uint8_t> m_flags;
+    // 就绪标记每次IO都会写，不能和上面的标记共用字节
+    std::atomic<bool> m_readReady;
+    std::atomic<bool> m_writeReady;
+    std::atomic<uint8_t> m_cancelled;
     int m_fd;
 
-    uint64_t m_recvTimeout;
-    uint64_t m_sendTimeout;
+    std::atomic<uint64_t> m_recvTimeout;
+    std::atomic<uint64_t> m_sendTimeout;
 };
 
 class FdManager {
 public:
     typedef std::shared_ptr<FdManager> ptr;
-    typedef RWMutex RWMutexType;
+    typedef Mutex MutexType;
 
     FdManager();
-    FdCtx::ptr get(int fd, bool auto_create = false);
+
+    // 查找不加锁，返回借出去的指针
+    // FdCtx在slab里，进程生命周期内不释放，del之后同一个fd再创建时复用，所以借出的指针在一次IO期间一直有效
+    FdCtx *get(int fd, bool auto_create = false);
     void del(int fd);
 
 private:
-    RWMutexType m_mutex;
-    std::vector<FdCtx::ptr> m_datas;
+    // 每个fd占一条cache line，发布标记和FdCtx放在一起，相邻fd被不同线程处理时不会伪共享
+    struct alignas(SYLAR_CACHELINE_SIZE) Slot {
+        std::atomic<bool> live;     // 对外是否可见
+        FdCtx ctx;
+
+        Slot(int fd) :live(false), ctx(fd) {}
+    };
+private:
+    // 只有创建/删除ctx时加锁，查找不加锁
+    MutexType m_mutex;
+    FdSlab<Slot> m_slots;
 };
 
 typedef sylar::Singleton<FdManager> FdMgr;
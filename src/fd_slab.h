@@ -0,0 +1,80 @@
+#ifndef __SYLAR_FD_SLAB_H__
+#define __SYLAR_FD_SLAB_H__
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include "thread.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+#define SYLAR_CACHELINE_SIZE 64
+
+// 按fd下标的分段slab，每段是一块连续的、按cache line对齐的T数组
+// 段一旦发布就不再移动，查找不加锁，只有分配新段时加锁
+// 段里的每个元素用T(int fd)构造，段在slab析构时才释放
+template<class T, size_t SEGMENT_BITS = 10, size_t MAX_SEGMENTS = 4096>
+class FdSlab : public Noncopyable {
+public:
+    typedef Mutex MutexType;
+    static const size_t SEGMENT_SIZE = (size_t)1 << SEGMENT_BITS;
+
+    FdSlab() {
+        for(size_t i = 0; i < MAX_SEGMENTS; i++) {
+            m_segments[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~FdSlab() {
+        for(size_t i = 0; i < MAX_SEGMENTS; i++) {
+            T *seg = m_segments[i].load(std::memory_order_relaxed);
+            if(!seg) {
+                continue;
+            }
+            for(size_t j = 0; j < SEGMENT_SIZE; j++) {
+                seg[j].~T();
+            }
+            free(seg);
+        }
+    }
+
+    // fd所在的段还没分配时返回nullptr
+    T *get(int fd) const {
+        if(fd < 0 || ((size_t)fd >> SEGMENT_BITS) >= MAX_SEGMENTS) {
+            return nullptr;
+        }
+        T *seg = m_segments[fd >> SEGMENT_BITS].load(std::memory_order_acquire);
+        return seg ? &seg[fd & (SEGMENT_SIZE - 1)] : nullptr;
+    }
+
+    T *getOrCreate(int fd) {
+        T *rt = get(fd);
+        if(rt || fd < 0 || ((size_t)fd >> SEGMENT_BITS) >= MAX_SEGMENTS) {
+            return rt;
+        }
+        MutexType::Lock lock(m_mutex);
+        std::atomic<T*> &seg_ptr = m_segments[fd >> SEGMENT_BITS];
+        T *seg = seg_ptr.load(std::memory_order_relaxed);
+        if(!seg) {
+            void *mem = nullptr;
+            if(posix_memalign(&mem, SYLAR_CACHELINE_SIZE, sizeof(T) * SEGMENT_SIZE)) {
+                return nullptr;
+            }
+            seg = (T*)mem;
+            int base = (fd >> SEGMENT_BITS) << SEGMENT_BITS;
+            for(size_t i = 0; i < SEGMENT_SIZE; i++) {
+                new (&seg[i]) T(base + i);
+            }
+            seg_ptr.store(seg, std::memory_order_release);
+        }
+        return &seg[fd & (SEGMENT_SIZE - 1)];
+    }
+private:
+    MutexType m_mutex;
+    std::atomic<T*> m_segments[MAX_SEGMENTS];
+};
+
+}
+
+#endif
@@ -4,6 +4,14 @@
 #include "macro.h"
 #include "log.h"
 #include "scheduler.h"
+#include "metrics.h"
+#include "util.h"
+#include <execinfo.h>
+#include <linux/mempolicy.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 namespace sylar{
 
@@ -16,6 +24,26 @@ static thread_local Fiber *t_fiber = nullptr;
 static thread_local std::shared_ptr<Fiber::ptr> t_threadFiber = nullptr;
 
 static ConfigVar<uint32_t>::ptr g_fiber_stack_size = Config::Lookup<uint32_t>("fiber.stack_size", 1024*1024, "fiber stack size");
+static ConfigVar<bool>::ptr g_fiber_stack_numa_local = Config::Lookup<bool>("fiber.stack_numa_local", true, "allocate fiber stacks on the numa node of the creating thread when it is bound to a cpu");
+static ConfigVar<bool>::ptr g_fiber_record_create_stack = Config::Lookup<bool>("fiber.record_create_stack", false, "record the backtrace where each fiber is created, shown in fiber dumps");
+// 收到这个信号时把所有协程dump到日志里，0表示不装
+static ConfigVar<int>::ptr g_fiber_dump_signal = Config::Lookup<int>("fiber.dump_signal", 0, "signal that dumps all fibers to the log, e.g. 12 for SIGUSR2, 0 disables");
+
+// 带栈的协程链表，DumpAll用；协程析构时要先从链表上摘掉，dump时持锁，协程不会被释放
+static Mutex &GetFiberListMutex() {
+    static Mutex *s_mutex = new Mutex;
+    return *s_mutex;
+}
+static Fiber *s_fiber_list = nullptr;
+
+// 缓存线程id，切换协程时不用每次系统调用
+static pid_t CurrentTid() {
+    static thread_local pid_t t_tid = 0;
+    if(!t_tid) {
+        t_tid = GetThreadId();
+    }
+    return t_tid;
+}
 
 class MallocStackAllocator {
 public:
@@ -28,7 +56,51 @@ public:
     }
 };
 
-using StackAllocator = MallocStackAllocator;
+// 绑了cpu的线程上创建的协程，栈直接mmap并用mbind指定到这个线程的NUMA节点
+// 协程大多在创建它的线程上跑，栈放在本地节点上
+class NumaStackAllocator {
+public:
+    // node<0或者分配失败时退回malloc，node改成-1
+    static void* Alloc(size_t size, int &node) {
+        if(node >= 0 && node < 64) {
+            void *vp = mmap(nullptr, size, PROT_READ | PROT_WRITE
+                            , MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+            if(vp != MAP_FAILED) {
+                unsigned long mask = 1UL << node;
+                syscall(SYS_mbind, vp, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+                return vp;
+            }
+        }
+        node = -1;
+        return MallocStackAllocator::Alloc(size);
+    }
+
+    static void Dealloc(void *vp, size_t size, int node) {
+        if(node >= 0) {
+            munmap(vp, size);
+        } else {
+            MallocStackAllocator::Dealloc(vp, size);
+        }
+    }
+};
+
+using StackAllocator = NumaStackAllocator;
+
+struct _FiberMetricsIniter {
+    _FiberMetricsIniter() {
+        MetricsRegistry *metrics = MetricsMgr::GetInstance();
+        metrics->add("sylar_fibers", {}, "Live fibers."
+                , std::make_shared<CallbackMetric>(Metric::GAUGE, []() {
+                    return (double)s_fiber_count;
+                }));
+        metrics->add("sylar_fibers_created_total", {}, "Fibers created with a stack."
+                , std::make_shared<CallbackMetric>(Metric::COUNTER, []() {
+                    return (double)s_fiber_id;
+                }));
+    }
+};
+
+static _FiberMetricsIniter s_fiber_metrics_initer;
 
 Fiber::Fiber(){
     m_state = EXEC;
@@ -49,7 +121,26 @@ Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
     s_fiber_count++;
     m_stacksize = stacksize > 0 ? stacksize : g_fiber_stack_size->getValue();
 
-    m_stack = StackAllocator::Alloc(m_stacksize);
+    m_stackNode = g_fiber_stack_numa_local->getValue() ? Thread::GetNumaNode() : -1;
+    m_stack = StackAllocator::Alloc(m_stacksize, m_stackNode);
+
+    m_createMs = GetCurrentMS();
+    setEntry(cb);
+    if(g_fiber_record_create_stack->getValue()) {
+        void *bt[32];
+        int n = ::backtrace(bt, 32);
+        // 跳过构造函数自己
+        m_createStack.assign(bt + 1, bt + n);
+    }
+    {
+        Mutex::Lock lock(GetFiberListMutex());
+        m_next = s_fiber_list;
+        if(s_fiber_list) {
+            s_fiber_list->m_prev = this;
+        }
+        s_fiber_list = this;
+    }
+
     if(getcontext(&m_ctx)) {
         SYLAR_ASSERT2(false, "getcontext");
     }
@@ -69,7 +160,18 @@ Fiber::~Fiber(){
     s_fiber_count--;
     if(m_stack) {
         SYLAR_ASSERT(m_state == TERM || m_state == INIT || m_state == EXCEPTION);
-        StackAllocator::Dealloc(m_stack, m_stacksize);
+        {
+            Mutex::Lock lock(GetFiberListMutex());
+            if(m_prev) {
+                m_prev->m_next = m_next;
+            } else {
+                s_fiber_list = m_next;
+            }
+            if(m_next) {
+                m_next->m_prev = m_prev;
+            }
+        }
+        StackAllocator::Dealloc(m_stack, m_stacksize, m_stackNode);
     } else {
         SYLAR_ASSERT(!m_cb);
         SYLAR_ASSERT(m_state == EXEC);
@@ -87,6 +189,9 @@ void Fiber::reset(std::function<void()> cb){
     SYLAR_ASSERT(m_stack);
     SYLAR_ASSERT(m_state == TERM || m_state == INIT || m_state == EXCEPTION);
     m_cb = cb;
+    setEntry(cb);
+    m_parkReason = PARK_NONE;
+    m_yieldSite = nullptr;
     if(getcontext(&m_ctx)) {
         SYLAR_ASSERT2(false, "getcontext");
     }
@@ -102,9 +207,13 @@ void Fiber::reset(std::function<void()> cb){
 void Fiber::call() {
     SetThis(this);
     m_state = EXEC;
+    m_thread = CurrentTid();
     if(swapcontext(&((*t_threadFiber)->m_ctx), &m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
+    if(m_state.load(std::memory_order_relaxed) == EXEC) {
+        m_state.store(HOLD, std::memory_order_release);
+    }
 }
 
 // void Fiber::back(){
@@ -121,14 +230,22 @@ void Fiber::back() {
     }
 }
 // 切换到当前协程执行
-void Fiber::swapIn(){
+Fiber::State Fiber::swapIn(){
     SetThis(this);
     SYLAR_ASSERT(m_state != EXEC);
     m_state = EXEC;
+    m_thread = CurrentTid();
 
     if(swapcontext(&Scheduler::GetMainFiber()->m_ctx, &m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
+    // YieldToHold换出的协程回到这里才算挂起，上下文已经保存好了
+    State state = m_state.load(std::memory_order_relaxed);
+    if(state == EXEC) {
+        state = HOLD;
+        m_state.store(HOLD, std::memory_order_release);
+    }
+    return state;
 }
 
 // 切换到后台
@@ -158,15 +275,39 @@ Fiber::ptr Fiber::GetThis(){
 // 协程切换到后台，并且设置为Ready状态
 void Fiber::YieldToReady(){
     Fiber::ptr cur = GetThis();
+    cur->m_yieldSite = __builtin_return_address(0);
     cur->m_state = READY;
     cur->swapOut();
 }
 
 // 协程切换到后台，并且设置为Hold状态
+// 状态在swapIn返回之后才改成HOLD，换出完成之前一直是EXEC
+// 否则别的线程看到HOLD就可能在上下文保存好之前把它调度起来
 void Fiber::YieldToHold(){
     Fiber::ptr cur = GetThis();
-    cur->m_state = HOLD;
+    cur->setPark(PARK_OTHER, -1, __builtin_return_address(0));
     cur->swapOut();
+    cur->m_parkReason = PARK_NONE;
+}
+
+void Fiber::YieldToHold(ParkReason reason, int64_t arg){
+    Fiber::ptr cur = GetThis();
+    cur->setPark(reason, arg, __builtin_return_address(0));
+    cur->swapOut();
+    cur->m_parkReason = PARK_NONE;
+}
+
+void Fiber::setPark(ParkReason reason, int64_t arg, void *site){
+    m_parkReason = reason;
+    m_parkArg = arg;
+    m_parkMs = GetCurrentMS();
+    m_yieldSite = site;
+}
+
+void Fiber::setEntry(const std::function<void()> &cb){
+    m_entryType = &cb.target_type();
+    void (* const *fn)() = cb.target<void(*)()>();
+    m_entryFn = fn ? (void*)*fn : nullptr;
 }
 
 // 获取总协程数
@@ -221,4 +362,134 @@ uint64_t Fiber::GetFiberId(){
     return 0;
 }
 
+static const char *FiberStateToString(Fiber::State state) {
+    switch(state) {
+#define XX(name) \
+        case Fiber::name: \
+            return #name;
+        XX(INIT);
+        XX(HOLD);
+        XX(EXEC);
+        XX(TERM);
+        XX(READY);
+        XX(EXCEPTION);
+#undef XX
+    }
+    return "UNKNOWN";
+}
+
+const char *Fiber::ParkReasonToString(ParkReason reason){
+    switch(reason) {
+#define XX(name, str) \
+        case name: \
+            return str;
+        XX(PARK_NONE, "none");
+        XX(PARK_IO, "io");
+        XX(PARK_TIMER, "timer");
+        XX(PARK_LOCK, "lock");
+        XX(PARK_CHANNEL, "channel");
+        XX(PARK_EXTERNAL, "external");
+        XX(PARK_OTHER, "other");
+#undef XX
+    }
+    return "unknown";
+}
+
+void Fiber::DumpAll(std::ostream &os){
+    Mutex::Lock lock(GetFiberListMutex());
+    uint64_t now = GetCurrentMS();
+    for(Fiber *f = s_fiber_list; f; f = f->m_next) {
+        State state = f->m_state;
+        os << "fiber " << f->m_id << " " << FiberStateToString(state);
+        if(state == EXEC) {
+            os << " thread=" << f->m_thread;
+        }
+        os << " age=" << now - f->m_createMs << "ms entry=";
+        if(f->m_entryFn) {
+            os << SymbolizeAddress(f->m_entryFn);
+        } else if(f->m_entryType && *f->m_entryType != typeid(void)) {
+            os << Demangle(f->m_entryType->name());
+        } else {
+            os << "-";
+        }
+        ParkReason reason = f->m_parkReason;
+        if(state != EXEC && reason != PARK_NONE) {
+            os << " parked=" << ParkReasonToString(reason);
+            if(reason == PARK_IO) {
+                os << " fd=" << f->m_parkArg;
+            } else if(reason == PARK_TIMER) {
+                os << " timeout=" << f->m_parkArg << "ms";
+            } else if((reason == PARK_LOCK || reason == PARK_CHANNEL) && f->m_parkArg != -1) {
+                os << " object=" << (void*)(intptr_t)f->m_parkArg;
+            }
+            os << " for=" << now - f->m_parkMs << "ms";
+        }
+        if(f->m_yieldSite) {
+            os << " last_yield=" << SymbolizeAddress(f->m_yieldSite);
+        }
+        os << "\n";
+        if(!f->m_createStack.empty()) {
+            os << "  created at:\n"
+               << BacktraceToString(f->m_createStack.data(), f->m_createStack.size(), 0, "    ");
+        }
+    }
+}
+
+// 信号处理函数里只能notify，dump在单独的线程里做
+static Semaphore *s_fiber_dump_sem = nullptr;
+static int s_fiber_dump_signal = 0;
+static struct sigaction s_old_fiber_dump_action;
+
+static void FiberDumpSignalHandler(int sig) {
+    int saved_errno = errno;
+    s_fiber_dump_sem->notify();
+    errno = saved_errno;
+}
+
+static void InstallFiberDumpSignal(int sig) {
+    static Mutex s_mutex;
+    Mutex::Lock lock(s_mutex);
+    if(!s_fiber_dump_sem) {
+        s_fiber_dump_sem = new Semaphore;
+        // 跟进程同生命周期，不join
+        static Thread::ptr s_dumper(new Thread([]() {
+            while(true) {
+                s_fiber_dump_sem->wait();
+                std::stringstream ss;
+                Fiber::DumpAll(ss);
+                SYLAR_LOG_INFO(fiber_logger) << "fiber dump, total=" << Fiber::TotalFibers() << "\n" << ss.str();
+            }
+        }, "fiber_dump"));
+    }
+    if(s_fiber_dump_signal) {
+        sigaction(s_fiber_dump_signal, &s_old_fiber_dump_action, nullptr);
+        s_fiber_dump_signal = 0;
+    }
+    if(sig > 0) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = FiberDumpSignalHandler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if(sigaction(sig, &sa, &s_old_fiber_dump_action) == 0) {
+            s_fiber_dump_signal = sig;
+        } else {
+            SYLAR_LOG_ERROR(fiber_logger) << "install fiber dump signal " << sig << " failed, errno=" << errno;
+        }
+    }
+}
+
+struct _FiberDumpIniter {
+    _FiberDumpIniter() {
+        if(g_fiber_dump_signal->getValue() > 0) {
+            InstallFiberDumpSignal(g_fiber_dump_signal->getValue());
+        }
+        g_fiber_dump_signal->addListener([](const int& old_value, const int& new_value){
+            InstallFiberDumpSignal(new_value);
+        });
+    }
+};
+
+static _FiberDumpIniter s_fiber_dump_initer;
+
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <ucontext.h>
 #include <memory>
 #include <functional>
+#include <atomic>
+#include <typeinfo>
+#include <vector>
 #include "thread.h"
 
 namespace sylar {
@@ -23,6 +26,18 @@ public:
         READY,
         EXCEPTION
     };
+
+    // 挂起的原因，DumpAll里显示，arg的含义看原因: IO是fd，TIMER是毫秒，LOCK/CHANNEL是对象地址
+    enum ParkReason {
+        PARK_NONE,
+        PARK_IO,
+        PARK_TIMER,
+        PARK_LOCK,
+        PARK_CHANNEL,
+        // 等别的线程(比如FileIOPool、正在做同一个DNS解析的协程)做完调度回来
+        PARK_EXTERNAL,
+        PARK_OTHER
+    };
 private:
     Fiber();
 public:
@@ -31,8 +46,9 @@ public:
 
     // 重置协程函数，并重置状态，能重置的也就是INIT或者TERM状态才能重置
     void reset(std::function<void()> cb);
-    // 切换到当前协程执行
-    void swapIn();
+    // 切换到当前协程执行，返回换出时的状态
+    // 换出后状态是HOLD的协程可能马上被别的线程唤醒执行，调用方只能用返回值判断，不能再读写它的状态
+    State swapIn();
     // 切换到后台
     void swapOut();
 
@@ -40,7 +56,8 @@ public:
     void back();
 
     uint64_t GetId() const { return m_id; }
-    State getState() const { return m_state;}
+    // 别的线程(调度器扫队列)据此判断上下文能不能恢复，和swapIn里的release配对
+    State getState() const { return m_state.load(std::memory_order_acquire);}
 public:
     // 设置当前协程
     static void SetThis(Fiber *f);
@@ -50,6 +67,8 @@ public:
     static void YieldToReady();
     // 协程切换到后台，并且设置为Hold状态
     static void YieldToHold();
+    // 同上，记下挂起的原因
+    static void YieldToHold(ParkReason reason, int64_t arg = -1);
     // 获取总协程数
     static uint64_t TotalFibers();
 
@@ -59,16 +78,47 @@ public:
 
     static uint64_t GetFiberId();
 
+    // 输出所有带栈的协程: 状态、入口、创建时长、挂起原因和挂起的位置
+    // 不停协程，别的线程上的协程状态可能正在变，只用来排查问题
+    static void DumpAll(std::ostream &os);
+    static const char *ParkReasonToString(ParkReason reason);
+
 // 这个private都是协程自己的一些函数
+private:
+    // 挂起前记下原因和位置
+    void setPark(ParkReason reason, int64_t arg, void *site);
+    // 记下入口函数
+    void setEntry(const std::function<void()> &cb);
 private:
     uint64_t m_id = 0;
     uint32_t m_stacksize = 0;
-    State m_state = INIT;
+    // 换出的线程写、调度器里别的线程读，上下文保存完之后才用release发布HOLD
+    std::atomic<State> m_state{INIT};
 
     ucontext_t m_ctx;
     void *m_stack = nullptr;
+    // 栈所在的NUMA节点，-1表示是malloc出来的
+    int m_stackNode = -1;
 
     std::function<void()> m_cb;
+
+    // 以下给DumpAll用
+    // 所有带栈的协程串成一个链表
+    Fiber *m_prev = nullptr;
+    Fiber *m_next = nullptr;
+    uint64_t m_createMs = 0;
+    // 入口函数的类型，是函数指针时另外记下地址
+    const std::type_info *m_entryType = nullptr;
+    void *m_entryFn = nullptr;
+    // fiber.record_create_stack打开时创建时的调用栈
+    std::vector<void*> m_createStack;
+    // 最近一次在哪个线程上跑
+    pid_t m_thread = -1;
+    ParkReason m_parkReason = PARK_NONE;
+    int64_t m_parkArg = -1;
+    uint64_t m_parkMs = 0;
+    // 最近一次YieldToHold/YieldToReady的调用者
+    void *m_yieldSite = nullptr;
 };
 
 }
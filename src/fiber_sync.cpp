@@ -0,0 +1,251 @@
+#include "fiber_sync.h"
+#include "IOManager.h"
+#include "macro.h"
+
+namespace sylar {
+
+FiberWaiter::FiberWaiter()
+    :scheduler(nullptr) {
+}
+
+FiberWaiter FiberWaiter::Current() {
+    FiberWaiter w;
+    w.scheduler = Scheduler::GetThis();
+    w.fiber = Fiber::GetThis();
+    SYLAR_ASSERT2(w.scheduler, "fiber sync primitive used outside scheduler");
+    return w;
+}
+
+void FiberWaiter::wake() {
+    // 对方可能还没来得及YieldToHold，调度器会跳过EXEC状态的协程直到它挂起
+    scheduler->schedule(fiber);
+    fiber.reset();
+}
+
+FiberMutex::FiberMutex()
+    :m_state(0) {
+}
+
+bool FiberMutex::tryLock() {
+    int expected = 0;
+    return m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+}
+
+void FiberMutex::lock() {
+    if(tryLock()) {
+        return;
+    }
+    while(true) {
+        {
+            Spinlock::Lock lock(m_guard);
+            // 置成2之后unlock一定走慢路径，能看到下面入队的等待者
+            if(m_state.exchange(2, std::memory_order_acquire) == 0) {
+                return;
+            }
+            m_waiters.push_back(FiberWaiter::Current());
+        }
+        Fiber::YieldToHold(Fiber::PARK_LOCK, (intptr_t)this);
+    }
+}
+
+void FiberMutex::unlock() {
+    int expected = 1;
+    if(m_state.compare_exchange_strong(expected, 0, std::memory_order_release)) {
+        return;
+    }
+    FiberWaiter w;
+    {
+        Spinlock::Lock lock(m_guard);
+        m_state.store(0, std::memory_order_release);
+        if(m_waiters.empty()) {
+            return;
+        }
+        w = m_waiters.front();
+        m_waiters.pop_front();
+    }
+    // 醒来的协程重新抢锁，抢到后状态是2，它的unlock会接着唤醒下一个
+    w.wake();
+}
+
+FiberRWMutex::FiberRWMutex()
+    :m_readers(0)
+    ,m_writeWaiters(0)
+    ,m_writer(false) {
+}
+
+void FiberRWMutex::rdlock() {
+    {
+        Spinlock::Lock lock(m_guard);
+        if(!m_writer && !m_writeWaiters) {
+            ++m_readers;
+            return;
+        }
+        m_waiters.push_back(Waiter{FiberWaiter::Current(), false});
+    }
+    Fiber::YieldToHold(Fiber::PARK_LOCK, (intptr_t)this);
+}
+
+void FiberRWMutex::wrlock() {
+    {
+        Spinlock::Lock lock(m_guard);
+        if(!m_writer && !m_readers) {
+            m_writer = true;
+            return;
+        }
+        ++m_writeWaiters;
+        m_waiters.push_back(Waiter{FiberWaiter::Current(), true});
+    }
+    Fiber::YieldToHold(Fiber::PARK_LOCK, (intptr_t)this);
+}
+
+void FiberRWMutex::unlock() {
+    std::vector<FiberWaiter> wakes;
+    {
+        Spinlock::Lock lock(m_guard);
+        if(m_writer) {
+            m_writer = false;
+        } else {
+            SYLAR_ASSERT(m_readers > 0);
+            --m_readers;
+        }
+        if(m_readers || m_waiters.empty()) {
+            return;
+        }
+        // 锁交给队头: 一个写者，或者连续的一批读者
+        if(m_waiters.front().write) {
+            m_writer = true;
+            --m_writeWaiters;
+            wakes.push_back(m_waiters.front().waiter);
+            m_waiters.pop_front();
+        } else {
+            while(!m_waiters.empty() && !m_waiters.front().write) {
+                ++m_readers;
+                wakes.push_back(m_waiters.front().waiter);
+                m_waiters.pop_front();
+            }
+        }
+    }
+    for(auto& i : wakes) {
+        i.wake();
+    }
+}
+
+void FiberCondVar::wait(FiberMutex::Lock& lock) {
+    std::shared_ptr<Node> node(new Node);
+    node->waiter = FiberWaiter::Current();
+    {
+        Spinlock::Lock guard(m_guard);
+        m_waiters.push_back(node);
+    }
+    lock.unlock();
+    Fiber::YieldToHold(Fiber::PARK_LOCK, (intptr_t)this);
+    lock.lock();
+}
+
+bool FiberCondVar::waitFor(FiberMutex::Lock& lock, uint64_t timeout_ms) {
+    IOManager* iom = IOManager::GetThis();
+    SYLAR_ASSERT2(iom, "FiberCondVar::waitFor needs IOManager");
+    std::shared_ptr<Node> node(new Node);
+    node->waiter = FiberWaiter::Current();
+    {
+        Spinlock::Lock guard(m_guard);
+        m_waiters.push_back(node);
+    }
+    std::weak_ptr<Node> weak(node);
+    Timer::ptr timer = iom->addConditionTimer(timeout_ms, [this, weak](){
+        std::shared_ptr<Node> n = weak.lock();
+        if(!n) {
+            return;
+        }
+        FiberWaiter w;
+        {
+            Spinlock::Lock guard(m_guard);
+            // 已经被notify取走的不用管
+            for(auto it = m_waiters.begin(); it != m_waiters.end(); ++it) {
+                if(*it == n) {
+                    w = n->waiter;
+                    m_waiters.erase(it);
+                    break;
+                }
+            }
+        }
+        if(w.fiber) {
+            w.wake();
+        }
+    }, weak);
+    lock.unlock();
+    Fiber::YieldToHold(Fiber::PARK_LOCK, (intptr_t)this);
+    timer->cancel();
+    lock.lock();
+    return node->notified;
+}
+
+void FiberCondVar::notify() {
+    std::shared_ptr<Node> node;
+    {
+        Spinlock::Lock guard(m_guard);
+        if(m_waiters.empty()) {
+            return;
+        }
+        node = m_waiters.front();
+        m_waiters.pop_front();
+        node->notified = true;
+    }
+    node->waiter.wake();
+}
+
+void FiberCondVar::notifyAll() {
+    std::list<std::shared_ptr<Node> > nodes;
+    {
+        Spinlock::Lock guard(m_guard);
+        nodes.swap(m_waiters);
+        for(auto& i : nodes) {
+            i->notified = true;
+        }
+    }
+    for(auto& i : nodes) {
+        i->waiter.wake();
+    }
+}
+
+FiberSemaphore::FiberSemaphore(uint32_t count)
+    :m_count(count) {
+}
+
+bool FiberSemaphore::tryWait() {
+    Spinlock::Lock lock(m_guard);
+    if(m_count > 0) {
+        --m_count;
+        return true;
+    }
+    return false;
+}
+
+void FiberSemaphore::wait() {
+    {
+        Spinlock::Lock lock(m_guard);
+        if(m_count > 0) {
+            --m_count;
+            return;
+        }
+        m_waiters.push_back(FiberWaiter::Current());
+    }
+    // notify把名额直接交过来
+    Fiber::YieldToHold(Fiber::PARK_LOCK, (intptr_t)this);
+}
+
+void FiberSemaphore::notify() {
+    FiberWaiter w;
+    {
+        Spinlock::Lock lock(m_guard);
+        if(m_waiters.empty()) {
+            ++m_count;
+            return;
+        }
+        w = m_waiters.front();
+        m_waiters.pop_front();
+    }
+    w.wake();
+}
+
+}
@@ -0,0 +1,164 @@
+/**
+ * @file fiber_sync.h
+ * @brief 协程同步原语
+ */
+#ifndef __SYLAR_FIBER_SYNC_H__
+#define __SYLAR_FIBER_SYNC_H__
+
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include "thread.h"
+#include "fiber.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+class Scheduler;
+
+/**
+ * @brief 挂起的协程, 由schedule唤醒
+ */
+struct FiberWaiter {
+    FiberWaiter();
+
+    /**
+     * @brief 记录当前协程和调度器
+     */
+    static FiberWaiter Current();
+
+    /**
+     * @brief 放回调度器
+     */
+    void wake();
+
+    Scheduler* scheduler;
+    Fiber::ptr fiber;
+};
+
+/**
+ * @brief 协程互斥量
+ * @details 拿不到锁时挂起当前协程而不是阻塞线程, 同一个线程上的其它协程照常运行
+ *          持有锁期间可以做会挂起的IO
+ *          无竞争时只有一次CAS; unlock只唤醒一个等待者让它重新抢锁, 不直接移交,
+ *          避免持锁的协程刚释放又要加锁时跟着挂起(锁护航)
+ * @pre lock在调度器的协程里调用
+ */
+class FiberMutex : Noncopyable {
+public:
+    typedef ScopedLockImpl<FiberMutex> Lock;
+
+    FiberMutex();
+
+    void lock();
+
+    /**
+     * @brief 不挂起地尝试加锁
+     */
+    bool tryLock();
+
+    void unlock();
+private:
+    /// 0未锁, 1已锁无等待者, 2已锁可能有等待者
+    std::atomic<int> m_state;
+    Spinlock m_guard;
+    std::deque<FiberWaiter> m_waiters;
+};
+
+/**
+ * @brief 协程读写锁, 写优先
+ * @details 有写者在等时新的读者排队, 写者释放后队头连续的读者一起放行
+ * @pre rdlock/wrlock在调度器的协程里调用
+ */
+class FiberRWMutex : Noncopyable {
+public:
+    typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+    typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+
+    FiberRWMutex();
+
+    void rdlock();
+
+    void wrlock();
+
+    void unlock();
+private:
+    struct Waiter {
+        FiberWaiter waiter;
+        bool write;
+    };
+
+    Spinlock m_guard;
+    /// 持有读锁的数量
+    uint32_t m_readers;
+    /// 等待中的写者数量
+    uint32_t m_writeWaiters;
+    /// 是否有写者持有
+    bool m_writer;
+    std::deque<Waiter> m_waiters;
+};
+
+/**
+ * @brief 协程条件变量, 配合FiberMutex使用
+ */
+class FiberCondVar : Noncopyable {
+public:
+    /**
+     * @brief 释放锁并挂起, 被唤醒后重新加锁返回
+     */
+    void wait(FiberMutex::Lock& lock);
+
+    /**
+     * @brief 带超时的wait, 超时由当前IOManager的定时器触发
+     * @return 被notify唤醒返回true, 超时返回false
+     */
+    bool waitFor(FiberMutex::Lock& lock, uint64_t timeout_ms);
+
+    /**
+     * @brief 唤醒一个等待者
+     */
+    void notify();
+
+    /**
+     * @brief 唤醒所有等待者
+     */
+    void notifyAll();
+private:
+    struct Node {
+        FiberWaiter waiter;
+        bool notified = false;
+    };
+
+    Spinlock m_guard;
+    std::list<std::shared_ptr<Node> > m_waiters;
+};
+
+/**
+ * @brief 协程信号量
+ * @details notify时有等待者就把名额直接交给队头的协程, 没有才计数
+ * @pre wait在调度器的协程里调用
+ */
+class FiberSemaphore : Noncopyable {
+public:
+    FiberSemaphore(uint32_t count = 0);
+
+    void wait();
+
+    /**
+     * @brief 有名额时拿一个, 不挂起
+     */
+    bool tryWait();
+
+    void notify();
+
+    uint32_t getCount() const { return m_count;}
+private:
+    Spinlock m_guard;
+    uint32_t m_count;
+    std::deque<FiberWaiter> m_waiters;
+};
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include "file_io.h"
+#include "config.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr file_io_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint32_t>::ptr g_file_io_threads =
+    sylar::Config::Lookup("file_io.threads", (uint32_t)4, "blocking file io offload threads, 0 means no offload");
+
+FileIOPool::FileIOPool()
+    :m_threadCount(g_file_io_threads->getValue())
+    ,m_stopping(false) {
+}
+
+FileIOPool::~FileIOPool() {
+    {
+        MutexType::Lock lock(m_mutex);
+        m_stopping = true;
+    }
+    for(size_t i = 0; i < m_threads.size(); ++i) {
+        m_sem.notify();
+    }
+    for(auto &i : m_threads) {
+        i->join();
+    }
+}
+
+void FileIOPool::submit(std::function<void()> cb) {
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_threads.empty()) {
+            for(size_t i = 0; i < m_threadCount; ++i) {
+                m_threads.push_back(Thread::ptr(new Thread(std::bind(&FileIOPool::run, this),
+                                "file_io_" + std::to_string(i), &m_startSem)));
+            }
+            SYLAR_LOG_INFO(file_io_logger) << "file io pool started threads=" << m_threadCount;
+        }
+        m_tasks.push_back(std::function<void()>());
+        m_tasks.back().swap(cb);
+    }
+    m_sem.notify();
+}
+
+void FileIOPool::run() {
+    while(true) {
+        m_sem.wait();
+        std::function<void()> cb;
+        {
+            MutexType::Lock lock(m_mutex);
+            if(m_tasks.empty()) {
+                if(m_stopping) {
+                    break;
+                }
+                continue;
+            }
+            cb.swap(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        cb();
+    }
+}
+
+}
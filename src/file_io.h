@@ -0,0 +1,46 @@
+#ifndef __SYLAR_FILE_IO_H__
+#define __SYLAR_FILE_IO_H__
+
+#include <memory>
+#include <list>
+#include <vector>
+#include <functional>
+#include "thread.h"
+#include "singleton.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+// 普通文件的阻塞IO线程池
+// 普通文件永远"就绪"，epoll帮不上忙，慢盘上的read/write会卡住整个调度线程
+// hook住的文件IO把系统调用交给这里的线程执行，发起的协程挂起，完成后再由原来的Scheduler调度回来
+class FileIOPool : public Noncopyable {
+public:
+    typedef Mutex MutexType;
+
+    FileIOPool();
+    ~FileIOPool();
+
+    // file_io.threads为0时不卸载，hook直接调用原函数
+    bool isEnabled() const { return m_threadCount > 0; }
+
+    // 第一次提交时才创建线程
+    void submit(std::function<void()> cb);
+private:
+    void run();
+private:
+    MutexType m_mutex;
+    Semaphore m_sem;
+    // 线程启动的通知，不需要等
+    Semaphore m_startSem;
+    std::list<std::function<void()> > m_tasks;
+    std::vector<Thread::ptr> m_threads;
+    size_t m_threadCount;
+    bool m_stopping;
+};
+
+typedef sylar::Singleton<FileIOPool> FileIOMgr;
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "file_stream.h"
+#include "log.h"
+#include <unistd.h>
+#include <string.h>
+
+namespace sylar {
+
+static sylar::Logger::ptr file_stream_logger = SYLAR_LOG_NAME("system");
+
+FileStream::FileStream(const std::string& path, int flags, mode_t mode)
+    :m_fd(-1)
+    ,m_owner(true) {
+    m_fd = ::open(path.c_str(), flags, mode);
+    if(m_fd == -1) {
+        SYLAR_LOG_ERROR(file_stream_logger) << "open " << path << " errno="
+            << errno << " errstr=" << strerror(errno);
+    }
+}
+
+FileStream::FileStream(int fd, bool owner)
+    :m_fd(fd)
+    ,m_owner(owner) {
+}
+
+FileStream::~FileStream() {
+    if(m_owner && m_fd != -1) {
+        close();
+    }
+}
+
+int FileStream::doReadv(iovec* iov, size_t cnt) {
+    if(m_fd == -1) {
+        return -1;
+    }
+    return ::readv(m_fd, iov, cnt);
+}
+
+int FileStream::doWritev(const iovec* iov, size_t cnt) {
+    if(m_fd == -1) {
+        return -1;
+    }
+    return ::writev(m_fd, iov, cnt);
+}
+
+void FileStream::doClose() {
+    if(m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+}
@@ -0,0 +1,63 @@
+/**
+ * @file file_stream.h
+ * @brief 文件流
+ */
+#ifndef __SYLAR_FILE_STREAM_H__
+#define __SYLAR_FILE_STREAM_H__
+
+#include <string>
+#include <fcntl.h>
+#include "stream.h"
+
+namespace sylar {
+
+/**
+ * @brief 文件流, 读写带缓冲
+ * @details 协程里hook住的readv/writev会交给FileIOPool执行, 缓冲把很多次小的卸载合成一次
+ */
+class FileStream : public BufferedStream {
+public:
+    typedef std::shared_ptr<FileStream> ptr;
+
+    /**
+     * @brief 打开文件
+     * @param[in] path 文件路径
+     * @param[in] flags open的flags
+     * @param[in] mode 创建文件时的权限
+     */
+    FileStream(const std::string& path, int flags = O_RDONLY, mode_t mode = 0644);
+
+    /**
+     * @brief 用已有的文件句柄构造
+     * @param[in] owner 是否完全控制, 是的话析构时flush并关闭句柄
+     */
+    FileStream(int fd, bool owner = true);
+
+    /**
+     * @brief 析构函数
+     */
+    ~FileStream();
+
+    /**
+     * @brief 是否打开成功
+     */
+    bool isOpen() const { return m_fd != -1;}
+
+    /**
+     * @brief 返回文件句柄
+     */
+    int getFd() const { return m_fd;}
+protected:
+    virtual int doReadv(iovec* iov, size_t cnt) override;
+    virtual int doWritev(const iovec* iov, size_t cnt) override;
+    virtual void doClose() override;
+private:
+    /// 文件句柄
+    int m_fd;
+    /// 是否主控
+    bool m_owner;
+};
+
+}
+
+#endif
@@ -8,13 +8,19 @@
 #include "config.h"
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <fcntl.h>
 #include "log.h"
 #include "fd_manager.h"
+#include "file_io.h"
+#include "util.h"
+#include <vector>
+#include <map>
 
 namespace sylar {
 
 static sylar::ConfigVar<int>::ptr g_tcp_connect_timeout = sylar::Config::Lookup("tcp.connect.timeout", 5000, "tcp connect timeout");
+static sylar::ConfigVar<bool>::ptr g_tcp_readiness_hint = sylar::Config::Lookup("tcp.readiness_hint", true, "park on known not ready socket without syscall");
 
 sylar::Logger::ptr hook_logger = SYLAR_LOG_ROOT();
 static thread_local bool t_hook_enable = false;
@@ -26,6 +32,7 @@ static thread_local bool t_hook_enable = false;
     XX(socket) \
     XX(connect) \
     XX(accept) \
+    XX(accept4) \
     XX(read) \
     XX(readv) \
     XX(recv) \
@@ -36,6 +43,17 @@ static thread_local bool t_hook_enable = false;
     XX(send) \
     XX(sendto) \
     XX(sendmsg) \
+    XX(sendfile) \
+    XX(splice) \
+    XX(tee) \
+    XX(copy_file_range) \
+    XX(poll) \
+    XX(select) \
+    XX(epoll_wait) \
+    XX(open) \
+    XX(pread) \
+    XX(pwrite) \
+    XX(fsync) \
     XX(close) \
     XX(fcntl) \
     XX(ioctl) \
@@ -53,6 +71,10 @@ void hook_init() {
 }
 
 static uint64_t s_connect_timeout = -1;
+static bool s_readiness_hint = true;
+
+static std::atomic<uint64_t> s_avoided_syscalls = {0};
+static std::atomic<uint64_t> s_eagain_syscalls = {0};
 
 struct _HookIniter {
     _HookIniter() {
@@ -62,6 +84,11 @@ struct _HookIniter {
             SYLAR_LOG_INFO(hook_logger) << "tcp connect timeout changed from " << old_value << " to "<< new_value;
             s_connect_timeout = g_tcp_connect_timeout->getValue();
         });
+        s_readiness_hint = g_tcp_readiness_hint->getValue();
+        g_tcp_readiness_hint->addListener([](const bool& old_value, const bool &new_value){
+            SYLAR_LOG_INFO(hook_logger) << "tcp readiness hint changed from " << old_value << " to "<< new_value;
+            s_readiness_hint = new_value;
+        });
     }
 };
 static _HookIniter s_hook_initer;
@@ -75,12 +102,38 @@ void set_hook_enable(bool flag){
     t_hook_enable = flag;
 }
 
+HookIoStats get_hook_io_stats() {
+    HookIoStats stats;
+    stats.avoided_syscalls = s_avoided_syscalls.load(std::memory_order_relaxed);
+    stats.eagain_syscalls = s_eagain_syscalls.load(std::memory_order_relaxed);
+    return stats;
+}
+
 }
 
 struct timer_info {
     int cancelled = 0;
 };
 
+// 普通文件的IO交给FileIOPool执行，当前协程挂起等结果，errno一起带回来
+template<typename Fun>
+static ssize_t do_file_io(Fun fun) {
+    sylar::Scheduler *scheduler = sylar::Scheduler::GetThis();
+    sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
+    ssize_t rt = -1;
+    int err = 0;
+    scheduler->addExternalWait();
+    sylar::FileIOMgr::GetInstance()->submit([&rt, &err, &fun, scheduler, fiber](){
+        rt = fun();
+        err = errno;
+        scheduler->schedule(fiber);
+        scheduler->doneExternalWait();
+    });
+    sylar::Fiber::YieldToHold(sylar::Fiber::PARK_EXTERNAL);
+    errno = err;
+    return rt;
+}
+
 template<typename OriginFun, typename ... Args>
 static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name, uint32_t event,
                      int timeout_so, Args &&... args) {
@@ -88,7 +141,7 @@ static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name, uint32_t
         return fun(fd, std::forward<Args>(args)...);
     }
     
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
     if(!ctx) {
         return fun(fd, std::forward<Args>(args)...);
     }
@@ -98,18 +151,40 @@ static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name, uint32_t
         return -1;
     }
 
-    if(!ctx->isSocket() || ctx->getUserNonblock()) {
+    if(ctx->isFile() && sylar::FileIOMgr::GetInstance()->isEnabled()) {
+        return do_file_io([&](){
+            return fun(fd, std::forward<Args>(args)...);
+        });
+    }
+
+    // 只有socket和pipe/FIFO被设成了系统非阻塞，能进epoll挂起
+    if(!ctx->getSysNonblock() || ctx->getUserNonblock()) {
         return fun(fd, std::forward<Args>(args)...);
     }
     // std::cout << "DO IO" << std::endl;
     uint64_t to = ctx->getTimeout(timeout_so);
     std::shared_ptr<timer_info> tinfo(new timer_info);
-retry:
-    ssize_t n = fun(fd, std::forward<Args>(args)...);
-    while(n == -1 && errno == EINTR) {
-        n = fun(fd, std::forward<Args>(args)...);
-    } 
-    if( n == -1 && errno == EAGAIN ) {
+
+    // 已知没就绪的fd直接挂起等epoll，省掉一次必然EAGAIN的系统调用
+    // 判断错了也没关系，边缘触发的epoll_ctl在fd已经就绪时会马上通知
+    bool park = sylar::s_readiness_hint && !ctx->isReady(event);
+    if(park) {
+        sylar::s_avoided_syscalls.fetch_add(1, std::memory_order_relaxed);
+    }
+    while(true) {
+        if(!park) {
+            ssize_t n = fun(fd, std::forward<Args>(args)...);
+            while(n == -1 && errno == EINTR) {
+                n = fun(fd, std::forward<Args>(args)...);
+            }
+            if(n != -1 || errno != EAGAIN) {
+                return n;
+            }
+            sylar::s_eagain_syscalls.fetch_add(1, std::memory_order_relaxed);
+            ctx->setReady(event, false);
+        }
+        park = false;
+
         sylar::IOManager *iom = sylar::IOManager::GetThis();
         sylar::Timer::ptr timer;
         std::weak_ptr<timer_info> winfo(tinfo);
@@ -133,7 +208,7 @@ retry:
             }
             return -1;
         } else {
-            sylar::Fiber::YieldToHold();
+            sylar::Fiber::YieldToHold(sylar::Fiber::PARK_IO, fd);
             if(timer) {
                 timer->cancel();
             }
@@ -141,12 +216,108 @@ retry:
                 errno = tinfo->cancelled;
                 return -1;
             }
-            goto retry;
+            if(ctx->takeCancelled(event)) {
+                errno = ECANCELED;
+                return -1;
+            }
+            ctx->setReady(event, true);
         }
     }
+}
+
+// 流式socket读写不满说明内核缓冲区已经读空/写满，下次直接挂起等epoll
+static ssize_t hint_ready(int fd, uint32_t event, ssize_t n, size_t len) {
+    if(!sylar::t_hook_enable || !sylar::s_readiness_hint || n <= 0 || (size_t)n >= len) {
+        return n;
+    }
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
+    if(ctx && ctx->isStream() && !ctx->getUserNonblock()) {
+        ctx->setReady(event, false);
+    }
     return n;
 }
 
+// 距离deadline还剩多少毫秒，deadline为-1表示不超时，返回-1
+static int remain_ms(uint64_t deadline) {
+    if(deadline == (uint64_t)-1) {
+        return -1;
+    }
+    uint64_t now = sylar::GetCurrentMS();
+    return now >= deadline ? 0 : (int)(deadline - now);
+}
+
+enum PollParkResult {
+    POLL_PARKED,        // 挂起过，醒来后重新探测
+    POLL_UNPOLLABLE,    // 有fd加不进epoll(比如普通文件)
+    POLL_BUSY,          // 有fd的同一个事件已经有别的协程在等
+};
+
+// 有fd被别的协程占着时挂起这么久再重新探测
+static const int s_poll_busy_ms = 10;
+
+// 把pollfd集合翻译成IOManager的事件加一个定时器，任意一个触发就唤醒当前协程
+// 同一个fd出现多次时合并成一次注册；events为0的fd也注册READ，POLLHUP/POLLERR会通过它唤醒
+static PollParkResult park_on_pollfds(struct pollfd *fds, nfds_t nfds, int timeout_ms) {
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
+    std::shared_ptr<std::atomic<bool>> woken(new std::atomic<bool>(false));
+    auto wake = [iom, fiber, woken]() {
+        if(!woken->exchange(true)) {
+            iom->schedule(fiber);
+        }
+    };
+
+    std::map<int, uint32_t> wanted;
+    for(nfds_t i = 0; i < nfds; i++) {
+        if(fds[i].fd < 0) {
+            continue;
+        }
+        uint32_t &ev = wanted[fds[i].fd];
+        if(fds[i].events & (POLLOUT | POLLWRNORM | POLLWRBAND)) {
+            ev |= sylar::IOManager::WRITE;
+        }
+        if((fds[i].events & (POLLIN | POLLPRI | POLLRDNORM | POLLRDBAND | POLLRDHUP))
+                || !(fds[i].events & (POLLOUT | POLLWRNORM | POLLWRBAND))) {
+            ev |= sylar::IOManager::READ;
+        }
+    }
+
+    std::vector<std::pair<int, sylar::IOManager::Event>> added;
+    PollParkResult res = POLL_PARKED;
+    for(auto it = wanted.begin(); it != wanted.end() && res == POLL_PARKED; ++it) {
+        for(uint32_t e : {(uint32_t)sylar::IOManager::READ, (uint32_t)sylar::IOManager::WRITE}) {
+            if(!(it->second & e)) {
+                continue;
+            }
+            int rt = iom->tryAddEvent(it->first, (sylar::IOManager::Event)e, wake);
+            if(rt) {
+                res = rt > 0 ? POLL_BUSY : POLL_UNPOLLABLE;
+                break;
+            }
+            added.push_back(std::make_pair(it->first, (sylar::IOManager::Event)e));
+        }
+    }
+
+    sylar::Timer::ptr timer;
+    if(res == POLL_PARKED) {
+        if(timeout_ms >= 0) {
+            timer = iom->addConditionTimer(timeout_ms, wake, std::weak_ptr<void>(woken));
+        }
+        sylar::Fiber::YieldToHold(sylar::Fiber::PARK_IO, nfds ? fds[0].fd : -1);
+    } else if(woken->exchange(true)) {
+        // 注册到一半已经有事件触发，协程已被放进调度队列，要把这次唤醒消费掉
+        sylar::Fiber::YieldToHold(sylar::Fiber::PARK_IO, nfds ? fds[0].fd : -1);
+    }
+
+    // 没触发的事件直接删掉，回调里的woken保证只唤醒一次
+    for(auto &i : added) {
+        iom->delEvent(i.first, i.second);
+    }
+    if(timer) {
+        timer->cancel();
+    }
+    return res;
+}
 
 extern "C" {
 
@@ -163,7 +334,7 @@ unsigned int sleep(unsigned int seconds) {
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager *iom = sylar::IOManager::GetThis();
     iom->addTimer(seconds * 1000, std::bind((void(sylar::Scheduler::*)(sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule, iom, fiber, -1));
-    sylar::Fiber::YieldToHold();
+    sylar::Fiber::YieldToHold(sylar::Fiber::PARK_TIMER, seconds * 1000);
     return 0;
 }
 
@@ -176,7 +347,7 @@ int usleep(useconds_t usec) {
     sylar::IOManager *iom = sylar::IOManager::GetThis();
     iom->addTimer(usec / 1000, std::bind((void(sylar::Scheduler::*)(sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule, iom, fiber, -1));
  
-    sylar::Fiber::YieldToHold();
+    sylar::Fiber::YieldToHold(sylar::Fiber::PARK_TIMER, usec / 1000);
     return 0;
 }
 
@@ -190,7 +361,7 @@ int nanosleep(const struct timespec *req, struct timespec *rem){
     sylar::IOManager *iom = sylar::IOManager::GetThis();
     iom->addTimer(timeout_ms, std::bind((void(sylar::Scheduler::*)(sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule, iom, fiber, -1));
 
-    sylar::Fiber::YieldToHold();
+    sylar::Fiber::YieldToHold(sylar::Fiber::PARK_TIMER, timeout_ms);
     return 0;
 }
 
@@ -212,7 +383,7 @@ int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen,
     if(!sylar::t_hook_enable) {
         return connect_f(fd, addr, addrlen);
     }
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
     if(!ctx || ctx->isClose()) {
         errno = EBADF;
         return -1;
@@ -247,7 +418,7 @@ int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen,
 
     int rt = iom->addEvent(fd, sylar::IOManager::WRITE);
     if(rt == 0){
-        sylar::Fiber::YieldToHold();
+        sylar::Fiber::YieldToHold(sylar::Fiber::PARK_IO, fd);
         if(timer){
             timer->cancel();
         }
@@ -286,8 +457,19 @@ int accept(int s, struct sockaddr *addr, socklen_t *addrlen){
     return fd;
 }
 
+int accept4(int s, struct sockaddr *addr, socklen_t *addrlen, int flags) {
+    int fd = do_io(s, accept4_f, "accept4", sylar::IOManager::READ, SO_RCVTIMEO, addr, addrlen, flags);
+    if(fd >= 0 && sylar::t_hook_enable) {
+        sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd, true);
+        if(ctx && (flags & SOCK_NONBLOCK)) {
+            ctx->setUserNonblock(true);
+        }
+    }
+    return fd;
+}
+
 ssize_t read(int fd, void *buf, size_t count) {
-    return do_io(fd, read_f, "read", sylar::IOManager::READ, SO_RCVTIMEO, buf, count);
+    return hint_ready(fd, sylar::IOManager::READ, do_io(fd, read_f, "read", sylar::IOManager::READ, SO_RCVTIMEO, buf, count), count);
 }
 
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt){
@@ -295,7 +477,10 @@ ssize_t readv(int fd, const struct iovec *iov, int iovcnt){
 }
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags){
-    return do_io(sockfd, recv_f, "recv", sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+    if(flags & MSG_PEEK) {
+        return do_io(sockfd, recv_f, "recv", sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+    }
+    return hint_ready(sockfd, sylar::IOManager::READ, do_io(sockfd, recv_f, "recv", sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags), len);
 }
 
 ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen){
@@ -309,7 +494,7 @@ ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags){
 
 
 ssize_t write(int fd, const void *buf, size_t count){
-    return do_io(fd, write_f, "write", sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count);
+    return hint_ready(fd, sylar::IOManager::WRITE, do_io(fd, write_f, "write", sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count), count);
 }
 
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt){
@@ -317,7 +502,7 @@ ssize_t writev(int fd, const struct iovec *iov, int iovcnt){
 }
 
 ssize_t send(int s, const void *msg, size_t len, int flags){
-    return do_io(s, send_f, "send", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags);
+    return hint_ready(s, sylar::IOManager::WRITE, do_io(s, send_f, "send", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags), len);
 }
 
 ssize_t sendto(int s, const void *msg, size_t len, int flags, const struct sockaddr *to, socklen_t tolen){
@@ -328,12 +513,241 @@ ssize_t sendmsg(int s, const struct msghdr *msg, int flags){
     return do_io(s, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
 }
 
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    return hint_ready(out_fd, sylar::IOManager::WRITE, do_io(out_fd, sendfile_f, "sendfile", sylar::IOManager::WRITE, SO_SNDTIMEO, in_fd, offset, count), count);
+}
+
+// splice/tee两端都可能是非阻塞的socket或pipe，EAGAIN时分不清是读空了还是写满了
+// 两端都就绪才能继续，所以先探测一次，哪一端没就绪就挂起等哪一端
+static ssize_t do_pipe_io(int fd_in, int fd_out, const std::function<ssize_t()> &fun) {
+    sylar::FdCtx *in = sylar::FdMgr::GetInstance()->get(fd_in);
+    sylar::FdCtx *out = sylar::FdMgr::GetInstance()->get(fd_out);
+    uint64_t to = std::min(in->getTimeout(SO_RCVTIMEO), out->getTimeout(SO_SNDTIMEO));
+    uint64_t deadline = to == (uint64_t)-1 ? (uint64_t)-1 : sylar::GetCurrentMS() + to;
+    while(true) {
+        ssize_t n = fun();
+        if(n != -1 || (errno != EAGAIN && errno != EINTR)) {
+            return n;
+        }
+        int left = remain_ms(deadline);
+        if(left == 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        struct pollfd fds[2] = {{fd_in, POLLIN, 0}, {fd_out, POLLOUT, 0}};
+        if(poll_f(fds, 2, 0) < 0) {
+            return -1;
+        }
+        struct pollfd *wait = !fds[0].revents ? &fds[0] : (!fds[1].revents ? &fds[1] : nullptr);
+        if(wait && poll(wait, 1, left) < 0) {
+            return -1;
+        }
+    }
+}
+
+static bool parks_on_epoll(int fd) {
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
+    return ctx && !ctx->isClose() && ctx->getSysNonblock() && !ctx->getUserNonblock();
+}
+
+// 只有一端会挂起时在那一端上等，socket->文件等读，文件->socket等写
+ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) {
+    auto fun = [=](int) {
+        return splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+    };
+    if(!sylar::t_hook_enable) {
+        return fun(fd_in);
+    }
+    bool wait_in = parks_on_epoll(fd_in);
+    if(wait_in && parks_on_epoll(fd_out)) {
+        return do_pipe_io(fd_in, fd_out, [&](){ return fun(fd_in); });
+    }
+    if(wait_in) {
+        return do_io(fd_in, fun, "splice", sylar::IOManager::READ, SO_RCVTIMEO);
+    }
+    return do_io(fd_out, fun, "splice", sylar::IOManager::WRITE, SO_SNDTIMEO);
+}
+
+// tee两端都只能是pipe，copy_file_range只能作用在普通文件上
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags) {
+    if(!sylar::t_hook_enable || !parks_on_epoll(fd_in) || !parks_on_epoll(fd_out)) {
+        return do_io(fd_in, tee_f, "tee", sylar::IOManager::READ, SO_RCVTIMEO, fd_out, len, flags);
+    }
+    return do_pipe_io(fd_in, fd_out, [=](){ return tee_f(fd_in, fd_out, len, flags); });
+}
+
+ssize_t copy_file_range(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) {
+    return do_io(fd_in, copy_file_range_f, "copy_file_range", sylar::IOManager::READ, SO_RCVTIMEO, off_in, fd_out, off_out, len, flags);
+}
+
+// 先用0超时探测一次，都没就绪再挂起协程等epoll或超时，醒来后再探测
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+    if(!sylar::t_hook_enable) {
+        return poll_f(fds, nfds, timeout);
+    }
+    int rt = poll_f(fds, nfds, 0);
+    if(rt != 0 || timeout == 0) {
+        return rt;
+    }
+    uint64_t deadline = timeout > 0 ? sylar::GetCurrentMS() + timeout : (uint64_t)-1;
+    while(true) {
+        int left = remain_ms(deadline);
+        if(left == 0) {
+            return 0;
+        }
+        PollParkResult res = park_on_pollfds(fds, nfds, left);
+        if(res == POLL_UNPOLLABLE) {
+            return poll_f(fds, nfds, left);
+        }
+        if(res == POLL_BUSY) {
+            // 不能阻塞在poll_f上，占着事件的协程和定时器可能就在这个线程上，挂起一会再探测
+            int wait = left < 0 ? s_poll_busy_ms : std::min(left, s_poll_busy_ms);
+            sylar::IOManager *iom = sylar::IOManager::GetThis();
+            iom->addTimer(wait, std::bind((void(sylar::Scheduler::*)(sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule
+                        , iom, sylar::Fiber::GetThis(), -1));
+            sylar::Fiber::YieldToHold(sylar::Fiber::PARK_IO, nfds ? fds[0].fd : -1);
+        }
+        rt = poll_f(fds, nfds, 0);
+        if(rt != 0) {
+            return rt;
+        }
+    }
+}
+
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout) {
+    if(!sylar::t_hook_enable) {
+        return select_f(nfds, readfds, writefds, exceptfds, timeout);
+    }
+    std::vector<struct pollfd> pfds;
+    for(int fd = 0; fd < nfds; fd++) {
+        short events = 0;
+        if(readfds && FD_ISSET(fd, readfds)) {
+            events |= POLLIN;
+        }
+        if(writefds && FD_ISSET(fd, writefds)) {
+            events |= POLLOUT;
+        }
+        if(exceptfds && FD_ISSET(fd, exceptfds)) {
+            events |= POLLPRI;
+        }
+        if(events) {
+            struct pollfd pfd = {fd, events, 0};
+            pfds.push_back(pfd);
+        }
+    }
+
+    int timeout_ms = timeout ? timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000 : -1;
+    int rt = poll(pfds.data(), pfds.size(), timeout_ms);
+    if(rt < 0) {
+        return rt;
+    }
+    if(readfds) {
+        FD_ZERO(readfds);
+    }
+    if(writefds) {
+        FD_ZERO(writefds);
+    }
+    if(exceptfds) {
+        FD_ZERO(exceptfds);
+    }
+    int count = 0;
+    for(auto &pfd : pfds) {
+        if(pfd.revents & POLLNVAL) {
+            errno = EBADF;
+            return -1;
+        }
+        if((pfd.events & POLLIN) && (pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            FD_SET(pfd.fd, readfds);
+            count++;
+        }
+        if((pfd.events & POLLOUT) && (pfd.revents & (POLLOUT | POLLERR))) {
+            FD_SET(pfd.fd, writefds);
+            count++;
+        }
+        if((pfd.events & POLLPRI) && (pfd.revents & POLLPRI)) {
+            FD_SET(pfd.fd, exceptfds);
+            count++;
+        }
+    }
+    return count;
+}
+
+// epoll fd本身有就绪事件时可读，等它可读之后再非阻塞地取事件
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+    if(!sylar::t_hook_enable) {
+        return epoll_wait_f(epfd, events, maxevents, timeout);
+    }
+    int rt = epoll_wait_f(epfd, events, maxevents, 0);
+    if(rt != 0 || timeout == 0) {
+        return rt;
+    }
+    uint64_t deadline = timeout > 0 ? sylar::GetCurrentMS() + timeout : (uint64_t)-1;
+    while(true) {
+        struct pollfd pfd = {epfd, POLLIN, 0};
+        rt = poll(&pfd, 1, remain_ms(deadline));
+        if(rt <= 0) {
+            return rt;
+        }
+        rt = epoll_wait_f(epfd, events, maxevents, 0);
+        if(rt != 0) {
+            return rt;
+        }
+    }
+}
+
+int open(const char *pathname, int flags, ...) {
+    mode_t mode = 0;
+    // O_TMPFILE包含了O_DIRECTORY的位，要整体比较
+    if((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) {
+        va_list va;
+        va_start(va, flags);
+        mode = va_arg(va, mode_t);
+        va_end(va);
+    }
+    if(!sylar::t_hook_enable) {
+        return open_f(pathname, flags, mode);
+    }
+    int fd = -1;
+    if(sylar::FileIOMgr::GetInstance()->isEnabled()) {
+        fd = do_file_io([=](){
+            return open_f(pathname, flags, mode);
+        });
+    } else {
+        fd = open_f(pathname, flags, mode);
+    }
+    if(fd >= 0) {
+        sylar::FdMgr::GetInstance()->get(fd, true);
+    }
+    return fd;
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+    return do_io(fd, pread_f, "pread", sylar::IOManager::READ, SO_RCVTIMEO, buf, count, offset);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    return do_io(fd, pwrite_f, "pwrite", sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count, offset);
+}
+
+int fsync(int fd) {
+    if(!sylar::t_hook_enable) {
+        return fsync_f(fd);
+    }
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
+    if(!ctx || !ctx->isFile() || !sylar::FileIOMgr::GetInstance()->isEnabled()) {
+        return fsync_f(fd);
+    }
+    return do_file_io([fd](){
+        return fsync_f(fd);
+    });
+}
+
 int close(int fd) {
     if(!sylar::t_hook_enable) {
         return close_f(fd);
     }
 
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
     if(ctx) {
         auto iom = sylar::IOManager::GetThis();
         if(iom){
@@ -352,8 +766,8 @@ int fcntl(int fd, int cmd, ...){
             {
                 int arg = va_arg(va, int);
                 va_end(va);
-                sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-                if(!ctx || ctx->isClose() || !ctx->isSocket()) {
+                sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
+                if(!ctx || ctx->isClose() || !ctx->getSysNonblock()) {
                     return fcntl_f(fd, cmd, arg);
                 }
                 ctx->setUserNonblock(arg & O_NONBLOCK);
@@ -368,8 +782,8 @@ int fcntl(int fd, int cmd, ...){
             {
                 va_end(va);
                 int arg = fcntl_f(fd, cmd);
-                sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-                if(!ctx || ctx->isClose() || ctx->isSocket()) {
+                sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
+                if(!ctx || ctx->isClose() || !ctx->getSysNonblock()) {
                     return arg;
                 }
                 if(ctx->getUserNonblock()) {
@@ -434,8 +848,8 @@ int ioctl(int d, unsigned long int request, ...){
 
     if(FIONBIO == request) {
         bool user_nonblock = !!*(int *)arg;
-        sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(d);
-        if(!ctx || ctx->isClose() || !ctx->isSocket()) {
+        sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(d);
+        if(!ctx || ctx->isClose() || !ctx->getSysNonblock()) {
             return ioctl_f(d, request, arg);
         }
         ctx->setUserNonblock(user_nonblock);
@@ -453,7 +867,7 @@ int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t
     }
     if(level == SOL_SOCKET) {
         if(optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) {
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(sockfd);
+            sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(sockfd);
             if(ctx) {
                 const timeval *tv = (const timeval*)optval;
                 ctx->setTimeout(optname, tv->tv_sec * 1000 + tv->tv_usec / 1000);
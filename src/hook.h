@@ -7,11 +7,23 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/epoll.h>
+
+#include <stdint.h>
 
 namespace sylar {
     bool is_hook_enable();
 
     void set_hook_enable(bool flag);
+
+    // hook IO的统计
+    struct HookIoStats {
+        uint64_t avoided_syscalls = 0;  // fd已知未就绪，直接挂起省掉的系统调用
+        uint64_t eagain_syscalls = 0;   // 实际调用之后返回EAGAIN的系统调用
+    };
+    HookIoStats get_hook_io_stats();
 }
 
 extern "C" {
@@ -33,9 +45,15 @@ extern "C" {
     typedef int (*connect_fun)(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
     extern connect_fun connect_f;
 
+    // 带超时的connect，timeout_ms为-1表示不超时
+    int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen, uint64_t timeout_ms);
+
     typedef int (*accept_fun)(int s, struct sockaddr *addr, socklen_t *addrlen);
     extern accept_fun accept_f;
 
+    typedef int (*accept4_fun)(int s, struct sockaddr *addr, socklen_t *addrlen, int flags);
+    extern accept4_fun accept4_f;
+
     typedef ssize_t (*read_fun)(int fd, void *buf, size_t count);
     extern read_fun read_f;
 
@@ -68,6 +86,42 @@ extern "C" {
     typedef ssize_t (*sendmsg_fun)(int s, const struct msghdr *msg, int flags);
     extern sendmsg_fun sendmsg_f;
 
+    // 零拷贝
+    typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t *offset, size_t count);
+    extern sendfile_fun sendfile_f;
+
+    typedef ssize_t (*splice_fun)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags);
+    extern splice_fun splice_f;
+
+    typedef ssize_t (*tee_fun)(int fd_in, int fd_out, size_t len, unsigned int flags);
+    extern tee_fun tee_f;
+
+    typedef ssize_t (*copy_file_range_fun)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags);
+    extern copy_file_range_fun copy_file_range_f;
+
+    // 多路复用
+    typedef int (*poll_fun)(struct pollfd *fds, nfds_t nfds, int timeout);
+    extern poll_fun poll_f;
+
+    typedef int (*select_fun)(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
+    extern select_fun select_f;
+
+    typedef int (*epoll_wait_fun)(int epfd, struct epoll_event *events, int maxevents, int timeout);
+    extern epoll_wait_fun epoll_wait_f;
+
+    // 普通文件
+    typedef int (*open_fun)(const char *pathname, int flags, ...);
+    extern open_fun open_f;
+
+    typedef ssize_t (*pread_fun)(int fd, void *buf, size_t count, off_t offset);
+    extern pread_fun pread_f;
+
+    typedef ssize_t (*pwrite_fun)(int fd, const void *buf, size_t count, off_t offset);
+    extern pwrite_fun pwrite_f;
+
+    typedef int (*fsync_fun)(int fd);
+    extern fsync_fun fsync_f;
+
     typedef int (*close_fun)(int fd);
     extern close_fun close_f;
 
@@ -0,0 +1,206 @@
+#include "http.h"
+#include <sstream>
+
+namespace sylar {
+namespace http {
+
+HttpMethod StringToHttpMethod(const char* m, size_t len) {
+#define XX(num, name, string) \
+    if(len == sizeof(#string) - 1 && memcmp(#string, m, len) == 0) { \
+        return HttpMethod::name; \
+    }
+    HTTP_METHOD_MAP(XX);
+#undef XX
+    return HttpMethod::INVALID_METHOD;
+}
+
+static const char* s_method_string[] = {
+#define XX(num, name, string) #string,
+    HTTP_METHOD_MAP(XX)
+#undef XX
+};
+
+const char* HttpMethodToString(const HttpMethod& m) {
+    uint32_t idx = (uint32_t)m;
+    if(idx >= (sizeof(s_method_string) / sizeof(s_method_string[0]))) {
+        return "<unknown>";
+    }
+    return s_method_string[idx];
+}
+
+const char* HttpStatusToString(const HttpStatus& s) {
+    switch(s) {
+#define XX(code, name, msg) \
+        case HttpStatus::name: \
+            return #msg;
+        HTTP_STATUS_MAP(XX);
+#undef XX
+        default:
+            return "<unknown>";
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const StringPiece& s) {
+    if(s.size) {
+        os.write(s.data, s.size);
+    }
+    return os;
+}
+
+HttpRequest::HttpRequest() {
+    reset();
+}
+
+void HttpRequest::reset() {
+    m_method = HttpMethod::GET;
+    m_version = 0x11;
+    m_close = false;
+    m_chunked = false;
+    m_contentLength = 0;
+    m_uri = StringPiece();
+    m_path = StringPiece();
+    m_query = StringPiece();
+    m_fragment = StringPiece();
+    m_body = StringPiece();
+    m_headerCount = 0;
+}
+
+StringPiece HttpRequest::getHeader(const StringPiece& key, const StringPiece& def) const {
+    for(size_t i = 0; i < m_headerCount; ++i) {
+        if(m_headers[i].name.iequals(key)) {
+            return m_headers[i].value;
+        }
+    }
+    return def;
+}
+
+bool HttpRequest::hasHeader(const StringPiece& key, StringPiece* val) const {
+    for(size_t i = 0; i < m_headerCount; ++i) {
+        if(m_headers[i].name.iequals(key)) {
+            if(val) {
+                *val = m_headers[i].value;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+std::ostream& HttpRequest::dump(std::ostream& os) const {
+    os << HttpMethodToString(m_method) << " "
+       << m_uri
+       << " HTTP/"
+       << ((uint32_t)(m_version >> 4))
+       << "."
+       << ((uint32_t)(m_version & 0x0F))
+       << "\r\n";
+    for(size_t i = 0; i < m_headerCount; ++i) {
+        os << m_headers[i].name << ": " << m_headers[i].value << "\r\n";
+    }
+    os << "\r\n" << m_body;
+    return os;
+}
+
+std::string HttpRequest::toString() const {
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+HttpResponse::HttpResponse(uint8_t version, bool close)
+    :m_status(HttpStatus::OK)
+    ,m_version(version)
+    ,m_close(close) {
+}
+
+void HttpResponse::reset(uint8_t version, bool close) {
+    m_status = HttpStatus::OK;
+    m_version = version;
+    m_close = close;
+    m_body.clear();
+    m_reason.clear();
+    m_headers.clear();
+}
+
+std::string HttpResponse::getHeader(const std::string& key, const std::string& def) const {
+    for(auto& i : m_headers) {
+        if(strcasecmp(i.first.c_str(), key.c_str()) == 0) {
+            return i.second;
+        }
+    }
+    return def;
+}
+
+void HttpResponse::setHeader(const std::string& key, const std::string& val) {
+    for(auto& i : m_headers) {
+        if(strcasecmp(i.first.c_str(), key.c_str()) == 0) {
+            i.second = val;
+            return;
+        }
+    }
+    m_headers.push_back(std::make_pair(key, val));
+}
+
+void HttpResponse::delHeader(const std::string& key) {
+    for(auto it = m_headers.begin(); it != m_headers.end(); ++it) {
+        if(strcasecmp(it->first.c_str(), key.c_str()) == 0) {
+            m_headers.erase(it);
+            return;
+        }
+    }
+}
+
+void HttpResponse::encodeHead(std::string& out) const {
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), "HTTP/%u.%u %u ", (uint32_t)(m_version >> 4)
+                , (uint32_t)(m_version & 0x0F), (uint32_t)m_status);
+    out.append(buf, n);
+    if(m_reason.empty()) {
+        out.append(HttpStatusToString(m_status));
+    } else {
+        out.append(m_reason);
+    }
+    out.append("\r\n");
+
+    for(auto& i : m_headers) {
+        if(strcasecmp(i.first.c_str(), "connection") == 0
+                || strcasecmp(i.first.c_str(), "content-length") == 0) {
+            continue;
+        }
+        out.append(i.first);
+        out.append(": ");
+        out.append(i.second);
+        out.append("\r\n");
+    }
+    out.append(m_close ? "connection: close\r\n" : "connection: keep-alive\r\n");
+    n = snprintf(buf, sizeof(buf), "content-length: %zu\r\n\r\n", m_body.size());
+    out.append(buf, n);
+}
+
+void HttpResponse::encode(std::string& out) const {
+    encodeHead(out);
+    out.append(m_body);
+}
+
+std::ostream& HttpResponse::dump(std::ostream& os) const {
+    std::string out;
+    encode(out);
+    return os << out;
+}
+
+std::string HttpResponse::toString() const {
+    std::string out;
+    encode(out);
+    return out;
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req) {
+    return req.dump(os);
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp) {
+    return rsp.dump(os);
+}
+
+}
+}
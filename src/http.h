@@ -0,0 +1,320 @@
+/**
+ * @file http.h
+ * @brief HTTP定义
+ */
+#ifndef __SYLAR_HTTP_H__
+#define __SYLAR_HTTP_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+
+namespace sylar {
+namespace http {
+
+/* Request Methods */
+#define HTTP_METHOD_MAP(XX)         \
+  XX(0,  DELETE,      DELETE)       \
+  XX(1,  GET,         GET)          \
+  XX(2,  HEAD,        HEAD)         \
+  XX(3,  POST,        POST)         \
+  XX(4,  PUT,         PUT)          \
+  XX(5,  CONNECT,     CONNECT)      \
+  XX(6,  OPTIONS,     OPTIONS)      \
+  XX(7,  TRACE,       TRACE)        \
+  XX(8,  PATCH,       PATCH)        \
+
+/* Status Codes */
+#define HTTP_STATUS_MAP(XX)                                                 \
+  XX(100, CONTINUE,                        Continue)                        \
+  XX(101, SWITCHING_PROTOCOLS,             Switching Protocols)             \
+  XX(200, OK,                              OK)                              \
+  XX(201, CREATED,                         Created)                         \
+  XX(202, ACCEPTED,                        Accepted)                        \
+  XX(204, NO_CONTENT,                      No Content)                      \
+  XX(206, PARTIAL_CONTENT,                 Partial Content)                 \
+  XX(301, MOVED_PERMANENTLY,               Moved Permanently)               \
+  XX(302, FOUND,                           Found)                           \
+  XX(304, NOT_MODIFIED,                    Not Modified)                    \
+  XX(307, TEMPORARY_REDIRECT,              Temporary Redirect)              \
+  XX(400, BAD_REQUEST,                     Bad Request)                     \
+  XX(401, UNAUTHORIZED,                    Unauthorized)                    \
+  XX(403, FORBIDDEN,                       Forbidden)                       \
+  XX(404, NOT_FOUND,                       Not Found)                       \
+  XX(405, METHOD_NOT_ALLOWED,              Method Not Allowed)              \
+  XX(408, REQUEST_TIMEOUT,                 Request Timeout)                 \
+  XX(411, LENGTH_REQUIRED,                 Length Required)                 \
+  XX(413, PAYLOAD_TOO_LARGE,               Payload Too Large)               \
+  XX(414, URI_TOO_LONG,                    URI Too Long)                    \
+  XX(431, REQUEST_HEADER_FIELDS_TOO_LARGE, Request Header Fields Too Large) \
+  XX(500, INTERNAL_SERVER_ERROR,           Internal Server Error)           \
+  XX(501, NOT_IMPLEMENTED,                 Not Implemented)                 \
+  XX(502, BAD_GATEWAY,                     Bad Gateway)                     \
+  XX(503, SERVICE_UNAVAILABLE,             Service Unavailable)             \
+  XX(504, GATEWAY_TIMEOUT,                 Gateway Timeout)                 \
+  XX(505, HTTP_VERSION_NOT_SUPPORTED,      HTTP Version Not Supported)      \
+
+/**
+ * @brief HTTP方法枚举
+ */
+enum class HttpMethod {
+#define XX(num, name, string) name = num,
+    HTTP_METHOD_MAP(XX)
+#undef XX
+    INVALID_METHOD
+};
+
+/**
+ * @brief HTTP状态枚举
+ */
+enum class HttpStatus {
+#define XX(code, name, desc) name = code,
+    HTTP_STATUS_MAP(XX)
+#undef XX
+};
+
+/**
+ * @brief 将字符串方法名转成HTTP方法枚举
+ */
+HttpMethod StringToHttpMethod(const char* m, size_t len);
+
+/**
+ * @brief 将HTTP方法枚举转换成字符串
+ */
+const char* HttpMethodToString(const HttpMethod& m);
+
+/**
+ * @brief 将HTTP状态枚举转换成字符串
+ */
+const char* HttpStatusToString(const HttpStatus& s);
+
+/**
+ * @brief 指向外部内存的一段字符串, 不拥有内存
+ * @details 解析出来的字段都是指向接收缓冲区的StringPiece, 解析过程不分配内存
+ *          缓冲区被复用或者移动后就失效了
+ */
+struct StringPiece {
+    StringPiece()
+        :data(nullptr)
+        ,size(0) {
+    }
+
+    StringPiece(const char* d, size_t s)
+        :data(d)
+        ,size(s) {
+    }
+
+    StringPiece(const char* d)
+        :data(d)
+        ,size(strlen(d)) {
+    }
+
+    StringPiece(const std::string& s)
+        :data(s.c_str())
+        ,size(s.size()) {
+    }
+
+    bool empty() const { return size == 0;}
+    std::string toString() const { return std::string(data, size);}
+
+    bool operator==(const StringPiece& o) const {
+        return size == o.size && memcmp(data, o.data, size) == 0;
+    }
+    bool operator!=(const StringPiece& o) const { return !(*this == o);}
+
+    /**
+     * @brief 忽略大小写比较
+     */
+    bool iequals(const StringPiece& o) const {
+        return size == o.size && strncasecmp(data, o.data, size) == 0;
+    }
+
+    const char* data;
+    size_t size;
+};
+
+std::ostream& operator<<(std::ostream& os, const StringPiece& s);
+
+/**
+ * @brief 解析出来的一个头部字段
+ */
+struct HttpHeader {
+    StringPiece name;
+    StringPiece value;
+};
+
+/**
+ * @brief HTTP请求, 由HttpRequestParser填充
+ * @details 所有字段都指向接收缓冲区, 只在处理这个请求期间有效
+ *          同一个连接上的请求复用同一个对象
+ */
+class HttpRequest {
+public:
+    typedef std::shared_ptr<HttpRequest> ptr;
+
+    /// 最多保存的头部字段数, 超过按解析错误处理
+    static const size_t MAX_HEADERS = 64;
+
+    HttpRequest();
+
+    /**
+     * @brief 清空, 开始解析下一个请求之前调用
+     */
+    void reset();
+
+    HttpMethod getMethod() const { return m_method;}
+    /**
+     * @brief 返回版本, 0x11表示HTTP/1.1
+     */
+    uint8_t getVersion() const { return m_version;}
+    StringPiece getUri() const { return m_uri;}
+    StringPiece getPath() const { return m_path;}
+    StringPiece getQuery() const { return m_query;}
+    StringPiece getFragment() const { return m_fragment;}
+    StringPiece getBody() const { return m_body;}
+
+    /**
+     * @brief 是否要在响应后关闭连接
+     * @details HTTP/1.1默认保持, HTTP/1.0需要显式的Connection: keep-alive
+     */
+    bool isClose() const { return m_close;}
+    bool isChunked() const { return m_chunked;}
+    uint64_t getContentLength() const { return m_contentLength;}
+
+    size_t getHeaderCount() const { return m_headerCount;}
+    const HttpHeader& getHeaderAt(size_t i) const { return m_headers[i];}
+
+    /**
+     * @brief 忽略大小写查找头部字段
+     * @param[in] key 字段名
+     * @param[in] def 不存在时返回的默认值
+     */
+    StringPiece getHeader(const StringPiece& key, const StringPiece& def = StringPiece()) const;
+
+    /**
+     * @brief 是否有该头部字段
+     */
+    bool hasHeader(const StringPiece& key, StringPiece* val = nullptr) const;
+
+    /**
+     * @brief 序列化输出到流中
+     */
+    std::ostream& dump(std::ostream& os) const;
+
+    /**
+     * @brief 转成字符串
+     */
+    std::string toString() const;
+private:
+    friend class HttpRequestParser;
+    friend class HttpSession;
+
+    HttpMethod m_method;
+    uint8_t m_version;
+    bool m_close;
+    bool m_chunked;
+    uint64_t m_contentLength;
+    StringPiece m_uri;
+    StringPiece m_path;
+    StringPiece m_query;
+    StringPiece m_fragment;
+    StringPiece m_body;
+    size_t m_headerCount;
+    HttpHeader m_headers[MAX_HEADERS];
+};
+
+/**
+ * @brief HTTP响应, 由servlet填写后序列化发送
+ */
+class HttpResponse {
+public:
+    typedef std::shared_ptr<HttpResponse> ptr;
+    typedef std::vector<std::pair<std::string, std::string> > HeaderList;
+
+    /**
+     * @brief 构造函数
+     * @param[in] version 版本
+     * @param[in] close 是否关闭连接
+     */
+    HttpResponse(uint8_t version = 0x11, bool close = true);
+
+    /**
+     * @brief 复用对象处理下一个请求
+     */
+    void reset(uint8_t version, bool close);
+
+    HttpStatus getStatus() const { return m_status;}
+    uint8_t getVersion() const { return m_version;}
+    const std::string& getBody() const { return m_body;}
+    const std::string& getReason() const { return m_reason;}
+    const HeaderList& getHeaders() const { return m_headers;}
+
+    void setStatus(HttpStatus v) { m_status = v;}
+    void setVersion(uint8_t v) { m_version = v;}
+    void setBody(const std::string& v) { m_body = v;}
+    void setBody(const char* data, size_t len) { m_body.assign(data, len);}
+    void appendBody(const char* data, size_t len) { m_body.append(data, len);}
+    void setReason(const std::string& v) { m_reason = v;}
+
+    /**
+     * @brief 获取响应头部字段, 忽略大小写
+     */
+    std::string getHeader(const std::string& key, const std::string& def = "") const;
+
+    /**
+     * @brief 设置响应头部字段, 已经存在时覆盖
+     */
+    void setHeader(const std::string& key, const std::string& val);
+
+    /**
+     * @brief 追加响应头部字段, 不检查重复(客户端保存收到的Set-Cookie等)
+     */
+    void addHeader(const std::string& key, const std::string& val) { m_headers.push_back(std::make_pair(key, val));}
+
+    /**
+     * @brief 删除响应头部字段
+     */
+    void delHeader(const std::string& key);
+
+    bool isClose() const { return m_close;}
+    void setClose(bool v) { m_close = v;}
+
+    /**
+     * @brief 把状态行和头部追加到out, connection和content-length由这里生成
+     */
+    void encodeHead(std::string& out) const;
+
+    /**
+     * @brief 把完整响应追加到out
+     */
+    void encode(std::string& out) const;
+
+    /**
+     * @brief 序列化输出到流中
+     */
+    std::ostream& dump(std::ostream& os) const;
+
+    /**
+     * @brief 转成字符串
+     */
+    std::string toString() const;
+private:
+    HttpStatus m_status;
+    uint8_t m_version;
+    bool m_close;
+    std::string m_body;
+    std::string m_reason;
+    HeaderList m_headers;
+};
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req);
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp);
+
+}
+}
+
+#endif
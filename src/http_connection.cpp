@@ -0,0 +1,778 @@
+#include "http_connection.h"
+#include "config.h"
+#include "log.h"
+#include "macro.h"
+#include "util.h"
+#include <atomic>
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr http_client_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint32_t>::ptr g_http_client_max_connections =
+    sylar::Config::Lookup("http.client.max_connections"
+                ,(uint32_t)16, "http client max connections per host");
+
+static sylar::ConfigVar<uint32_t>::ptr g_http_client_max_in_flight =
+    sylar::Config::Lookup("http.client.max_in_flight"
+                ,(uint32_t)1024, "http client max in-flight requests per host");
+
+static sylar::ConfigVar<uint32_t>::ptr g_http_client_pipeline_depth =
+    sylar::Config::Lookup("http.client.pipeline_depth"
+                ,(uint32_t)8, "http client max pipelined requests per connection");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_client_idle_timeout =
+    sylar::Config::Lookup("http.client.idle_timeout"
+                ,(uint64_t)(30 * 1000), "http client idle connection timeout ms");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_client_timeout =
+    sylar::Config::Lookup("http.client.timeout"
+                ,(uint64_t)(5 * 1000), "http client connect/send/recv timeout ms");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_client_max_header_size =
+    sylar::Config::Lookup("http.client.max_header_size"
+                ,(uint64_t)(64 * 1024), "http client max response header size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_client_max_body_size =
+    sylar::Config::Lookup("http.client.max_body_size"
+                ,(uint64_t)(64 * 1024 * 1024), "http client max response body size");
+
+static std::atomic<uint64_t> s_http_client_max_header_size(0);
+static std::atomic<uint64_t> s_http_client_max_body_size(0);
+
+namespace {
+struct _HttpClientIniter {
+    _HttpClientIniter() {
+        s_http_client_max_header_size = g_http_client_max_header_size->getValue();
+        s_http_client_max_body_size = g_http_client_max_body_size->getValue();
+
+        g_http_client_max_header_size->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_http_client_max_header_size = nv;
+        });
+
+        g_http_client_max_body_size->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_http_client_max_body_size = nv;
+        });
+    }
+};
+static _HttpClientIniter s_http_client_initer;
+}
+
+static HttpResult::ptr MakeResult(HttpResult::Error err, const std::string& msg) {
+    return std::make_shared<HttpResult>((int)err, nullptr, msg);
+}
+
+std::string HttpResult::toString() const {
+    std::stringstream ss;
+    ss << "[HttpResult result=" << result
+       << " error=" << error
+       << " response=" << (response ? response->toString() : "nullptr")
+       << "]";
+    return ss.str();
+}
+
+HttpConnection::ptr HttpConnection::Create(Address::ptr addr, uint64_t timeout_ms) {
+    Socket::ptr sock = Socket::CreateTCP(addr);
+    if(!sock->connect(addr, timeout_ms)) {
+        return nullptr;
+    }
+    sock->setSendTimeout(timeout_ms);
+    sock->setRecvTimeout(timeout_ms);
+    return std::make_shared<HttpConnection>(sock);
+}
+
+void HttpConnection::EncodeRequest(std::string& out, HttpMethod method, const std::string& host
+                                   ,const std::string& path, const HttpResult::Headers& headers
+                                   ,const std::string& body) {
+    out.append(HttpMethodToString(method));
+    out.push_back(' ');
+    out.append(path.empty() ? "/" : path);
+    out.append(" HTTP/1.1\r\nHost: ");
+    out.append(host);
+    out.append("\r\n");
+    for(auto& i : headers) {
+        if(strcasecmp(i.first.c_str(), "host") == 0
+                || strcasecmp(i.first.c_str(), "content-length") == 0) {
+            continue;
+        }
+        out.append(i.first);
+        out.append(": ");
+        out.append(i.second);
+        out.append("\r\n");
+    }
+    if(!body.empty() || method == HttpMethod::POST || method == HttpMethod::PUT) {
+        out.append("Content-Length: ");
+        out.append(std::to_string(body.size()));
+        out.append("\r\n");
+    }
+    out.append("\r\n");
+    out.append(body);
+}
+
+HttpConnection::HttpConnection(Socket::ptr sock, bool owner)
+    :SocketStream(sock, owner)
+    ,m_createTime(GetCurrentMS())
+    ,m_begin(0)
+    ,m_end(0)
+    ,m_consumed(0) {
+    // 响应直接读进m_buf，不需要SocketStream再预读一份
+    setReadBufferSize(0);
+    m_buf.resize(4 * 1024);
+}
+
+int HttpConnection::fillBuffer(size_t limit) {
+    if(m_end == m_buf.size()) {
+        if(m_begin > 0) {
+            memmove(&m_buf[0], &m_buf[m_begin], m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
+        } else if(m_buf.size() < limit) {
+            m_buf.resize(std::min(m_buf.size() * 2, limit));
+        } else {
+            return -1;
+        }
+    }
+    int rt = read(&m_buf[m_end], m_buf.size() - m_end);
+    if(rt > 0) {
+        m_end += rt;
+    }
+    return rt;
+}
+
+int HttpConnection::sendRequest(const std::string& data) {
+    int rt = writeFixSize(data.data(), data.size());
+    if(rt <= 0) {
+        return rt;
+    }
+    return flush() < 0 ? -1 : rt;
+}
+
+// 读失败时按返回值和errno区分错误
+static HttpResult::ptr RecvFail(int rt, size_t buffered, size_t limit) {
+    if(rt == 0) {
+        return MakeResult(HttpResult::Error::RECV_CLOSE_BY_PEER, "recv close by peer");
+    }
+    if(buffered >= limit) {
+        return MakeResult(HttpResult::Error::PARSE_ERROR, "response too large");
+    }
+    if(errno == ETIMEDOUT) {
+        return MakeResult(HttpResult::Error::TIMEOUT, "recv timeout");
+    }
+    return MakeResult(HttpResult::Error::RECV_SOCKET_ERROR
+            , "recv socket error errno=" + std::to_string(errno) + " errstr=" + strerror(errno));
+}
+
+HttpResult::ptr HttpConnection::recvResponse(bool head) {
+    m_begin += m_consumed;
+    m_consumed = 0;
+    if(m_begin == m_end) {
+        m_begin = m_end = 0;
+    }
+    m_parser.reset();
+
+    size_t head_limit = s_http_client_max_header_size;
+    size_t head_len = 0;
+    while(!(head_len = m_parser.execute(&m_buf[m_begin], m_end - m_begin))) {
+        if(m_parser.hasError()) {
+            return MakeResult(HttpResult::Error::PARSE_ERROR
+                    , "parse error=" + std::to_string(m_parser.hasError()));
+        }
+        int rt = fillBuffer(head_limit);
+        if(rt <= 0) {
+            return RecvFail(rt, m_end - m_begin, head_limit);
+        }
+    }
+
+    // 头部在读body之前拷贝出来，读body时缓冲区可能被移动
+    HttpResponse::ptr rsp = std::make_shared<HttpResponse>(m_parser.getVersion(), m_parser.isClose());
+    rsp->setStatus(m_parser.getStatus());
+    rsp->setReason(m_parser.getReason().toString());
+    for(size_t i = 0; i < m_parser.getHeaderCount(); ++i) {
+        const HttpHeader& h = m_parser.getHeaderAt(i);
+        // 这几个由isClose和body长度表示，encode时重新生成
+        if(h.name.iequals("connection") || h.name.iequals("content-length")
+                || h.name.iequals("transfer-encoding")) {
+            continue;
+        }
+        rsp->addHeader(h.name.toString(), h.value.toString());
+    }
+
+    int status = (int)m_parser.getStatus();
+    size_t body_limit = head_limit + s_http_client_max_body_size;
+    size_t body_len = 0;
+    if(head || status / 100 == 1 || status == 204 || status == 304) {
+        body_len = 0;
+    } else if(m_parser.isChunked()) {
+        m_decoder.reset();
+        while(true) {
+            size_t raw = m_begin + head_len + body_len;
+            size_t size = m_end - raw;
+            ssize_t rt = m_decoder.decode(&m_buf[raw], &size);
+            body_len += size;
+            if(rt == -1) {
+                return MakeResult(HttpResult::Error::PARSE_ERROR, "invalid chunked body");
+            }
+            if(rt >= 0) {
+                m_end = m_begin + head_len + body_len + rt;
+                break;
+            }
+            m_end = m_begin + head_len + body_len;
+            int n = fillBuffer(body_limit);
+            if(n <= 0) {
+                return RecvFail(n, m_end - m_begin, body_limit);
+            }
+        }
+    } else if(m_parser.hasContentLength()) {
+        body_len = m_parser.getContentLength();
+        if(body_len > s_http_client_max_body_size) {
+            return MakeResult(HttpResult::Error::PARSE_ERROR, "response body too large");
+        }
+        while(m_end - m_begin < head_len + body_len) {
+            int n = fillBuffer(body_limit);
+            if(n <= 0) {
+                return RecvFail(n, m_end - m_begin, body_limit);
+            }
+        }
+    } else {
+        // 没有长度，body读到连接关闭为止
+        while(true) {
+            int n = fillBuffer(body_limit);
+            if(n == 0) {
+                break;
+            }
+            if(n < 0) {
+                return RecvFail(n, m_end - m_begin, body_limit);
+            }
+        }
+        body_len = m_end - m_begin - head_len;
+        rsp->setClose(true);
+    }
+
+    rsp->setBody(&m_buf[m_begin + head_len], body_len);
+    m_consumed = head_len + body_len;
+    return std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
+}
+
+/**
+ * @brief 一个在途请求
+ */
+struct HttpConnectionPool::Pending {
+    typedef std::shared_ptr<Pending> ptr;
+
+    Pending(bool h)
+        :head(h)
+        ,scheduler(nullptr) {
+    }
+
+    /// 是否是HEAD请求
+    bool head;
+    /// 挂起等轮到自己读响应的协程
+    Scheduler* scheduler;
+    Fiber::ptr fiber;
+    /// 连接在轮到自己之前出错时由failConn填写
+    HttpResult::ptr error;
+};
+
+/**
+ * @brief 连接池里的一个连接
+ */
+struct HttpConnectionPool::ConnCtx {
+    typedef std::shared_ptr<ConnCtx> ptr;
+
+    ConnCtx(HttpConnection::ptr c)
+        :conn(c)
+        ,writing(false)
+        ,broken(false)
+        ,served(0)
+        ,lastActive(GetCurrentMS()) {
+    }
+
+    HttpConnection::ptr conn;
+    /// 已经排进发送缓冲还没拿到响应的请求, 按发送顺序
+    std::deque<Pending::ptr> queue;
+    /// 还没写出去的请求数据
+    std::string out;
+    /// 是否有协程在写
+    bool writing;
+    /// 出错或者对端要求关闭, 不再分配请求
+    bool broken;
+    /// 完成的keep-alive响应数, 确认过对端支持长连接才往上流水线发送
+    uint64_t served;
+    uint64_t lastActive;
+};
+
+HttpConnectionPool::HttpConnectionPool(const std::string& host, uint16_t port)
+    :m_host(host)
+    ,m_port(port)
+    ,m_iom(nullptr)
+    ,m_maxConns(g_http_client_max_connections->getValue())
+    ,m_maxInFlight(g_http_client_max_in_flight->getValue())
+    ,m_pipelineDepth(g_http_client_pipeline_depth->getValue())
+    ,m_idleTimeout(g_http_client_idle_timeout->getValue())
+    ,m_timeout(g_http_client_timeout->getValue())
+    ,m_connecting(0)
+    ,m_inFlight(0)
+    ,m_closed(false)
+    ,m_created(0)
+    ,m_evicted(0) {
+    m_vhost = port == 80 ? host : host + ":" + std::to_string(port);
+    if(!m_maxConns) m_maxConns = 1;
+    if(!m_maxInFlight) m_maxInFlight = 1;
+    if(!m_pipelineDepth) m_pipelineDepth = 1;
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+    if(m_sweepTimer) {
+        m_sweepTimer->cancel();
+    }
+}
+
+HttpResult::ptr HttpConnectionPool::doGet(const std::string& path
+                                          ,const HttpResult::Headers& headers) {
+    return doRequest(HttpMethod::GET, path, headers);
+}
+
+HttpResult::ptr HttpConnectionPool::doPost(const std::string& path, const std::string& body
+                                           ,const HttpResult::Headers& headers) {
+    return doRequest(HttpMethod::POST, path, headers, body);
+}
+
+size_t HttpConnectionPool::getConnectionCount() {
+    MutexType::Lock lock(m_mutex);
+    return m_conns.size();
+}
+
+size_t HttpConnectionPool::getIdleCount() {
+    MutexType::Lock lock(m_mutex);
+    size_t n = 0;
+    for(auto& i : m_conns) {
+        if(i->queue.empty() && !i->writing) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+uint32_t HttpConnectionPool::getInFlight() {
+    MutexType::Lock lock(m_mutex);
+    return m_inFlight;
+}
+
+bool HttpConnectionPool::acquireSlot() {
+    MutexType::Lock lock(m_mutex);
+    while(!m_closed && m_inFlight >= m_maxInFlight) {
+        m_slotWaiters.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
+        lock.unlock();
+        Fiber::YieldToHold();
+        lock.lock();
+    }
+    if(m_closed) {
+        return false;
+    }
+    ++m_inFlight;
+    return true;
+}
+
+void HttpConnectionPool::releaseSlot() {
+    MutexType::Lock lock(m_mutex);
+    --m_inFlight;
+    if(!m_slotWaiters.empty()) {
+        Waiter w = m_slotWaiters.front();
+        m_slotWaiters.pop_front();
+        w.first->schedule(w.second);
+    }
+}
+
+HttpConnectionPool::ConnCtx::ptr HttpConnectionPool::enqueue(Pending::ptr pending, const std::string& data
+                                                             ,HttpResult::ptr& error) {
+    MutexType::Lock lock(m_mutex);
+    while(true) {
+        if(m_closed) {
+            error = MakeResult(HttpResult::Error::POOL_CLOSED, "pool closed");
+            return nullptr;
+        }
+        // 优先空闲连接，其次在途最少的可流水线连接
+        ConnCtx::ptr best;
+        for(auto& i : m_conns) {
+            if(i->broken || i->queue.size() >= m_pipelineDepth
+                    || (!i->queue.empty() && !i->served)) {
+                continue;
+            }
+            if(!best || i->queue.size() < best->queue.size()) {
+                best = i;
+                if(best->queue.empty()) {
+                    break;
+                }
+            }
+        }
+
+        if((!best || !best->queue.empty()) && m_conns.size() + m_connecting < m_maxConns) {
+            ++m_connecting;
+            Address::ptr addr = m_addr;
+            lock.unlock();
+            HttpConnection::ptr conn;
+            if(!addr) {
+                IPAddress::ptr ip = Address::LookupAnyIPAddress(m_host);
+                if(ip) {
+                    ip->setPort(m_port);
+                    addr = ip;
+                }
+            }
+            if(addr) {
+                conn = HttpConnection::Create(addr, m_timeout);
+            }
+            lock.lock();
+            --m_connecting;
+            if(addr && !m_addr) {
+                m_addr = addr;
+            }
+            if(!conn) {
+                if(!m_connWaiters.empty()) {
+                    Waiter w = m_connWaiters.front();
+                    m_connWaiters.pop_front();
+                    w.first->schedule(w.second);
+                }
+                error = addr ? MakeResult(HttpResult::Error::CONNECT_FAIL, "connect fail: " + m_vhost)
+                               : MakeResult(HttpResult::Error::INVALID_HOST, "invalid host: " + m_host);
+                return nullptr;
+            }
+            best.reset(new ConnCtx(conn));
+            m_conns.push_back(best);
+            ++m_created;
+        }
+
+        if(best) {
+            best->queue.push_back(pending);
+            best->out.append(data);
+            return best;
+        }
+
+        // 连接数到上限并且都排满了，等有请求完成
+        m_connWaiters.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
+        lock.unlock();
+        Fiber::YieldToHold();
+        lock.lock();
+    }
+}
+
+void HttpConnectionPool::flushConn(ConnCtx::ptr ctx) {
+    std::string data;
+    while(true) {
+        {
+            MutexType::Lock lock(m_mutex);
+            data.clear();
+            if(ctx->broken || ctx->out.empty()) {
+                ctx->writing = false;
+                return;
+            }
+            data.swap(ctx->out);
+        }
+        int rt = ctx->conn->sendRequest(data);
+        if(rt <= 0) {
+            HttpResult::ptr error;
+            if(rt == 0) {
+                error = MakeResult(HttpResult::Error::SEND_CLOSE_BY_PEER, "send close by peer");
+            } else if(errno == ETIMEDOUT) {
+                error = MakeResult(HttpResult::Error::TIMEOUT, "send timeout");
+            } else {
+                error = MakeResult(HttpResult::Error::SEND_SOCKET_ERROR
+                        , "send socket error errno=" + std::to_string(errno) + " errstr=" + strerror(errno));
+            }
+            MutexType::Lock lock(m_mutex);
+            failConn(ctx, error);
+            ctx->writing = false;
+            return;
+        }
+    }
+}
+
+void HttpConnectionPool::failConn(ConnCtx::ptr ctx, HttpResult::ptr error) {
+    if(!ctx->broken) {
+        ctx->broken = true;
+        for(auto it = m_conns.begin(); it != m_conns.end(); ++it) {
+            if(*it == ctx) {
+                m_conns.erase(it);
+                break;
+            }
+        }
+        // 连接少了一个，等连接的协程可以新建了
+        for(auto& w : m_connWaiters) {
+            w.first->schedule(w.second);
+        }
+        m_connWaiters.clear();
+    }
+    for(auto& p : ctx->queue) {
+        p->error = error;
+        if(p->fiber) {
+            p->scheduler->schedule(p->fiber);
+            p->fiber.reset();
+        }
+    }
+    ctx->queue.clear();
+    ctx->out.clear();
+}
+
+HttpResult::ptr HttpConnectionPool::doRequest(HttpMethod method, const std::string& path
+                                              ,const HttpResult::Headers& headers
+                                              ,const std::string& body) {
+    SYLAR_ASSERT2(Scheduler::GetThis() && Fiber::GetThis(), "HttpConnectionPool must be used in fiber");
+    if(!m_iom) {
+        m_iom = IOManager::GetThis();
+    }
+
+    std::string data;
+    HttpConnection::EncodeRequest(data, method, m_vhost, path, headers, body);
+
+    if(!acquireSlot()) {
+        return MakeResult(HttpResult::Error::POOL_CLOSED, "pool closed");
+    }
+
+    HttpResult::ptr result;
+    Pending::ptr pending(new Pending(method == HttpMethod::HEAD));
+    ConnCtx::ptr ctx = enqueue(pending, data, result);
+    if(!ctx) {
+        releaseSlot();
+        return result;
+    }
+
+    bool writer = false;
+    {
+        MutexType::Lock lock(m_mutex);
+        if(!ctx->writing && !ctx->broken) {
+            ctx->writing = writer = true;
+        }
+    }
+    if(writer) {
+        flushConn(ctx);
+    }
+
+    // 等排到队头，前一个请求读完响应会唤醒这里
+    {
+        MutexType::Lock lock(m_mutex);
+        while(!pending->error && ctx->queue.front() != pending) {
+            pending->scheduler = Scheduler::GetThis();
+            pending->fiber = Fiber::GetThis();
+            lock.unlock();
+            Fiber::YieldToHold();
+            lock.lock();
+        }
+        result = pending->error;
+    }
+
+    if(!result) {
+        result = ctx->conn->recvResponse(pending->head);
+    }
+
+    {
+        MutexType::Lock lock(m_mutex);
+        ctx->lastActive = GetCurrentMS();
+        if(!pending->error) {
+            ctx->queue.pop_front();
+            if(result->result || result->response->isClose()) {
+                // 排在后面的请求不会再有响应
+                failConn(ctx, MakeResult(HttpResult::Error::RECV_CLOSE_BY_PEER
+                            , result->result ? "connection broken: " + result->error
+                                             : "connection closed by peer"));
+            } else {
+                ++ctx->served;
+                if(!ctx->queue.empty()) {
+                    Pending::ptr& next = ctx->queue.front();
+                    if(next->fiber) {
+                        next->scheduler->schedule(next->fiber);
+                        next->fiber.reset();
+                    }
+                } else if(m_closed) {
+                    failConn(ctx, nullptr);
+                } else if(!ctx->writing) {
+                    scheduleSweep();
+                }
+            }
+        } else {
+            result = pending->error;
+        }
+        if(!m_connWaiters.empty()) {
+            Waiter w = m_connWaiters.front();
+            m_connWaiters.pop_front();
+            w.first->schedule(w.second);
+        }
+    }
+    releaseSlot();
+    return result;
+}
+
+void HttpConnectionPool::scheduleSweep() {
+    if(m_sweepTimer || m_closed || !m_idleTimeout || !m_iom) {
+        return;
+    }
+    std::weak_ptr<HttpConnectionPool> weak(shared_from_this());
+    m_sweepTimer = m_iom->addConditionTimer(m_idleTimeout, [weak](){
+        HttpConnectionPool::ptr self = weak.lock();
+        if(self) {
+            self->sweep();
+        }
+    }, weak);
+}
+
+void HttpConnectionPool::sweep() {
+    std::vector<ConnCtx::ptr> expired;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_sweepTimer.reset();
+        uint64_t now = GetCurrentMS();
+        uint64_t next = ~0ull;
+        for(auto it = m_conns.begin(); it != m_conns.end();) {
+            ConnCtx::ptr ctx = *it;
+            if(!ctx->queue.empty() || ctx->writing) {
+                ++it;
+                continue;
+            }
+            if(ctx->lastActive + m_idleTimeout <= now) {
+                ctx->broken = true;
+                expired.push_back(ctx);
+                it = m_conns.erase(it);
+                ++m_evicted;
+            } else {
+                next = std::min(next, ctx->lastActive + m_idleTimeout - now);
+                ++it;
+            }
+        }
+        // 还有空闲连接，在最早到期的时候再来
+        if(next != ~0ull && !m_closed) {
+            std::weak_ptr<HttpConnectionPool> weak(shared_from_this());
+            m_sweepTimer = m_iom->addConditionTimer(next, [weak](){
+                HttpConnectionPool::ptr self = weak.lock();
+                if(self) {
+                    self->sweep();
+                }
+            }, weak);
+        }
+    }
+    for(auto& i : expired) {
+        SYLAR_LOG_DEBUG(http_client_logger) << "http connection idle timeout " << m_vhost;
+        i->conn->close();
+    }
+}
+
+void HttpConnectionPool::close() {
+    std::vector<ConnCtx::ptr> idle;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_closed = true;
+        if(m_sweepTimer) {
+            m_sweepTimer->cancel();
+            m_sweepTimer.reset();
+        }
+        for(auto it = m_conns.begin(); it != m_conns.end();) {
+            if((*it)->queue.empty() && !(*it)->writing) {
+                (*it)->broken = true;
+                idle.push_back(*it);
+                it = m_conns.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for(auto& w : m_slotWaiters) {
+            w.first->schedule(w.second);
+        }
+        m_slotWaiters.clear();
+        for(auto& w : m_connWaiters) {
+            w.first->schedule(w.second);
+        }
+        m_connWaiters.clear();
+    }
+    for(auto& i : idle) {
+        i->conn->close();
+    }
+}
+
+// 只支持http://host[:port][/path]
+static bool ParseUrl(const std::string& url, std::string& host, uint16_t& port, std::string& path) {
+    static const char prefix[] = "http://";
+    if(strncasecmp(url.c_str(), prefix, sizeof(prefix) - 1) != 0) {
+        return false;
+    }
+    size_t begin = sizeof(prefix) - 1;
+    size_t end = url.find_first_of("/?#", begin);
+    if(end == std::string::npos) {
+        end = url.size();
+    }
+    std::string authority = url.substr(begin, end - begin);
+    size_t colon = authority.rfind(':');
+    port = 80;
+    if(colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        int p = atoi(authority.c_str() + colon + 1);
+        if(p <= 0 || p > 65535) {
+            return false;
+        }
+        port = p;
+        authority.resize(colon);
+    }
+    if(authority.empty()) {
+        return false;
+    }
+    host = authority;
+    path = end < url.size() && url[end] != '#' ? url.substr(end) : "/";
+    if(path[0] == '?') {
+        path = "/" + path;
+    }
+    size_t hash = path.find('#');
+    if(hash != std::string::npos) {
+        path.resize(hash);
+    }
+    return true;
+}
+
+HttpConnectionPool::ptr HttpClient::getPool(const std::string& host, uint16_t port) {
+    std::string key = host + ":" + std::to_string(port);
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_pools.find(key);
+        if(it != m_pools.end()) {
+            return it->second;
+        }
+    }
+    RWMutexType::WriteLock lock(m_mutex);
+    HttpConnectionPool::ptr& pool = m_pools[key];
+    if(!pool) {
+        pool.reset(new HttpConnectionPool(host, port));
+    }
+    return pool;
+}
+
+HttpResult::ptr HttpClient::doGet(const std::string& url, const HttpResult::Headers& headers) {
+    return doRequest(HttpMethod::GET, url, headers);
+}
+
+HttpResult::ptr HttpClient::doPost(const std::string& url, const std::string& body
+                                   ,const HttpResult::Headers& headers) {
+    return doRequest(HttpMethod::POST, url, headers, body);
+}
+
+HttpResult::ptr HttpClient::doRequest(HttpMethod method, const std::string& url
+                                      ,const HttpResult::Headers& headers
+                                      ,const std::string& body) {
+    std::string host;
+    std::string path;
+    uint16_t port = 0;
+    if(!ParseUrl(url, host, port, path)) {
+        return MakeResult(HttpResult::Error::INVALID_URL, "invalid url: " + url);
+    }
+    return getPool(host, port)->doRequest(method, path, headers, body);
+}
+
+void HttpClient::close() {
+    std::unordered_map<std::string, HttpConnectionPool::ptr> pools;
+    {
+        RWMutexType::WriteLock lock(m_mutex);
+        pools.swap(m_pools);
+    }
+    for(auto& i : pools) {
+        i.second->close();
+    }
+}
+
+}
+}
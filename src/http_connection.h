@@ -0,0 +1,332 @@
+/**
+ * @file http_connection.h
+ * @brief 客户端的HTTP连接和连接池
+ */
+#ifndef __SYLAR_HTTP_CONNECTION_H__
+#define __SYLAR_HTTP_CONNECTION_H__
+
+#include <map>
+#include <deque>
+#include <unordered_map>
+#include "socket_stream.h"
+#include "http.h"
+#include "http_parser.h"
+#include "IOManager.h"
+#include "singleton.h"
+#include "thread.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief HTTP请求的结果
+ */
+struct HttpResult {
+    typedef std::shared_ptr<HttpResult> ptr;
+    typedef std::map<std::string, std::string> Headers;
+
+    /**
+     * @brief 错误码
+     */
+    enum class Error {
+        /// 正常
+        OK = 0,
+        /// 非法URL
+        INVALID_URL = 1,
+        /// 无法解析HOST
+        INVALID_HOST = 2,
+        /// 连接失败
+        CONNECT_FAIL = 3,
+        /// 发送时连接被对端关闭
+        SEND_CLOSE_BY_PEER = 4,
+        /// 发送时socket出错
+        SEND_SOCKET_ERROR = 5,
+        /// 超时
+        TIMEOUT = 6,
+        /// 接收时连接被对端关闭
+        RECV_CLOSE_BY_PEER = 7,
+        /// 接收时socket出错
+        RECV_SOCKET_ERROR = 8,
+        /// 响应格式错误
+        PARSE_ERROR = 9,
+        /// 连接池已经关闭
+        POOL_CLOSED = 10,
+    };
+
+    HttpResult(int _result, HttpResponse::ptr _response, const std::string& _error)
+        :result(_result)
+        ,response(_response)
+        ,error(_error) {
+    }
+
+    /// 错误码
+    int result;
+    /// 响应, 出错时为nullptr
+    HttpResponse::ptr response;
+    /// 错误描述
+    std::string error;
+
+    std::string toString() const;
+};
+
+/**
+ * @brief 客户端的HTTP连接
+ * @details 响应读进连接自己的缓冲区, 解析完拷贝成HttpResponse返回, 缓冲区里多出来的数据留给下一个响应
+ *          支持content-length, chunked和读到连接关闭三种body
+ */
+class HttpConnection : public SocketStream {
+public:
+    typedef std::shared_ptr<HttpConnection> ptr;
+
+    /**
+     * @brief 连接到addr
+     * @param[in] addr 服务端地址
+     * @param[in] timeout_ms 连接超时, 同时作为之后收发的超时
+     * @return 失败返回nullptr
+     */
+    static HttpConnection::ptr Create(Address::ptr addr, uint64_t timeout_ms);
+
+    /**
+     * @brief 把请求序列化追加到out
+     * @param[in] host Host头部的值
+     * @param[in] path 路径, 可以带query
+     */
+    static void EncodeRequest(std::string& out, HttpMethod method, const std::string& host
+                              ,const std::string& path, const HttpResult::Headers& headers
+                              ,const std::string& body);
+
+    /**
+     * @brief 构造函数
+     * @param[in] sock Socket类型
+     * @param[in] owner 是否托管
+     */
+    HttpConnection(Socket::ptr sock, bool owner = true);
+
+    /**
+     * @brief 发送序列化好的请求, 可以是多个请求拼在一起
+     * @return >0 成功, 其它为失败
+     */
+    int sendRequest(const std::string& data);
+
+    /**
+     * @brief 接收下一个响应
+     * @param[in] head 对应的请求是否是HEAD, HEAD的响应没有body
+     */
+    HttpResult::ptr recvResponse(bool head = false);
+
+    /**
+     * @brief 创建时间(毫秒)
+     */
+    uint64_t getCreateTime() const { return m_createTime;}
+private:
+    /**
+     * @brief 往缓冲区读更多数据, 满了先把已处理的部分挪走, 还不够再扩容
+     */
+    int fillBuffer(size_t limit);
+private:
+    uint64_t m_createTime;
+    /// 接收缓冲区
+    std::string m_buf;
+    /// 当前响应的开始位置
+    size_t m_begin;
+    /// 有效数据的结束位置
+    size_t m_end;
+    /// 上一个响应占用的长度
+    size_t m_consumed;
+    HttpResponseParser m_parser;
+    HttpChunkedDecoder m_decoder;
+};
+
+/**
+ * @brief 同一个host:port的长连接池
+ * @details 请求优先用空闲连接, 没有空闲的且连接数没到上限时新建连接;
+ *          连接数到上限后, 在已经成功复用过的连接上流水线发送(pipelining), 每个连接最多pipeline_depth个在途请求
+ *          同一个连接上的请求按发送顺序排队, 轮到队头的协程读自己的响应, 读完唤醒下一个
+ *          在途请求数超过max_in_flight时挂起当前协程直到有请求完成
+ *          空闲连接由IOManager的定时器在idle_timeout之后关闭, 没有空闲连接时不保留定时器
+ *          连接出错或者对端要求关闭时, 排在它上面还没拿到响应的请求都返回错误, 不会自动重试
+ * @pre 请求必须在调度器的协程里发起
+ */
+class HttpConnectionPool : public std::enable_shared_from_this<HttpConnectionPool>, Noncopyable {
+public:
+    typedef std::shared_ptr<HttpConnectionPool> ptr;
+    typedef Mutex MutexType;
+
+    /**
+     * @brief 构造函数, 上限和超时取http.client.*配置
+     * @param[in] host 域名或者IP
+     * @param[in] port 端口
+     */
+    HttpConnectionPool(const std::string& host, uint16_t port);
+
+    ~HttpConnectionPool();
+
+    HttpResult::ptr doGet(const std::string& path
+                          ,const HttpResult::Headers& headers = HttpResult::Headers());
+
+    HttpResult::ptr doPost(const std::string& path, const std::string& body
+                           ,const HttpResult::Headers& headers = HttpResult::Headers());
+
+    /**
+     * @brief 发送请求并等待响应
+     * @param[in] method 方法
+     * @param[in] path 路径, 可以带query
+     * @param[in] headers 额外的头部, Host/Content-Length由这里生成
+     * @param[in] body 请求体
+     */
+    HttpResult::ptr doRequest(HttpMethod method, const std::string& path
+                              ,const HttpResult::Headers& headers = HttpResult::Headers()
+                              ,const std::string& body = "");
+
+    /**
+     * @brief 关闭空闲连接并取消定时器, 之后的请求返回POOL_CLOSED
+     */
+    void close();
+
+    /// 下面的设置在发起请求之前调用
+    void setMaxConnections(uint32_t v) { m_maxConns = v ? v : 1;}
+    void setMaxInFlight(uint32_t v) { m_maxInFlight = v ? v : 1;}
+    void setPipelineDepth(uint32_t v) { m_pipelineDepth = v ? v : 1;}
+    void setIdleTimeout(uint64_t v) { m_idleTimeout = v;}
+    void setTimeout(uint64_t v) { m_timeout = v;}
+
+    const std::string& getHost() const { return m_host;}
+    uint16_t getPort() const { return m_port;}
+
+    /**
+     * @brief 当前连接数
+     */
+    size_t getConnectionCount();
+
+    /**
+     * @brief 当前空闲连接数
+     */
+    size_t getIdleCount();
+
+    /**
+     * @brief 当前在途请求数
+     */
+    uint32_t getInFlight();
+
+    /**
+     * @brief 累计新建的连接数
+     */
+    uint64_t getCreatedCount() const { return m_created;}
+
+    /**
+     * @brief 累计因为空闲超时关闭的连接数
+     */
+    uint64_t getEvictedCount() const { return m_evicted;}
+private:
+    struct Pending;
+    struct ConnCtx;
+    typedef std::pair<Scheduler*, Fiber::ptr> Waiter;
+
+    /**
+     * @brief 占一个在途名额, 满了挂起
+     */
+    bool acquireSlot();
+
+    /**
+     * @brief 释放在途名额, 唤醒一个等待者
+     */
+    void releaseSlot();
+
+    /**
+     * @brief 选一个连接并把请求排进它的发送队列, 需要时新建连接
+     */
+    std::shared_ptr<ConnCtx> enqueue(std::shared_ptr<Pending> pending, const std::string& data
+                                     ,HttpResult::ptr& error);
+
+    /**
+     * @brief 把连接的发送缓冲写完, 同一时间只有一个协程在写
+     */
+    void flushConn(std::shared_ptr<ConnCtx> ctx);
+
+    /**
+     * @brief 标记连接不可用, 队列里的请求都以error返回
+     * @pre 持有m_mutex
+     */
+    void failConn(std::shared_ptr<ConnCtx> ctx, HttpResult::ptr error);
+
+    /**
+     * @brief 有空闲连接且没有定时器时启动定时器
+     * @pre 持有m_mutex
+     */
+    void scheduleSweep();
+
+    /**
+     * @brief 定时器回调, 关闭空闲超时的连接
+     */
+    void sweep();
+private:
+    std::string m_host;
+    uint16_t m_port;
+    /// Host头部的值
+    std::string m_vhost;
+    Address::ptr m_addr;
+    /// 空闲定时器所在的IOManager, 第一次请求时确定
+    IOManager* m_iom;
+
+    uint32_t m_maxConns;
+    uint32_t m_maxInFlight;
+    uint32_t m_pipelineDepth;
+    uint64_t m_idleTimeout;
+    uint64_t m_timeout;
+
+    MutexType m_mutex;
+    std::vector<std::shared_ptr<ConnCtx> > m_conns;
+    /// 正在建立的连接数, 算在m_maxConns里
+    uint32_t m_connecting;
+    uint32_t m_inFlight;
+    /// 等在途名额的协程
+    std::deque<Waiter> m_slotWaiters;
+    /// 连接都满了时等连接的协程
+    std::deque<Waiter> m_connWaiters;
+    Timer::ptr m_sweepTimer;
+    bool m_closed;
+    uint64_t m_created;
+    uint64_t m_evicted;
+};
+
+/**
+ * @brief HTTP客户端, 按host:port管理连接池
+ */
+class HttpClient {
+public:
+    typedef ShardedRWMutex RWMutexType;
+
+    /**
+     * @brief 获取host:port的连接池, 不存在时创建
+     */
+    HttpConnectionPool::ptr getPool(const std::string& host, uint16_t port);
+
+    HttpResult::ptr doGet(const std::string& url
+                          ,const HttpResult::Headers& headers = HttpResult::Headers());
+
+    HttpResult::ptr doPost(const std::string& url, const std::string& body
+                           ,const HttpResult::Headers& headers = HttpResult::Headers());
+
+    /**
+     * @brief 发送请求
+     * @param[in] url http://host[:port][/path][?query], 不支持https
+     */
+    HttpResult::ptr doRequest(HttpMethod method, const std::string& url
+                              ,const HttpResult::Headers& headers = HttpResult::Headers()
+                              ,const std::string& body = "");
+
+    /**
+     * @brief 关闭所有连接池
+     */
+    void close();
+private:
+    RWMutexType m_mutex;
+    std::unordered_map<std::string, HttpConnectionPool::ptr> m_pools;
+};
+
+typedef sylar::Singleton<HttpClient> HttpClientMgr;
+
+}
+}
+
+#endif
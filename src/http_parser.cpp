@@ -0,0 +1,546 @@
+#include "http_parser.h"
+#include "config.h"
+#include "log.h"
+#include <atomic>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr http_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_request_buffer_size =
+    sylar::Config::Lookup("http.request.buffer_size"
+                ,(uint64_t)(4 * 1024), "http request buffer size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_request_max_body_size =
+    sylar::Config::Lookup("http.request.max_body_size"
+                ,(uint64_t)(64 * 1024 * 1024), "http request max body size");
+
+static std::atomic<uint64_t> s_http_request_buffer_size(0);
+static std::atomic<uint64_t> s_http_request_max_body_size(0);
+
+uint64_t HttpRequestParser::GetHttpRequestBufferSize() {
+    return s_http_request_buffer_size;
+}
+
+uint64_t HttpRequestParser::GetHttpRequestMaxBodySize() {
+    return s_http_request_max_body_size;
+}
+
+namespace {
+struct _RequestSizeIniter {
+    _RequestSizeIniter() {
+        s_http_request_buffer_size = g_http_request_buffer_size->getValue();
+        s_http_request_max_body_size = g_http_request_max_body_size->getValue();
+
+        g_http_request_buffer_size->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_http_request_buffer_size = nv;
+        });
+
+        g_http_request_max_body_size->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_http_request_max_body_size = nv;
+        });
+    }
+};
+static _RequestSizeIniter _init;
+}
+
+// 找头部结束的\r\n\r\n，返回它之后的位置，没找到返回nullptr
+// 先用SSE2一次比较16个字节找'\n'，只在命中的位置回头看前三个字节
+static const char* FindHeaderEnd(const char* begin, const char* p, const char* end) {
+#define CHECK_END(q) \
+    if((q) - begin >= 3 && (q)[-1] == '\r' && (q)[-2] == '\n' && (q)[-3] == '\r') { \
+        return (q) + 1; \
+    }
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+    while(end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        while(mask) {
+            const char* q = p + __builtin_ctz(mask);
+            CHECK_END(q);
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    for(; p < end; ++p) {
+        if(*p == '\n') {
+            CHECK_END(p);
+        }
+    }
+#undef CHECK_END
+    return nullptr;
+}
+
+static StringPiece Trim(const char* b, const char* e) {
+    while(b < e && (*b == ' ' || *b == '\t')) {
+        ++b;
+    }
+    while(e > b && (e[-1] == ' ' || e[-1] == '\t')) {
+        --e;
+    }
+    return StringPiece(b, e - b);
+}
+
+// 逗号分隔的列表里是否有token，比如connection: keep-alive, Upgrade
+static bool HasToken(const StringPiece& value, const StringPiece& token) {
+    const char* p = value.data;
+    const char* end = value.data + value.size;
+    while(p < end) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        const char* e = comma ? comma : end;
+        if(Trim(p, e).iequals(token)) {
+            return true;
+        }
+        p = e + 1;
+    }
+    return false;
+}
+
+static int ParseVersion(const char* p, const char* end, uint8_t& version) {
+    if(end - p != 8 || memcmp(p, "HTTP/1.", 7) != 0) {
+        return HTTP_PARSE_INVALID_VERSION;
+    }
+    if(p[7] == '1') {
+        version = 0x11;
+    } else if(p[7] == '0') {
+        version = 0x10;
+    } else {
+        return HTTP_PARSE_INVALID_VERSION;
+    }
+    return HTTP_PARSE_OK;
+}
+
+/**
+ * @brief 头部字段里影响消息边界和连接的几个
+ */
+struct HeaderInfo {
+    HeaderInfo()
+        :close(-1)
+        ,chunked(false)
+        ,hasTransferEncoding(false)
+        ,chunkedCount(0)
+        ,hasContentLength(false)
+        ,contentLength(0) {
+    }
+
+    /// -1没有connection头, 0 keep-alive, 1 close
+    int close;
+    /// 所有transfer-encoding头合起来, 最后一个编码是chunked
+    bool chunked;
+    bool hasTransferEncoding;
+    /// chunked出现的次数, 只能编码一次
+    uint32_t chunkedCount;
+    bool hasContentLength;
+    uint64_t contentLength;
+};
+
+// 多个transfer-encoding头按顺序合并成一个编码列表，只关心最后一个编码是不是chunked
+static void ParseTransferEncoding(const StringPiece& value, HeaderInfo& info) {
+    const char* p = value.data;
+    const char* end = value.data + value.size;
+    while(p < end) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        const char* e = comma ? comma : end;
+        StringPiece coding = Trim(p, e);
+        if(!coding.empty()) {
+            info.hasTransferEncoding = true;
+            info.chunked = coding.iequals("chunked");
+            if(info.chunked) {
+                ++info.chunkedCount;
+            }
+        }
+        p = e + 1;
+    }
+}
+
+// 解析[p, end)里的头部行，end是\r\n\r\n的最后一个\r\n之前
+static int ParseHeaders(const char* p, const char* end, HttpHeader* headers
+                        ,size_t max, size_t& count, HeaderInfo& info) {
+    count = 0;
+    while(p < end) {
+        const char* eol = (const char*)memchr(p, '\r', end - p);
+        if(!eol) {
+            eol = end;
+        }
+        // end后面就是最后的\r\n，这里不会越界
+        if(eol[1] != '\n') {
+            return HTTP_PARSE_INVALID;
+        }
+        const char* colon = (const char*)memchr(p, ':', eol - p);
+        // 不支持obs-fold，字段名不能为空也不能带空白
+        if(!colon || colon == p || *p == ' ' || *p == '\t' || colon[-1] == ' ' || colon[-1] == '\t') {
+            return HTTP_PARSE_INVALID;
+        }
+        if(count == max) {
+            return HTTP_PARSE_TOO_MANY_HEADERS;
+        }
+        HttpHeader& h = headers[count++];
+        h.name = StringPiece(p, colon - p);
+        h.value = Trim(colon + 1, eol);
+
+        switch(h.name.size) {
+            case 10:
+                if(h.name.iequals("connection")) {
+                    if(HasToken(h.value, "close")) {
+                        info.close = 1;
+                    } else if(HasToken(h.value, "keep-alive")) {
+                        info.close = 0;
+                    }
+                }
+                break;
+            case 14:
+                if(h.name.iequals("content-length")) {
+                    if(h.value.empty() || h.value.size > 19) {
+                        return HTTP_PARSE_INVALID_CONTENT_LENGTH;
+                    }
+                    uint64_t v = 0;
+                    for(size_t i = 0; i < h.value.size; ++i) {
+                        char c = h.value.data[i];
+                        if(c < '0' || c > '9') {
+                            return HTTP_PARSE_INVALID_CONTENT_LENGTH;
+                        }
+                        v = v * 10 + (c - '0');
+                    }
+                    if(info.hasContentLength && info.contentLength != v) {
+                        return HTTP_PARSE_INVALID_CONTENT_LENGTH;
+                    }
+                    info.hasContentLength = true;
+                    info.contentLength = v;
+                }
+                break;
+            case 17:
+                if(h.name.iequals("transfer-encoding")) {
+                    ParseTransferEncoding(h.value, info);
+                }
+                break;
+            default:
+                break;
+        }
+        p = eol + 2;
+    }
+    return HTTP_PARSE_OK;
+}
+
+HttpRequestParser::HttpRequestParser() {
+    reset();
+}
+
+void HttpRequestParser::reset() {
+    m_scanned = 0;
+    m_error = HTTP_PARSE_OK;
+    m_finished = false;
+}
+
+size_t HttpRequestParser::execute(const char* data, size_t len, HttpRequest& req) {
+    if(m_error || m_finished) {
+        return 0;
+    }
+    const char* end = data + len;
+    const char* head_end = FindHeaderEnd(data, data + (m_scanned > 3 ? m_scanned - 3 : 0), end);
+    if(!head_end) {
+        m_scanned = len;
+        if(len >= GetHttpRequestBufferSize()) {
+            m_error = HTTP_PARSE_HEADER_TOO_LARGE;
+        }
+        return 0;
+    }
+    size_t head_len = head_end - data;
+    if(head_len > GetHttpRequestBufferSize()) {
+        m_error = HTTP_PARSE_HEADER_TOO_LARGE;
+        return 0;
+    }
+
+    req.reset();
+    // 请求行: METHOD SP URI SP HTTP/1.x CRLF
+    const char* p = data;
+    const char* eol = (const char*)memchr(p, '\r', head_end - p);
+    const char* sp = (const char*)memchr(p, ' ', eol - p);
+    if(!sp) {
+        m_error = HTTP_PARSE_INVALID;
+        return 0;
+    }
+    req.m_method = StringToHttpMethod(p, sp - p);
+    if(req.m_method == HttpMethod::INVALID_METHOD) {
+        m_error = HTTP_PARSE_INVALID_METHOD;
+        return 0;
+    }
+    p = sp + 1;
+    sp = (const char*)memchr(p, ' ', eol - p);
+    if(!sp || sp == p) {
+        m_error = HTTP_PARSE_INVALID;
+        return 0;
+    }
+    req.m_uri = StringPiece(p, sp - p);
+    m_error = ParseVersion(sp + 1, eol, req.m_version);
+    if(m_error) {
+        return 0;
+    }
+
+    const char* uri_end = sp;
+    const char* hash = (const char*)memchr(p, '#', uri_end - p);
+    if(hash) {
+        req.m_fragment = StringPiece(hash + 1, uri_end - hash - 1);
+        uri_end = hash;
+    }
+    const char* question = (const char*)memchr(p, '?', uri_end - p);
+    if(question) {
+        req.m_query = StringPiece(question + 1, uri_end - question - 1);
+        uri_end = question;
+    }
+    req.m_path = StringPiece(p, uri_end - p);
+
+    HeaderInfo info;
+    m_error = ParseHeaders(eol + 2, head_end - 2, req.m_headers, HttpRequest::MAX_HEADERS
+                            ,req.m_headerCount, info);
+    if(m_error) {
+        return 0;
+    }
+    // RFC 9112 6.3: 请求的body边界只能有一种解释，否则前后两跳可能切出不同的请求(request smuggling)
+    // transfer-encoding和content-length不能同时出现，有transfer-encoding时最后一个编码必须是chunked且只出现一次
+    if(info.hasTransferEncoding && info.hasContentLength) {
+        m_error = HTTP_PARSE_INVALID_CONTENT_LENGTH;
+        return 0;
+    }
+    if(info.hasTransferEncoding && (!info.chunked || info.chunkedCount != 1)) {
+        m_error = HTTP_PARSE_INVALID_TRANSFER_ENCODING;
+        return 0;
+    }
+    if(info.contentLength > GetHttpRequestMaxBodySize()) {
+        m_error = HTTP_PARSE_BODY_TOO_LARGE;
+        return 0;
+    }
+    req.m_chunked = info.chunked;
+    req.m_contentLength = info.contentLength;
+    req.m_close = info.close == -1 ? req.m_version == 0x10 : info.close == 1;
+    m_finished = true;
+    return head_len;
+}
+
+HttpResponseParser::HttpResponseParser() {
+    reset();
+}
+
+void HttpResponseParser::reset() {
+    m_scanned = 0;
+    m_error = HTTP_PARSE_OK;
+    m_finished = false;
+    m_status = HttpStatus::OK;
+    m_reason = StringPiece();
+    m_version = 0x11;
+    m_close = false;
+    m_chunked = false;
+    m_hasContentLength = false;
+    m_contentLength = 0;
+    m_headerCount = 0;
+}
+
+size_t HttpResponseParser::execute(const char* data, size_t len) {
+    if(m_error || m_finished) {
+        return 0;
+    }
+    const char* end = data + len;
+    const char* head_end = FindHeaderEnd(data, data + (m_scanned > 3 ? m_scanned - 3 : 0), end);
+    if(!head_end) {
+        m_scanned = len;
+        if(len >= HttpRequestParser::GetHttpRequestBufferSize() * 16) {
+            m_error = HTTP_PARSE_HEADER_TOO_LARGE;
+        }
+        return 0;
+    }
+
+    // 状态行: HTTP/1.x SP 3DIGIT SP reason CRLF
+    const char* eol = (const char*)memchr(data, '\r', head_end - data);
+    if(eol - data < 12 || data[8] != ' ' || ParseVersion(data, data + 8, m_version)) {
+        m_error = HTTP_PARSE_INVALID;
+        return 0;
+    }
+    uint32_t status = 0;
+    for(int i = 9; i < 12; ++i) {
+        if(data[i] < '0' || data[i] > '9') {
+            m_error = HTTP_PARSE_INVALID;
+            return 0;
+        }
+        status = status * 10 + data[i] - '0';
+    }
+    m_status = (HttpStatus)status;
+    m_reason = eol - data > 13 ? StringPiece(data + 13, eol - data - 13) : StringPiece();
+
+    HeaderInfo info;
+    m_error = ParseHeaders(eol + 2, head_end - 2, m_headers, MAX_HEADERS, m_headerCount, info);
+    if(m_error) {
+        return 0;
+    }
+    // 响应有transfer-encoding时忽略content-length，最后一个编码不是chunked就读到连接关闭
+    m_chunked = info.chunked;
+    m_hasContentLength = info.hasContentLength && !info.hasTransferEncoding;
+    m_contentLength = info.contentLength;
+    m_close = info.close == -1 ? m_version == 0x10 : info.close == 1;
+    m_finished = true;
+    return head_end - data;
+}
+
+StringPiece HttpResponseParser::getHeader(const StringPiece& key, const StringPiece& def) const {
+    for(size_t i = 0; i < m_headerCount; ++i) {
+        if(m_headers[i].name.iequals(key)) {
+            return m_headers[i].value;
+        }
+    }
+    return def;
+}
+
+enum {
+    CHUNKED_IN_CHUNK_SIZE,
+    CHUNKED_IN_CHUNK_EXT,
+    CHUNKED_IN_CHUNK_DATA,
+    CHUNKED_IN_CHUNK_CRLF,
+    CHUNKED_IN_TRAILERS_LINE_HEAD,
+    CHUNKED_IN_TRAILERS_LINE_MIDDLE
+};
+
+HttpChunkedDecoder::HttpChunkedDecoder() {
+    reset();
+}
+
+void HttpChunkedDecoder::reset() {
+    m_state = CHUNKED_IN_CHUNK_SIZE;
+    m_bytesLeft = 0;
+    m_hexCount = 0;
+}
+
+static int DecodeHex(char c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    } else if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+ssize_t HttpChunkedDecoder::decode(char* buf, size_t* bufsz) {
+    size_t dst = 0;
+    size_t src = 0;
+    size_t size = *bufsz;
+    ssize_t ret = -2;
+
+    while(true) {
+        switch(m_state) {
+            case CHUNKED_IN_CHUNK_SIZE:
+                for(;; ++src) {
+                    if(src == size) {
+                        goto exit;
+                    }
+                    int v = DecodeHex(buf[src]);
+                    if(v == -1) {
+                        if(m_hexCount == 0) {
+                            return -1;
+                        }
+                        break;
+                    }
+                    if(m_hexCount == 15) {
+                        return -1;
+                    }
+                    m_bytesLeft = m_bytesLeft * 16 + v;
+                    ++m_hexCount;
+                }
+                m_hexCount = 0;
+                m_state = CHUNKED_IN_CHUNK_EXT;
+                // fallthrough
+            case CHUNKED_IN_CHUNK_EXT:
+                for(;; ++src) {
+                    if(src == size) {
+                        goto exit;
+                    }
+                    if(buf[src] == '\n') {
+                        break;
+                    }
+                }
+                ++src;
+                if(m_bytesLeft == 0) {
+                    m_state = CHUNKED_IN_TRAILERS_LINE_HEAD;
+                    break;
+                }
+                m_state = CHUNKED_IN_CHUNK_DATA;
+                // fallthrough
+            case CHUNKED_IN_CHUNK_DATA: {
+                size_t avail = size - src;
+                if(avail < m_bytesLeft) {
+                    memmove(buf + dst, buf + src, avail);
+                    src += avail;
+                    dst += avail;
+                    m_bytesLeft -= avail;
+                    goto exit;
+                }
+                memmove(buf + dst, buf + src, m_bytesLeft);
+                src += m_bytesLeft;
+                dst += m_bytesLeft;
+                m_bytesLeft = 0;
+                m_state = CHUNKED_IN_CHUNK_CRLF;
+            }
+                // fallthrough
+            case CHUNKED_IN_CHUNK_CRLF:
+                for(;; ++src) {
+                    if(src == size) {
+                        goto exit;
+                    }
+                    if(buf[src] != '\r') {
+                        break;
+                    }
+                }
+                if(buf[src] != '\n') {
+                    return -1;
+                }
+                ++src;
+                m_state = CHUNKED_IN_CHUNK_SIZE;
+                break;
+            case CHUNKED_IN_TRAILERS_LINE_HEAD:
+                for(;; ++src) {
+                    if(src == size) {
+                        goto exit;
+                    }
+                    if(buf[src] != '\r') {
+                        break;
+                    }
+                }
+                if(buf[src++] == '\n') {
+                    ret = size - src;
+                    goto exit;
+                }
+                m_state = CHUNKED_IN_TRAILERS_LINE_MIDDLE;
+                // fallthrough
+            case CHUNKED_IN_TRAILERS_LINE_MIDDLE:
+                for(;; ++src) {
+                    if(src == size) {
+                        goto exit;
+                    }
+                    if(buf[src] == '\n') {
+                        break;
+                    }
+                }
+                ++src;
+                m_state = CHUNKED_IN_TRAILERS_LINE_HEAD;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+exit:
+    if(dst != src) {
+        memmove(buf + dst, buf + src, size - src);
+    }
+    *bufsz = dst;
+    return ret;
+}
+
+}
+}
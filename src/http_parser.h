@@ -0,0 +1,164 @@
+/**
+ * @file http_parser.h
+ * @brief HTTP/1.1解析器
+ */
+#ifndef __SYLAR_HTTP_PARSER_H__
+#define __SYLAR_HTTP_PARSER_H__
+
+#include <sys/types.h>
+#include "http.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief 解析错误码
+ */
+enum HttpParseError {
+    /// 没有错误
+    HTTP_PARSE_OK = 0,
+    /// 格式错误
+    HTTP_PARSE_INVALID = 1,
+    /// 方法不认识
+    HTTP_PARSE_INVALID_METHOD = 2,
+    /// 版本不支持
+    HTTP_PARSE_INVALID_VERSION = 3,
+    /// content-length非法, 或者和transfer-encoding同时出现
+    HTTP_PARSE_INVALID_CONTENT_LENGTH = 4,
+    /// 头部字段太多
+    HTTP_PARSE_TOO_MANY_HEADERS = 5,
+    /// 头部超过http.request.buffer_size
+    HTTP_PARSE_HEADER_TOO_LARGE = 6,
+    /// body超过http.request.max_body_size
+    HTTP_PARSE_BODY_TOO_LARGE = 7,
+    /// 请求的transfer-encoding最后一个编码不是chunked, 或者chunked出现了多次
+    HTTP_PARSE_INVALID_TRANSFER_ENCODING = 8,
+};
+
+/**
+ * @brief HTTP请求解析器
+ * @details 增量解析: 每次带上目前收到的全部数据调用execute, 已经扫描过的部分不会重复找头部结束位置
+ *          找到\r\n\r\n之后一次性解析请求行和头部, 结果是指向data的StringPiece, 不分配内存
+ *          只解析头部, body由调用方按getContentLength或者HttpChunkedDecoder处理
+ */
+class HttpRequestParser {
+public:
+    HttpRequestParser();
+
+    /**
+     * @brief 开始解析新的请求
+     */
+    void reset();
+
+    /**
+     * @brief 解析请求头
+     * @param[in] data 从请求开始的数据
+     * @param[in] len 数据长度
+     * @param[out] req 解析结果
+     * @return 头部完整时返回头部长度(含\r\n\r\n), 数据不够或者出错返回0, 出错时hasError()非0
+     */
+    size_t execute(const char* data, size_t len, HttpRequest& req);
+
+    /**
+     * @brief 是否解析完成
+     */
+    int isFinished() const { return m_finished;}
+
+    /**
+     * @brief 返回HttpParseError
+     */
+    int hasError() const { return m_error;}
+
+    /**
+     * @brief 返回请求头的最大长度
+     */
+    static uint64_t GetHttpRequestBufferSize();
+
+    /**
+     * @brief 返回请求体的最大长度
+     */
+    static uint64_t GetHttpRequestMaxBodySize();
+private:
+    /// 已经确认不含头部结束标记的长度
+    size_t m_scanned;
+    int m_error;
+    bool m_finished;
+};
+
+/**
+ * @brief HTTP响应解析器, 用法和HttpRequestParser一样
+ */
+class HttpResponseParser {
+public:
+    static const size_t MAX_HEADERS = 64;
+
+    HttpResponseParser();
+
+    void reset();
+
+    /**
+     * @brief 解析响应头
+     * @return 头部完整时返回头部长度, 数据不够或者出错返回0
+     */
+    size_t execute(const char* data, size_t len);
+
+    int isFinished() const { return m_finished;}
+    int hasError() const { return m_error;}
+
+    HttpStatus getStatus() const { return m_status;}
+    StringPiece getReason() const { return m_reason;}
+    uint8_t getVersion() const { return m_version;}
+    bool isClose() const { return m_close;}
+    bool isChunked() const { return m_chunked;}
+
+    /**
+     * @brief 是否带了content-length, 没有也不是chunked时body读到连接关闭为止
+     */
+    bool hasContentLength() const { return m_hasContentLength;}
+    uint64_t getContentLength() const { return m_contentLength;}
+
+    size_t getHeaderCount() const { return m_headerCount;}
+    const HttpHeader& getHeaderAt(size_t i) const { return m_headers[i];}
+    StringPiece getHeader(const StringPiece& key, const StringPiece& def = StringPiece()) const;
+private:
+    size_t m_scanned;
+    int m_error;
+    bool m_finished;
+    HttpStatus m_status;
+    StringPiece m_reason;
+    uint8_t m_version;
+    bool m_close;
+    bool m_chunked;
+    bool m_hasContentLength;
+    uint64_t m_contentLength;
+    size_t m_headerCount;
+    HttpHeader m_headers[MAX_HEADERS];
+};
+
+/**
+ * @brief chunked编码的原地解码
+ * @details 可以分多次喂数据, 解出来的数据移到buf的开头
+ */
+class HttpChunkedDecoder {
+public:
+    HttpChunkedDecoder();
+
+    void reset();
+
+    /**
+     * @brief 解码
+     * @param[in,out] buf 待解码的数据, 解出的数据原地写回buf开头
+     * @param[in,out] bufsz 输入为数据长度, 输出为解出的数据长度
+     * @return -1出错, -2需要更多数据, >=0结束, 值为最后一个chunk之后多出来的字节数(紧跟在解出的数据后面)
+     */
+    ssize_t decode(char* buf, size_t* bufsz);
+private:
+    int m_state;
+    uint64_t m_bytesLeft;
+    int m_hexCount;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "http_server.h"
+#include "log.h"
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr http_server_logger = SYLAR_LOG_NAME("system");
+
+HttpServer::HttpServer(bool keepalive
+               ,sylar::IOManager* worker
+               ,sylar::IOManager* accept_worker)
+    :TcpServer(worker, accept_worker)
+    ,m_isKeepalive(keepalive) {
+    m_dispatch.reset(new ServletDispatch);
+}
+
+void HttpServer::setName(const std::string& v) {
+    TcpServer::setName(v);
+    m_dispatch->setDefault(std::make_shared<NotFoundServlet>(v));
+}
+
+void HttpServer::handleClient(Socket::ptr client) {
+    SYLAR_LOG_DEBUG(http_server_logger) << "handleClient " << *client;
+    HttpSession::ptr session(new HttpSession(client));
+    // 同一个连接上的请求和响应对象复用，解析和分发过程不再分配
+    HttpRequest::ptr req(new HttpRequest);
+    HttpResponse::ptr rsp(new HttpResponse);
+    while(true) {
+        int rt = session->recvRequest(*req);
+        if(rt <= 0) {
+            int err = session->getParseError();
+            if(err) {
+                SYLAR_LOG_DEBUG(http_server_logger) << "recv http request fail, parse error="
+                    << err << " client:" << *client << " keep_alive=" << m_isKeepalive;
+                rsp->reset(0x11, true);
+                if(err == HTTP_PARSE_HEADER_TOO_LARGE) {
+                    rsp->setStatus(HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE);
+                } else if(err == HTTP_PARSE_BODY_TOO_LARGE) {
+                    rsp->setStatus(HttpStatus::PAYLOAD_TOO_LARGE);
+                } else {
+                    rsp->setStatus(HttpStatus::BAD_REQUEST);
+                }
+                session->sendResponse(*rsp);
+            }
+            break;
+        }
+
+        bool close = req->isClose() || !m_isKeepalive;
+        rsp->reset(req->getVersion(), close);
+        rsp->setHeader("Server", getName());
+        m_dispatch->handle(req, rsp, session);
+        if(session->sendResponse(*rsp) <= 0) {
+            break;
+        }
+        if(close) {
+            break;
+        }
+    }
+    session->close();
+}
+
+}
+}
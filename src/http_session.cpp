@@ -0,0 +1,127 @@
+#include "http_session.h"
+
+namespace sylar {
+namespace http {
+
+HttpSession::HttpSession(Socket::ptr sock, bool owner)
+    :SocketStream(sock, owner)
+    ,m_begin(0)
+    ,m_end(0)
+    ,m_consumed(0)
+    ,m_parseError(HTTP_PARSE_OK) {
+    // 请求直接读进m_buf，不需要SocketStream再预读一份
+    setReadBufferSize(0);
+    m_buf.resize(HttpRequestParser::GetHttpRequestBufferSize());
+}
+
+int HttpSession::fillBuffer(size_t limit) {
+    if(m_end == m_buf.size()) {
+        if(m_begin > 0) {
+            memmove(&m_buf[0], &m_buf[m_begin], m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
+        } else if(m_buf.size() < limit) {
+            m_buf.resize(std::min(m_buf.size() * 2, limit));
+        } else {
+            return -1;
+        }
+    }
+    int rt = read(&m_buf[m_end], m_buf.size() - m_end);
+    if(rt > 0) {
+        m_end += rt;
+    }
+    return rt;
+}
+
+int HttpSession::recvRequest(HttpRequest& req) {
+    m_begin += m_consumed;
+    m_consumed = 0;
+    if(m_begin == m_end) {
+        m_begin = m_end = 0;
+    }
+    m_parseError = HTTP_PARSE_OK;
+    m_parser.reset();
+
+    size_t head_len = 0;
+    while(true) {
+        head_len = m_parser.execute(&m_buf[m_begin], m_end - m_begin, req);
+        if(m_parser.hasError()) {
+            m_parseError = m_parser.hasError();
+            return -1;
+        }
+        if(head_len) {
+            break;
+        }
+        int rt = fillBuffer(HttpRequestParser::GetHttpRequestBufferSize());
+        if(rt <= 0) {
+            return rt;
+        }
+    }
+
+    // 读body时缓冲区可能被移动或者扩容，之后要重新解析头部让StringPiece指向新位置
+    const char* base = &m_buf[m_begin];
+    size_t limit = HttpRequestParser::GetHttpRequestBufferSize()
+                    + HttpRequestParser::GetHttpRequestMaxBodySize();
+    size_t body_len = 0;
+    if(req.isChunked()) {
+        m_decoder.reset();
+        while(true) {
+            size_t raw = m_begin + head_len + body_len;
+            size_t size = m_end - raw;
+            ssize_t rt = m_decoder.decode(&m_buf[raw], &size);
+            body_len += size;
+            if(rt == -1) {
+                m_parseError = HTTP_PARSE_INVALID;
+                return -1;
+            }
+            if(rt >= 0) {
+                m_end = m_begin + head_len + body_len + rt;
+                break;
+            }
+            m_end = m_begin + head_len + body_len;
+            if(body_len > HttpRequestParser::GetHttpRequestMaxBodySize()) {
+                m_parseError = HTTP_PARSE_BODY_TOO_LARGE;
+                return -1;
+            }
+            int n = fillBuffer(limit);
+            if(n <= 0) {
+                return n;
+            }
+        }
+    } else {
+        body_len = req.getContentLength();
+        while(m_end - m_begin < head_len + body_len) {
+            int n = fillBuffer(limit);
+            if(n <= 0) {
+                return n;
+            }
+        }
+    }
+
+    if(base != &m_buf[m_begin]) {
+        m_parser.reset();
+        m_parser.execute(&m_buf[m_begin], head_len, req);
+    }
+    req.m_body = StringPiece(&m_buf[m_begin + head_len], body_len);
+    m_consumed = head_len + body_len;
+    return 1;
+}
+
+int HttpSession::sendResponse(const HttpResponse& rsp) {
+    m_out.clear();
+    rsp.encodeHead(m_out);
+    const std::string& body = rsp.getBody();
+    // 小响应拼成一块进写缓冲，大的body不拷贝，和头部一起writev
+    if(body.size() < 1024) {
+        m_out.append(body);
+        return writeFixSize(m_out.data(), m_out.size());
+    }
+    int rt = writeFixSize(m_out.data(), m_out.size());
+    if(rt <= 0) {
+        return rt;
+    }
+    return writeFixSize(body.data(), body.size());
+}
+
+}
+}
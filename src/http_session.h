@@ -0,0 +1,74 @@
+/**
+ * @file http_session.h
+ * @brief 服务端的HTTP连接
+ */
+#ifndef __SYLAR_HTTP_SESSION_H__
+#define __SYLAR_HTTP_SESSION_H__
+
+#include "socket_stream.h"
+#include "http.h"
+#include "http_parser.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief 服务端的HTTP连接
+ * @details 请求直接读进连接自己的缓冲区, 解析结果指向这个缓冲区, 一个请求处理完才会被覆盖
+ *          一次读到多个请求(pipelining)时依次解析, 不再读fd; 响应先进写缓冲,
+ *          攒够阈值或者下一次真正读fd之前一起发出去
+ */
+class HttpSession : public SocketStream {
+public:
+    typedef std::shared_ptr<HttpSession> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] sock Socket类型
+     * @param[in] owner 是否托管
+     */
+    HttpSession(Socket::ptr sock, bool owner = true);
+
+    /**
+     * @brief 接收下一个HTTP请求
+     * @param[out] req 解析结果, 在下一次recvRequest之前有效
+     * @return >0 成功, 0 对端关闭, <0 出错, 出错时getParseError()说明协议错误的原因
+     */
+    int recvRequest(HttpRequest& req);
+
+    /**
+     * @brief 发送HTTP响应
+     * @return >0 成功, 其它为失败
+     */
+    int sendResponse(const HttpResponse& rsp);
+
+    /**
+     * @brief 最近一次recvRequest的HttpParseError
+     */
+    int getParseError() const { return m_parseError;}
+private:
+    /**
+     * @brief 往缓冲区读更多数据, 满了先把已处理的部分挪走, 还不够再扩容
+     * @param[in] limit 缓冲区允许的最大长度
+     */
+    int fillBuffer(size_t limit);
+private:
+    /// 接收缓冲区
+    std::string m_buf;
+    /// 当前请求的开始位置
+    size_t m_begin;
+    /// 有效数据的结束位置
+    size_t m_end;
+    /// 上一个请求占用的长度, 下一次recvRequest时跳过
+    size_t m_consumed;
+    int m_parseError;
+    HttpRequestParser m_parser;
+    HttpChunkedDecoder m_decoder;
+    /// 响应头的序列化缓冲区
+    std::string m_out;
+};
+
+}
+}
+
+#endif
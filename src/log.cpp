@@ -14,6 +14,23 @@
 #include "hook.cpp"
 #include "fd_manager.cpp"
 #include "address.cpp"
+#include "dns.cpp"
+#include "file_io.cpp"
+#include "socket.cpp"
+#include "tcp_server.cpp"
+#include "bytearray.cpp"
+#include "stream.cpp"
+#include "socket_stream.cpp"
+#include "file_stream.cpp"
+#include "http.cpp"
+#include "http_parser.cpp"
+#include "http_session.cpp"
+#include "servlet.cpp"
+#include "http_server.cpp"
+#include "http_connection.cpp"
+#include "fiber_sync.cpp"
+#include "metrics.cpp"
+#include "profiler.cpp"
 
 namespace sylar{
 
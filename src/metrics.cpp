@@ -0,0 +1,257 @@
+#include "metrics.h"
+#include "log.h"
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <stdlib.h>
+
+namespace sylar {
+
+static sylar::Logger::ptr metrics_logger = SYLAR_LOG_NAME("system");
+
+uint32_t MetricsNextSlot() {
+    static std::atomic<uint32_t> s_next(0);
+    return s_next.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metric::writePrometheus(std::ostream& os, const std::string& name
+                             ,const std::string& labels) const {
+    os << name << labels << " " << value() << "\n";
+}
+
+Counter::Counter() {
+    void* p = nullptr;
+    if(posix_memalign(&p, 64, sizeof(Slot) * SLOTS)) {
+        throw std::bad_alloc();
+    }
+    m_slots = (Slot*)p;
+    for(size_t i = 0; i < SLOTS; ++i) {
+        new (&m_slots[i]) Slot();
+    }
+}
+
+Counter::~Counter() {
+    for(size_t i = 0; i < SLOTS; ++i) {
+        m_slots[i].~Slot();
+    }
+    free(m_slots);
+}
+
+
+uint64_t Counter::get() const {
+    uint64_t v = 0;
+    for(size_t i = 0; i < SLOTS; ++i) {
+        v += m_slots[i].value.load(std::memory_order_relaxed);
+    }
+    return v;
+}
+
+void Gauge::updateMax(int64_t v) {
+    int64_t cur = m_value.load(std::memory_order_relaxed);
+    while(v > cur && !m_value.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+    }
+}
+
+Histogram::Histogram() {
+    void* p = nullptr;
+    if(posix_memalign(&p, 64, sizeof(Shard) * SHARDS)) {
+        throw std::bad_alloc();
+    }
+    m_shards = (Shard*)p;
+    for(size_t i = 0; i < SHARDS; ++i) {
+        new (&m_shards[i]) Shard();
+        for(int j = 0; j < BUCKETS; ++j) {
+            m_shards[i].buckets[j] = 0;
+        }
+        m_shards[i].sum = 0;
+    }
+}
+
+Histogram::~Histogram() {
+    for(size_t i = 0; i < SHARDS; ++i) {
+        m_shards[i].~Shard();
+    }
+    free(m_shards);
+}
+
+uint64_t Histogram::BucketUpper(int idx) {
+    if(idx < SUB_COUNT) {
+        return idx;
+    }
+    int e = idx / SUB_COUNT + SUB_BITS - 1;
+    uint64_t sub = idx % SUB_COUNT;
+    uint64_t step = 1ull << (e - SUB_BITS);
+    // 最后一个桶的上界会溢出, 正好是UINT64_MAX
+    return ((SUB_COUNT + sub + 1) * step) - 1;
+}
+
+void Histogram::merge(std::vector<uint64_t>& buckets) const {
+    buckets.assign(BUCKETS, 0);
+    for(size_t i = 0; i < SHARDS; ++i) {
+        for(int j = 0; j < BUCKETS; ++j) {
+            buckets[j] += m_shards[i].buckets[j].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t Histogram::getCount() const {
+    uint64_t count = 0;
+    for(size_t i = 0; i < SHARDS; ++i) {
+        for(int j = 0; j < BUCKETS; ++j) {
+            count += m_shards[i].buckets[j].load(std::memory_order_relaxed);
+        }
+    }
+    return count;
+}
+
+uint64_t Histogram::getSum() const {
+    uint64_t sum = 0;
+    for(size_t i = 0; i < SHARDS; ++i) {
+        sum += m_shards[i].sum.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    std::vector<uint64_t> buckets;
+    merge(buckets);
+    uint64_t count = 0;
+    for(auto i : buckets) {
+        count += i;
+    }
+    if(!count) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p * count);
+    if(rank >= count) {
+        rank = count - 1;
+    }
+    uint64_t seen = 0;
+    for(int i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i];
+        if(seen > rank) {
+            return BucketUpper(i);
+        }
+    }
+    return BucketUpper(BUCKETS - 1);
+}
+
+void Histogram::writePrometheus(std::ostream& os, const std::string& name
+                                ,const std::string& labels) const {
+    std::vector<uint64_t> buckets;
+    merge(buckets);
+    int last = -1;
+    for(int i = 0; i < BUCKETS; ++i) {
+        if(buckets[i]) {
+            last = i;
+        }
+    }
+    // le标签接在已有标签后面
+    std::string prefix = labels.empty() ? "{" : labels.substr(0, labels.size() - 1) + ",";
+    uint64_t cumulative = 0;
+    int idx = 0;
+    // 2的幂边界: 桶上界为2^k-1的位置
+    for(uint64_t bound = 0; last >= 0 && idx <= last; bound = bound * 2 + 1) {
+        while(idx < BUCKETS && BucketUpper(idx) <= bound) {
+            cumulative += buckets[idx++];
+        }
+        os << name << "_bucket" << prefix << "le=\"" << bound << "\"} " << cumulative << "\n";
+    }
+    for(; idx < BUCKETS; ++idx) {
+        cumulative += buckets[idx];
+    }
+    os << name << "_bucket" << prefix << "le=\"+Inf\"} " << cumulative << "\n";
+    os << name << "_sum" << labels << " " << getSum() << "\n";
+    os << name << "_count" << labels << " " << cumulative << "\n";
+}
+
+static std::string FormatLabels(const MetricsRegistry::Labels& labels) {
+    if(labels.empty()) {
+        return "";
+    }
+    std::stringstream ss;
+    ss << "{";
+    bool first = true;
+    for(auto& i : labels) {
+        if(!first) {
+            ss << ",";
+        }
+        first = false;
+        ss << i.first << "=\"";
+        for(char c : i.second) {
+            switch(c) {
+                case '\\': ss << "\\\\"; break;
+                case '"': ss << "\\\""; break;
+                case '\n': ss << "\\n"; break;
+                default: ss << c;
+            }
+        }
+        ss << "\"";
+    }
+    ss << "}";
+    return ss.str();
+}
+
+bool MetricsRegistry::add(const std::string& name, const Labels& labels, const std::string& help
+                          ,Metric::ptr metric, const void* owner) {
+    std::string label_str = FormatLabels(labels);
+    Mutex::Lock lock(m_mutex);
+    Family& family = m_families[name];
+    if(family.entries.empty()) {
+        family.help = help;
+        family.type = metric->getType();
+    }
+    // 同名同标签导出后是同一条时间序列，Prometheus会拒绝整个抓取结果
+    for(auto& e : family.entries) {
+        if(e.labels == label_str) {
+            SYLAR_LOG_ERROR(metrics_logger) << "MetricsRegistry::add duplicate metric " << name << label_str;
+            return false;
+        }
+    }
+    family.entries.push_back(Entry{label_str, metric, owner});
+    return true;
+}
+
+void MetricsRegistry::remove(const void* owner) {
+    Mutex::Lock lock(m_mutex);
+    for(auto it = m_families.begin(); it != m_families.end();) {
+        auto& entries = it->second.entries;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [owner](const Entry& e) {
+            return e.owner == owner;
+        }), entries.end());
+        if(entries.empty()) {
+            m_families.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::vector<MetricSample> MetricsRegistry::snapshot() {
+    std::vector<MetricSample> samples;
+    Mutex::Lock lock(m_mutex);
+    for(auto& i : m_families) {
+        for(auto& e : i.second.entries) {
+            samples.push_back(MetricSample{i.first, e.labels, i.second.type, e.metric->value()});
+        }
+    }
+    return samples;
+}
+
+std::string MetricsRegistry::toPrometheus() {
+    std::stringstream ss;
+    ss.precision(17);
+    Mutex::Lock lock(m_mutex);
+    for(auto& i : m_families) {
+        ss << "# HELP " << i.first << " " << i.second.help << "\n";
+        ss << "# TYPE " << i.first << " "
+           << (i.second.type == Metric::COUNTER ? "counter"
+               : i.second.type == Metric::GAUGE ? "gauge" : "histogram") << "\n";
+        for(auto& e : i.second.entries) {
+            e.metric->writePrometheus(ss, i.first, e.labels);
+        }
+    }
+    return ss.str();
+}
+
+}
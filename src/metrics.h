@@ -0,0 +1,256 @@
+/**
+ * @file metrics.h
+ * @brief 运行时指标
+ * @details 计数器按线程分槽累加, 热路径上只有一次relaxed的fetch_add, 不同线程不抢同一个cache line
+ *          指标按名字+标签注册到MetricsMgr, 可以取快照或者导出Prometheus文本格式
+ */
+#ifndef __SYLAR_METRICS_H__
+#define __SYLAR_METRICS_H__
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "thread.h"
+#include "singleton.h"
+
+namespace sylar {
+
+/**
+ * @brief 当前线程的槽位号, 线程第一次调用时轮流分配
+ */
+uint32_t MetricsNextSlot();
+inline uint32_t MetricsThreadSlot() {
+    static thread_local uint32_t t_slot = MetricsNextSlot();
+    return t_slot;
+}
+
+/**
+ * @brief 指标基类
+ */
+class Metric {
+public:
+    typedef std::shared_ptr<Metric> ptr;
+    enum Type {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    virtual ~Metric() {}
+    virtual Type getType() const = 0;
+    /**
+     * @brief 当前值, 取快照时调用, 直方图返回样本数
+     */
+    virtual double value() const = 0;
+    /**
+     * @brief 输出Prometheus格式的样本行
+     * @param[in] labels 格式化好的标签, 可能为空
+     */
+    virtual void writePrometheus(std::ostream& os, const std::string& name
+                                 ,const std::string& labels) const;
+};
+
+/**
+ * @brief 只增不减的计数器, 按线程分槽
+ */
+class Counter : public Metric {
+public:
+    typedef std::shared_ptr<Counter> ptr;
+
+    Counter();
+    ~Counter();
+
+    void add(uint64_t v = 1) {
+        m_slots[MetricsThreadSlot() % SLOTS].value.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 各槽位加起来的值
+     */
+    uint64_t get() const;
+
+    Type getType() const override { return COUNTER;}
+    double value() const override { return get();}
+private:
+    static const size_t SLOTS = 64;
+    struct Slot {
+        std::atomic<uint64_t> value{0};
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+private:
+    Slot* m_slots;
+};
+
+/**
+ * @brief 可以设置、加减的瞬时值
+ */
+class Gauge : public Metric {
+public:
+    typedef std::shared_ptr<Gauge> ptr;
+
+    Gauge() :m_value(0) {}
+
+    void set(int64_t v) { m_value.store(v, std::memory_order_relaxed);}
+    void add(int64_t v) { m_value.fetch_add(v, std::memory_order_relaxed);}
+    /**
+     * @brief 比当前值大时才更新, 用来记最大值
+     */
+    void updateMax(int64_t v);
+    int64_t get() const { return m_value.load(std::memory_order_relaxed);}
+
+    Type getType() const override { return GAUGE;}
+    double value() const override { return get();}
+private:
+    std::atomic<int64_t> m_value;
+};
+
+/**
+ * @brief 取快照时才调用回调算值, 适合队列长度这种本来就有的数
+ */
+class CallbackMetric : public Metric {
+public:
+    typedef std::shared_ptr<CallbackMetric> ptr;
+
+    CallbackMetric(Type type, std::function<double()> cb)
+        :m_type(type)
+        ,m_cb(cb) {
+    }
+
+    Type getType() const override { return m_type;}
+    double value() const override { return m_cb();}
+private:
+    Type m_type;
+    std::function<double()> m_cb;
+};
+
+/**
+ * @brief HDR风格的直方图, 记录非负整数(比如微秒)
+ * @details 每个2的幂区间再等分成8个桶, 相对误差不超过12.5%, 覆盖整个uint64范围
+ *          按线程分成几组桶, 记录时只有两次relaxed的fetch_add
+ *          Prometheus导出时只输出2的幂边界上的累计桶
+ */
+class Histogram : public Metric {
+public:
+    typedef std::shared_ptr<Histogram> ptr;
+
+    Histogram();
+    ~Histogram();
+
+    void record(uint64_t v) {
+        Shard& shard = m_shards[MetricsThreadSlot() % SHARDS];
+        shard.buckets[BucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    uint64_t getCount() const;
+    uint64_t getSum() const;
+    /**
+     * @brief 分位数
+     * @param[in] p 0到1之间, 比如0.99
+     * @return 分位数所在桶的上界, 没有样本返回0
+     */
+    uint64_t percentile(double p) const;
+
+    Type getType() const override { return HISTOGRAM;}
+    double value() const override { return getCount();}
+    void writePrometheus(std::ostream& os, const std::string& name
+                         ,const std::string& labels) const override;
+private:
+    static const int SUB_BITS = 3;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+    static const size_t SHARDS = 8;
+
+    struct Shard {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> sum;
+    };
+
+    static int BucketIndex(uint64_t v) {
+        if(v < (uint64_t)SUB_COUNT) {
+            return (int)v;
+        }
+        int e = 63 - __builtin_clzll(v);
+        int sub = (int)(v >> (e - SUB_BITS)) & (SUB_COUNT - 1);
+        return (e - SUB_BITS + 1) * SUB_COUNT + sub;
+    }
+    /// 桶里最大的值
+    static uint64_t BucketUpper(int idx);
+
+    /// 各组桶加起来
+    void merge(std::vector<uint64_t>& buckets) const;
+private:
+    Shard* m_shards;
+};
+
+/**
+ * @brief 快照里的一条
+ */
+struct MetricSample {
+    std::string name;
+    /// 已经格式化好的标签, 比如{scheduler="io"}, 没有标签时为空
+    std::string labels;
+    Metric::Type type;
+    double value;
+};
+
+/**
+ * @brief 指标注册表
+ * @details 同名的指标是一族, 共用help和类型, 用标签区分
+ *          注册时带上owner, owner析构前用remove(owner)把自己的指标都摘掉
+ */
+class MetricsRegistry {
+public:
+    typedef std::map<std::string, std::string> Labels;
+
+    /**
+     * @brief 注册指标
+     * @param[in] name 指标名, 比如sylar_scheduler_tasks_total
+     * @param[in] labels 标签
+     * @param[in] help 说明
+     * @param[in] metric 指标
+     * @param[in] owner 所有者, 用来批量删除
+     * @return 同名同标签的指标已经注册过时不注册, 返回false
+     */
+    bool add(const std::string& name, const Labels& labels, const std::string& help
+             ,Metric::ptr metric, const void* owner = nullptr);
+
+    /**
+     * @brief 删除owner注册的所有指标
+     */
+    void remove(const void* owner);
+
+    /**
+     * @brief 所有指标的当前值, 按名字排序
+     */
+    std::vector<MetricSample> snapshot();
+
+    /**
+     * @brief 导出Prometheus文本格式(text/plain; version=0.0.4)
+     */
+    std::string toPrometheus();
+private:
+    struct Entry {
+        std::string labels;
+        Metric::ptr metric;
+        const void* owner;
+    };
+    struct Family {
+        std::string help;
+        Metric::Type type;
+        std::vector<Entry> entries;
+    };
+
+    Mutex m_mutex;
+    std::map<std::string, Family> m_families;
+};
+
+typedef sylar::Singleton<MetricsRegistry> MetricsMgr;
+
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include "profiler.h"
+#include "fiber.h"
+#include "log.h"
+#include "thread.h"
+#include "util.h"
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <execinfo.h>
+#include <map>
+#include <sched.h>
+#include <signal.h>
+#include <sstream>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+namespace sylar {
+
+static sylar::Logger::ptr profiler_logger = SYLAR_LOG_NAME("system");
+
+namespace {
+
+struct ProfileSample {
+    static const int MAX_FRAMES = 64;
+    // 0表示还没写完
+    std::atomic<int> depth = {0};
+    void* frames[MAX_FRAMES];
+};
+
+}
+
+static ProfileSample* s_profile_samples = nullptr;
+static size_t s_profile_max = 0;
+static std::atomic<size_t> s_profile_next = {0};
+static std::atomic<uint64_t> s_profile_skipped = {0};
+static std::atomic<bool> s_profile_running = {false};
+// 正在信号处理函数里的线程数，Stop要等它们都出来才能读样本
+static std::atomic<int> s_profile_in_handler = {0};
+static bool s_profile_installed = false;
+static struct sigaction s_old_profile_action;
+static FiberProfiler::Stats s_profile_last_stats;
+
+static Mutex& GetProfilerMutex() {
+    static Mutex* s_mutex = new Mutex;
+    return *s_mutex;
+}
+
+static void ProfileSignalHandler(int sig, siginfo_t* info, void* ctx) {
+    int saved_errno = errno;
+    s_profile_in_handler.fetch_add(1, std::memory_order_seq_cst);
+    if(s_profile_running.load(std::memory_order_seq_cst)) {
+        // 协程id为0是线程的主协程，不在协程上
+        if(Fiber::GetFiberId() != 0) {
+            size_t idx = s_profile_next.fetch_add(1, std::memory_order_relaxed);
+            if(idx < s_profile_max) {
+                ProfileSample& sample = s_profile_samples[idx];
+                int n = ::backtrace(sample.frames, ProfileSample::MAX_FRAMES);
+                sample.depth.store(n > 0 ? n : 1, std::memory_order_release);
+            }
+        } else {
+            s_profile_skipped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    s_profile_in_handler.fetch_sub(1, std::memory_order_seq_cst);
+    errno = saved_errno;
+    if(s_old_profile_action.sa_flags & SA_SIGINFO) {
+        if(s_old_profile_action.sa_sigaction) {
+            s_old_profile_action.sa_sigaction(sig, info, ctx);
+        }
+    } else if(s_old_profile_action.sa_handler != SIG_DFL
+            && s_old_profile_action.sa_handler != SIG_IGN) {
+        s_old_profile_action.sa_handler(sig);
+    }
+}
+
+bool FiberProfiler::Start(uint32_t hz, size_t max_samples) {
+    Mutex::Lock lock(GetProfilerMutex());
+    if(s_profile_running || hz == 0 || max_samples == 0) {
+        return false;
+    }
+    // 第一次调用backtrace会加载libgcc，不能发生在信号处理函数里
+    void* bt[1];
+    ::backtrace(bt, 1);
+
+    // 装上就不卸了，停止后还可能有已经发出的SIGPROF，卸掉后默认动作会杀掉进程
+    if(!s_profile_installed) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = ProfileSignalHandler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if(sigaction(SIGPROF, &sa, &s_old_profile_action)) {
+            SYLAR_LOG_ERROR(profiler_logger) << "install SIGPROF handler failed, errno=" << errno;
+            return false;
+        }
+        s_profile_installed = true;
+    }
+
+    delete[] s_profile_samples;
+    s_profile_samples = new ProfileSample[max_samples];
+    s_profile_max = max_samples;
+    s_profile_next = 0;
+    s_profile_skipped = 0;
+    s_profile_running = true;
+
+    struct itimerval tv;
+    tv.it_interval.tv_sec = 0;
+    tv.it_interval.tv_usec = hz >= 1000000 ? 1 : 1000000 / hz;
+    tv.it_value = tv.it_interval;
+    if(setitimer(ITIMER_PROF, &tv, nullptr)) {
+        SYLAR_LOG_ERROR(profiler_logger) << "setitimer ITIMER_PROF failed, errno=" << errno;
+        s_profile_running = false;
+        return false;
+    }
+    return true;
+}
+
+// 同一个函数里不同位置的样本要合并，去掉+0x..的偏移，';'是folded格式的分隔符
+static std::string ProfileFrameName(void* addr, std::map<void*, std::string>& cache) {
+    auto it = cache.find(addr);
+    if(it != cache.end()) {
+        return it->second;
+    }
+    std::string name = SymbolizeAddress(addr);
+    size_t pos = name.rfind("+0x");
+    if(pos != std::string::npos && pos > 0) {
+        name.resize(pos);
+    }
+    for(auto& c : name) {
+        if(c == ';') {
+            c = ':';
+        }
+    }
+    cache[addr] = name;
+    return name;
+}
+
+void FiberProfiler::Stop(std::ostream& os) {
+    Mutex::Lock lock(GetProfilerMutex());
+    if(!s_profile_running) {
+        return;
+    }
+    struct itimerval tv;
+    memset(&tv, 0, sizeof(tv));
+    setitimer(ITIMER_PROF, &tv, nullptr);
+    s_profile_running = false;
+    while(s_profile_in_handler.load(std::memory_order_seq_cst)) {
+        sched_yield();
+    }
+
+    size_t next = s_profile_next;
+    size_t count = std::min(next, s_profile_max);
+    Stats stats;
+    stats.samples = count;
+    stats.skipped = s_profile_skipped;
+    stats.dropped = next - count;
+
+    // 先按地址合并再符号化，符号化比较慢
+    std::map<std::vector<void*>, uint64_t> stacks;
+    for(size_t i = 0; i < count; ++i) {
+        ProfileSample& sample = s_profile_samples[i];
+        int depth = sample.depth.load(std::memory_order_acquire);
+        // 跳过信号处理函数和信号返回的那两层
+        if(depth <= 2) {
+            continue;
+        }
+        ++stacks[std::vector<void*>(sample.frames + 2, sample.frames + depth)];
+    }
+
+    std::map<void*, std::string> names;
+    std::map<std::string, uint64_t> folded;
+    for(auto& i : stacks) {
+        std::string line;
+        for(auto it = i.first.rbegin(); it != i.first.rend(); ++it) {
+            if(!line.empty()) {
+                line += ";";
+            }
+            line += ProfileFrameName(*it, names);
+        }
+        folded[line] += i.second;
+    }
+    for(auto& i : folded) {
+        os << i.first << " " << i.second << "\n";
+    }
+
+    delete[] s_profile_samples;
+    s_profile_samples = nullptr;
+    s_profile_max = 0;
+    s_profile_last_stats = stats;
+}
+
+std::string FiberProfiler::Stop() {
+    std::stringstream ss;
+    Stop(ss);
+    return ss.str();
+}
+
+bool FiberProfiler::IsRunning() {
+    return s_profile_running;
+}
+
+FiberProfiler::Stats FiberProfiler::GetLastStats() {
+    Mutex::Lock lock(GetProfilerMutex());
+    return s_profile_last_stats;
+}
+
+}
@@ -0,0 +1,59 @@
+/**
+ * @file profiler.h
+ * @brief 协程栈的采样profiler
+ * @details 用ITIMER_PROF按进程消耗的cpu时间定时发SIGPROF, 信号处理函数只在协程上的时候抓调用栈,
+ *          存进开始时分配好的样本数组里; 停止后把相同的栈合并,
+ *          输出flamegraph.pl能直接用的folded格式
+ */
+#ifndef __SYLAR_PROFILER_H__
+#define __SYLAR_PROFILER_H__
+
+#include <iostream>
+#include <string>
+#include <stdint.h>
+
+namespace sylar {
+
+/**
+ * @brief 协程栈采样, 整个进程同一时间只能有一次
+ */
+class FiberProfiler {
+public:
+    /**
+     * @brief 一次采样的统计
+     */
+    struct Stats {
+        /// 抓到的栈
+        uint64_t samples = 0;
+        /// 触发时不在协程上, 跳过的
+        uint64_t skipped = 0;
+        /// 样本数组满了丢掉的
+        uint64_t dropped = 0;
+    };
+
+    /**
+     * @brief 开始采样
+     * @param[in] hz 每秒cpu时间采多少次
+     * @param[in] max_samples 最多保存的样本数
+     * @return 已经在采样或者设置定时器失败返回false
+     */
+    static bool Start(uint32_t hz = 99, size_t max_samples = 10000);
+
+    /**
+     * @brief 停止采样, 输出folded格式
+     * @details 每行是"根函数;...;叶子函数 次数", 没在采样时什么都不输出
+     */
+    static void Stop(std::ostream& os);
+    static std::string Stop();
+
+    static bool IsRunning();
+
+    /**
+     * @brief 最近一次Stop时的统计
+     */
+    static Stats GetLastStats();
+};
+
+}
+
+#endif
@@ -2,6 +2,16 @@
 #include "log.h"
 #include "macro.h"
 #include "hook.h"
+#include "config.h"
+#include "util.h"
+#include <algorithm>
+#include <errno.h>
+#include <execinfo.h>
+#include <fstream>
+#include <sched.h>
+#include <signal.h>
+#include <sstream>
+#include <string.h>
 
 namespace sylar {
 extern Fiber thread_local *t_fiber;
@@ -14,8 +24,222 @@ static thread_local Scheduler* t_scheduler = nullptr;
 // 因此才需要用t_scheduler_fiber来保存这个线程最开始的fiber
 static thread_local Fiber* t_scheduler_fiber = nullptr;
 
+// 所有调度器任务队列锁共用的竞争统计
+static LockStats s_scheduler_lock_stats("scheduler");
+
+static std::atomic<uint32_t> s_scheduler_next_id(0);
+
+// 调度器名字 -> cpu列表，第i个工作线程绑到列表里第i%n个cpu上，没配置的不绑
+static ConfigVar<std::map<std::string, std::string> >::ptr g_scheduler_affinity =
+    Config::Lookup("scheduler.affinity", std::map<std::string, std::string>()
+            , "scheduler worker cpu binding, name: cpu list like 0-3,8");
+
+// 卡住的任务: 一个任务切进去后超过阈值还没切出来，多半是在协程里做了阻塞调用或者死循环
+// 看门狗线程定期扫所有工作线程，发现卡住的就给那个线程发SIGURG，信号处理函数在那个线程上
+// 把调用栈抓到WorkerState里，看门狗再符号化打日志；每个任务只报一次
+static ConfigVar<uint64_t>::ptr g_slow_task_threshold =
+    Config::Lookup("scheduler.slow_task_threshold", (uint64_t)0
+            , "log backtrace of tasks running longer than this without yielding, ms, 0 disables");
+
+static std::atomic<uint64_t> s_slow_task_threshold = {0};
+
+namespace {
+
+struct WorkerState {
+    static const int MAX_FRAMES = 64;
+    // 抓栈的状态
+    enum {
+        BT_IDLE = -1,
+        BT_REQUESTED = -2
+    };
+
+    pthread_t thread;
+    pid_t tid;
+    std::string scheduler;
+    Counter::ptr slowTasks;
+    // 当前任务切进去的时间，0表示没在跑任务
+    std::atomic<uint64_t> taskBeginUs = {0};
+    // 每切进去一次加一，看门狗用来区分是不是同一次
+    std::atomic<uint64_t> taskSeq = {0};
+    std::atomic<uint64_t> fiberId = {0};
+    // 以下只有看门狗和信号处理函数用
+    uint64_t reportedSeq = 0;
+    std::atomic<int> btSize = {BT_IDLE};
+    void* bt[MAX_FRAMES];
+};
+
+}
+
+static thread_local WorkerState* t_worker_state = nullptr;
+
+static Mutex& GetWorkerStatesMutex() {
+    static Mutex* s_mutex = new Mutex;
+    return *s_mutex;
+}
+
+// 故意不释放，工作线程可能在静态析构之后才退出
+static std::vector<WorkerState*>& GetWorkerStates() {
+    static std::vector<WorkerState*>* s_states = new std::vector<WorkerState*>;
+    return *s_states;
+}
+
+static struct sigaction s_old_slow_task_action;
+
+static void SlowTaskSignalHandler(int sig, siginfo_t* info, void* ctx) {
+    int saved_errno = errno;
+    WorkerState* state = t_worker_state;
+    int expected = WorkerState::BT_REQUESTED;
+    if(state && state->btSize.load(std::memory_order_acquire) == expected) {
+        int n = ::backtrace(state->bt, WorkerState::MAX_FRAMES);
+        state->btSize.store(n, std::memory_order_release);
+    }
+    errno = saved_errno;
+    // 别人也装了SIGURG的处理函数就接着调
+    if(s_old_slow_task_action.sa_flags & SA_SIGINFO) {
+        if(s_old_slow_task_action.sa_sigaction) {
+            s_old_slow_task_action.sa_sigaction(sig, info, ctx);
+        }
+    } else if(s_old_slow_task_action.sa_handler != SIG_DFL
+            && s_old_slow_task_action.sa_handler != SIG_IGN) {
+        s_old_slow_task_action.sa_handler(sig);
+    }
+}
+
+static void CheckSlowTasks(uint64_t threshold_ms) {
+    Mutex::Lock lock(GetWorkerStatesMutex());
+    uint64_t now = GetCurrentUS();
+    std::vector<WorkerState*> stalled;
+    for(auto state : GetWorkerStates()) {
+        uint64_t begin = state->taskBeginUs.load(std::memory_order_acquire);
+        uint64_t seq = state->taskSeq.load(std::memory_order_acquire);
+        if(!begin || now < begin + threshold_ms * 1000 || seq == state->reportedSeq) {
+            continue;
+        }
+        state->reportedSeq = seq;
+        state->slowTasks->add();
+        state->btSize.store(WorkerState::BT_REQUESTED, std::memory_order_release);
+        if(pthread_kill(state->thread, SIGURG)) {
+            state->btSize.store(WorkerState::BT_IDLE, std::memory_order_relaxed);
+        }
+        stalled.push_back(state);
+    }
+
+    // 持着锁等，工作线程退出前要拿这个锁摘掉自己，WorkerState不会被释放
+    for(auto state : stalled) {
+        uint64_t wait_until = GetCurrentMS() + 50;
+        while(state->btSize.load(std::memory_order_acquire) == WorkerState::BT_REQUESTED
+                && GetCurrentMS() < wait_until) {
+            usleep(1000);
+        }
+        int n = state->btSize.exchange(WorkerState::BT_IDLE, std::memory_order_acquire);
+        std::stringstream ss;
+        ss << "slow task scheduler=" << state->scheduler << " thread=" << state->tid
+           << " fiber=" << state->fiberId.load(std::memory_order_relaxed)
+           << " running " << (now - state->taskBeginUs.load(std::memory_order_relaxed)) / 1000
+           << "ms without yielding";
+        if(n > 0 && state->taskSeq.load(std::memory_order_acquire) == state->reportedSeq) {
+            // 跳过信号处理函数和信号返回的那两层
+            ss << "\n" << BacktraceToString(state->bt, n, 2, "    ");
+        } else {
+            ss << ", backtrace not captured";
+        }
+        SYLAR_LOG_WARN(scheduler_logger) << ss.str();
+    }
+}
+
+static void StartSlowTaskWatchdog() {
+    static std::atomic<bool> s_started = {false};
+    if(s_started.exchange(true)) {
+        return;
+    }
+    // 先调一次backtrace，第一次调用会加载libgcc，不能发生在信号处理函数里
+    void* bt[1];
+    ::backtrace(bt, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = SlowTaskSignalHandler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGURG, &sa, &s_old_slow_task_action);
+
+    // 跟进程同生命周期，不join
+    static Thread::ptr s_watchdog(new Thread([]() {
+        while(true) {
+            uint64_t threshold = s_slow_task_threshold;
+            if(!threshold) {
+                usleep(100 * 1000);
+                continue;
+            }
+            usleep(std::max<uint64_t>(threshold / 2, 1) * 1000);
+            CheckSlowTasks(threshold);
+        }
+    }, "slow_task_dog"));
+}
+
+struct _SlowTaskIniter {
+    _SlowTaskIniter() {
+        s_slow_task_threshold = g_slow_task_threshold->getValue();
+        if(s_slow_task_threshold) {
+            StartSlowTaskWatchdog();
+        }
+        g_slow_task_threshold->addListener([](const uint64_t& old_value, const uint64_t& new_value){
+            s_slow_task_threshold = new_value;
+            if(new_value) {
+                StartSlowTaskWatchdog();
+            }
+        });
+    }
+};
+static _SlowTaskIniter s_slow_task_initer;
+
+namespace {
+
+// 工作线程在run里登记，退出run时摘掉
+class WorkerStateGuard {
+public:
+    WorkerStateGuard(const std::string& scheduler, Counter::ptr slow_tasks) {
+        m_state = new WorkerState;
+        m_state->thread = pthread_self();
+        m_state->tid = GetThreadId();
+        m_state->scheduler = scheduler;
+        m_state->slowTasks = slow_tasks;
+        Mutex::Lock lock(GetWorkerStatesMutex());
+        GetWorkerStates().push_back(m_state);
+        m_prev = t_worker_state;
+        t_worker_state = m_state;
+    }
+
+    ~WorkerStateGuard() {
+        t_worker_state = m_prev;
+        {
+            Mutex::Lock lock(GetWorkerStatesMutex());
+            auto& states = GetWorkerStates();
+            states.erase(std::find(states.begin(), states.end(), m_state));
+        }
+        delete m_state;
+    }
+
+    void begin(uint64_t now, uint64_t fiber_id) {
+        m_state->fiberId.store(fiber_id, std::memory_order_relaxed);
+        m_state->taskSeq.fetch_add(1, std::memory_order_relaxed);
+        m_state->taskBeginUs.store(now, std::memory_order_release);
+    }
+
+    void end() {
+        m_state->taskBeginUs.store(0, std::memory_order_release);
+    }
+private:
+    WorkerState* m_state;
+    WorkerState* m_prev;
+};
+
+}
+
 Scheduler::Scheduler(size_t threads, bool use_caller, const std::string &name)
-    :m_name(name){
+    :m_mutex(&s_scheduler_lock_stats)
+    ,m_name(name)
+    ,m_id(++s_scheduler_next_id){
     SYLAR_ASSERT(threads > 0);
     // use_caller决定调度器所在的线程本身是否参与任务的执行
     if(use_caller) {
@@ -33,9 +257,44 @@ Scheduler::Scheduler(size_t threads, bool use_caller, const std::string &name)
         m_rootThread = -1;
     }
     m_threadCount = threads;
+
+    m_tasksMetric.reset(new Counter);
+    m_switchesMetric.reset(new Counter);
+    m_idleUsMetric.reset(new Counter);
+    m_queueWaitMetric.reset(new Histogram);
+    m_runTimeMetric.reset(new Histogram);
+    m_slowTasksMetric.reset(new Counter);
+    MetricsRegistry::Labels labels = getMetricLabels();
+    MetricsRegistry* metrics = MetricsMgr::GetInstance();
+    metrics->add("sylar_scheduler_queue_depth", labels, "Tasks waiting in the scheduler queue."
+            , std::make_shared<CallbackMetric>(Metric::GAUGE, [this]() {
+                MutexType::Lock lock(m_mutex);
+                return (double)m_fibers.size();
+            }), this);
+    metrics->add("sylar_scheduler_active_threads", labels, "Worker threads running a task."
+            , std::make_shared<CallbackMetric>(Metric::GAUGE, [this]() {
+                return (double)m_activeThreadCount;
+            }), this);
+    metrics->add("sylar_scheduler_tasks_total", labels, "Tasks executed.", m_tasksMetric, this);
+    metrics->add("sylar_scheduler_context_switches_total", labels, "Switches into task fibers."
+            , m_switchesMetric, this);
+    metrics->add("sylar_scheduler_idle_microseconds_total", labels, "Time worker threads spent in idle."
+            , m_idleUsMetric, this);
+    metrics->add("sylar_scheduler_queue_wait_microseconds", labels
+            , "Time tasks waited in the queue before running.", m_queueWaitMetric, this);
+    metrics->add("sylar_scheduler_run_microseconds", labels
+            , "Time a task ran each time it was switched in.", m_runTimeMetric, this);
+    metrics->add("sylar_scheduler_slow_tasks_total", labels
+            , "Tasks that ran longer than scheduler.slow_task_threshold without yielding."
+            , m_slowTasksMetric, this);
+}
+
+MetricsRegistry::Labels Scheduler::getMetricLabels() const {
+    return {{"scheduler", m_name}, {"instance", std::to_string(m_id)}};
 }
 
 Scheduler::~Scheduler(){
+    MetricsMgr::GetInstance()->remove(this);
     SYLAR_ASSERT(m_stopping);
     if(GetThis() == this) {
         t_scheduler = nullptr;
@@ -60,13 +319,34 @@ void Scheduler::start(){
     SYLAR_ASSERT(m_threads.empty());
 
     m_threads.resize(m_threadCount);
+    std::vector<int> cpus;
+    auto affinity = g_scheduler_affinity->getValue();
+    auto it = affinity.find(m_name);
+    if(it != affinity.end() && !ParseCpuList(it->second, cpus)) {
+        SYLAR_LOG_ERROR(scheduler_logger) << "scheduler " << m_name << " invalid affinity " << it->second;
+        cpus.clear();
+    }
+
+    // 先把线程全部创建出来，再统一等它们拿到线程id，不用一个个地握手
+    for(size_t i = 0; i<m_threadCount; i++) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        m_threads[i].reset(new Thread(std::bind(&Scheduler::run, this), m_name+"_"+std::to_string(i), &m_startSem, cpu));
+    }
+    for(size_t i = 0; i<m_threadCount; i++) {
+        m_startSem.wait();
+    }
     for(size_t i = 0; i<m_threadCount; i++) {
-        m_threads[i].reset(new Thread(std::bind(&Scheduler::run, this), m_name+"_"+std::to_string(i)));
         m_threadIds.push_back(m_threads[i]->getId());
     }
     
     lock.unlock();
 
+    if(!cpus.empty()) {
+        std::stringstream ss;
+        dumpPlacement(ss);
+        SYLAR_LOG_INFO(scheduler_logger) << "scheduler " << m_name << " placement:\n" << ss.str();
+    }
+
     // 为了效率考虑，使用use_caller的这个线程不适用swapIn和swapOut，不然每次都需要专门if判断要swap的Fiber是不是use_caller线程的Fiber
     // 专门设计了call和back两个函数，就不需要使用swapIn和swapOut了
     // if(m_rootFiber) {
@@ -74,6 +354,70 @@ void Scheduler::start(){
     // }
 }
 
+static std::string FormatCpuSet(const cpu_set_t &set) {
+    std::stringstream ss;
+    int first = -1;
+    for(int i = 0; i <= CPU_SETSIZE; ++i) {
+        bool in = i < CPU_SETSIZE && CPU_ISSET(i, &set);
+        if(in && first < 0) {
+            first = i;
+        } else if(!in && first >= 0) {
+            if(ss.tellp() > 0) {
+                ss << ",";
+            }
+            ss << first;
+            if(i - 1 > first) {
+                ss << "-" << i - 1;
+            }
+            first = -1;
+        }
+    }
+    return ss.str();
+}
+
+// /proc/self/task/<tid>/stat的第39个字段是最近运行的cpu
+static int GetLastCpu(pid_t tid) {
+    std::ifstream ifs("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string line;
+    if(!std::getline(ifs, line)) {
+        return -1;
+    }
+    size_t pos = line.rfind(')');
+    if(pos == std::string::npos) {
+        return -1;
+    }
+    std::stringstream ss(line.substr(pos + 1));
+    std::string field;
+    for(int i = 3; i <= 39; ++i) {
+        if(!(ss >> field)) {
+            return -1;
+        }
+    }
+    return atoi(field.c_str());
+}
+
+std::ostream &Scheduler::dumpPlacement(std::ostream &os) {
+    std::vector<Thread::ptr> thrs;
+    {
+        MutexType::Lock lock(m_mutex);
+        thrs = m_threads;
+    }
+    for(auto &i : thrs) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        std::string allowed = sched_getaffinity(i->getId(), sizeof(set), &set) == 0
+                                ? FormatCpuSet(set) : "?";
+        int last = GetLastCpu(i->getId());
+        os << i->getName() << " tid=" << i->getId()
+           << " bind=" << i->getCpu()
+           << " allowed=" << allowed
+           << " last_cpu=" << last
+           << " node=" << (last >= 0 ? GetCpuNumaNode(last) : -1)
+           << std::endl;
+    }
+    return os;
+}
+
 void Scheduler::stop(){
     m_autoStop = true;
     if(m_rootFiber && m_threadCount == 0 &&( (m_rootFiber->getState() == Fiber::TERM) || (m_rootFiber->getState() == Fiber::INIT))){
@@ -141,7 +485,8 @@ void Scheduler::tickle() {
 
 bool Scheduler::stopping() {
     MutexType::Lock lock(m_mutex);
-    return m_autoStop && m_stopping && m_fibers.empty() && m_activeThreadCount == 0;
+    return m_autoStop && m_stopping && m_fibers.empty() && m_activeThreadCount == 0
+        && m_externalWaitCount == 0;
 }
 
 void Scheduler::run() {
@@ -155,6 +500,7 @@ void Scheduler::run() {
 
     Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this)));
     Fiber::ptr cb_fiber;
+    WorkerStateGuard worker(m_name, m_slowTasksMetric);
 
     FiberAndThread ft;
     while(true) {
@@ -189,14 +535,23 @@ void Scheduler::run() {
             tickle();
         }
 
+        uint64_t begin = 0;
+        if(ft.fiber || ft.cb) {
+            begin = GetCurrentUS();
+            m_queueWaitMetric->record(begin > ft.enqueueUs ? begin - ft.enqueueUs : 0);
+        }
+
         if(ft.fiber && (ft.fiber->getState() != Fiber::State::TERM && ft.fiber->getState() != Fiber::State::EXCEPTION)) {
-            ft.fiber->swapIn();
+            m_tasksMetric->add();
+            m_switchesMetric->add();
+            worker.begin(begin, ft.fiber->GetId());
+            Fiber::State state = ft.fiber->swapIn();
+            worker.end();
+            m_runTimeMetric->record(GetCurrentUS() - begin);
             --m_activeThreadCount;
-            
-            if(ft.fiber->getState() == Fiber::READY) {
+
+            if(state == Fiber::READY) {
                 schedule(ft.fiber);
-            } else if(ft.fiber->getState() != Fiber::State::TERM && ft.fiber->getState() != Fiber::State::EXCEPTION){
-                ft.fiber->m_state = Fiber::HOLD;
             }
             ft.reset();
         } else if(ft.cb) {
@@ -206,15 +561,20 @@ void Scheduler::run() {
                 cb_fiber.reset(new Fiber(ft.cb));
             }
             ft.reset();
-            cb_fiber->swapIn();
+            m_tasksMetric->add();
+            m_switchesMetric->add();
+            worker.begin(begin, cb_fiber->GetId());
+            Fiber::State state = cb_fiber->swapIn();
+            worker.end();
+            m_runTimeMetric->record(GetCurrentUS() - begin);
             --m_activeThreadCount;
-            if(cb_fiber->getState() == Fiber::READY) {
+            if(state == Fiber::READY) {
                 schedule(cb_fiber);
                 cb_fiber.reset();
-            } else if(cb_fiber->getState() == Fiber::State::EXCEPTION || cb_fiber->getState() == Fiber::State::TERM) {
+            } else if(state == Fiber::State::EXCEPTION || state == Fiber::State::TERM) {
                 cb_fiber->reset(nullptr);
             } else {
-                cb_fiber->m_state = Fiber::HOLD;
+                // 已经挂起，可能正被别的线程唤醒，不能再复用
                 cb_fiber.reset();
             }
         } else {
@@ -228,11 +588,10 @@ void Scheduler::run() {
                 break;
             }
             m_idleThreadCount++;
+            uint64_t idle_begin = GetCurrentUS();
             idle_fiber->swapIn();
+            m_idleUsMetric->add(GetCurrentUS() - idle_begin);
             m_idleThreadCount--;
-            if(idle_fiber->getState() != Fiber::State::TERM && idle_fiber->getState() != Fiber::State::EXCEPTION){
-                idle_fiber->m_state = Fiber::HOLD;
-            }
         }
     }
 }
@@ -5,25 +5,40 @@
 #include "fiber.h"
 #include <list>
 #include <vector>
+#include <atomic>
 #include "thread.h"
+#include "metrics.h"
+#include "util.h"
 
 namespace sylar {
 
 class Scheduler {
 public:
     typedef std::shared_ptr<Scheduler> ptr;
-    typedef Mutex MutexType;
+    typedef AdaptiveMutex MutexType;
 
     Scheduler(size_t threads = 1, bool use_caller = true, const std::string &name = "");
     virtual ~Scheduler();
 
     const std::string &getName() const { return m_name; }
+    // 进程内唯一的编号，同名的调度器靠它区分指标
+    uint32_t getId() const { return m_id; }
+    MetricsRegistry::Labels getMetricLabels() const;
+    // 参与调度的线程id，start之后才完整，可以作为schedule的thread参数
+    const std::vector<int> &getThreadIds() const { return m_threadIds; }
+
+    // 挂起等别的线程(比如FileIOPool)调度回来的协程，没有fd事件和定时器撑着，stop时要单独等它们
+    void addExternalWait() { ++m_externalWaitCount; }
+    void doneExternalWait() { --m_externalWaitCount; }
 
     static Scheduler *GetThis();
     static Fiber *GetMainFiber();
 
     void start();
     void stop();
+
+    // 输出每个工作线程配置的cpu、允许运行的cpu、最近运行的cpu和NUMA节点
+    std::ostream &dumpPlacement(std::ostream &os);
     template<class FiberOrCb>
     void schedule(FiberOrCb fc, int thread = -1) {
         bool need_tickle = false;
@@ -67,6 +82,7 @@ private:
         bool need_tickle = m_fibers.empty();
         FiberAndThread ft(fc, thread);
         if(ft.fiber || ft.cb) {
+            ft.enqueueUs = GetCurrentUS();
             m_fibers.push_back(ft);
         }
         return need_tickle;
@@ -76,6 +92,8 @@ private:
         Fiber::ptr fiber;
         std::function<void()> cb;
         int thread;
+        // 入队的时间，出队时算排队等了多久
+        uint64_t enqueueUs = 0;
 
         FiberAndThread(Fiber::ptr f, int thr)
             :fiber(f), thread(thr) {}
@@ -103,6 +121,7 @@ private:
             fiber = nullptr;
             cb = nullptr;
             thread = -1;
+            enqueueUs = 0;
         }
     };
 
@@ -113,12 +132,26 @@ private:
     // std::map<int, std::list<FiberAndThread>> m_threadFibers;
     Fiber::ptr m_rootFiber;
     std::string m_name;
+    uint32_t m_id;
+    // 工作线程启动完成的通知，start里一起等
+    Semaphore m_startSem;
+    // 执行的任务数、协程切换次数、idle里待的时间
+    Counter::ptr m_tasksMetric;
+    Counter::ptr m_switchesMetric;
+    Counter::ptr m_idleUsMetric;
+    // 任务排队等待的时间、每次切进去跑的时间，微秒
+    Histogram::ptr m_queueWaitMetric;
+    Histogram::ptr m_runTimeMetric;
+    // 超过scheduler.slow_task_threshold还没切出来的次数
+    Counter::ptr m_slowTasksMetric;
 
 protected:
     std::vector<int> m_threadIds;
     size_t m_threadCount = 0;
-    size_t m_activeThreadCount = 0;
-    size_t m_idleThreadCount = 0;
+    // 加是在锁里，减在锁外，要用原子变量
+    std::atomic<size_t> m_activeThreadCount = {0};
+    std::atomic<size_t> m_idleThreadCount = {0};
+    std::atomic<size_t> m_externalWaitCount = {0};
     bool m_stopping = true;
     bool m_autoStop = false;
     int m_rootThread = 0;
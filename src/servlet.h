@@ -0,0 +1,150 @@
+/**
+ * @file servlet.h
+ * @brief HTTP请求处理和按路径分发
+ */
+#ifndef __SYLAR_SERVLET_H__
+#define __SYLAR_SERVLET_H__
+
+#include <memory>
+#include <functional>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "http.h"
+#include "http_session.h"
+#include "thread.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief Servlet封装
+ */
+class Servlet {
+public:
+    typedef std::shared_ptr<Servlet> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] name 名称
+     */
+    Servlet(const std::string& name)
+        :m_name(name) {}
+
+    virtual ~Servlet() {}
+
+    /**
+     * @brief 处理请求
+     * @param[in] request HTTP请求
+     * @param[in] response HTTP响应
+     * @param[in] session HTTP连接
+     * @return 是否处理成功
+     */
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session) = 0;
+
+    /**
+     * @brief 返回Servlet名称
+     */
+    const std::string& getName() const { return m_name;}
+protected:
+    /// 名称
+    std::string m_name;
+};
+
+/**
+ * @brief 函数式Servlet
+ */
+class FunctionServlet : public Servlet {
+public:
+    typedef std::shared_ptr<FunctionServlet> ptr;
+    /// 函数回调类型定义
+    typedef std::function<int32_t (sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session)> callback;
+
+    /**
+     * @brief 构造函数
+     * @param[in] cb 回调函数
+     */
+    FunctionServlet(callback cb);
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session) override;
+private:
+    /// 回调函数
+    callback m_cb;
+};
+
+/**
+ * @brief Servlet分发器
+ * @details 先精确匹配路径, 再按添加顺序做通配(fnmatch)匹配, 都没有就交给默认Servlet
+ */
+class ServletDispatch : public Servlet {
+public:
+    typedef std::shared_ptr<ServletDispatch> ptr;
+    typedef ShardedRWMutex RWMutexType;
+
+    ServletDispatch();
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session) override;
+
+    /**
+     * @brief 添加精确匹配的servlet
+     */
+    void addServlet(const std::string& uri, Servlet::ptr slt);
+    void addServlet(const std::string& uri, FunctionServlet::callback cb);
+
+    /**
+     * @brief 添加模糊匹配的servlet
+     * @param[in] uri 模糊匹配 /sylar_*
+     */
+    void addGlobServlet(const std::string& uri, Servlet::ptr slt);
+    void addGlobServlet(const std::string& uri, FunctionServlet::callback cb);
+
+    void delServlet(const std::string& uri);
+    void delGlobServlet(const std::string& uri);
+
+    Servlet::ptr getDefault() const { return m_default;}
+    void setDefault(Servlet::ptr v) { m_default = v;}
+
+    Servlet::ptr getServlet(const std::string& uri);
+    Servlet::ptr getGlobServlet(const std::string& uri);
+
+    /**
+     * @brief 通过uri获取servlet, 优先精确匹配, 其次模糊匹配, 最后返回默认
+     */
+    Servlet::ptr getMatchedServlet(const StringPiece& uri);
+private:
+    /// 读写互斥量
+    RWMutexType m_mutex;
+    /// 精准匹配servlet MAP
+    std::unordered_map<std::string, Servlet::ptr> m_datas;
+    /// 模糊匹配servlet 数组
+    std::vector<std::pair<std::string, Servlet::ptr> > m_globs;
+    /// 默认servlet，所有路径都没匹配到时使用
+    Servlet::ptr m_default;
+};
+
+/**
+ * @brief NotFoundServlet(默认返回404)
+ */
+class NotFoundServlet : public Servlet {
+public:
+    typedef std::shared_ptr<NotFoundServlet> ptr;
+
+    NotFoundServlet(const std::string& name);
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session) override;
+private:
+    std::string m_name;
+    std::string m_content;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,602 @@
+#include "socket.h"
+#include "IOManager.h"
+#include "fd_manager.h"
+#include "log.h"
+#include "macro.h"
+#include "hook.h"
+#include <limits.h>
+#include <string.h>
+#include <sstream>
+#include <linux/errqueue.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+namespace sylar {
+
+static sylar::Logger::ptr socket_logger = SYLAR_LOG_NAME("system");
+
+Socket::ptr Socket::CreateTCP(sylar::Address::ptr address) {
+    Socket::ptr sock(new Socket(address->getFamily(), TCP, 0));
+    return sock;
+}
+
+Socket::ptr Socket::CreateUDP(sylar::Address::ptr address) {
+    Socket::ptr sock(new Socket(address->getFamily(), UDP, 0));
+    sock->newSock();
+    sock->m_isConnected = true;
+    return sock;
+}
+
+Socket::ptr Socket::CreateTCPSocket() {
+    Socket::ptr sock(new Socket(IPv4, TCP, 0));
+    return sock;
+}
+
+Socket::ptr Socket::CreateUDPSocket() {
+    Socket::ptr sock(new Socket(IPv4, UDP, 0));
+    sock->newSock();
+    sock->m_isConnected = true;
+    return sock;
+}
+
+Socket::ptr Socket::CreateTCPSocket6() {
+    Socket::ptr sock(new Socket(IPv6, TCP, 0));
+    return sock;
+}
+
+Socket::ptr Socket::CreateUDPSocket6() {
+    Socket::ptr sock(new Socket(IPv6, UDP, 0));
+    sock->newSock();
+    sock->m_isConnected = true;
+    return sock;
+}
+
+Socket::ptr Socket::CreateUnixTCPSocket() {
+    Socket::ptr sock(new Socket(UNIX, TCP, 0));
+    return sock;
+}
+
+Socket::ptr Socket::CreateUnixUDPSocket() {
+    Socket::ptr sock(new Socket(UNIX, UDP, 0));
+    return sock;
+}
+
+Socket::Socket(int family, int type, int protocol)
+    :m_sock(-1)
+    ,m_family(family)
+    ,m_type(type)
+    ,m_protocol(protocol)
+    ,m_isConnected(false)
+    ,m_zeroCopy(false)
+    ,m_zcSent(0)
+    ,m_zcDone(0)
+    ,m_zcCopied(0) {
+}
+
+Socket::~Socket() {
+    close();
+}
+
+int64_t Socket::getSendTimeout() {
+    FdCtx *ctx = FdMgr::GetInstance()->get(m_sock);
+    if(ctx) {
+        return ctx->getTimeout(SO_SNDTIMEO);
+    }
+    return -1;
+}
+
+void Socket::setSendTimeout(int64_t v) {
+    struct timeval tv{int(v / 1000), int(v % 1000 * 1000)};
+    setOption(SOL_SOCKET, SO_SNDTIMEO, tv);
+}
+
+int64_t Socket::getRecvTimeout() {
+    FdCtx *ctx = FdMgr::GetInstance()->get(m_sock);
+    if(ctx) {
+        return ctx->getTimeout(SO_RCVTIMEO);
+    }
+    return -1;
+}
+
+void Socket::setRecvTimeout(int64_t v) {
+    struct timeval tv{int(v / 1000), int(v % 1000 * 1000)};
+    setOption(SOL_SOCKET, SO_RCVTIMEO, tv);
+}
+
+bool Socket::getOption(int level, int option, void* result, socklen_t* len) {
+    int rt = getsockopt(m_sock, level, option, result, (socklen_t*)len);
+    if(rt) {
+        SYLAR_LOG_DEBUG(socket_logger) << "getOption sock=" << m_sock
+            << " level=" << level << " option=" << option
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setOption(int level, int option, const void* result, socklen_t len) {
+    // TCP socket是bind/connect时才创建的，像SO_REUSEPORT这种要在bind之前设的选项先把句柄建出来
+    if(!isValid()) {
+        newSock();
+        if(!isValid()) {
+            return false;
+        }
+    }
+    if(setsockopt(m_sock, level, option, result, (socklen_t)len)) {
+        SYLAR_LOG_DEBUG(socket_logger) << "setOption sock=" << m_sock
+            << " level=" << level << " option=" << option
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+Socket::ptr Socket::accept() {
+    Socket::ptr sock(new Socket(m_family, m_type, m_protocol));
+    int newsock = ::accept(m_sock, nullptr, nullptr);
+    if(newsock == -1) {
+        SYLAR_LOG_ERROR(socket_logger) << "accept(" << m_sock << ") errno="
+            << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    if(sock->init(newsock)) {
+        return sock;
+    }
+    return nullptr;
+}
+
+Socket::ptr Socket::tryAccept() {
+    int newsock = accept_f(m_sock, nullptr, nullptr);
+    if(newsock == -1) {
+        return nullptr;
+    }
+    Socket::ptr sock(new Socket(m_family, m_type, m_protocol));
+    if(sock->init(newsock)) {
+        return sock;
+    }
+    return nullptr;
+}
+
+bool Socket::init(int sock) {
+    FdCtx *ctx = FdMgr::GetInstance()->get(sock, true);
+    if(ctx && ctx->isSocket() && !ctx->isClose()) {
+        m_sock = sock;
+        m_isConnected = true;
+        initSock();
+        getLocalAddress();
+        getRemoteAddress();
+        return true;
+    }
+    return false;
+}
+
+bool Socket::bind(const Address::ptr addr) {
+    if(!isValid()) {
+        newSock();
+        if(!isValid()) {
+            return false;
+        }
+    }
+
+    if(addr->getFamily() != m_family) {
+        SYLAR_LOG_ERROR(socket_logger) << "bind sock.family("
+            << m_family << ") addr.family(" << addr->getFamily()
+            << ") not equal, addr=" << addr->toString();
+        return false;
+    }
+
+    UnixAddress::ptr uaddr = std::dynamic_pointer_cast<UnixAddress>(addr);
+    if(uaddr) {
+        // 已经有人在监听就不能抢，否则把残留的socket文件删掉再bind
+        int fd = socket_f(AF_UNIX, SOCK_STREAM, 0);
+        bool in_use = fd != -1 && connect_f(fd, uaddr->getAddr(), uaddr->getAddrLen()) == 0;
+        if(fd != -1) {
+            close_f(fd);
+        }
+        if(in_use) {
+            SYLAR_LOG_ERROR(socket_logger) << "bind " << uaddr->toString() << " already in use";
+            return false;
+        }
+        unlink(uaddr->getPath().c_str());
+    }
+
+    if(::bind(m_sock, addr->getAddr(), addr->getAddrLen())) {
+        SYLAR_LOG_ERROR(socket_logger) << "bind error errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    getLocalAddress();
+    return true;
+}
+
+bool Socket::reconnect(uint64_t timeout_ms) {
+    if(!m_remoteAddress) {
+        SYLAR_LOG_ERROR(socket_logger) << "reconnect m_remoteAddress is null";
+        return false;
+    }
+    m_localAddress.reset();
+    return connect(m_remoteAddress, timeout_ms);
+}
+
+bool Socket::connect(const Address::ptr addr, uint64_t timeout_ms) {
+    m_remoteAddress = addr;
+    if(!isValid()) {
+        newSock();
+        if(!isValid()) {
+            return false;
+        }
+    }
+
+    if(addr->getFamily() != m_family) {
+        SYLAR_LOG_ERROR(socket_logger) << "connect sock.family("
+            << m_family << ") addr.family(" << addr->getFamily()
+            << ") not equal, addr=" << addr->toString();
+        return false;
+    }
+
+    if(timeout_ms == (uint64_t)-1) {
+        if(::connect(m_sock, addr->getAddr(), addr->getAddrLen())) {
+            SYLAR_LOG_ERROR(socket_logger) << "sock=" << m_sock << " connect(" << addr->toString()
+                << ") error errno=" << errno << " errstr=" << strerror(errno);
+            close();
+            return false;
+        }
+    } else {
+        if(::connect_with_timeout(m_sock, addr->getAddr(), addr->getAddrLen(), timeout_ms)) {
+            SYLAR_LOG_ERROR(socket_logger) << "sock=" << m_sock << " connect(" << addr->toString()
+                << ") timeout=" << timeout_ms << " error errno="
+                << errno << " errstr=" << strerror(errno);
+            close();
+            return false;
+        }
+    }
+    m_isConnected = true;
+    getRemoteAddress();
+    getLocalAddress();
+    return true;
+}
+
+bool Socket::listen(int backlog) {
+    if(!isValid()) {
+        SYLAR_LOG_ERROR(socket_logger) << "listen error sock=-1";
+        return false;
+    }
+    if(::listen(m_sock, backlog)) {
+        SYLAR_LOG_ERROR(socket_logger) << "listen error errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::close() {
+    if(!m_isConnected && m_sock == -1) {
+        return true;
+    }
+    m_isConnected = false;
+    if(m_sock != -1) {
+        ::close(m_sock);
+        m_sock = -1;
+    }
+    return true;
+}
+
+int Socket::send(const void* buffer, size_t length, int flags) {
+    if(isConnected()) {
+        return ::send(m_sock, buffer, length, flags);
+    }
+    return -1;
+}
+
+int Socket::sendv(const iovec* buffers, size_t length, int flags) {
+    if(isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec*)buffers;
+        msg.msg_iovlen = length;
+        return ::sendmsg(m_sock, &msg, flags);
+    }
+    return -1;
+}
+
+int Socket::sendTo(const void* buffer, size_t length, const Address::ptr to, int flags) {
+    if(isConnected()) {
+        return ::sendto(m_sock, buffer, length, flags, to->getAddr(), to->getAddrLen());
+    }
+    return -1;
+}
+
+int Socket::sendvTo(const iovec* buffers, size_t length, const Address::ptr to, int flags) {
+    if(isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec*)buffers;
+        msg.msg_iovlen = length;
+        msg.msg_name = to->getAddr();
+        msg.msg_namelen = to->getAddrLen();
+        return ::sendmsg(m_sock, &msg, flags);
+    }
+    return -1;
+}
+
+int Socket::recv(void* buffer, size_t length, int flags) {
+    if(isConnected()) {
+        return ::recv(m_sock, buffer, length, flags);
+    }
+    return -1;
+}
+
+int Socket::recvv(iovec* buffers, size_t length, int flags) {
+    if(isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec*)buffers;
+        msg.msg_iovlen = length;
+        return ::recvmsg(m_sock, &msg, flags);
+    }
+    return -1;
+}
+
+int Socket::recvFrom(void* buffer, size_t length, Address::ptr from, int flags) {
+    if(isConnected()) {
+        socklen_t len = from->getAddrLen();
+        return ::recvfrom(m_sock, buffer, length, flags, from->getAddr(), &len);
+    }
+    return -1;
+}
+
+int Socket::recvvFrom(iovec* buffers, size_t length, Address::ptr from, int flags) {
+    if(isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec*)buffers;
+        msg.msg_iovlen = length;
+        msg.msg_name = from->getAddr();
+        msg.msg_namelen = from->getAddrLen();
+        return ::recvmsg(m_sock, &msg, flags);
+    }
+    return -1;
+}
+
+bool Socket::setZeroCopy(bool v) {
+    if(!isValid()) {
+        newSock();
+    }
+    int val = v ? 1 : 0;
+    if(!setOption(SOL_SOCKET, SO_ZEROCOPY, val)) {
+        m_zeroCopy = false;
+        return false;
+    }
+    m_zeroCopy = v;
+    return true;
+}
+
+int Socket::sendZeroCopy(const void* buffer, size_t length, int flags) {
+    iovec iov;
+    iov.iov_base = (void*)buffer;
+    iov.iov_len = length;
+    return sendvZeroCopy(&iov, 1, flags);
+}
+
+int Socket::sendvZeroCopy(const iovec* buffers, size_t length, int flags) {
+    if(!m_zeroCopy) {
+        return sendv(buffers, length, flags);
+    }
+    int rt = sendv(buffers, length, flags | MSG_ZEROCOPY);
+    // 内核每次成功的MSG_ZEROCOPY发送占一个完成序号
+    if(rt > 0) {
+        ++m_zcSent;
+    } else if(rt < 0 && errno == ENOBUFS) {
+        // 锁定的页超过了optmem限制，先收掉完成通知再用普通send
+        reapZeroCopy();
+        rt = sendv(buffers, length, flags);
+    }
+    return rt;
+}
+
+uint32_t Socket::reapZeroCopy() {
+    if(!m_zeroCopy || !isValid()) {
+        return 0;
+    }
+    uint32_t done = 0;
+    while(true) {
+        char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        // 错误队列不会阻塞，直接用原函数
+        if(recvmsg_f(m_sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+        for(cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool is_recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if(!is_recverr) {
+                continue;
+            }
+            sock_extended_err *serr = (sock_extended_err*)CMSG_DATA(cm);
+            if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            // [ee_info, ee_data] 这一段序号都完成了
+            uint32_t n = serr->ee_data - serr->ee_info + 1;
+            done += n;
+            if(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                m_zcCopied += n;
+            }
+        }
+    }
+    m_zcDone += done;
+    return done;
+}
+
+Address::ptr Socket::getRemoteAddress() {
+    if(m_remoteAddress) {
+        return m_remoteAddress;
+    }
+
+    Address::ptr result;
+    switch(m_family) {
+        case AF_INET:
+            result.reset(new IPv4Address());
+            break;
+        case AF_INET6:
+            result.reset(new IPv6Address());
+            break;
+        case AF_UNIX:
+            result.reset(new UnixAddress());
+            break;
+        default:
+            result.reset(new UnknownAddress(m_family));
+            break;
+    }
+    socklen_t addrlen = result->getAddrLen();
+    if(getpeername(m_sock, result->getAddr(), &addrlen)) {
+        return Address::ptr(new UnknownAddress(m_family));
+    }
+    if(m_family == AF_UNIX) {
+        UnixAddress::ptr addr = std::dynamic_pointer_cast<UnixAddress>(result);
+        addr->setAddrLen(addrlen);
+    }
+    m_remoteAddress = result;
+    return m_remoteAddress;
+}
+
+Address::ptr Socket::getLocalAddress() {
+    if(m_localAddress) {
+        return m_localAddress;
+    }
+
+    Address::ptr result;
+    switch(m_family) {
+        case AF_INET:
+            result.reset(new IPv4Address());
+            break;
+        case AF_INET6:
+            result.reset(new IPv6Address());
+            break;
+        case AF_UNIX:
+            result.reset(new UnixAddress());
+            break;
+        default:
+            result.reset(new UnknownAddress(m_family));
+            break;
+    }
+    socklen_t addrlen = result->getAddrLen();
+    if(getsockname(m_sock, result->getAddr(), &addrlen)) {
+        SYLAR_LOG_ERROR(socket_logger) << "getsockname error sock=" << m_sock
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        return Address::ptr(new UnknownAddress(m_family));
+    }
+    if(m_family == AF_UNIX) {
+        UnixAddress::ptr addr = std::dynamic_pointer_cast<UnixAddress>(result);
+        addr->setAddrLen(addrlen);
+    }
+    m_localAddress = result;
+    return m_localAddress;
+}
+
+bool Socket::isValid() const {
+    return m_sock != -1;
+}
+
+int Socket::getError() {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if(!getOption(SOL_SOCKET, SO_ERROR, &error, &len)) {
+        error = errno;
+    }
+    return error;
+}
+
+std::ostream& Socket::dump(std::ostream& os) const {
+    os << "[Socket sock=" << m_sock
+       << " is_connected=" << m_isConnected
+       << " family=" << m_family
+       << " type=" << m_type
+       << " protocol=" << m_protocol;
+    if(m_localAddress) {
+        os << " local_address=" << m_localAddress->toString();
+    }
+    if(m_remoteAddress) {
+        os << " remote_address=" << m_remoteAddress->toString();
+    }
+    os << "]";
+    return os;
+}
+
+std::string Socket::toString() const {
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+// 先打取消标记再唤醒，被唤醒的IO不会再重试；没有协程在等就把标记撤掉
+static bool CancelEvent(int sock, uint32_t events) {
+    IOManager *iom = IOManager::GetThis();
+    FdCtx *ctx = FdMgr::GetInstance()->get(sock);
+    if(!iom || !ctx) {
+        return false;
+    }
+    bool rt = false;
+    for(uint32_t event : {(uint32_t)IOManager::READ, (uint32_t)IOManager::WRITE}) {
+        if(!(events & event)) {
+            continue;
+        }
+        ctx->setCancelled(event, true);
+        if(iom->cancelEvent(sock, (IOManager::Event)event)) {
+            rt = true;
+        } else {
+            ctx->setCancelled(event, false);
+        }
+    }
+    return rt;
+}
+
+bool Socket::cancelRead() {
+    return CancelEvent(m_sock, IOManager::READ);
+}
+
+bool Socket::cancelWrite() {
+    return CancelEvent(m_sock, IOManager::WRITE);
+}
+
+bool Socket::cancelAccept() {
+    return CancelEvent(m_sock, IOManager::READ);
+}
+
+bool Socket::cancelAll() {
+    return CancelEvent(m_sock, IOManager::READ | IOManager::WRITE);
+}
+
+void Socket::initSock() {
+    int val = 1;
+    setOption(SOL_SOCKET, SO_REUSEADDR, val);
+    if(m_type == SOCK_STREAM && m_family != AF_UNIX) {
+        setOption(IPPROTO_TCP, TCP_NODELAY, val);
+    }
+}
+
+void Socket::newSock() {
+    m_sock = socket(m_family, m_type, m_protocol);
+    if(m_sock != -1) {
+        initSock();
+    } else {
+        SYLAR_LOG_ERROR(socket_logger) << "socket(" << m_family
+            << ", " << m_type << ", " << m_protocol << ") errno="
+            << errno << " errstr=" << strerror(errno);
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const Socket& sock) {
+    return sock.dump(os);
+}
+
+}
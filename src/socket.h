@@ -0,0 +1,402 @@
+/**
+ * @file socket.h
+ * @brief Socket封装
+ */
+#ifndef __SYLAR_SOCKET_H__
+#define __SYLAR_SOCKET_H__
+
+#include <memory>
+#include <netinet/tcp.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "address.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+/**
+ * @brief Socket封装类
+ * @details 在协程里使用时IO走hook, 超时来自FdCtx, 阻塞时只挂起当前协程
+ */
+class Socket : public std::enable_shared_from_this<Socket>, Noncopyable {
+public:
+    typedef std::shared_ptr<Socket> ptr;
+    typedef std::weak_ptr<Socket> weak_ptr;
+
+    /**
+     * @brief Socket类型
+     */
+    enum Type {
+        /// TCP类型
+        TCP = SOCK_STREAM,
+        /// UDP类型
+        UDP = SOCK_DGRAM
+    };
+
+    /**
+     * @brief Socket协议簇
+     */
+    enum Family {
+        /// IPv4 socket
+        IPv4 = AF_INET,
+        /// IPv6 socket
+        IPv6 = AF_INET6,
+        /// Unix socket
+        UNIX = AF_UNIX,
+    };
+
+    /**
+     * @brief 创建和地址协议簇一致的TCP Socket
+     */
+    static Socket::ptr CreateTCP(sylar::Address::ptr address);
+
+    /**
+     * @brief 创建和地址协议簇一致的UDP Socket
+     */
+    static Socket::ptr CreateUDP(sylar::Address::ptr address);
+
+    /**
+     * @brief 创建IPv4的TCP Socket
+     */
+    static Socket::ptr CreateTCPSocket();
+
+    /**
+     * @brief 创建IPv4的UDP Socket
+     */
+    static Socket::ptr CreateUDPSocket();
+
+    /**
+     * @brief 创建IPv6的TCP Socket
+     */
+    static Socket::ptr CreateTCPSocket6();
+
+    /**
+     * @brief 创建IPv6的UDP Socket
+     */
+    static Socket::ptr CreateUDPSocket6();
+
+    /**
+     * @brief 创建Unix的TCP Socket
+     */
+    static Socket::ptr CreateUnixTCPSocket();
+
+    /**
+     * @brief 创建Unix的UDP Socket
+     */
+    static Socket::ptr CreateUnixUDPSocket();
+
+    /**
+     * @brief Socket构造函数
+     * @param[in] family 协议簇
+     * @param[in] type 类型
+     * @param[in] protocol 协议
+     */
+    Socket(int family, int type, int protocol = 0);
+
+    /**
+     * @brief 析构函数, 会关闭socket
+     */
+    virtual ~Socket();
+
+    /**
+     * @brief 获取发送超时时间(毫秒)
+     */
+    int64_t getSendTimeout();
+
+    /**
+     * @brief 设置发送超时时间(毫秒)
+     */
+    void setSendTimeout(int64_t v);
+
+    /**
+     * @brief 获取接收超时时间(毫秒)
+     */
+    int64_t getRecvTimeout();
+
+    /**
+     * @brief 设置接收超时时间(毫秒)
+     */
+    void setRecvTimeout(int64_t v);
+
+    /**
+     * @brief 获取sockopt @see getsockopt
+     */
+    bool getOption(int level, int option, void* result, socklen_t* len);
+
+    /**
+     * @brief 获取sockopt模板 @see getsockopt
+     */
+    template<class T>
+    bool getOption(int level, int option, T& result) {
+        socklen_t length = sizeof(T);
+        return getOption(level, option, &result, &length);
+    }
+
+    /**
+     * @brief 设置sockopt @see setsockopt
+     */
+    bool setOption(int level, int option, const void* result, socklen_t len);
+
+    /**
+     * @brief 设置sockopt模板 @see setsockopt
+     */
+    template<class T>
+    bool setOption(int level, int option, const T& value) {
+        return setOption(level, option, &value, sizeof(T));
+    }
+
+    /**
+     * @brief 接收connect链接
+     * @return 成功返回新连接的socket,失败返回nullptr
+     * @pre Socket必须 bind , listen  成功
+     */
+    virtual Socket::ptr accept();
+
+    /**
+     * @brief 不挂起地接收一个已经在队列里的连接
+     * @return 队列为空或者出错时返回nullptr, 队列为空时errno为EAGAIN
+     */
+    virtual Socket::ptr tryAccept();
+
+    /**
+     * @brief 绑定地址
+     * @param[in] addr 地址
+     * @return 是否绑定成功
+     */
+    virtual bool bind(const Address::ptr addr);
+
+    /**
+     * @brief 连接地址
+     * @param[in] addr 目标地址
+     * @param[in] timeout_ms 超时时间(毫秒), -1表示用tcp.connect.timeout
+     */
+    virtual bool connect(const Address::ptr addr, uint64_t timeout_ms = -1);
+
+    /**
+     * @brief 用上次connect的地址重新连接
+     */
+    virtual bool reconnect(uint64_t timeout_ms = -1);
+
+    /**
+     * @brief 监听socket
+     * @param[in] backlog 未完成连接队列的最大长度
+     * @pre 必须先 bind 成功
+     */
+    virtual bool listen(int backlog = SOMAXCONN);
+
+    /**
+     * @brief 关闭socket
+     */
+    virtual bool close();
+
+    /**
+     * @brief 发送数据
+     * @return
+     *      @retval >0 发送成功对应大小的数据
+     *      @retval =0 socket被关闭
+     *      @retval <0 socket出错
+     */
+    virtual int send(const void* buffer, size_t length, int flags = 0);
+
+    /**
+     * @brief 发送一组分散的buffer(writev语义)
+     * @param[in] buffers iovec数组
+     * @param[in] length iovec数组长度
+     */
+    virtual int sendv(const iovec* buffers, size_t length, int flags = 0);
+
+    /**
+     * @brief 发送数据到指定地址
+     */
+    virtual int sendTo(const void* buffer, size_t length, const Address::ptr to, int flags = 0);
+
+    /**
+     * @brief 发送一组分散的buffer到指定地址
+     */
+    virtual int sendvTo(const iovec* buffers, size_t length, const Address::ptr to, int flags = 0);
+
+    /**
+     * @brief 接收数据
+     * @return
+     *      @retval >0 接收到对应大小的数据
+     *      @retval =0 socket被关闭
+     *      @retval <0 socket出错
+     */
+    virtual int recv(void* buffer, size_t length, int flags = 0);
+
+    /**
+     * @brief 接收数据到一组分散的buffer(readv语义)
+     */
+    virtual int recvv(iovec* buffers, size_t length, int flags = 0);
+
+    /**
+     * @brief 接收数据并返回对端地址
+     */
+    virtual int recvFrom(void* buffer, size_t length, Address::ptr from, int flags = 0);
+
+    /**
+     * @brief 接收数据到一组分散的buffer并返回对端地址
+     */
+    virtual int recvvFrom(iovec* buffers, size_t length, Address::ptr from, int flags = 0);
+
+    /**
+     * @brief 打开/关闭SO_ZEROCOPY
+     * @return 内核不支持时返回false, 之后sendZeroCopy退化成普通send
+     */
+    bool setZeroCopy(bool v);
+
+    /**
+     * @brief 是否启用了SO_ZEROCOPY
+     */
+    bool isZeroCopy() const { return m_zeroCopy; }
+
+    /**
+     * @brief 用MSG_ZEROCOPY发送数据
+     * @details 内核直接引用用户内存, 在reapZeroCopy报告完成之前buffer不能修改或释放
+     */
+    int sendZeroCopy(const void* buffer, size_t length, int flags = 0);
+
+    /**
+     * @brief 用MSG_ZEROCOPY发送一组分散的buffer
+     */
+    int sendvZeroCopy(const iovec* buffers, size_t length, int flags = 0);
+
+    /**
+     * @brief 非阻塞地读取错误队列里的零拷贝完成通知
+     * @return 本次确认完成的发送次数
+     */
+    uint32_t reapZeroCopy();
+
+    /**
+     * @brief 还没确认完成的零拷贝发送次数
+     */
+    uint32_t getZeroCopyPending() const { return m_zcSent - m_zcDone; }
+
+    /**
+     * @brief 完成通知里内核退化成拷贝的次数(比如走loopback)
+     */
+    uint32_t getZeroCopyCopied() const { return m_zcCopied; }
+
+    /**
+     * @brief 获取远端地址
+     */
+    Address::ptr getRemoteAddress();
+
+    /**
+     * @brief 获取本地地址
+     */
+    Address::ptr getLocalAddress();
+
+    /**
+     * @brief 获取协议簇
+     */
+    int getFamily() const { return m_family;}
+
+    /**
+     * @brief 获取类型
+     */
+    int getType() const { return m_type;}
+
+    /**
+     * @brief 获取协议
+     */
+    int getProtocol() const { return m_protocol;}
+
+    /**
+     * @brief 返回是否连接
+     */
+    bool isConnected() const { return m_isConnected;}
+
+    /**
+     * @brief 是否有效(m_sock != -1)
+     */
+    bool isValid() const;
+
+    /**
+     * @brief 返回Socket错误
+     */
+    int getError();
+
+    /**
+     * @brief 输出信息到流中
+     */
+    virtual std::ostream& dump(std::ostream& os) const;
+
+    /**
+     * @brief 返回可读性字符串
+     */
+    virtual std::string toString() const;
+
+    /**
+     * @brief 返回socket句柄
+     */
+    int getSocket() const { return m_sock;}
+
+    /**
+     * @brief 取消读, 正在recv的协程被唤醒并返回错误
+     */
+    bool cancelRead();
+
+    /**
+     * @brief 取消写
+     */
+    bool cancelWrite();
+
+    /**
+     * @brief 取消accept
+     */
+    bool cancelAccept();
+
+    /**
+     * @brief 取消所有事件
+     */
+    bool cancelAll();
+protected:
+    /**
+     * @brief 初始化socket
+     */
+    void initSock();
+
+    /**
+     * @brief 创建socket
+     */
+    void newSock();
+
+    /**
+     * @brief 用已有的句柄初始化(accept得到的)
+     */
+    virtual bool init(int sock);
+private:
+    /// socket句柄
+    int m_sock;
+    /// 协议簇
+    int m_family;
+    /// 类型
+    int m_type;
+    /// 协议
+    int m_protocol;
+    /// 是否连接
+    bool m_isConnected;
+    /// 是否启用SO_ZEROCOPY
+    bool m_zeroCopy;
+    /// MSG_ZEROCOPY发送次数, 和内核的完成序号一一对应
+    uint32_t m_zcSent;
+    /// 已确认完成的次数
+    uint32_t m_zcDone;
+    /// 完成时内核退化成拷贝的次数
+    uint32_t m_zcCopied;
+    /// 本地地址
+    Address::ptr m_localAddress;
+    /// 远端地址
+    Address::ptr m_remoteAddress;
+};
+
+/**
+ * @brief 流式输出socket
+ */
+std::ostream& operator<<(std::ostream& os, const Socket& sock);
+
+}
+
+#endif
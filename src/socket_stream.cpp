@@ -0,0 +1,54 @@
+#include "socket_stream.h"
+
+namespace sylar {
+
+SocketStream::SocketStream(Socket::ptr sock, bool owner)
+    :m_socket(sock)
+    ,m_owner(owner) {
+}
+
+SocketStream::~SocketStream() {
+    if(m_owner && m_socket) {
+        close();
+    }
+}
+
+bool SocketStream::isConnected() const {
+    return m_socket && m_socket->isConnected();
+}
+
+int SocketStream::doReadv(iovec* iov, size_t cnt) {
+    if(!isConnected()) {
+        return -1;
+    }
+    return m_socket->recvv(iov, cnt);
+}
+
+int SocketStream::doWritev(const iovec* iov, size_t cnt) {
+    if(!isConnected()) {
+        return -1;
+    }
+    return m_socket->sendv(iov, cnt);
+}
+
+void SocketStream::doClose() {
+    if(m_socket) {
+        m_socket->close();
+    }
+}
+
+Address::ptr SocketStream::getRemoteAddress() {
+    if(m_socket) {
+        return m_socket->getRemoteAddress();
+    }
+    return nullptr;
+}
+
+Address::ptr SocketStream::getLocalAddress() {
+    if(m_socket) {
+        return m_socket->getLocalAddress();
+    }
+    return nullptr;
+}
+
+}
@@ -0,0 +1,64 @@
+/**
+ * @file socket_stream.h
+ * @brief Socket流
+ */
+#ifndef __SYLAR_SOCKET_STREAM_H__
+#define __SYLAR_SOCKET_STREAM_H__
+
+#include "stream.h"
+#include "socket.h"
+
+namespace sylar {
+
+/**
+ * @brief Socket流, 读写带缓冲, 底层走Socket::recvv/sendv
+ */
+class SocketStream : public BufferedStream {
+public:
+    typedef std::shared_ptr<SocketStream> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] sock Socket类
+     * @param[in] owner 是否完全控制, 是的话析构时flush并关闭socket
+     */
+    SocketStream(Socket::ptr sock, bool owner = true);
+
+    /**
+     * @brief 析构函数
+     */
+    ~SocketStream();
+
+    /**
+     * @brief 返回Socket类
+     */
+    Socket::ptr getSocket() const { return m_socket;}
+
+    /**
+     * @brief 返回是否连接
+     */
+    bool isConnected() const;
+
+    /**
+     * @brief 返回远端地址
+     */
+    Address::ptr getRemoteAddress();
+
+    /**
+     * @brief 返回本地地址
+     */
+    Address::ptr getLocalAddress();
+protected:
+    virtual int doReadv(iovec* iov, size_t cnt) override;
+    virtual int doWritev(const iovec* iov, size_t cnt) override;
+    virtual void doClose() override;
+protected:
+    /// Socket类
+    Socket::ptr m_socket;
+    /// 是否主控
+    bool m_owner;
+};
+
+}
+
+#endif
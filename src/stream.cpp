@@ -0,0 +1,239 @@
+#include "stream.h"
+#include "config.h"
+#include <limits.h>
+#include <string.h>
+
+namespace sylar {
+
+static sylar::ConfigVar<uint32_t>::ptr g_stream_read_buffer_size =
+    sylar::Config::Lookup("stream.read_buffer_size", (uint32_t)(16 * 1024), "stream read-ahead buffer size, 0 means no read-ahead");
+static sylar::ConfigVar<uint32_t>::ptr g_stream_write_buffer_size =
+    sylar::Config::Lookup("stream.write_buffer_size", (uint32_t)(16 * 1024), "stream write coalescing threshold, 0 means no buffering");
+
+int Stream::readFixSize(void* buffer, size_t length) {
+    size_t offset = 0;
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = read((char*)buffer + offset, left);
+        if(len <= 0) {
+            return len;
+        }
+        offset += len;
+        left -= len;
+    }
+    return length;
+}
+
+int Stream::readFixSize(ByteArray::ptr ba, size_t length) {
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = read(ba, left);
+        if(len <= 0) {
+            return len;
+        }
+        left -= len;
+    }
+    return length;
+}
+
+int Stream::writeFixSize(const void* buffer, size_t length) {
+    size_t offset = 0;
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = write((const char*)buffer + offset, left);
+        if(len <= 0) {
+            return len;
+        }
+        offset += len;
+        left -= len;
+    }
+    return length;
+}
+
+int Stream::writeFixSize(ByteArray::ptr ba, size_t length) {
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = write(ba, left);
+        if(len <= 0) {
+            return len;
+        }
+        left -= len;
+    }
+    return length;
+}
+
+BufferedStream::BufferedStream()
+    :m_rpos(0)
+    ,m_rend(0)
+    ,m_writeBufferSize(0)
+    ,m_readCalls(0)
+    ,m_writeCalls(0) {
+    m_rbuf.resize(g_stream_read_buffer_size->getValue());
+    m_writeBufferSize = g_stream_write_buffer_size->getValue();
+    m_wbuf.reset(new ByteArray(m_writeBufferSize));
+}
+
+void BufferedStream::setReadBufferSize(size_t v) {
+    if(m_rpos == m_rend) {
+        m_rpos = m_rend = 0;
+        m_rbuf.resize(v);
+    }
+}
+
+void BufferedStream::setWriteBufferSize(size_t v) {
+    flush();
+    m_writeBufferSize = v;
+    m_wbuf.reset(new ByteArray(v));
+}
+
+int BufferedStream::fill(std::vector<iovec>& iovs, size_t length) {
+    // 要去读fd了，先把攒着的写发出去，不然对端可能一直在等这些数据
+    int rt = flush();
+    if(rt < 0) {
+        return rt;
+    }
+    m_rpos = m_rend = 0;
+    if(length < m_rbuf.size()) {
+        iovec iov;
+        iov.iov_base = &m_rbuf[0];
+        iov.iov_len = m_rbuf.size();
+        iovs.push_back(iov);
+    }
+    int n = doReadv(&iovs[0], iovs.size());
+    ++m_readCalls;
+    if(n <= 0) {
+        return n;
+    }
+    if((size_t)n > length) {
+        m_rend = n - length;
+        n = length;
+    }
+    return n;
+}
+
+int BufferedStream::read(void* buffer, size_t length) {
+    if(length == 0) {
+        return 0;
+    }
+    if(m_rpos < m_rend) {
+        size_t n = std::min(length, m_rend - m_rpos);
+        memcpy(buffer, &m_rbuf[m_rpos], n);
+        m_rpos += n;
+        return n;
+    }
+    std::vector<iovec> iovs;
+    iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = length;
+    iovs.push_back(iov);
+    return fill(iovs, length);
+}
+
+int BufferedStream::read(ByteArray::ptr ba, size_t length) {
+    if(length == 0) {
+        return 0;
+    }
+    if(m_rpos < m_rend) {
+        size_t n = std::min(length, m_rend - m_rpos);
+        ba->write(&m_rbuf[m_rpos], n);
+        m_rpos += n;
+        return n;
+    }
+    std::vector<iovec> iovs;
+    ba->getWriteBuffers(iovs, length);
+    int n = fill(iovs, length);
+    if(n > 0) {
+        ba->setPosition(ba->getPosition() + n);
+    }
+    return n;
+}
+
+int BufferedStream::writevAll(std::vector<iovec>& iovs) {
+    size_t total = 0;
+    for(auto& i : iovs) {
+        total += i.iov_len;
+    }
+    size_t idx = 0;
+    while(idx < iovs.size()) {
+        int n = doWritev(&iovs[idx], std::min(iovs.size() - idx, (size_t)IOV_MAX));
+        ++m_writeCalls;
+        if(n <= 0) {
+            return n;
+        }
+        size_t left = n;
+        while(left > 0 && idx < iovs.size()) {
+            if(left >= iovs[idx].iov_len) {
+                left -= iovs[idx].iov_len;
+                ++idx;
+            } else {
+                iovs[idx].iov_base = (char*)iovs[idx].iov_base + left;
+                iovs[idx].iov_len -= left;
+                left = 0;
+            }
+        }
+        while(idx < iovs.size() && iovs[idx].iov_len == 0) {
+            ++idx;
+        }
+    }
+    return total;
+}
+
+int BufferedStream::writeIov(const iovec* iov, size_t cnt, size_t length) {
+    if(m_wbuf->getSize() + length < m_writeBufferSize) {
+        for(size_t i = 0; i < cnt; ++i) {
+            m_wbuf->write(iov[i].iov_base, iov[i].iov_len);
+        }
+        return length;
+    }
+    // 攒够了，已缓冲的数据和这次的数据一次writev出去，这次的数据不再拷贝
+    std::vector<iovec> iovs;
+    m_wbuf->getReadBuffers(iovs, m_wbuf->getSize(), 0);
+    iovs.insert(iovs.end(), iov, iov + cnt);
+    int rt = writevAll(iovs);
+    m_wbuf->clear();
+    return rt <= 0 ? rt : length;
+}
+
+int BufferedStream::write(const void* buffer, size_t length) {
+    if(length == 0) {
+        return 0;
+    }
+    iovec iov;
+    iov.iov_base = (void*)buffer;
+    iov.iov_len = length;
+    return writeIov(&iov, 1, length);
+}
+
+int BufferedStream::write(ByteArray::ptr ba, size_t length) {
+    if(length == 0) {
+        return 0;
+    }
+    std::vector<iovec> iovs;
+    length = ba->getReadBuffers(iovs, length);
+    if(length == 0) {
+        return 0;
+    }
+    int rt = writeIov(&iovs[0], iovs.size(), length);
+    if(rt > 0) {
+        ba->setPosition(ba->getPosition() + rt);
+    }
+    return rt;
+}
+
+int BufferedStream::flush() {
+    if(m_wbuf->getSize() == 0) {
+        return 0;
+    }
+    std::vector<iovec> iovs;
+    m_wbuf->getReadBuffers(iovs, m_wbuf->getSize(), 0);
+    int rt = writevAll(iovs);
+    m_wbuf->clear();
+    return rt;
+}
+
+void BufferedStream::close() {
+    flush();
+    doClose();
+}
+
+}
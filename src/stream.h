@@ -0,0 +1,196 @@
+/**
+ * @file stream.h
+ * @brief 流接口
+ */
+#ifndef __SYLAR_STREAM_H__
+#define __SYLAR_STREAM_H__
+
+#include <memory>
+#include <vector>
+#include <sys/uio.h>
+#include "bytearray.h"
+
+namespace sylar {
+
+/**
+ * @brief 流结构
+ */
+class Stream {
+public:
+    typedef std::shared_ptr<Stream> ptr;
+
+    /**
+     * @brief 析构函数
+     */
+    virtual ~Stream() {}
+
+    /**
+     * @brief 读数据
+     * @param[out] buffer 接收数据的内存
+     * @param[in] length 接收数据的内存大小
+     * @return
+     *      @retval >0 返回接收到的数据的实际大小
+     *      @retval =0 被关闭
+     *      @retval <0 出现流错误
+     */
+    virtual int read(void* buffer, size_t length) = 0;
+
+    /**
+     * @brief 读数据到ByteArray的当前位置, 读完后position前进
+     */
+    virtual int read(ByteArray::ptr ba, size_t length) = 0;
+
+    /**
+     * @brief 读固定长度的数据
+     * @return 成功返回length, 否则返回出错时read的返回值
+     */
+    virtual int readFixSize(void* buffer, size_t length);
+
+    /**
+     * @brief 读固定长度的数据到ByteArray
+     */
+    virtual int readFixSize(ByteArray::ptr ba, size_t length);
+
+    /**
+     * @brief 写数据
+     * @return
+     *      @retval >0 返回写入的数据的实际大小
+     *      @retval =0 被关闭
+     *      @retval <0 出现流错误
+     */
+    virtual int write(const void* buffer, size_t length) = 0;
+
+    /**
+     * @brief 从ByteArray的当前位置写数据, 写完后position前进
+     */
+    virtual int write(ByteArray::ptr ba, size_t length) = 0;
+
+    /**
+     * @brief 写固定长度的数据
+     * @return 成功返回length, 否则返回出错时write的返回值
+     */
+    virtual int writeFixSize(const void* buffer, size_t length);
+
+    /**
+     * @brief 从ByteArray写固定长度的数据
+     */
+    virtual int writeFixSize(ByteArray::ptr ba, size_t length);
+
+    /**
+     * @brief 把缓冲的写数据发出去
+     * @return 成功返回>=0, 出错返回<0
+     */
+    virtual int flush() { return 0;}
+
+    /**
+     * @brief 关闭流
+     */
+    virtual void close() = 0;
+};
+
+/**
+ * @brief 带读写缓冲的流
+ * @details 读: 缓冲区空时用一次readv同时填调用方的内存和预读缓冲区, 后面的小读直接从缓冲区拿
+ *          写: 小写入先拷进写缓冲区, 攒够stream.write_buffer_size后和本次数据一起writev出去
+ *          写缓冲在这几个时机发出去: 超过阈值, 要真正去读fd之前(协程可能在读上挂起, 对端得先收到请求),
+ *          flush/close
+ *          不是线程安全的, 同一时间只能有一个协程使用
+ */
+class BufferedStream : public Stream {
+public:
+    typedef std::shared_ptr<BufferedStream> ptr;
+
+    /**
+     * @brief 构造函数, 缓冲区大小取stream.read_buffer_size/stream.write_buffer_size
+     */
+    BufferedStream();
+
+    virtual int read(void* buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+    virtual int write(const void* buffer, size_t length) override;
+    virtual int write(ByteArray::ptr ba, size_t length) override;
+    virtual int flush() override;
+
+    /**
+     * @brief 先flush再关闭
+     */
+    virtual void close() override;
+
+    /**
+     * @brief 设置预读缓冲区大小, 0表示不预读, 需要在读之前设置
+     */
+    void setReadBufferSize(size_t v);
+
+    /**
+     * @brief 设置写缓冲阈值, 0表示不缓冲, 会先flush
+     */
+    void setWriteBufferSize(size_t v);
+
+    /**
+     * @brief 预读缓冲里还没被读走的字节数
+     */
+    size_t getReadBuffered() const { return m_rend - m_rpos;}
+
+    /**
+     * @brief 写缓冲里还没发出去的字节数
+     */
+    size_t getWriteBuffered() const { return m_wbuf->getSize();}
+
+    /**
+     * @brief 实际发起的读系统调用次数
+     */
+    uint64_t getReadSyscalls() const { return m_readCalls;}
+
+    /**
+     * @brief 实际发起的写系统调用次数
+     */
+    uint64_t getWriteSyscalls() const { return m_writeCalls;}
+protected:
+    /**
+     * @brief 底层的readv
+     */
+    virtual int doReadv(iovec* iov, size_t cnt) = 0;
+
+    /**
+     * @brief 底层的writev
+     */
+    virtual int doWritev(const iovec* iov, size_t cnt) = 0;
+
+    /**
+     * @brief 底层的关闭
+     */
+    virtual void doClose() = 0;
+private:
+    /**
+     * @brief 把写缓冲和iov一起写出去, 或者在没超过阈值时拷进写缓冲
+     */
+    int writeIov(const iovec* iov, size_t cnt, size_t length);
+
+    /**
+     * @brief 循环writev直到全部写完
+     */
+    int writevAll(std::vector<iovec>& iovs);
+
+    /**
+     * @brief 缓冲区为空时从fd读, 多出来的部分留在预读缓冲区
+     */
+    int fill(std::vector<iovec>& iovs, size_t length);
+private:
+    /// 预读缓冲区
+    std::string m_rbuf;
+    /// 预读缓冲区中未读数据的起止位置
+    size_t m_rpos;
+    size_t m_rend;
+    /// 写缓冲区
+    ByteArray::ptr m_wbuf;
+    /// 写缓冲阈值
+    size_t m_writeBufferSize;
+    /// 读系统调用次数
+    uint64_t m_readCalls;
+    /// 写系统调用次数
+    uint64_t m_writeCalls;
+};
+
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "tcp_server.h"
+#include "config.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::ConfigVar<uint64_t>::ptr g_tcp_server_read_timeout =
+    sylar::Config::Lookup("tcp_server.read_timeout", (uint64_t)(60 * 1000 * 2),
+            "tcp server read timeout");
+static sylar::ConfigVar<uint32_t>::ptr g_tcp_server_accept_batch =
+    sylar::Config::Lookup("tcp_server.accept_batch", (uint32_t)16,
+            "max connections accepted per wakeup");
+static sylar::ConfigVar<bool>::ptr g_tcp_server_reuseport =
+    sylar::Config::Lookup("tcp_server.reuseport", true,
+            "one SO_REUSEPORT listener per accept thread");
+
+static sylar::Logger::ptr tcp_server_logger = SYLAR_LOG_NAME("system");
+
+TcpServer::TcpServer(sylar::IOManager* worker, sylar::IOManager* accept_worker)
+    :m_worker(worker)
+    ,m_acceptWorker(accept_worker)
+    ,m_recvTimeout(g_tcp_server_read_timeout->getValue())
+    ,m_name("sylar/1.0.0")
+    ,m_acceptBatch(g_tcp_server_accept_batch->getValue())
+    ,m_reusePort(g_tcp_server_reuseport->getValue())
+    ,m_isStop(true)
+    ,m_acceptCount(0) {
+    if(m_acceptBatch == 0) {
+        m_acceptBatch = 1;
+    }
+}
+
+TcpServer::~TcpServer() {
+    for(auto& i : m_socks) {
+        i->close();
+    }
+    m_socks.clear();
+}
+
+bool TcpServer::bind(sylar::Address::ptr addr) {
+    std::vector<Address::ptr> addrs;
+    std::vector<Address::ptr> fails;
+    addrs.push_back(addr);
+    return bind(addrs, fails);
+}
+
+Socket::ptr TcpServer::listenOn(Address::ptr addr) {
+    Socket::ptr sock = Socket::CreateTCP(addr);
+    if(m_reusePort) {
+        int val = 1;
+        sock->setOption(SOL_SOCKET, SO_REUSEPORT, val);
+    }
+    if(!sock->bind(addr)) {
+        SYLAR_LOG_ERROR(tcp_server_logger) << "bind fail errno="
+            << errno << " errstr=" << strerror(errno)
+            << " addr=[" << addr->toString() << "]";
+        return nullptr;
+    }
+    if(!sock->listen()) {
+        SYLAR_LOG_ERROR(tcp_server_logger) << "listen fail errno="
+            << errno << " errstr=" << strerror(errno)
+            << " addr=[" << addr->toString() << "]";
+        return nullptr;
+    }
+    return sock;
+}
+
+bool TcpServer::bind(const std::vector<Address::ptr>& addrs
+                        ,std::vector<Address::ptr>& fails) {
+    // unix socket不支持SO_REUSEPORT分片，只建一个
+    size_t shards = m_reusePort ? std::max(m_acceptWorker->getThreadIds().size(), (size_t)1) : 1;
+    for(auto& addr : addrs) {
+        Socket::ptr sock = listenOn(addr);
+        if(!sock) {
+            fails.push_back(addr);
+            continue;
+        }
+        m_socks.push_back(sock);
+        if(addr->getFamily() == AF_UNIX) {
+            continue;
+        }
+        // 端口为0时后面的监听socket要绑到第一个分到的端口上
+        Address::ptr bound = sock->getLocalAddress();
+        for(size_t i = 1; i < shards; ++i) {
+            Socket::ptr shard = listenOn(bound);
+            if(!shard) {
+                fails.push_back(addr);
+                break;
+            }
+            m_socks.push_back(shard);
+        }
+    }
+
+    if(!fails.empty()) {
+        m_socks.clear();
+        return false;
+    }
+
+    for(auto& i : m_socks) {
+        SYLAR_LOG_INFO(tcp_server_logger) << "server bind success: " << *i;
+    }
+    return true;
+}
+
+void TcpServer::startAccept(Socket::ptr sock) {
+    std::vector<std::function<void()> > cbs;
+    while(!m_isStop) {
+        Socket::ptr client = sock->accept();
+        if(!client) {
+            if(!m_isStop) {
+                SYLAR_LOG_ERROR(tcp_server_logger) << "accept errno=" << errno
+                    << " errstr=" << strerror(errno);
+            }
+            continue;
+        }
+        // 一次唤醒之后把队列里已经完成握手的连接都取出来，一次性交给worker
+        cbs.clear();
+        while(true) {
+            client->setRecvTimeout(m_recvTimeout);
+            cbs.push_back(std::bind(&TcpServer::handleClient, shared_from_this(), client));
+            if(cbs.size() >= m_acceptBatch) {
+                break;
+            }
+            client = sock->tryAccept();
+            if(!client) {
+                break;
+            }
+        }
+        m_acceptCount += cbs.size();
+        m_worker->schedule(cbs.begin(), cbs.end());
+    }
+}
+
+bool TcpServer::start() {
+    if(!m_isStop) {
+        return true;
+    }
+    m_isStop = false;
+    // 每个监听socket的accept循环从accept调度器的不同线程上开始
+    const std::vector<int>& threads = m_acceptWorker->getThreadIds();
+    for(size_t i = 0; i < m_socks.size(); ++i) {
+        int thread = threads.empty() ? -1 : threads[i % threads.size()];
+        m_acceptWorker->schedule(std::bind(&TcpServer::startAccept,
+                    shared_from_this(), m_socks[i]), thread);
+    }
+    return true;
+}
+
+void TcpServer::stop() {
+    m_isStop = true;
+    auto self = shared_from_this();
+    m_acceptWorker->schedule([this, self]() {
+        for(auto& sock : m_socks) {
+            sock->cancelAll();
+            sock->close();
+        }
+        m_socks.clear();
+    });
+}
+
+void TcpServer::handleClient(Socket::ptr client) {
+    SYLAR_LOG_INFO(tcp_server_logger) << "handleClient: " << *client;
+}
+
+}
@@ -0,0 +1,149 @@
+/**
+ * @file tcp_server.h
+ * @brief TCP服务器的封装
+ */
+#ifndef __SYLAR_TCP_SERVER_H__
+#define __SYLAR_TCP_SERVER_H__
+
+#include <memory>
+#include <functional>
+#include <atomic>
+#include "address.h"
+#include "IOManager.h"
+#include "socket.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+/**
+ * @brief TCP服务器封装
+ * @details accept在m_acceptWorker上跑, 新连接交给m_worker处理
+ *          打开SO_REUSEPORT时每个地址给m_acceptWorker的每个线程各建一个监听socket,
+ *          由内核把连接分散到各自的accept队列, 不再所有线程争同一个监听fd
+ */
+class TcpServer : public std::enable_shared_from_this<TcpServer>, Noncopyable {
+public:
+    typedef std::shared_ptr<TcpServer> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] worker 处理连接的协程调度器
+     * @param[in] accept_worker 执行accept的协程调度器
+     */
+    TcpServer(sylar::IOManager* worker = sylar::IOManager::GetThis()
+              ,sylar::IOManager* accept_worker = sylar::IOManager::GetThis());
+
+    /**
+     * @brief 析构函数
+     */
+    virtual ~TcpServer();
+
+    /**
+     * @brief 绑定地址
+     */
+    virtual bool bind(sylar::Address::ptr addr);
+
+    /**
+     * @brief 绑定地址数组
+     * @param[in] addrs 需要绑定的地址数组
+     * @param[out] fails 绑定失败的地址
+     * @return 是否全部绑定成功
+     */
+    virtual bool bind(const std::vector<Address::ptr>& addrs
+                        ,std::vector<Address::ptr>& fails);
+
+    /**
+     * @brief 启动服务, 需要先bind
+     */
+    virtual bool start();
+
+    /**
+     * @brief 停止服务
+     */
+    virtual void stop();
+
+    /**
+     * @brief 返回读取超时时间(毫秒)
+     */
+    uint64_t getRecvTimeout() const { return m_recvTimeout;}
+
+    /**
+     * @brief 返回服务器名称
+     */
+    std::string getName() const { return m_name;}
+
+    /**
+     * @brief 设置读取超时时间(毫秒)
+     */
+    void setRecvTimeout(uint64_t v) { m_recvTimeout = v;}
+
+    /**
+     * @brief 设置服务器名称
+     */
+    virtual void setName(const std::string& v) { m_name = v;}
+
+    /**
+     * @brief 一次唤醒最多accept的连接数
+     */
+    void setAcceptBatch(uint32_t v) { m_acceptBatch = v ? v : 1;}
+    uint32_t getAcceptBatch() const { return m_acceptBatch;}
+
+    /**
+     * @brief 是否每个accept线程一个SO_REUSEPORT监听socket, 需要在bind之前设置
+     */
+    void setReusePort(bool v) { m_reusePort = v;}
+    bool isReusePort() const { return m_reusePort;}
+
+    /**
+     * @brief 是否停止
+     */
+    bool isStop() const { return m_isStop;}
+
+    /**
+     * @brief 已经accept的连接总数
+     */
+    uint64_t getAcceptCount() const { return m_acceptCount;}
+
+    /**
+     * @brief 返回监听的socket
+     */
+    std::vector<Socket::ptr> getSocks() const { return m_socks;}
+protected:
+    /**
+     * @brief 处理新连接的Socket类
+     */
+    virtual void handleClient(Socket::ptr client);
+
+    /**
+     * @brief 开始接受连接
+     */
+    virtual void startAccept(Socket::ptr sock);
+private:
+    /**
+     * @brief 创建一个监听socket并bind/listen
+     */
+    Socket::ptr listenOn(Address::ptr addr);
+protected:
+    /// 监听Socket数组
+    std::vector<Socket::ptr> m_socks;
+    /// 新连接的Socket工作的调度器
+    IOManager* m_worker;
+    /// 服务器Socket接收连接的调度器
+    IOManager* m_acceptWorker;
+    /// 接收超时时间(毫秒)
+    uint64_t m_recvTimeout;
+    /// 服务器名称
+    std::string m_name;
+    /// 一次唤醒最多accept的连接数
+    uint32_t m_acceptBatch;
+    /// 是否使用SO_REUSEPORT分片
+    bool m_reusePort;
+    /// 服务是否停止
+    bool m_isStop;
+    /// accept的连接总数
+    std::atomic<uint64_t> m_acceptCount;
+};
+
+}
+
+#endif
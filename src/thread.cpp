@@ -1,32 +1,106 @@
 #include "thread.h"
 #include "log.h"
+#include "util.h"
+#include <algorithm>
+#include <errno.h>
+#include <new>
+#include <sched.h>
+#include <vector>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
 
 namespace sylar{
-Semaphore::Semaphore(uint32_t count){
-    if(sem_init(&m_semaphore, 0, count)) {
-        throw std::logic_error("sem_init error");
-    }
+static uint64_t NowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    asm volatile("" ::: "memory");
+#endif
+}
+
+static void FutexWait(std::atomic<int>* addr, int val, const timespec* timeout = nullptr) {
+    syscall(SYS_futex, (int*)addr, FUTEX_WAIT_PRIVATE, val, timeout, nullptr, 0);
+}
+
+static void FutexWake(std::atomic<int>* addr, int n) {
+    syscall(SYS_futex, (int*)addr, FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
 }
-Semaphore::~Semaphore(){
-    sem_destroy(&m_semaphore);
+
+Semaphore::Semaphore(uint32_t count)
+    :m_count(count)
+    ,m_waiters(0) {
+}
+
+bool Semaphore::tryWait() {
+    int c = m_count.load(std::memory_order_relaxed);
+    while(c > 0) {
+        if(m_count.compare_exchange_weak(c, c - 1, std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void Semaphore::wait(){
-    // 成功返回0,失败返回-1,并设置errno
-    if(sem_wait(&m_semaphore)){
-        throw std::logic_error("sem_wait error");
+    // 交接通常很快，多核时先短暂自旋再挂起，单核上自旋只会拖住对方
+    static const int s_spins = std::thread::hardware_concurrency() > 1 ? 100 : 0;
+    for(int i = 0; i < s_spins; ++i) {
+        if(tryWait()) {
+            return;
+        }
+        CpuRelax();
+    }
+    m_waiters.fetch_add(1, std::memory_order_seq_cst);
+    while(!tryWait()) {
+        FutexWait(&m_count, 0);
     }
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
 }
-void Semaphore::notify(){
-    // 成功返回0,失败返回-1,并设置errno
-    if(sem_post(&m_semaphore)){
-        throw std::logic_error("sem_post error");
+
+bool Semaphore::waitFor(uint64_t timeout_ms) {
+    if(tryWait()) {
+        return true;
     }
+    uint64_t deadline = NowNs() + timeout_ms * 1000000ull;
+    bool rt = false;
+    m_waiters.fetch_add(1, std::memory_order_seq_cst);
+    while(true) {
+        if(tryWait()) {
+            rt = true;
+            break;
+        }
+        uint64_t now = NowNs();
+        if(now >= deadline) {
+            break;
+        }
+        timespec ts;
+        ts.tv_sec = (deadline - now) / 1000000000ull;
+        ts.tv_nsec = (deadline - now) % 1000000000ull;
+        FutexWait(&m_count, 0, &ts);
+    }
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    return rt;
 }
 
+void Semaphore::notify(){
+    m_count.fetch_add(1, std::memory_order_seq_cst);
+    if(m_waiters.load(std::memory_order_seq_cst)) {
+        FutexWake(&m_count, 1);
+    }
+}
 
 static thread_local Thread* t_thread = nullptr;
 static thread_local std::string t_thread_name = "UNKNOW";
+static thread_local int t_numa_node = -1;
 
 sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
@@ -38,6 +112,10 @@ const std::string& Thread::GetName(){
     return t_thread_name;
 }
 
+int Thread::GetNumaNode() {
+    return t_numa_node;
+}
+
 void Thread::SetName(const std::string& name) {
     if(t_thread) {
         t_thread->m_name = name;
@@ -45,19 +123,47 @@ void Thread::SetName(const std::string& name) {
     t_thread_name = name;
 }
 
-Thread::Thread(std::function<void()> cb, const std::string& name){
+Thread::Thread(std::function<void()> cb, const std::string& name)
+    :Thread(cb, name, nullptr) {
+    m_sem.wait();
+}
+
+Thread::Thread(std::function<void()> cb, const std::string& name, Semaphore* started, int cpu)
+    :m_cpu(cpu)
+    ,m_started(started ? started : &m_sem) {
     if(name.empty()) {
        m_name = "UNKNOW";
     } else {
         m_name = name;
     }
     m_cb = cb;
-    int rt = pthread_create(&m_thread, nullptr, *Thread::run, this);
+    int rt = 0;
+    if(m_cpu >= CPU_SETSIZE) {
+        m_cpu = -1;
+    }
+    if(m_cpu >= 0) {
+        // 创建时就带上亲和性，线程的栈和一开始的内存都在这个cpu的节点上
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(m_cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        rt = pthread_create(&m_thread, &attr, *Thread::run, this);
+        pthread_attr_destroy(&attr);
+        if(rt == EINVAL) {
+            SYLAR_LOG_ERROR(g_logger) << "thread " << m_name << " can not bind cpu " << m_cpu
+                << ", run unbound";
+            m_cpu = -1;
+        }
+    }
+    if(m_cpu < 0) {
+        rt = pthread_create(&m_thread, nullptr, *Thread::run, this);
+    }
     if(rt) {
         SYLAR_LOG_ERROR(g_logger) << "pthread_create thread fail, rt = " << rt << " name = " << m_name;
         throw std::logic_error("pthread_create error");
     }
-    m_sem.wait();
 }
 
 void* Thread::run(void *arg){
@@ -65,11 +171,14 @@ void* Thread::run(void *arg){
     t_thread = thread;
     SetName(thread->m_name);
     thread->m_id = sylar::GetThreadId();
+    if(thread->m_cpu >= 0) {
+        t_numa_node = GetCpuNumaNode(thread->m_cpu);
+    }
     pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
 
     std::function<void()> cb;
     cb.swap(thread->m_cb);
-    thread->m_sem.notify();
+    thread->m_started->notify();
     cb();
     return 0;
 }
@@ -91,4 +200,247 @@ void Thread::join(){
     }
 }
 
-}
\ No newline at end of file
+
+static Mutex& GetLockStatsMutex() {
+    static Mutex s_mutex;
+    return s_mutex;
+}
+
+static std::vector<LockStats*>& GetLockStatsList() {
+    static std::vector<LockStats*> s_list;
+    return s_list;
+}
+
+LockStats::LockStats(const std::string& name)
+    :m_name(name) {
+    void* p = nullptr;
+    if(posix_memalign(&p, 64, sizeof(Slot) * SLOTS)) {
+        throw std::bad_alloc();
+    }
+    m_slots = (Slot*)p;
+    for(size_t i = 0; i < SLOTS; ++i) {
+        new (&m_slots[i]) Slot();
+    }
+    Mutex::Lock lock(GetLockStatsMutex());
+    GetLockStatsList().push_back(this);
+}
+
+LockStats::~LockStats() {
+    {
+        Mutex::Lock lock(GetLockStatsMutex());
+        auto& list = GetLockStatsList();
+        list.erase(std::remove(list.begin(), list.end(), this), list.end());
+    }
+    for(size_t i = 0; i < SLOTS; ++i) {
+        m_slots[i].~Slot();
+    }
+    free(m_slots);
+}
+
+LockStats::Slot& LockStats::getSlot() {
+    // 线程第一次用时轮流分一个槽位，线程数超过SLOTS时共用
+    static std::atomic<uint32_t> s_next(0);
+    static thread_local uint32_t t_slot = s_next.fetch_add(1, std::memory_order_relaxed) % SLOTS;
+    return m_slots[t_slot];
+}
+
+void LockStats::addContended(uint64_t spins, uint64_t parks, uint64_t wait_ns) {
+    Slot& slot = getSlot();
+    slot.contended.fetch_add(1, std::memory_order_relaxed);
+    slot.spins.fetch_add(spins, std::memory_order_relaxed);
+    slot.parks.fetch_add(parks, std::memory_order_relaxed);
+    slot.wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+}
+
+LockStats::Snapshot LockStats::snapshot() const {
+    Snapshot s;
+    for(size_t i = 0; i < SLOTS; ++i) {
+        s.acquisitions += m_slots[i].acquisitions.load(std::memory_order_relaxed);
+        s.contended += m_slots[i].contended.load(std::memory_order_relaxed);
+        s.spins += m_slots[i].spins.load(std::memory_order_relaxed);
+        s.parks += m_slots[i].parks.load(std::memory_order_relaxed);
+        s.wait_ns += m_slots[i].wait_ns.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+void LockStats::reset() {
+    for(size_t i = 0; i < SLOTS; ++i) {
+        m_slots[i].acquisitions = 0;
+        m_slots[i].contended = 0;
+        m_slots[i].spins = 0;
+        m_slots[i].parks = 0;
+        m_slots[i].wait_ns = 0;
+    }
+}
+
+std::ostream& LockStats::dump(std::ostream& os) const {
+    Snapshot s = snapshot();
+    os << m_name
+       << " acquisitions=" << s.acquisitions
+       << " contended=" << s.contended
+       << " (" << (s.acquisitions ? s.contended * 100.0 / s.acquisitions : 0) << "%)"
+       << " spins=" << s.spins
+       << " parks=" << s.parks
+       << " avg_wait_ns=" << (s.contended ? s.wait_ns / s.contended : 0);
+    return os;
+}
+
+void LockStats::DumpAll(std::ostream& os) {
+    Mutex::Lock lock(GetLockStatsMutex());
+    for(auto i : GetLockStatsList()) {
+        i->dump(os) << std::endl;
+    }
+}
+
+static std::atomic<uint64_t> s_spin_budget_ns(2000);
+
+// 实测一次pause的耗时，不同CPU上差一个数量级
+static uint64_t GetPauseCostPs() {
+    static uint64_t s_cost = [](){
+        static const int loops = 10000;
+        uint64_t begin = NowNs();
+        for(int i = 0; i < loops; ++i) {
+            CpuRelax();
+        }
+        uint64_t ps = (NowNs() - begin) * 1000 / loops;
+        return ps ? ps : 1;
+    }();
+    return s_cost;
+}
+
+static std::atomic<uint32_t> s_max_spins(0);
+
+void AdaptiveMutex::SetSpinBudgetNs(uint64_t ns) {
+    s_spin_budget_ns = ns;
+    s_max_spins = ns * 1000 / GetPauseCostPs();
+}
+
+uint32_t AdaptiveMutex::GetMaxSpins() {
+    static bool s_inited = (SetSpinBudgetNs(s_spin_budget_ns), true);
+    (void)s_inited;
+    return s_max_spins;
+}
+
+void AdaptiveMutex::lockSlow() {
+    uint64_t begin = m_stats ? NowNs() : 0;
+    uint32_t max_spins = GetMaxSpins();
+    int32_t spin = m_spin.load(std::memory_order_relaxed);
+    uint32_t limit = std::min<uint32_t>(max_spins, spin * 2 + 10);
+    uint32_t cnt = 0;
+    bool got = false;
+    for(; cnt < limit; ++cnt) {
+        CpuRelax();
+        int c = 0;
+        if(m_state.load(std::memory_order_relaxed) == 0
+                && m_state.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+            got = true;
+            break;
+        }
+    }
+    if(limit) {
+        m_spin.store(spin + ((int32_t)cnt - spin) / 8, std::memory_order_relaxed);
+    }
+
+    uint64_t parks = 0;
+    if(!got) {
+        // 置成2再睡，unlock看到2才会去futex唤醒
+        while(m_state.exchange(2, std::memory_order_acquire) != 0) {
+            FutexWait(&m_state, 2);
+            ++parks;
+        }
+    }
+    if(m_stats) {
+        m_stats->addContended(cnt, parks, NowNs() - begin);
+    }
+}
+
+void AdaptiveMutex::wake() {
+    FutexWake(&m_state, 1);
+}
+
+
+ShardedRWMutex::ShardedRWMutex()
+    :m_writer(0)
+    ,m_readWaiters(0)
+    ,m_owner(nullptr) {
+    uint32_t cpus = std::thread::hardware_concurrency();
+    uint32_t n = 8;
+    while(n < cpus && n < 64) {
+        n <<= 1;
+    }
+    m_mask = n - 1;
+    void* p = nullptr;
+    if(posix_memalign(&p, 64, sizeof(Slot) * n)) {
+        throw std::bad_alloc();
+    }
+    m_slots = (Slot*)p;
+    for(uint32_t i = 0; i < n; ++i) {
+        new (&m_slots[i]) Slot();
+    }
+}
+
+ShardedRWMutex::~ShardedRWMutex() {
+    for(uint32_t i = 0; i <= m_mask; ++i) {
+        m_slots[i].~Slot();
+    }
+    free(m_slots);
+}
+
+uint32_t ShardedRWMutex::NextSlot() {
+    static std::atomic<uint32_t> s_next(0);
+    return s_next.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ShardedRWMutex::rdlockSlow(Slot& slot) {
+    while(true) {
+        // 退出来让写者能等到0，写完再重新登记
+        slot.readers.fetch_sub(1, std::memory_order_seq_cst);
+        for(int i = 0; i < 100 && m_writer.load(std::memory_order_relaxed); ++i) {
+            CpuRelax();
+        }
+        if(m_writer.load(std::memory_order_seq_cst)) {
+            m_readWaiters.fetch_add(1, std::memory_order_seq_cst);
+            while(m_writer.load(std::memory_order_seq_cst)) {
+                FutexWait(&m_writer, 1);
+            }
+            m_readWaiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+        slot.readers.fetch_add(1, std::memory_order_seq_cst);
+        if(!m_writer.load(std::memory_order_seq_cst)) {
+            return;
+        }
+    }
+}
+
+void ShardedRWMutex::wrlock() {
+    m_wmutex.lock();
+    m_writer.store(1, std::memory_order_seq_cst);
+    // 置标记之后新来的读者都会退出，这里只等已经拿到读锁的
+    for(uint32_t spins = 0; ; ++spins) {
+        int64_t sum = 0;
+        for(uint32_t i = 0; i <= m_mask; ++i) {
+            sum += m_slots[i].readers.load(std::memory_order_acquire);
+        }
+        if(sum == 0) {
+            break;
+        }
+        if(spins < 1000) {
+            CpuRelax();
+        } else {
+            sched_yield();
+        }
+    }
+    m_owner.store(&ThreadSlot(), std::memory_order_relaxed);
+}
+
+void ShardedRWMutex::wrunlock() {
+    m_owner.store(nullptr, std::memory_order_relaxed);
+    m_writer.store(0, std::memory_order_seq_cst);
+    if(m_readWaiters.load(std::memory_order_seq_cst)) {
+        FutexWake(&m_writer, INT32_MAX);
+    }
+    m_wmutex.unlock();
+}
+
+}
@@ -2,28 +2,34 @@
 #define __SYLAR_THREAD_H__
 
 #include <thread>
+#include <atomic>
+#include <string>
 #include <functional>
 #include <memory>
 #include <stdint.h>
 #include <iostream>
 #include <unistd.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdint.h>
 #include "noncopyable.h"
 
 namespace sylar{
 
+// 基于futex的计数信号量，有余量时wait只有一次CAS，没有等待者时notify不进内核
 class Semaphore : public Noncopyable {
 public:
     Semaphore(uint32_t count = 0);
-    ~Semaphore();
 
     void wait();
+    // 超时返回false
+    bool waitFor(uint64_t timeout_ms);
+    // 不阻塞，没有余量返回false
+    bool tryWait();
     void notify();
 
 private:
-    sem_t m_semaphore;
+    std::atomic<int> m_count;
+    std::atomic<int> m_waiters;
 };
 
 template<class T>
@@ -231,19 +237,188 @@ private:
     volatile std::atomic_flag m_mutex;
 };
 
+// 锁的竞争统计，按线程分槽计数，加锁的快路径上不会抢同一个cache line
+// 一般一类锁共用一个，按名字注册，DumpAll输出全部
+class LockStats : public Noncopyable {
+public:
+    struct Snapshot {
+        uint64_t acquisitions = 0;   // 加锁次数
+        uint64_t contended = 0;      // 进入慢路径的次数
+        uint64_t spins = 0;          // 自旋的总轮数
+        uint64_t parks = 0;          // futex挂起的次数
+        uint64_t wait_ns = 0;        // 慢路径里花的总时间
+    };
+
+    LockStats(const std::string& name);
+    ~LockStats();
+
+    const std::string& getName() const { return m_name; }
+
+    void addAcquire() {
+        getSlot().acquisitions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void addContended(uint64_t spins, uint64_t parks, uint64_t wait_ns);
+
+    // 各线程槽位加起来的结果
+    Snapshot snapshot() const;
+
+    void reset();
+
+    std::ostream& dump(std::ostream& os) const;
+
+    // 输出所有注册的统计，每行一个
+    static void DumpAll(std::ostream& os);
+private:
+    static const size_t SLOTS = 64;
+    // 每个槽位占一个cache line，用posix_memalign分配
+    struct Slot {
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contended{0};
+        std::atomic<uint64_t> spins{0};
+        std::atomic<uint64_t> parks{0};
+        std::atomic<uint64_t> wait_ns{0};
+        char pad[64 - 5 * sizeof(std::atomic<uint64_t>)];
+    };
+
+    Slot& getSlot();
+private:
+    std::string m_name;
+    Slot* m_slots;
+};
+
+// 先自旋后挂起的互斥量，只有一个int的状态，适合临界区很短、数量很多的锁
+// 0未锁，1已锁，2已锁且可能有线程在futex上等
+// 拿不到锁时先pause自旋，轮数上限按这个锁最近成功的轮数自适应(类似PTHREAD_MUTEX_ADAPTIVE_NP)，
+// 整体不超过SetSpinBudgetNs对应的轮数，启动时按pause的实测耗时换算；还拿不到就futex挂起
+class AdaptiveMutex : public Noncopyable {
+public:
+    typedef ScopedLockImpl<AdaptiveMutex> Lock;
+
+    AdaptiveMutex(LockStats* stats = nullptr)
+        :m_state(0)
+        ,m_spin(0)
+        ,m_stats(stats) {
+    }
+
+    void lock() {
+        int c = 0;
+        if(!m_state.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+            lockSlow();
+        }
+        if(m_stats) {
+            m_stats->addAcquire();
+        }
+    }
+
+    bool tryLock() {
+        int c = 0;
+        return m_state.compare_exchange_strong(c, 1, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        if(m_state.exchange(0, std::memory_order_release) == 2) {
+            wake();
+        }
+    }
+
+    void setStats(LockStats* v) { m_stats = v; }
+
+    // 自旋的时间预算(纳秒)，0表示不自旋直接挂起
+    static void SetSpinBudgetNs(uint64_t ns);
+    // 预算换算出来的自旋轮数上限
+    static uint32_t GetMaxSpins();
+private:
+    void lockSlow();
+    void wake();
+private:
+    std::atomic<int> m_state;
+    // 这个锁最近自旋成功需要的轮数的滑动平均，并发更新不要求精确
+    std::atomic<int32_t> m_spin;
+    LockStats* m_stats;
+};
+
+// 读多写少的读写锁，读计数按线程分散到各自cache line上，读锁不会在核之间来回抢同一个cache line
+// 读锁: 本线程槽位加一，没有写者就拿到了；写锁: 置写标记后等所有槽位的读计数加起来为0
+// 写锁要扫一遍所有槽位，比RWMutex贵，适合每次操作都要读、偶尔才写的地方
+// 读锁可以在别的线程上解锁(协程换了线程)，槽位计数可能为负，只看总和；写锁要在加锁的线程上解锁
+class ShardedRWMutex : public Noncopyable {
+public:
+    typedef ReadScopedLockImpl<ShardedRWMutex> ReadLock;
+    typedef WriteScopedLockImpl<ShardedRWMutex> WriteLock;
+
+    ShardedRWMutex();
+    ~ShardedRWMutex();
+
+    void rdlock() {
+        Slot& slot = m_slots[ThreadSlot() & m_mask];
+        slot.readers.fetch_add(1, std::memory_order_seq_cst);
+        if(m_writer.load(std::memory_order_seq_cst)) {
+            rdlockSlow(slot);
+        }
+    }
+
+    void wrlock();
+
+    void unlock() {
+        // 持有写锁的只可能是本线程自己，用本线程的thread_local地址区分
+        if(m_owner.load(std::memory_order_relaxed) == &ThreadSlot()) {
+            wrunlock();
+            return;
+        }
+        m_slots[ThreadSlot() & m_mask].readers.fetch_sub(1, std::memory_order_release);
+    }
+
+    // 槽位数，cpu数向上取2的幂，最少8最多64
+    uint32_t getSlotCount() const { return m_mask + 1; }
+private:
+    struct Slot {
+        std::atomic<int64_t> readers{0};
+        char pad[64 - sizeof(std::atomic<int64_t>)];
+    };
+
+    // 线程第一次用时轮流分一个编号
+    static uint32_t& ThreadSlot() {
+        static thread_local uint32_t t_slot = NextSlot();
+        return t_slot;
+    }
+    static uint32_t NextSlot();
+
+    void rdlockSlow(Slot& slot);
+    void wrunlock();
+private:
+    Slot* m_slots;
+    uint32_t m_mask;
+    // 1表示有写者持有或正在等读者退出，读者在上面futex等待
+    std::atomic<int> m_writer;
+    std::atomic<int> m_readWaiters;
+    std::atomic<uint32_t*> m_owner;
+    // 写者之间互斥
+    AdaptiveMutex m_wmutex;
+};
+
 class Thread{
 public:
     typedef std::shared_ptr<Thread> ptr;
     Thread(std::function<void()> cb, const std::string& name);
+    // 不等线程跑起来就返回，线程设置好id后notify started
+    // 一次创建多个线程时共用一个started，全部创建完再wait对应次数，线程的启动可以并行
+    // started wait到之前getId()还不可用
+    // cpu>=0时线程创建出来就绑在这个cpu上
+    Thread(std::function<void()> cb, const std::string& name, Semaphore* started, int cpu = -1);
     ~Thread();
 
     pid_t getId() const { return m_id; }
     const std::string& getName() const { return m_name; }
+    // 绑定的cpu，没绑定是-1
+    int getCpu() const { return m_cpu; }
     void join();
 
     static Thread* GetThis();
     static const std::string& GetName();
     static void SetName(const std::string& name);
+    // 当前线程绑定的cpu所在的NUMA节点，没绑定是-1
+    static int GetNumaNode();
 private:
     Thread(const Thread&) = delete;
     Thread(const Thread&&) = delete;
@@ -252,11 +427,13 @@ private:
     static void* run(void *arg);
 private:
     pid_t m_id = -1;
+    int m_cpu = -1;
     pthread_t m_thread = 0;
     std::function<void()> m_cb;
     std::string m_name;
 
     Semaphore m_sem;
+    Semaphore* m_started;
 };
 
 }
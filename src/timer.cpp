@@ -89,10 +89,29 @@ bool Timer::reset(uint64_t ms, bool from_now) {
     return true;
 }
 
-TimerManager::TimerManager(){
+TimerManager::TimerManager()
+    :m_addedMetric(new Counter)
+    ,m_firedMetric(new Counter)
+    ,m_latenessMsMetric(new Counter)
+    ,m_maxLatenessMsMetric(new Gauge) {
     m_previouseTime = sylar::GetCurrentMS();
 }
 
+void TimerManager::registerTimerMetrics(const MetricsRegistry::Labels &labels, const void *owner) {
+    MetricsRegistry *metrics = MetricsMgr::GetInstance();
+    metrics->add("sylar_timers", labels, "Timers waiting to fire."
+            , std::make_shared<CallbackMetric>(Metric::GAUGE, [this]() {
+                RWMutexType::ReadLock lock(m_mutex);
+                return (double)m_timers.size();
+            }), owner);
+    metrics->add("sylar_timers_added_total", labels, "Timers added.", m_addedMetric, owner);
+    metrics->add("sylar_timers_fired_total", labels, "Timers fired.", m_firedMetric, owner);
+    metrics->add("sylar_timer_lateness_milliseconds_total", labels
+            , "Sum of how late fired timers were.", m_latenessMsMetric, owner);
+    metrics->add("sylar_timer_lateness_milliseconds_max", labels
+            , "Largest lateness of a fired timer.", m_maxLatenessMsMetric, owner);
+}
+
 TimerManager::~TimerManager(){
 
 }
@@ -159,7 +178,13 @@ void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs){
     m_timers.erase(m_timers.begin(), it);
     
     cbs.reserve(expired.size());
+    m_firedMetric->add(expired.size());
     for(auto &timer : expired) {
+        // 时钟回拨时m_next可能比now大
+        if(now_ms > timer->m_next) {
+            m_latenessMsMetric->add(now_ms - timer->m_next);
+            m_maxLatenessMsMetric->updateMax(now_ms - timer->m_next);
+        }
         cbs.push_back(timer->m_cb);
         if(timer->m_recurring) {
             timer->m_next = now_ms + timer->m_ms;
@@ -171,6 +196,7 @@ void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs){
 }
 
 void TimerManager::addTimer(Timer::ptr val, RWMutexType::WriteLock &lock){
+    m_addedMetric->add();
     auto it = m_timers.insert(val).first;
     bool at_front = (it == m_timers.begin()) && !m_tickled;
     if(at_front) {
@@ -6,6 +6,7 @@
 #include <set>
 #include <functional>
 #include "thread.h"
+#include "metrics.h"
 #include <vector>
 
 namespace sylar {
@@ -41,7 +42,7 @@ class TimerManager{
 friend class Timer;
 public:
     typedef std::shared_ptr<TimerManager> ptr;
-    typedef RWMutex RWMutexType;
+    typedef ShardedRWMutex RWMutexType;
 
     TimerManager();
     virtual ~TimerManager();
@@ -56,6 +57,9 @@ public:
 
     void listExpiredCb(std::vector<std::function<void()>> &cbs);
 protected:
+    // 定时器相关指标注册到MetricsMgr，owner析构前要remove
+    void registerTimerMetrics(const MetricsRegistry::Labels &labels, const void *owner);
+
     virtual void onTimerInsertedAtFront() = 0;
 
     void addTimer(Timer::ptr val, RWMutexType::WriteLock &lock);
@@ -66,6 +70,11 @@ private:
     std::set<Timer::ptr, Timer::Comparator> m_timers;
     bool m_tickled = false;
     uint64_t m_previouseTime = 0;
+    // 添加、触发的定时器数，触发时比预定时间晚了多少毫秒
+    Counter::ptr m_addedMetric;
+    Counter::ptr m_firedMetric;
+    Counter::ptr m_latenessMsMetric;
+    Gauge::ptr m_maxLatenessMsMetric;
 };
 
 
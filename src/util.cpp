@@ -1,7 +1,10 @@
 #include "util.h"
 #include <execinfo.h>
+#include <cxxabi.h>
 #include "log.h"
 #include <sys/time.h>
+#include <dirent.h>
+#include <stdlib.h>
 #include "fiber.h"
 
 namespace sylar{
@@ -43,6 +46,59 @@ namespace sylar{
         return ss.str();
     }
 
+    std::string BacktraceToString(void** array, int size, int skip, std::string prefix){
+        std::stringstream ss;
+        char** strings = backtrace_symbols(array, size);
+        if(strings == NULL) {
+            SYLAR_LOG_ERROR(util_logger) << "backtrace_synbols error";
+            return "";
+        }
+        for(int i = skip; i < size; i++) {
+            ss << prefix << strings[i] << std::endl;
+        }
+        free(strings);
+        return ss.str();
+    }
+
+
+    std::string Demangle(const char* name){
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if(status != 0 || !demangled) {
+            return name;
+        }
+        std::string rt(demangled);
+        free(demangled);
+        return rt;
+    }
+
+    std::string SymbolizeAddress(void* addr){
+        char** strings = backtrace_symbols(&addr, 1);
+        if(strings == NULL) {
+            return "?";
+        }
+        // 格式是 module(symbol+0x10) [0x...]，没有符号时是 module(+0x10) [0x...]
+        std::string str(strings[0]);
+        free(strings);
+        size_t begin = str.find('(');
+        size_t end = str.find(')', begin);
+        if(begin == std::string::npos || end == std::string::npos) {
+            return str;
+        }
+        std::string sym = str.substr(begin + 1, end - begin - 1);
+        size_t plus = sym.rfind('+');
+        std::string name = sym.substr(0, plus);
+        std::string offset = plus == std::string::npos ? "" : sym.substr(plus);
+        if(offset == "+0" || offset == "+0x0") {
+            offset.clear();
+        }
+        if(name.empty()) {
+            std::string module = str.substr(0, begin);
+            size_t slash = module.rfind('/');
+            return (slash == std::string::npos ? module : module.substr(slash + 1)) + offset;
+        }
+        return Demangle(name.c_str()) + offset;
+    }
 
     uint64_t GetCurrentMS(){
         struct timeval tv;
@@ -56,6 +112,59 @@ namespace sylar{
         return tv.tv_sec * 1000 * 1000 + tv.tv_usec;
     }
 
+    bool ParseCpuList(const std::string &str, std::vector<int> &cpus){
+        cpus.clear();
+        const char *p = str.c_str();
+        while(*p) {
+            while(*p == ' ' || *p == ',') {
+                ++p;
+            }
+            if(!*p) {
+                break;
+            }
+            char *end = nullptr;
+            long first = strtol(p, &end, 10);
+            if(end == p || first < 0) {
+                return false;
+            }
+            long last = first;
+            p = end;
+            if(*p == '-') {
+                ++p;
+                last = strtol(p, &end, 10);
+                if(end == p || last < first) {
+                    return false;
+                }
+                p = end;
+            }
+            if(*p && *p != ',' && *p != ' ') {
+                return false;
+            }
+            for(long i = first; i <= last; ++i) {
+                cpus.push_back((int)i);
+            }
+        }
+        return true;
+    }
+
+    int GetCpuNumaNode(int cpu){
+        // cpuN目录下有一个nodeK的链接
+        std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        DIR *dir = opendir(path.c_str());
+        if(!dir) {
+            return -1;
+        }
+        int node = -1;
+        while(dirent *ent = readdir(dir)) {
+            if(strncmp(ent->d_name, "node", 4) == 0 && isdigit(ent->d_name[4])) {
+                node = atoi(ent->d_name + 4);
+                break;
+            }
+        }
+        closedir(dir);
+        return node;
+    }
+
 
 
 
@@ -24,10 +24,21 @@ uint32_t GetFiberId();
 
 void Backtrace(std::vector<std::string> &bt, int size, int skip);
 std::string BacktraceToString(int size, int skip = 2, const std::string prefix = "");
+// 符号化别处(比如信号处理函数里)用::backtrace抓下来的调用栈
+std::string BacktraceToString(void** array, int size, int skip = 0, const std::string prefix = "");
+// C++符号名还原，失败原样返回
+std::string Demangle(const char* name);
+// 代码地址对应的函数名+偏移，没有符号时是模块名+偏移
+std::string SymbolizeAddress(void* addr);
 
 uint64_t GetCurrentMS();
 uint64_t GetCurrentUS();
 
+// 解析"0-3,8,10-11"这样的cpu列表，格式不对返回false
+bool ParseCpuList(const std::string &str, std::vector<int> &cpus);
+// cpu所在的NUMA节点，从/sys读，不知道返回-1
+int GetCpuNumaNode(int cpu);
+
 
 
 
@@ -0,0 +1,74 @@
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/config.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <sched.h>
+#include <sstream>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void test_parse() {
+    std::vector<int> cpus;
+    SYLAR_ASSERT(sylar::ParseCpuList("0-3,8,10-11", cpus));
+    SYLAR_ASSERT(cpus == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    SYLAR_ASSERT(sylar::ParseCpuList(" 5 ", cpus) && cpus == std::vector<int>({5}));
+    SYLAR_ASSERT(sylar::ParseCpuList("", cpus) && cpus.empty());
+    SYLAR_ASSERT(!sylar::ParseCpuList("3-1", cpus));
+    SYLAR_ASSERT(!sylar::ParseCpuList("a", cpus));
+    SYLAR_ASSERT(!sylar::ParseCpuList("1-", cpus));
+    SYLAR_LOG_INFO(g_logger) << "cpu0 numa node=" << sylar::GetCpuNumaNode(0);
+}
+
+void test_bind() {
+    // 所有工作线程都绑到当前线程允许的第一个cpu上
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    SYLAR_ASSERT(sched_getaffinity(0, sizeof(set), &set) == 0);
+    int cpu = 0;
+    while(!CPU_ISSET(cpu, &set)) {
+        ++cpu;
+    }
+    auto affinity = sylar::Config::Lookup("scheduler.affinity"
+            , std::map<std::string, std::string>(), "");
+    affinity->setValue({{"pin", std::to_string(cpu)}});
+
+    static std::atomic<int> s_done(0);
+    static int s_cpu;
+    s_cpu = cpu;
+    sylar::IOManager iom(2, false, "pin");
+    for(int i = 0; i < 2; i++) {
+        iom.schedule([]() {
+            SYLAR_ASSERT(sylar::Thread::GetThis()->getCpu() == s_cpu);
+            SYLAR_ASSERT(sched_getcpu() == s_cpu);
+            SYLAR_ASSERT(sylar::Thread::GetNumaNode() == sylar::GetCpuNumaNode(s_cpu));
+            ++s_done;
+        }, iom.getThreadIds()[i]);
+    }
+    while(s_done < 2) {
+        usleep(1000);
+    }
+    std::stringstream ss;
+    iom.dumpPlacement(ss);
+    SYLAR_LOG_INFO(g_logger) << "placement:\n" << ss.str();
+
+    // 没配置的调度器不绑
+    sylar::IOManager free_iom(1, false, "free");
+    free_iom.schedule([]() {
+        SYLAR_ASSERT(sylar::Thread::GetThis()->getCpu() == -1);
+        SYLAR_ASSERT(sylar::Thread::GetNumaNode() == -1);
+        ++s_done;
+    });
+    while(s_done < 3) {
+        usleep(1000);
+    }
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    test_parse();
+    test_bind();
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "../src/bytearray.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <sys/socket.h>
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 随机数据写进去再读出来，块故意取得很小，让数据跨块
+void test_roundtrip() {
+#define XX(type, len, write_fun, read_fun, base_len) {\
+    std::vector<type> vec; \
+    for(int i = 0; i < len; ++i) { \
+        vec.push_back((type)(((uint64_t)rand() << 32) | rand())); \
+    } \
+    sylar::ByteArray::ptr ba(new sylar::ByteArray(base_len)); \
+    for(auto& i : vec) { \
+        ba->write_fun(i); \
+    } \
+    ba->setPosition(0); \
+    for(size_t i = 0; i < vec.size(); ++i) { \
+        type v = ba->read_fun(); \
+        SYLAR_ASSERT(v == vec[i]); \
+    } \
+    SYLAR_ASSERT(ba->getReadSize() == 0); \
+    SYLAR_LOG_INFO(g_logger) << #write_fun "/" #read_fun \
+                    " (" #type " ) len=" << len \
+                    << " base_len=" << base_len \
+                    << " size=" << ba->getSize(); \
+}
+
+    XX(int8_t,  100, writeFint8, readFint8, 1);
+    XX(uint8_t, 100, writeFuint8, readFuint8, 1);
+    XX(int16_t,  100, writeFint16,  readFint16, 1);
+    XX(uint16_t, 100, writeFuint16, readFuint16, 1);
+    XX(int32_t,  100, writeFint32,  readFint32, 1);
+    XX(uint32_t, 100, writeFuint32, readFuint32, 1);
+    XX(int64_t,  100, writeFint64,  readFint64, 1);
+    XX(uint64_t, 100, writeFuint64, readFuint64, 1);
+
+    XX(int32_t,  100, writeInt32,  readInt32, 1);
+    XX(uint32_t, 100, writeUint32, readUint32, 1);
+    XX(int64_t,  100, writeInt64,  readInt64, 1);
+    XX(uint64_t, 100, writeUint64, readUint64, 1);
+
+    XX(int64_t,  1000, writeInt64,  readInt64, 7);
+    XX(uint64_t, 1000, writeUint64, readUint64, 7);
+#undef XX
+
+    sylar::ByteArray::ptr ba(new sylar::ByteArray(3));
+    ba->writeInt32(-1);
+    ba->writeInt64(INT64_MIN);
+    ba->writeFloat(3.25f);
+    ba->writeDouble(-1e300);
+    ba->writeStringF16("hello");
+    ba->writeStringVint(std::string(1000, 'x'));
+    ba->setPosition(0);
+    SYLAR_ASSERT(ba->readInt32() == -1);
+    SYLAR_ASSERT(ba->readInt64() == INT64_MIN);
+    SYLAR_ASSERT(ba->readFloat() == 3.25f);
+    SYLAR_ASSERT(ba->readDouble() == -1e300);
+    SYLAR_ASSERT(ba->readStringF16() == "hello");
+    SYLAR_ASSERT(ba->readStringVint() == std::string(1000, 'x'));
+
+    bool thrown = false;
+    try {
+        ba->readFuint8();
+    } catch(std::out_of_range& e) {
+        thrown = true;
+    }
+    SYLAR_LOG_INFO(g_logger) << "mixed roundtrip ok, read past end thrown=" << thrown;
+}
+
+// getWriteBuffers/getReadBuffers直接给readv/writev用
+void test_iovec() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    sylar::ByteArray::ptr out(new sylar::ByteArray(64));
+    for(int i = 0; i < 1000; ++i) {
+        out->writeUint32(i * 7919);
+    }
+    out->setPosition(0);
+    std::vector<iovec> iovs;
+    uint64_t len = out->getReadBuffers(iovs);
+    ssize_t n = writev(fds[0], &iovs[0], iovs.size());
+    SYLAR_ASSERT((uint64_t)n == len);
+
+    sylar::ByteArray::ptr in(new sylar::ByteArray(100));
+    iovs.clear();
+    in->getWriteBuffers(iovs, len);
+    n = readv(fds[1], &iovs[0], iovs.size());
+    SYLAR_ASSERT((uint64_t)n == len);
+    in->setPosition(in->getPosition() + n);
+    in->setPosition(0);
+    for(int i = 0; i < 1000; ++i) {
+        SYLAR_ASSERT(in->readUint32() == (uint32_t)(i * 7919));
+    }
+    SYLAR_LOG_INFO(g_logger) << "iovec roundtrip bytes=" << len << " iovs=" << iovs.size();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void bench() {
+    static const int loops = 1000000;
+#define XX(type, write_fun, read_fun, value) {\
+    sylar::ByteArray ba; \
+    uint64_t begin = sylar::GetCurrentUS(); \
+    for(int i = 0; i < loops; ++i) { \
+        ba.write_fun((type)(value)); \
+    } \
+    uint64_t encode = sylar::GetCurrentUS() - begin; \
+    ba.setPosition(0); \
+    type sum = 0; \
+    begin = sylar::GetCurrentUS(); \
+    for(int i = 0; i < loops; ++i) { \
+        sum += ba.read_fun(); \
+    } \
+    uint64_t decode = sylar::GetCurrentUS() - begin; \
+    SYLAR_LOG_INFO(g_logger) << #write_fun "/" #read_fun " bytes=" << ba.getSize() \
+        << " encode " << encode * 1000.0 / loops << " ns/op " \
+        << ba.getSize() / (encode ? encode : 1) << " MB/s" \
+        << " decode " << decode * 1000.0 / loops << " ns/op " \
+        << ba.getSize() / (decode ? decode : 1) << " MB/s" \
+        << " sum=" << (uint64_t)sum; \
+}
+    XX(uint8_t, writeFuint8, readFuint8, i);
+    XX(uint32_t, writeFuint32, readFuint32, i);
+    XX(uint64_t, writeFuint64, readFuint64, i);
+    XX(uint32_t, writeUint32, readUint32, i & 0x7F);
+    XX(uint32_t, writeUint32, readUint32, i * 2654435761u);
+    XX(uint64_t, writeUint64, readUint64, (uint64_t)i * 11400714819323198485ull);
+    XX(int64_t, writeInt64, readInt64, -i);
+    XX(double, writeDouble, readDouble, i * 0.5);
+#undef XX
+
+    sylar::ByteArray ba;
+    std::string s(32, 's');
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < loops; ++i) {
+        ba.writeStringVint(s);
+    }
+    uint64_t encode = sylar::GetCurrentUS() - begin;
+    ba.setPosition(0);
+    size_t total = 0;
+    begin = sylar::GetCurrentUS();
+    for(int i = 0; i < loops; ++i) {
+        total += ba.readStringVint().size();
+    }
+    uint64_t decode = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "writeStringVint/readStringVint(32) bytes=" << ba.getSize()
+        << " encode " << encode * 1000.0 / loops << " ns/op"
+        << " decode " << decode * 1000.0 / loops << " ns/op total=" << total;
+}
+
+int main(int argc, char** argv) {
+    test_roundtrip();
+    test_iovec();
+    bench();
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "../src/channel.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_done(0);
+
+void wait_done(int n) {
+    while(s_done < n) {
+        usleep(1000);
+    }
+}
+
+void test_functional() {
+    sylar::Channel<int> ch(2);
+    int v = 0;
+    SYLAR_ASSERT(ch.capacity() == 2);
+    SYLAR_ASSERT(ch.trySend(1) && ch.trySend(2) && !ch.trySend(3));
+
+    uint64_t begin = sylar::GetCurrentMS();
+    bool rt = ch.send(3, 20);
+    uint64_t used = sylar::GetCurrentMS() - begin;
+    SYLAR_ASSERT(!rt && used >= 19);
+    SYLAR_ASSERT(ch.recv(v) && v == 1 && ch.tryRecv(v) && v == 2 && !ch.tryRecv(v));
+
+    begin = sylar::GetCurrentMS();
+    rt = ch.recv(v, 20);
+    SYLAR_LOG_INFO(g_logger) << "send timeout used=" << used << "ms recv timeout used="
+        << sylar::GetCurrentMS() - begin << "ms";
+    SYLAR_ASSERT(!rt);
+
+    // 挂起的接收者被另一个协程的send唤醒
+    static sylar::Channel<int> s_ch(4);
+    sylar::IOManager::GetThis()->schedule([]() {
+        usleep(5000);
+        s_ch.send(42);
+    });
+    SYLAR_ASSERT(s_ch.recv(v, 1000) && v == 42);
+
+    // 三个通道上select
+    static sylar::Channel<int> s_a(4), s_b(4), s_c(4);
+    sylar::Channel<int>* chs[] = {&s_a, &s_b, &s_c};
+    sylar::IOManager::GetThis()->schedule([]() {
+        usleep(5000);
+        s_b.send(7);
+    });
+    int idx = sylar::Channel<int>::Select(chs, 3, v, 1000);
+    SYLAR_ASSERT(idx == 1 && v == 7);
+    idx = sylar::Channel<int>::Select(chs, 3, v, 10);
+    SYLAR_ASSERT(idx == -1);
+
+    // close之后剩下的数据还能取出来
+    s_c.send(9);
+    s_c.close();
+    SYLAR_ASSERT(!s_c.send(10));
+    SYLAR_ASSERT(s_c.recv(v) && v == 9 && !s_c.recv(v));
+    s_a.close();
+    s_b.close();
+    idx = sylar::Channel<int>::Select(chs, 3, v);
+    SYLAR_LOG_INFO(g_logger) << "select after wake idx=1, after close idx=" << idx;
+    SYLAR_ASSERT(idx == -1);
+}
+
+static const int s_items = 200000;
+
+void bench_channel(int producers, int consumers, size_t capacity) {
+    static sylar::Channel<int>* s_ch = nullptr;
+    static std::atomic<long> s_sum(0);
+    std::unique_ptr<sylar::Channel<int> > ch(new sylar::Channel<int>(capacity));
+    s_ch = ch.get();
+    s_sum = 0;
+    s_done = 0;
+    int per = s_items / producers;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < consumers; i++) {
+        sylar::IOManager::GetThis()->schedule([]() {
+            int v;
+            long sum = 0;
+            while(s_ch->recv(v)) {
+                sum += v;
+            }
+            s_sum += sum;
+            ++s_done;
+        });
+    }
+    for(int i = 0; i < producers; i++) {
+        sylar::IOManager::GetThis()->schedule([per]() {
+            for(int j = 1; j <= per; j++) {
+                s_ch->send(j);
+            }
+            ++s_done;
+        });
+    }
+    wait_done(producers);
+    s_ch->close();
+    wait_done(producers + consumers);
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(s_sum == (long)producers * per * (per + 1) / 2);
+    SYLAR_LOG_INFO(g_logger) << "channel " << producers << ":" << consumers << " cap=" << capacity
+        << " " << (double)producers * per * 1000000.0 / used << " msg/s";
+}
+
+// 现在的做法: 每次交接schedule一个lambda
+void bench_schedule(int producers) {
+    static std::atomic<long> s_sum(0);
+    static std::atomic<int> s_handled(0);
+    s_sum = 0;
+    s_handled = 0;
+    s_done = 0;
+    int per = s_items / producers;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < producers; i++) {
+        sylar::IOManager::GetThis()->schedule([per]() {
+            for(int j = 1; j <= per; j++) {
+                sylar::IOManager::GetThis()->schedule([j]() {
+                    s_sum += j;
+                    ++s_handled;
+                });
+            }
+            ++s_done;
+        });
+    }
+    wait_done(producers);
+    while(s_handled < producers * per) {
+        usleep(1000);
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "schedule lambda " << producers << ":N "
+        << (double)producers * per * 1000000.0 / used << " msg/s";
+}
+
+void run() {
+    test_functional();
+    bench_schedule(1);
+    bench_channel(1, 1, 1024);
+    bench_channel(1, 1, 4);
+    bench_schedule(8);
+    bench_channel(8, 1, 1024);
+    bench_channel(8, 8, 1024);
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    sylar::IOManager iom(2, false, "chan");
+    iom.schedule(run);
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <iostream>
+#include "../src/log.h"
+#include "../src/config.h"
+#include "../src/util.h"
+
+static const int s_var_count = 2000;
+static const int s_rounds = 5;
+
+std::vector<sylar::ConfigVar<std::vector<int>>::ptr> g_vec_vars;
+std::vector<sylar::ConfigVar<std::map<std::string, int>>::ptr> g_map_vars;
+std::vector<sylar::ConfigVar<int>::ptr> g_int_vars;
+
+void register_vars() {
+    for(int i = 0; i < s_var_count; i++) {
+        std::string idx = std::to_string(i);
+        g_int_vars.push_back(sylar::Config::Lookup("bench.int_" + idx, (int)0, "bench int"));
+        g_vec_vars.push_back(sylar::Config::Lookup("bench.vec_" + idx, std::vector<int>(), "bench vec"));
+        g_map_vars.push_back(sylar::Config::Lookup("bench.map_" + idx, std::map<std::string, int>(), "bench map"));
+    }
+}
+
+YAML::Node build_yaml() {
+    YAML::Node root;
+    for(int i = 0; i < s_var_count; i++) {
+        std::string idx = std::to_string(i);
+        root["bench"]["int_" + idx] = i;
+        for(int j = 0; j < 8; j++) {
+            root["bench"]["vec_" + idx].push_back(i + j);
+            root["bench"]["map_" + idx]["k" + std::to_string(j)] = i * j;
+        }
+    }
+    return root;
+}
+
+void reset_vars() {
+    for(int i = 0; i < s_var_count; i++) {
+        g_int_vars[i]->setValue(0);
+        g_vec_vars[i]->setValue(std::vector<int>());
+        g_map_vars[i]->setValue(std::map<std::string, int>());
+    }
+}
+
+bool check_vars() {
+    for(int i = 0; i < s_var_count; i++) {
+        if(g_int_vars[i]->getValue() != i
+                || g_vec_vars[i]->getValue().size() != 8
+                || g_vec_vars[i]->getValue()[7] != i + 7
+                || g_map_vars[i]->getValue().at("k3") != i * 3) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "check fail index=" << i;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 写一个两项的快照: 第一项bench.int_1=42是好的，第二项由调用方给
+void write_snapshot(const std::string &path, const std::string &name,
+                    const std::string &type, const std::string &value) {
+    std::string good;
+    sylar::ConfigVar<int>::ptr tmp(new sylar::ConfigVar<int>("tmp", 42, ""));
+    tmp->toBinary(good);
+    std::string body;
+    uint32_t header[] = {0x46435953, 1, 2};
+    body.append((const char*)header, sizeof(header));
+    sylar::BinaryCast<std::string>().encode(body, "bench.int_1");
+    sylar::BinaryCast<std::string>().encode(body, g_int_vars[1]->getTypeName());
+    sylar::BinaryCast<std::string>().encode(body, good);
+    sylar::BinaryCast<std::string>().encode(body, name);
+    sylar::BinaryCast<std::string>().encode(body, type);
+    sylar::BinaryCast<std::string>().encode(body, value);
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    ofs.write(body.c_str(), body.size());
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::WARN);
+    register_vars();
+
+    std::string yaml_path = "config_snapshot_bench.yaml";
+    std::string snapshot_path = "config_snapshot_bench.bin";
+    {
+        std::ofstream ofs(yaml_path);
+        ofs << build_yaml();
+    }
+
+    uint64_t yaml_us = 0;
+    for(int i = 0; i < s_rounds; i++) {
+        reset_vars();
+        uint64_t begin = sylar::GetCurrentUS();
+        sylar::Config::LoadFromYaml(YAML::LoadFile(yaml_path));
+        yaml_us += sylar::GetCurrentUS() - begin;
+    }
+    if(!check_vars()) {
+        return 1;
+    }
+
+    if(!sylar::Config::SaveSnapshot(snapshot_path)) {
+        return 1;
+    }
+
+    uint64_t snapshot_us = 0;
+    for(int i = 0; i < s_rounds; i++) {
+        reset_vars();
+        uint64_t begin = sylar::GetCurrentUS();
+        sylar::Config::LoadFromSnapshot(snapshot_path);
+        snapshot_us += sylar::GetCurrentUS() - begin;
+    }
+    if(!check_vars()) {
+        return 1;
+    }
+
+    // 坏记录排在好记录后面，加载要失败，而且前面的好记录也不能生效
+    reset_vars();
+    write_snapshot(snapshot_path, "bench.int_0", g_int_vars[0]->getTypeName(), "ab");
+    if(sylar::Config::LoadFromSnapshot(snapshot_path)) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "corrupted snapshot loaded";
+        return 1;
+    }
+    if(g_int_vars[1]->getValue() != 0) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "corrupted snapshot partially applied";
+        return 1;
+    }
+
+    // 类型对不上，加载也要失败
+    write_snapshot(snapshot_path, "bench.vec_0", g_int_vars[0]->getTypeName(), "ab");
+    if(sylar::Config::LoadFromSnapshot(snapshot_path)) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "mismatched snapshot loaded";
+        return 1;
+    }
+    if(g_int_vars[1]->getValue() != 0) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "mismatched snapshot partially applied";
+        return 1;
+    }
+
+    std::cout << "vars=" << s_var_count * 3 << " rounds=" << s_rounds << std::endl;
+    std::cout << "yaml     avg " << yaml_us / s_rounds << " us" << std::endl;
+    std::cout << "snapshot avg " << snapshot_us / s_rounds << " us" << std::endl;
+
+    unlink(yaml_path.c_str());
+    unlink(snapshot_path.c_str());
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "../src/log.h"
 #include "../src/config.h"
+#include "../src/macro.h"
 sylar::ConfigVar<int>::ptr g_int_value_config = sylar::Config::Lookup("system.port", (int)8080, "system port");
 sylar::ConfigVar<float>::ptr g_int_xvalue_config = sylar::Config::Lookup("system.port_float", (float)8080, "system port");
 sylar::ConfigVar<std::vector<int>>::ptr g_int_vector_value_config = sylar::Config::Lookup("system.int_vec", std::vector<int>{1,2}, "system int vec");
@@ -189,12 +190,47 @@ void test_log(){
     // SYLAR_LOG_INFO(system_log) << SYLAR_LOG_ROOT()->m_appender.back()->toYamlString();
 }
 
+void test_lookup_threads() {
+    // 多线程同时查已存在的key和注册新key，查找不再抢全局锁
+    std::vector<sylar::Thread::ptr> thrs;
+    std::atomic<int> fails(0);
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < 4; i++) {
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread([i, &fails](){
+            for(int j = 0; j < 100000; j++) {
+                if(sylar::Config::LookupBase("system.port") != g_int_value_config) {
+                    ++fails;
+                }
+                if(j % 1000 == 0) {
+                    auto var = sylar::Config::Lookup("lookup.thread_" + std::to_string(i) + "_" + std::to_string(j), j);
+                    if(!var || var->getValue() != j) {
+                        ++fails;
+                    }
+                }
+            }
+        }, "lookup_" + std::to_string(i))));
+    }
+    for(auto &i : thrs) {
+        i->join();
+    }
+    SYLAR_ASSERT(fails == 0);
+    // 别的线程注册的key都要能查到
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 100000; j += 1000) {
+            auto var = sylar::Config::Lookup<int>("lookup.thread_" + std::to_string(i) + "_" + std::to_string(j));
+            SYLAR_ASSERT(var && var->getValue() == j);
+        }
+    }
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "test_lookup_threads used " << (sylar::GetCurrentUS() - begin) << " us";
+}
+
 int main(int argc, char** argv) {
     // SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << g_int_value_config->getValue();
     // SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << g_int_value_config->toString();
     // test_yaml();
     // test_config();
     //test_class();
+    test_lookup_threads();
     test_log();
     
     return 0;
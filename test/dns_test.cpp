@@ -0,0 +1,181 @@
+#include "../src/dns.h"
+#include "../src/address.h"
+#include "../src/IOManager.h"
+#include "../src/hook.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 本地的DNS桩服务器，只认stub.test、slow.test和short.test(TTL 1秒)三个A记录，其余回NXDOMAIN
+static int s_stub_fd = -1;
+static int s_ticks = 0;
+
+void run_stub_server() {
+    uint8_t buf[512];
+    while(true) {
+        sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        ssize_t n = recvfrom(s_stub_fd, buf, sizeof(buf), 0, (sockaddr*)&peer, &len);
+        if(n < 12) {
+            break;
+        }
+        std::string qname;
+        size_t pos = 12;
+        while(pos < (size_t)n && buf[pos]) {
+            if(!qname.empty()) {
+                qname.push_back('.');
+            }
+            qname.append((const char*)buf + pos + 1, buf[pos]);
+            pos += buf[pos] + 1;
+        }
+        pos += 5;
+        uint16_t qtype = (buf[pos - 4] << 8) | buf[pos - 3];
+
+        std::string resp((const char*)buf, pos);
+        bool known = (qname == "stub.test" || qname == "slow.test" || qname == "short.test");
+        resp[2] = (char)0x81;
+        resp[3] = known ? (char)0x80 : (char)0x83;
+        if(known && qtype == 1) {
+            resp[7] = 1;
+            uint8_t answer[] = {0xc0, 0x0c, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 10, 0, 0, 1};
+            if(qname == "short.test") {
+                answer[9] = 1;
+            }
+            resp.append((const char*)answer, sizeof(answer));
+        }
+        if(qname == "slow.test") {
+            usleep(50 * 1000);
+        }
+        sendto(s_stub_fd, resp.c_str(), resp.size(), 0, (sockaddr*)&peer, len);
+    }
+}
+
+// 20个协程同时查同一个慢域名只发一次查询，失败结果也会缓存
+void test_lookup_cache() {
+    sylar::DnsResolver *resolver = sylar::DnsMgr::GetInstance();
+    sylar::Address::ClearLookupCache();
+    resolver->clearCache();
+
+    static int s_done = 0;
+    uint64_t queries = resolver->getQueryCount();
+    for(int i = 0; i < 20; i++) {
+        sylar::IOManager::GetThis()->schedule([](){
+            sylar::Address::ptr addr = sylar::Address::LookupAny("slow.test:80");
+            if(addr) {
+                ++s_done;
+            }
+        });
+    }
+    while(s_done < 20) {
+        usleep(10 * 1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "20 concurrent lookups queries=" << resolver->getQueryCount() - queries;
+
+    queries = resolver->getQueryCount();
+    std::vector<sylar::Address::ptr> result;
+    sylar::Address::Lookup(result, "nx.test");
+    sylar::Address::Lookup(result, "nx.test");
+    SYLAR_LOG_INFO(g_logger) << "2 failed lookups queries=" << resolver->getQueryCount() - queries;
+
+    std::multimap<std::string, std::pair<sylar::Address::ptr, uint32_t> > ifaces;
+    static const int loops = 10000;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < loops; i++) {
+        ifaces.clear();
+        sylar::Address::GetInterfaceAddresses(ifaces);
+    }
+    SYLAR_LOG_INFO(g_logger) << "cached GetInterfaceAddresses size=" << ifaces.size() << " "
+        << (sylar::GetCurrentUS() - begin) * 1000.0 / loops << " ns/op";
+}
+
+void test_dns() {
+    s_stub_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sylar::IPv4Address::ptr addr = sylar::IPv4Address::Create("127.0.0.1", 0);
+    bind(s_stub_fd, addr->getAddr(), addr->getAddrLen());
+    socklen_t len = addr->getAddrLen();
+    getsockname(s_stub_fd, addr->getAddr(), &len);
+    sylar::IOManager::GetThis()->schedule(run_stub_server);
+
+    sylar::DnsResolver *resolver = sylar::DnsMgr::GetInstance();
+    resolver->setServers({addr});
+    SYLAR_LOG_INFO(g_logger) << "stub dns server " << *addr;
+
+    std::vector<sylar::Address::ptr> result;
+    bool rt = sylar::Address::Lookup(result, "stub.test:80");
+    SYLAR_LOG_INFO(g_logger) << "lookup stub.test rt=" << rt << " addr=" << (rt ? result[0]->toString() : "")
+        << " queries=" << resolver->getQueryCount();
+
+    result.clear();
+    rt = sylar::Address::Lookup(result, "STUB.test:8080");
+    SYLAR_LOG_INFO(g_logger) << "cached lookup rt=" << rt << " addr=" << (rt ? result[0]->toString() : "")
+        << " queries=" << resolver->getQueryCount();
+
+    result.clear();
+    rt = sylar::Address::Lookup(result, "nx.test");
+    SYLAR_LOG_INFO(g_logger) << "lookup nx.test rt=" << rt << " queries=" << resolver->getQueryCount();
+
+    // 短域名按search展开: stub -> stub.nope.test(NXDOMAIN) -> stub.test
+    resolver->setSearch({"nope.test", "test"});
+    result.clear();
+    rt = sylar::Address::Lookup(result, "stub:80");
+    SYLAR_LOG_INFO(g_logger) << "lookup stub via search rt=" << rt << " addr=" << (rt ? result[0]->toString() : "");
+    SYLAR_ASSERT(rt && result[0]->toString() == "10.0.0.1:80");
+    // .结尾的绝对域名不展开
+    result.clear();
+    SYLAR_ASSERT(!sylar::Address::Lookup(result, "stub.:80"));
+    // 点数不少于ndots时先查原名
+    sylar::Address::ClearLookupCache();
+    resolver->clearCache();
+    uint64_t queries = resolver->getQueryCount();
+    result.clear();
+    SYLAR_ASSERT(sylar::Address::Lookup(result, "stub.test:80"));
+    SYLAR_ASSERT(resolver->getQueryCount() - queries == 1);
+    resolver->setSearch({});
+
+    // 地址缓存不能比记录的TTL活得久
+    queries = resolver->getQueryCount();
+    result.clear();
+    SYLAR_ASSERT(sylar::Address::Lookup(result, "short.test:80"));
+    usleep(1100 * 1000);
+    result.clear();
+    SYLAR_ASSERT(sylar::Address::Lookup(result, "short.test:80"));
+    SYLAR_LOG_INFO(g_logger) << "short ttl lookups queries=" << resolver->getQueryCount() - queries;
+    SYLAR_ASSERT(resolver->getQueryCount() - queries == 2);
+
+    result.clear();
+    rt = sylar::Address::Lookup(result, "localhost:8080");
+    SYLAR_LOG_INFO(g_logger) << "lookup localhost rt=" << rt << " addr=" << (rt ? result[0]->toString() : "")
+        << " queries=" << resolver->getQueryCount();
+
+    // 等应答的50ms里同线程的其他协程照常运行
+    sylar::IOManager::GetThis()->schedule([](){
+        for(int i = 0; i < 10; i++) {
+            usleep(5000);
+            ++s_ticks;
+        }
+    });
+    uint64_t begin = sylar::GetCurrentMS();
+    sylar::Address::ptr slow = sylar::Address::LookupAny("slow.test:80");
+    SYLAR_LOG_INFO(g_logger) << "lookup slow.test addr=" << (slow ? slow->toString() : "null")
+        << " used=" << sylar::GetCurrentMS() - begin << "ms ticks while parked=" << s_ticks;
+
+    static const int loops = 100000;
+    begin = sylar::GetCurrentUS();
+    for(int i = 0; i < loops; i++) {
+        result.clear();
+        sylar::Address::Lookup(result, "stub.test:80");
+    }
+    SYLAR_LOG_INFO(g_logger) << "cached lookup " << (sylar::GetCurrentUS() - begin) * 1000.0 / loops << " ns/op";
+
+    test_lookup_cache();
+    close(s_stub_fd);
+}
+
+int main(int argc, char** argv) {
+    sylar::IOManager iom(1);
+    iom.schedule(test_dns);
+    return 0;
+}
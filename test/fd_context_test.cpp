@@ -0,0 +1,90 @@
+#include "../src/fd_manager.h"
+#include "../src/hook.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <random>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_fd_count = 100000;
+static std::vector<int> s_fds;
+
+// 打开尽量多的socket，受RLIMIT_NOFILE限制
+void open_fds() {
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    getrlimit(RLIMIT_NOFILE, &rl);
+    if((rlim_t)s_fd_count + 64 > rl.rlim_cur) {
+        s_fd_count = rl.rlim_cur - 64;
+    }
+
+    while((int)s_fds.size() + 2 <= s_fd_count) {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+            break;
+        }
+        s_fds.push_back(fds[0]);
+        s_fds.push_back(fds[1]);
+    }
+}
+
+void bench() {
+    uint64_t begin = sylar::GetCurrentUS();
+    for(auto fd : s_fds) {
+        sylar::FdMgr::GetInstance()->get(fd, true);
+    }
+    SYLAR_LOG_INFO(g_logger) << "register " << s_fds.size() << " fds used "
+        << (sylar::GetCurrentUS() - begin) << " us";
+
+    std::vector<int> order(s_fds);
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+
+    // 随机顺序访问每个fd的热字段，体现cache miss和指针跳转
+    static const int ROUNDS = 20;
+    uint64_t sum = 0;
+    begin = sylar::GetCurrentUS();
+    for(int r = 0; r < ROUNDS; r++) {
+        for(auto fd : order) {
+            auto ctx = sylar::FdMgr::GetInstance()->get(fd);
+            sum += ctx->getTimeout(SO_RCVTIMEO) + ctx->getSysNonblock() + ctx->isSocket();
+        }
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "FdCtx random access " << (used * 1000.0 / (ROUNDS * order.size()))
+        << " ns/op sum=" << sum;
+
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    begin = sylar::GetCurrentUS();
+    for(auto fd : order) {
+        iom->addEvent(fd, sylar::IOManager::WRITE, [](){});
+    }
+    uint64_t add_used = sylar::GetCurrentUS() - begin;
+    begin = sylar::GetCurrentUS();
+    for(auto fd : order) {
+        iom->delEvent(fd, sylar::IOManager::WRITE);
+    }
+    uint64_t del_used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "addEvent " << (add_used * 1000.0 / order.size()) << " ns/op, delEvent "
+        << (del_used * 1000.0 / order.size()) << " ns/op";
+
+    for(auto fd : s_fds) {
+        close(fd);
+    }
+}
+
+int main(int argc, char** argv) {
+    if(argc > 1) {
+        s_fd_count = atoi(argv[1]);
+    }
+    open_fds();
+    SYLAR_LOG_INFO(g_logger) << "opened " << s_fds.size() << " sockets";
+    sylar::IOManager iom(1);
+    iom.schedule(bench);
+    return 0;
+}
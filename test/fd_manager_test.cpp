@@ -0,0 +1,73 @@
+#include "../src/fd_manager.h"
+#include "../src/hook.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <sys/socket.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_loops = 1000000;
+
+// FdMgr::get 本身的开销
+void bench_get() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    sylar::FdMgr::GetInstance()->get(fds[0], true);
+
+    uint64_t begin = sylar::GetCurrentUS();
+    uint64_t hit = 0;
+    for(int i = 0; i < s_loops; i++) {
+        if(sylar::FdMgr::GetInstance()->get(fds[0])) {
+            ++hit;
+        }
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "FdMgr::get loops=" << s_loops << " hit=" << hit
+        << " " << (used * 1000.0 / s_loops) << " ns/op";
+
+    // 超过64的fd也能自动创建
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(5000, true);
+    SYLAR_LOG_INFO(g_logger) << "auto create fd=5000 ctx=" << ctx;
+    sylar::FdMgr::GetInstance()->del(5000);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// hook住的read和直接调用read_f的差值就是hook路径的开销
+void bench_hook_read() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    sylar::FdMgr::GetInstance()->get(fds[0], true);
+    sylar::FdMgr::GetInstance()->get(fds[1], true);
+
+    char c = 'x';
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < s_loops; i++) {
+        write_f(fds[1], &c, 1);
+        read_f(fds[0], &c, 1);
+    }
+    uint64_t raw_used = sylar::GetCurrentUS() - begin;
+
+    begin = sylar::GetCurrentUS();
+    for(int i = 0; i < s_loops; i++) {
+        write_f(fds[1], &c, 1);
+        read(fds[0], &c, 1);
+    }
+    uint64_t hook_used = sylar::GetCurrentUS() - begin;
+
+    SYLAR_LOG_INFO(g_logger) << "read_f " << (raw_used * 1000.0 / s_loops) << " ns/op, hooked read "
+        << (hook_used * 1000.0 / s_loops) << " ns/op, overhead "
+        << ((double)hook_used - raw_used) * 1000.0 / s_loops << " ns/op";
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main(int argc, char** argv) {
+    bench_get();
+    sylar::IOManager iom(1);
+    iom.schedule(bench_hook_read);
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "../src/fiber_sync.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_fibers = 64;
+static std::atomic<int> s_done(0);
+static std::atomic<bool> s_ticking(false);
+static std::atomic<int> s_ticks(0);
+
+void wait_done(int n) {
+    while(s_done < n) {
+        usleep(1000);
+    }
+}
+
+// 和加锁的协程在同一个IOManager上，统计竞争期间它能跑几次
+void ticker() {
+    while(s_ticking) {
+        usleep(1000);
+        ++s_ticks;
+    }
+    ++s_done;
+}
+
+void busy(uint64_t us) {
+    uint64_t end = sylar::GetCurrentUS() + us;
+    while(sylar::GetCurrentUS() < end);
+}
+
+template<class MutexType>
+void bench_mutex(const char* name, int loops, uint64_t hold_us) {
+    static MutexType s_mutex;
+    static uint64_t s_count;
+    s_count = 0;
+    s_done = 0;
+    s_ticks = 0;
+    s_ticking = true;
+    sylar::IOManager::GetThis()->schedule(ticker);
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < s_fibers; i++) {
+        sylar::IOManager::GetThis()->schedule([loops, hold_us]() {
+            for(int j = 0; j < loops; j++) {
+                typename MutexType::Lock lock(s_mutex);
+                ++s_count;
+                if(hold_us) {
+                    busy(hold_us);
+                }
+            }
+            ++s_done;
+        });
+    }
+    wait_done(s_fibers);
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    s_ticking = false;
+    wait_done(s_fibers + 1);
+    SYLAR_ASSERT(s_count == (uint64_t)s_fibers * loops);
+    SYLAR_LOG_INFO(g_logger) << name << " fibers=" << s_fibers << " hold=" << hold_us << "us "
+        << s_count * 1000000.0 / used << " ops/s used=" << used / 1000 << "ms ticker=" << s_ticks;
+}
+
+// 持有锁期间做会挂起的IO，线程锁在这里会让同线程的协程死锁
+void test_hold_across_yield() {
+    static sylar::FiberMutex s_mutex;
+    static int s_inside = 0;
+    static const int n = 16;
+    s_done = 0;
+    s_ticks = 0;
+    s_ticking = true;
+    sylar::IOManager::GetThis()->schedule(ticker);
+    uint64_t begin = sylar::GetCurrentMS();
+    for(int i = 0; i < n; i++) {
+        sylar::IOManager::GetThis()->schedule([]() {
+            for(int j = 0; j < 10; j++) {
+                sylar::FiberMutex::Lock lock(s_mutex);
+                SYLAR_ASSERT(++s_inside == 1);
+                usleep(1000);
+                --s_inside;
+            }
+            ++s_done;
+        });
+    }
+    wait_done(n);
+    s_ticking = false;
+    wait_done(n + 1);
+    SYLAR_LOG_INFO(g_logger) << "hold across usleep fibers=" << n << " used="
+        << sylar::GetCurrentMS() - begin << "ms ticker=" << s_ticks;
+}
+
+void test_rwmutex() {
+    static sylar::FiberRWMutex s_mutex;
+    static std::atomic<int> s_readers(0);
+    static std::atomic<int> s_writers(0);
+    static int s_value = 0;
+    static const int n = 32;
+    s_done = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < n; i++) {
+        sylar::IOManager::GetThis()->schedule([i]() {
+            for(int j = 0; j < 2000; j++) {
+                if(i % 8 == 0 && j % 10 == 0) {
+                    sylar::FiberRWMutex::WriteLock lock(s_mutex);
+                    SYLAR_ASSERT(++s_writers == 1 && s_readers == 0);
+                    ++s_value;
+                    --s_writers;
+                } else {
+                    sylar::FiberRWMutex::ReadLock lock(s_mutex);
+                    ++s_readers;
+                    SYLAR_ASSERT(s_writers == 0);
+                    if(j % 100 == 0) {
+                        sylar::Fiber::YieldToReady();
+                    }
+                    --s_readers;
+                }
+            }
+            ++s_done;
+        });
+    }
+    wait_done(n);
+    SYLAR_ASSERT(s_value == 4 * 200);
+    SYLAR_LOG_INFO(g_logger) << "rwmutex fibers=" << n << " writes=" << s_value
+        << " used=" << (sylar::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+void test_semaphore() {
+    static sylar::FiberSemaphore s_ping;
+    static sylar::FiberSemaphore s_pong;
+    static const int loops = 100000;
+    s_done = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    sylar::IOManager::GetThis()->schedule([]() {
+        for(int i = 0; i < loops; i++) {
+            s_ping.wait();
+            s_pong.notify();
+        }
+        ++s_done;
+    });
+    sylar::IOManager::GetThis()->schedule([]() {
+        for(int i = 0; i < loops; i++) {
+            s_ping.notify();
+            s_pong.wait();
+        }
+        ++s_done;
+    });
+    wait_done(2);
+    SYLAR_ASSERT(s_ping.getCount() == 0 && s_pong.getCount() == 0);
+    SYLAR_LOG_INFO(g_logger) << "semaphore ping-pong " << (sylar::GetCurrentUS() - begin) * 1000.0 / loops
+        << " ns/round-trip";
+}
+
+void test_condvar() {
+    static sylar::FiberMutex s_mutex;
+    static sylar::FiberCondVar s_cond;
+    static std::deque<int> s_queue;
+    static const int producers = 4;
+    static const int consumers = 4;
+    static const int items = 10000;
+    static std::atomic<long> s_sum(0);
+    s_done = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < consumers; i++) {
+        sylar::IOManager::GetThis()->schedule([]() {
+            while(true) {
+                sylar::FiberMutex::Lock lock(s_mutex);
+                while(s_queue.empty()) {
+                    s_cond.wait(lock);
+                }
+                int v = s_queue.front();
+                s_queue.pop_front();
+                if(v < 0) {
+                    break;
+                }
+                s_sum += v;
+            }
+            ++s_done;
+        });
+    }
+    for(int i = 0; i < producers; i++) {
+        sylar::IOManager::GetThis()->schedule([]() {
+            for(int j = 1; j <= items; j++) {
+                sylar::FiberMutex::Lock lock(s_mutex);
+                s_queue.push_back(j);
+                s_cond.notify();
+            }
+            ++s_done;
+        });
+    }
+    wait_done(producers);
+    {
+        sylar::FiberMutex::Lock lock(s_mutex);
+        for(int i = 0; i < consumers; i++) {
+            s_queue.push_back(-1);
+        }
+        s_cond.notifyAll();
+    }
+    wait_done(producers + consumers);
+    SYLAR_ASSERT(s_sum == (long)producers * items * (items + 1) / 2);
+    SYLAR_LOG_INFO(g_logger) << "condvar " << producers << "x" << consumers << " items="
+        << producers * items << " used=" << (sylar::GetCurrentUS() - begin) / 1000 << "ms";
+
+    sylar::FiberMutex::Lock lock(s_mutex);
+    begin = sylar::GetCurrentMS();
+    bool notified = s_cond.waitFor(lock, 20);
+    uint64_t used = sylar::GetCurrentMS() - begin;
+    SYLAR_ASSERT(!notified && used >= 19);
+    sylar::IOManager::GetThis()->schedule([]() {
+        usleep(5000);
+        sylar::FiberMutex::Lock lock(s_mutex);
+        s_cond.notify();
+    });
+    notified = s_cond.waitFor(lock, 1000);
+    SYLAR_LOG_INFO(g_logger) << "waitFor timeout used=" << used << "ms, notified=" << notified;
+    SYLAR_ASSERT(notified);
+}
+
+void run() {
+    bench_mutex<sylar::Mutex>("Mutex", 20000, 0);
+    bench_mutex<sylar::Spinlock>("Spinlock", 20000, 0);
+    bench_mutex<sylar::FiberMutex>("FiberMutex", 20000, 0);
+    // 临界区200us，线程锁让等锁的线程整个停住
+    bench_mutex<sylar::Mutex>("Mutex", 20, 200);
+    bench_mutex<sylar::FiberMutex>("FiberMutex", 20, 200);
+    test_hold_across_yield();
+    test_rwmutex();
+    test_semaphore();
+    test_condvar();
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    sylar::IOManager iom(2, false, "sync");
+    iom.schedule(run);
+    return 0;
+}
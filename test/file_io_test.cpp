@@ -0,0 +1,83 @@
+#include "../src/file_io.h"
+#include "../src/hook.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include "../src/config.h"
+#include "../src/macro.h"
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const size_t s_block_size = 1024 * 1024;
+static const size_t s_block_count = 64;
+static int s_ticks = 0;
+static bool s_running = false;
+
+// 同线程的心跳协程，文件IO卸载出去之后它在IO期间也能跑
+void heartbeat() {
+    while(s_running) {
+        usleep(1000);
+        ++s_ticks;
+    }
+}
+
+void test_file_io() {
+    const char *path = "/tmp/sylar_file_io_test.dat";
+    // 每块内容不同，读回来能看出偏移有没有错
+    std::string block(s_block_size, 'x');
+
+    s_running = true;
+    sylar::IOManager::GetThis()->schedule(heartbeat);
+
+    uint64_t begin = sylar::GetCurrentMS();
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    SYLAR_ASSERT(fd >= 0);
+    for(size_t i = 0; i < s_block_count; i++) {
+        memset(&block[0], 'a' + i % 26, block.size());
+        if(write(fd, block.c_str(), block.size()) != (ssize_t)block.size()) {
+            SYLAR_LOG_ERROR(g_logger) << "write fail errno=" << errno << " " << strerror(errno);
+            break;
+        }
+    }
+    fsync(fd);
+
+    size_t total = 0;
+    std::string buf(s_block_size, '\0');
+    for(size_t i = 0; i < s_block_count; i++) {
+        ssize_t n = pread(fd, &buf[0], buf.size(), i * s_block_size);
+        if(n <= 0) {
+            break;
+        }
+        SYLAR_ASSERT(buf.find_first_not_of((char)('a' + i % 26), 0) == std::string::npos);
+        total += n;
+    }
+    close(fd);
+    unlink(path);
+    s_running = false;
+
+    SYLAR_LOG_INFO(g_logger) << "file io offload=" << sylar::FileIOMgr::GetInstance()->isEnabled()
+        << " bytes=" << total << " used=" << sylar::GetCurrentMS() - begin
+        << "ms heartbeat ticks=" << s_ticks;
+    SYLAR_ASSERT(total == s_block_size * s_block_count);
+    // 卸载打开时IO期间同线程的协程也要能跑
+    if(sylar::FileIOMgr::GetInstance()->isEnabled()) {
+        SYLAR_ASSERT(s_ticks > 0);
+    }
+
+    // 打开不存在的文件，errno要带回来
+    fd = open("/tmp/sylar_file_io_test/not_exist", O_RDONLY);
+    int err = errno;
+    SYLAR_LOG_INFO(g_logger) << "open not exist rt=" << fd << " errno=" << strerror(err);
+    SYLAR_ASSERT(fd == -1 && err == ENOENT);
+}
+
+// ./test_file_io direct 关掉卸载做对比
+int main(int argc, char** argv) {
+    if(argc > 1 && strcmp(argv[1], "direct") == 0) {
+        sylar::Config::Lookup<uint32_t>("file_io.threads")->setValue(0);
+    }
+    sylar::IOManager iom(1);
+    iom.schedule(test_file_io);
+    return 0;
+}
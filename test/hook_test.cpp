@@ -2,11 +2,15 @@
 #include "../src/IOManager.h"
 #include "../src/log.h"
 #include "../src/timer.h"
+#include "../src/fd_manager.h"
 #include <iostream>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/un.h>
+#include <poll.h>
 #include <fcntl.h>
 #include <memory>
 #include <string.h>
@@ -66,9 +70,259 @@ void test_sock() {
 }
 
 
+// 每次读不满之后再读，直接挂起等epoll，不再多调一次必然EAGAIN的read
+void test_readiness() {
+    static int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    sylar::FdMgr::GetInstance()->get(fds[0], true);
+    sylar::FdMgr::GetInstance()->get(fds[1], true);
+
+    sylar::IOManager::GetThis()->schedule([](){
+        char buf[64];
+        for(int i = 0; i < 100; i++) {
+            if(read(fds[0], buf, sizeof(buf)) <= 0) {
+                break;
+            }
+        }
+        auto stats = sylar::get_hook_io_stats();
+        SYLAR_LOG_INFO(hook_logger) << "test_readiness avoided_syscalls=" << stats.avoided_syscalls
+            << " eagain_syscalls=" << stats.eagain_syscalls;
+        close(fds[0]);
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        for(int i = 0; i < 100; i++) {
+            write(fds[1], "hello", 5);
+            usleep(2000);
+        }
+        close(fds[1]);
+    });
+}
+
+// 文件经sendfile写进socket，另一端用splice搬进pipe，socket缓冲区满/空时都挂起等epoll
+void test_sendfile() {
+    static int fds[2];
+    static const size_t s_file_size = 4 * 1024 * 1024;
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    sylar::FdMgr::GetInstance()->get(fds[0], true);
+    sylar::FdMgr::GetInstance()->get(fds[1], true);
+
+    sylar::IOManager::GetThis()->schedule([](){
+        char path[] = "/tmp/hook_sendfile_XXXXXX";
+        int file = mkstemp(path);
+        unlink(path);
+        std::string data(s_file_size, 'x');
+        write(file, data.c_str(), data.size());
+
+        off_t offset = 0;
+        while((size_t)offset < s_file_size) {
+            ssize_t rt = sendfile(fds[0], file, &offset, s_file_size - offset);
+            if(rt <= 0) {
+                SYLAR_LOG_ERROR(hook_logger) << "sendfile rt=" << rt << " errno=" << errno;
+                break;
+            }
+        }
+        SYLAR_LOG_INFO(hook_logger) << "sendfile done offset=" << offset;
+        close(file);
+        close(fds[0]);
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        int pipefd[2];
+        pipe(pipefd);
+        sylar::FdMgr::GetInstance()->get(pipefd[0], true);
+        sylar::FdMgr::GetInstance()->get(pipefd[1], true);
+        char buf[64 * 1024];
+        size_t total = 0;
+        while(true) {
+            ssize_t rt = splice(fds[1], nullptr, pipefd[1], nullptr, sizeof(buf), SPLICE_F_MOVE);
+            if(rt <= 0) {
+                break;
+            }
+            total += read(pipefd[0], buf, rt);
+        }
+        SYLAR_LOG_INFO(hook_logger) << "splice total=" << total << " expect=" << s_file_size;
+        close(pipefd[0]);
+        close(pipefd[1]);
+        close(fds[1]);
+    });
+}
+
+// 第三方库的poll/select/epoll_wait/accept4只挂起当前协程，同线程的心跳协程照常运行
+static int s_ticks = 0;
+
+void test_poll() {
+    static int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    sylar::FdMgr::GetInstance()->get(fds[0], true);
+    sylar::FdMgr::GetInstance()->get(fds[1], true);
+
+    sylar::IOManager::GetThis()->schedule([](){
+        for(int i = 0; i < 20; i++) {
+            usleep(5000);
+            ++s_ticks;
+        }
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        usleep(30000);
+        write(fds[1], "a", 1);
+        usleep(30000);
+        write(fds[1], "b", 1);
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        char c;
+        struct pollfd pfd = {fds[0], POLLIN, 0};
+        int ticks = s_ticks;
+        int rt = poll(&pfd, 1, 1000);
+        read(fds[0], &c, 1);
+        SYLAR_LOG_INFO(hook_logger) << "poll rt=" << rt << " revents=" << pfd.revents
+            << " ticks while parked=" << s_ticks - ticks;
+
+        fd_set rset;
+        FD_ZERO(&rset);
+        FD_SET(fds[0], &rset);
+        struct timeval tv = {0, 10000};
+        rt = select(fds[0] + 1, &rset, nullptr, nullptr, &tv);
+        SYLAR_LOG_INFO(hook_logger) << "select timeout rt=" << rt;
+
+        int epfd = epoll_create(1);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fds[0];
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev);
+        ticks = s_ticks;
+        rt = epoll_wait(epfd, &ev, 1, 1000);
+        SYLAR_LOG_INFO(hook_logger) << "epoll_wait rt=" << rt << " fd=" << ev.data.fd
+            << " ticks while parked=" << s_ticks - ticks;
+        close(epfd);
+        close(fds[0]);
+        close(fds[1]);
+    });
+}
+
+void test_accept4() {
+    static const char *path = "/tmp/hook_accept4.sock";
+    unlink(path);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    static int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(listen_fd, 16);
+
+    sylar::IOManager::GetThis()->schedule([addr](){
+        usleep(10000);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        connect(fd, (const struct sockaddr *)&addr, sizeof(addr));
+        close(fd);
+    });
+
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
+    SYLAR_LOG_INFO(hook_logger) << "accept4 fd=" << fd << " user_nonblock=" << (ctx && ctx->getUserNonblock());
+    close(fd);
+    close(listen_fd);
+    unlink(path);
+}
+
+// 同一个fd重复出现、events为0只等挂断、fd已经有别的协程在读，这几种poll都不能触发addEvent的断言
+void test_poll_corner() {
+    static int a[2];
+    static int c[2];
+    static int d[2];
+    for(int *p : {a, c, d}) {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, p);
+        sylar::FdMgr::GetInstance()->get(p[0], true);
+        sylar::FdMgr::GetInstance()->get(p[1], true);
+    }
+
+    sylar::IOManager::GetThis()->schedule([](){
+        usleep(10000);
+        write(a[1], "x", 1);
+        close(d[1]);
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        struct pollfd pfds[2] = {{a[0], POLLIN, 0}, {a[0], POLLIN, 0}};
+        int rt = poll(pfds, 2, 1000);
+        SYLAR_LOG_INFO(hook_logger) << "poll duplicate fd rt=" << rt;
+
+        struct pollfd hup = {d[0], 0, 0};
+        rt = poll(&hup, 1, 1000);
+        SYLAR_LOG_INFO(hook_logger) << "poll events=0 rt=" << rt << " pollhup=" << !!(hup.revents & POLLHUP);
+        close(a[0]);
+        close(a[1]);
+        close(d[0]);
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        char ch;
+        read(c[0], &ch, 1);
+    });
+
+    // 不超时地poll一个被占着的fd，写数据的协程和poll在同一个线程上，poll不能把线程卡住
+    sylar::IOManager::GetThis()->schedule([](){
+        struct pollfd pfd = {c[0], POLLIN, 0};
+        int rt = poll(&pfd, 1, -1);
+        SYLAR_LOG_INFO(hook_logger) << "poll busy fd rt=" << rt << " revents=" << pfd.revents;
+        close(c[0]);
+        close(c[1]);
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        usleep(20000);
+        write(c[1], "yz", 2);
+    });
+}
+
+// pipe和socket一样设成非阻塞进epoll，读空的pipe只挂起当前协程
+void test_pipe() {
+    static int p[2];
+    static int q[2];
+    static int ticks = 0;
+    pipe(p);
+    pipe(q);
+    for(int fd : {p[0], p[1], q[0], q[1]}) {
+        sylar::FdMgr::GetInstance()->get(fd, true);
+    }
+
+    sylar::IOManager::GetThis()->schedule([](){
+        for(int i = 0; i < 10; i++) {
+            usleep(5000);
+            ++ticks;
+        }
+        write(p[1], "hello", 5);
+    });
+
+    sylar::IOManager::GetThis()->schedule([](){
+        // tee在p读空时挂起，数据到了之后复制到q，p里的数据还在
+        ssize_t n = tee(p[0], q[1], 5, 0);
+        char buf[8] = {0};
+        char copy[8] = {0};
+        read(p[0], buf, sizeof(buf));
+        read(q[0], copy, sizeof(copy));
+        int flags = fcntl(p[0], F_GETFL);
+        SYLAR_LOG_INFO(hook_logger) << "tee n=" << n << " read=" << buf << " copy=" << copy
+            << " ticks while parked=" << ticks << " user sees O_NONBLOCK=" << !!(flags & O_NONBLOCK);
+        for(int fd : {p[0], p[1], q[0], q[1]}) {
+            close(fd);
+        }
+    });
+}
+
 int main() {
     //test_sleep();
     sylar::IOManager iom;
     iom.schedule(test_sock);
+    iom.schedule(test_readiness);
+    iom.schedule(test_sendfile);
+    iom.schedule(test_poll);
+    iom.schedule(test_poll_corner);
+    iom.schedule(test_accept4);
+    iom.schedule(test_pipe);
     return 0;
 }
@@ -0,0 +1,203 @@
+#include "../src/http_connection.h"
+#include "../src/http_server.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_slow_running(0);
+static std::atomic<int> s_slow_peak(0);
+
+// 服务端的socket要在IOManager的协程里创建，hook才会接管
+void run_server(sylar::IOManager* iom, sylar::http::HttpServer::ptr* out) {
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, iom, iom));
+    auto sd = server->getServletDispatch();
+    sd->addServlet("/hello", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody("hello world");
+        return 0;
+    });
+    sd->addServlet("/echo", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody(req->getBody().data, req->getBody().size);
+        return 0;
+    });
+    // 记录同时在处理的请求数
+    sd->addServlet("/slow", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        int n = ++s_slow_running;
+        int peak = s_slow_peak;
+        while(n > peak && !s_slow_peak.compare_exchange_weak(peak, n));
+        usleep(10 * 1000);
+        --s_slow_running;
+        rsp->setBody("slow");
+        return 0;
+    });
+    server->bind(sylar::IPv4Address::Create("127.0.0.1", 0));
+    server->start();
+    *out = server;
+}
+
+void test_functional(uint16_t port) {
+    sylar::http::HttpClient* client = sylar::http::HttpClientMgr::GetInstance();
+    std::string base = "http://127.0.0.1:" + std::to_string(port);
+
+    auto r = client->doGet(base + "/hello?a=1", {{"Accept", "*/*"}});
+    SYLAR_ASSERT(r->result == 0 && r->response->getBody() == "hello world");
+    SYLAR_LOG_INFO(g_logger) << "GET /hello status=" << (int)r->response->getStatus()
+        << " body=" << r->response->getBody() << " server=" << r->response->getHeader("server");
+
+    r = client->doPost(base + "/echo", "ping");
+    SYLAR_ASSERT(r->result == 0 && r->response->getBody() == "ping");
+    r = client->doGet(base + "/nope");
+    SYLAR_ASSERT(r->result == 0 && r->response->getStatus() == sylar::http::HttpStatus::NOT_FOUND);
+    r = client->doRequest(sylar::http::HttpMethod::HEAD, base + "/hello");
+    SYLAR_ASSERT(r->result == 0 && r->response->getBody().empty());
+
+    auto pool = client->getPool("127.0.0.1", port);
+    SYLAR_LOG_INFO(g_logger) << "4 requests connections=" << pool->getConnectionCount()
+        << " created=" << pool->getCreatedCount();
+
+    r = client->doGet("https://127.0.0.1/");
+    SYLAR_ASSERT(r->result == (int)sylar::http::HttpResult::Error::INVALID_URL);
+
+    // 端口1上没有服务
+    r = client->doGet("http://127.0.0.1:1/");
+    SYLAR_LOG_INFO(g_logger) << "connect refused result=" << r->result << " error=" << r->error;
+    SYLAR_ASSERT(r->result == (int)sylar::http::HttpResult::Error::CONNECT_FAIL);
+    client->close();
+}
+
+static const int s_fibers = 16;
+static const int s_requests = 1000;
+static std::atomic<int> s_done(0);
+static std::atomic<int> s_fail(0);
+
+void run_fresh(sylar::Address::ptr addr) {
+    std::string data;
+    sylar::http::HttpConnection::EncodeRequest(data, sylar::http::HttpMethod::GET, "bench", "/hello"
+            , sylar::http::HttpResult::Headers(), "");
+    for(int i = 0; i < s_requests; i++) {
+        auto conn = sylar::http::HttpConnection::Create(addr, 5000);
+        if(!conn || conn->sendRequest(data) <= 0 || conn->recvResponse()->result) {
+            ++s_fail;
+        }
+    }
+    ++s_done;
+}
+
+void run_pooled(sylar::http::HttpConnectionPool::ptr pool) {
+    for(int i = 0; i < s_requests; i++) {
+        auto r = pool->doGet("/hello");
+        if(r->result || r->response->getBody() != "hello world") {
+            ++s_fail;
+        }
+    }
+    ++s_done;
+}
+
+void wait_done(int n) {
+    while(s_done < n) {
+        usleep(1000);
+    }
+}
+
+void bench(const std::string& name, std::function<void()> cb, sylar::http::HttpConnectionPool::ptr pool) {
+    s_done = 0;
+    s_fail = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < s_fibers; i++) {
+        sylar::IOManager::GetThis()->schedule(cb);
+    }
+    wait_done(s_fibers);
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << name << " fibers=" << s_fibers << " requests=" << s_fibers * s_requests
+        << " fail=" << s_fail << " " << s_fibers * s_requests * 1000000.0 / used << " req/s"
+        << " connections=" << (pool ? pool->getCreatedCount() : s_fibers * s_requests);
+    SYLAR_ASSERT(s_fail == 0);
+}
+
+void test_bench(sylar::Address::ptr addr, uint16_t port) {
+    bench("fresh connection", std::bind(run_fresh, addr), nullptr);
+
+    sylar::http::HttpConnectionPool::ptr pool(new sylar::http::HttpConnectionPool("127.0.0.1", port));
+    pool->setMaxConnections(s_fibers);
+    pool->setPipelineDepth(1);
+    bench("pooled", std::bind(run_pooled, pool), pool);
+    pool->close();
+
+    // 两个连接，每个连接最多8个请求在途
+    pool.reset(new sylar::http::HttpConnectionPool("127.0.0.1", port));
+    pool->setMaxConnections(2);
+    pool->setPipelineDepth(8);
+    bench("pipelined", std::bind(run_pooled, pool), pool);
+    pool->close();
+}
+
+void test_limit_and_idle(uint16_t port) {
+    sylar::http::HttpConnectionPool::ptr pool(new sylar::http::HttpConnectionPool("127.0.0.1", port));
+    pool->setMaxConnections(8);
+    pool->setPipelineDepth(1);
+    pool->setMaxInFlight(4);
+    pool->setIdleTimeout(100);
+
+    static const int n = 32;
+    s_done = 0;
+    s_fail = 0;
+    uint64_t begin = sylar::GetCurrentMS();
+    for(int i = 0; i < n; i++) {
+        sylar::IOManager::GetThis()->schedule([pool]() {
+            auto r = pool->doGet("/slow");
+            if(r->result || r->response->getBody() != "slow") {
+                ++s_fail;
+            }
+            ++s_done;
+        });
+    }
+    wait_done(n);
+    SYLAR_LOG_INFO(g_logger) << "max_in_flight=4 requests=" << n << " fail=" << s_fail
+        << " server peak=" << s_slow_peak << " used=" << sylar::GetCurrentMS() - begin << "ms"
+        << " connections=" << pool->getConnectionCount();
+    SYLAR_ASSERT(s_fail == 0 && s_slow_peak <= 4);
+
+    // 空闲100ms后由定时器关闭
+    usleep(50 * 1000);
+    size_t idle = pool->getIdleCount();
+    usleep(200 * 1000);
+    SYLAR_LOG_INFO(g_logger) << "idle after 50ms=" << idle << " after 250ms connections="
+        << pool->getConnectionCount() << " evicted=" << pool->getEvictedCount();
+    SYLAR_ASSERT(idle == 4 && pool->getConnectionCount() == 0 && pool->getEvictedCount() == 4);
+    pool->close();
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    sylar::IOManager server_iom(2, false, "http");
+    static sylar::http::HttpServer::ptr s_server;
+    server_iom.schedule(std::bind(run_server, &server_iom, &s_server));
+    while(!s_server) {
+        usleep(1000);
+    }
+    sylar::http::HttpServer::ptr server = s_server;
+    sylar::Address::ptr addr = server->getSocks()[0]->getLocalAddress();
+    uint16_t port = std::dynamic_pointer_cast<sylar::IPAddress>(addr)->getPort();
+
+    {
+        sylar::IOManager client_iom(1, true, "client");
+        client_iom.schedule([addr, port, server]() {
+            test_functional(port);
+            test_bench(addr, port);
+            test_limit_and_idle(port);
+            server->stop();
+        });
+    }
+    s_server.reset();
+    return 0;
+}
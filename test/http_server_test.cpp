@@ -0,0 +1,247 @@
+#include "../src/http_server.h"
+#include "../src/http_parser.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <algorithm>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 客户端连接，响应按content-length切分
+struct Conn {
+    Conn(sylar::Address::ptr addr)
+        :sock(sylar::Socket::CreateTCP(addr))
+        ,begin(0)
+        ,end(0) {
+        sock->connect(addr);
+        buf.resize(64 * 1024);
+    }
+
+    // 返回状态码，连接断开返回-1
+    int readResponse(std::string* body = nullptr) {
+        parser.reset();
+        size_t head = 0;
+        while(!(head = parser.execute(&buf[begin], end - begin))) {
+            if(parser.hasError() || !fill()) {
+                return -1;
+            }
+        }
+        size_t len = parser.getContentLength();
+        while(end - begin < head + len) {
+            if(!fill()) {
+                return -1;
+            }
+        }
+        if(body) {
+            body->assign(&buf[begin + head], len);
+        }
+        begin += head + len;
+        return (int)parser.getStatus();
+    }
+
+    bool fill() {
+        if(begin == end) {
+            begin = end = 0;
+        } else if(end == buf.size()) {
+            memmove(&buf[0], &buf[begin], end - begin);
+            end -= begin;
+            begin = 0;
+        }
+        int rt = sock->recv(&buf[end], buf.size() - end);
+        if(rt <= 0) {
+            return false;
+        }
+        end += rt;
+        return true;
+    }
+
+    bool send(const std::string& data) {
+        return sock->send(data.c_str(), data.size()) == (int)data.size();
+    }
+
+    sylar::Socket::ptr sock;
+    std::string buf;
+    size_t begin;
+    size_t end;
+    sylar::http::HttpResponseParser parser;
+};
+
+void test_functional(sylar::Address::ptr addr) {
+    Conn conn(addr);
+    std::string body;
+    conn.send("GET /hello?a=1 HTTP/1.1\r\nHost: test\r\n\r\n");
+    int status = conn.readResponse(&body);
+    SYLAR_LOG_INFO(g_logger) << "GET /hello status=" << status << " body=" << body
+        << " keep-alive=" << !conn.parser.isClose();
+    SYLAR_ASSERT(status == 200 && body == "hello world" && !conn.parser.isClose());
+
+    // 三个请求一次发出去，响应按顺序回来
+    conn.send("GET /hello HTTP/1.1\r\n\r\nGET /nope HTTP/1.1\r\n\r\n"
+              "POST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello");
+    int s1 = conn.readResponse();
+    int s2 = conn.readResponse();
+    int s3 = conn.readResponse(&body);
+    SYLAR_LOG_INFO(g_logger) << "pipelined status=" << s1 << "," << s2 << "," << s3 << " echo=" << body;
+    SYLAR_ASSERT(s1 == 200 && s2 == 404 && s3 == 200 && body == "hello");
+
+    // chunked body分两次发
+    conn.send("POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n8;ext=1\r\n, wor");
+    usleep(10 * 1000);
+    conn.send("ld!\r\n0\r\n\r\n");
+    status = conn.readResponse(&body);
+    SYLAR_LOG_INFO(g_logger) << "chunked echo status=" << status << " body=" << body;
+    SYLAR_ASSERT(status == 200 && body == "hello, world!" && !conn.parser.isClose());
+
+    // HTTP/1.0默认短连接，响应之后服务端关闭
+    conn.send("GET /static/a.css HTTP/1.0\r\n\r\n");
+    status = conn.readResponse(&body);
+    bool close = conn.parser.isClose();
+    int next = conn.readResponse();
+    SYLAR_LOG_INFO(g_logger) << "glob status=" << status << " body=" << body
+        << " close=" << close << " next=" << next;
+    SYLAR_ASSERT(status == 200 && body == "static /static/a.css" && close && next == -1);
+
+    // 消息边界有歧义的请求都要400，不能交给servlet
+    const char* smuggling[] = {
+        "POST /echo HTTP/1.1\r\nContent-Length: 1\r\nTransfer-Encoding: chunked\r\n\r\n",
+        "POST /echo HTTP/1.1\r\nContent-Length: 1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: identity\r\n\r\n",
+        "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n",
+        "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n",
+        "POST /echo HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+    };
+    for(auto req : smuggling) {
+        Conn bad(addr);
+        bad.send(req);
+        status = bad.readResponse();
+        SYLAR_LOG_INFO(g_logger) << "smuggling request status=" << status;
+        SYLAR_ASSERT(status == 400);
+    }
+}
+
+static const int s_conns = 16;
+static const int s_requests = 2000;
+static std::atomic<int> s_done(0);
+static std::vector<uint64_t> s_latency;
+
+void run_conn(sylar::Address::ptr addr, int depth, bool record) {
+    Conn conn(addr);
+    std::string req;
+    for(int i = 0; i < depth; i++) {
+        req += "GET /hello HTTP/1.1\r\nHost: bench\r\nUser-Agent: sylar-bench\r\nAccept: */*\r\n\r\n";
+    }
+    for(int i = 0; i < s_requests / depth; i++) {
+        uint64_t begin = sylar::GetCurrentUS();
+        conn.send(req);
+        for(int j = 0; j < depth; j++) {
+            if(conn.readResponse() != 200) {
+                SYLAR_LOG_ERROR(g_logger) << "bad response";
+                ++s_done;
+                return;
+            }
+        }
+        if(record) {
+            s_latency.push_back(sylar::GetCurrentUS() - begin);
+        }
+    }
+    ++s_done;
+}
+
+void bench(sylar::Address::ptr addr, int depth) {
+    s_done = 0;
+    s_latency.clear();
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < s_conns; i++) {
+        sylar::IOManager::GetThis()->schedule(std::bind(run_conn, addr, depth, i == 0));
+    }
+    while(s_done < s_conns) {
+        usleep(1000);
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    std::sort(s_latency.begin(), s_latency.end());
+    SYLAR_LOG_INFO(g_logger) << "conns=" << s_conns << " depth=" << depth
+        << " requests=" << s_conns * s_requests << " "
+        << s_conns * s_requests * 1000000.0 / used << " req/s"
+        << " p50=" << s_latency[s_latency.size() / 2] << "us"
+        << " p99=" << s_latency[s_latency.size() * 99 / 100] << "us";
+}
+
+void bench_parser() {
+    std::string req = "GET /api/v1/users/12345?fields=name,email HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Cookie: session=abcdef0123456789; theme=dark\r\n"
+        "Connection: keep-alive\r\n\r\n";
+    sylar::http::HttpRequestParser parser;
+    sylar::http::HttpRequest request;
+    static const int loops = 200000;
+    uint64_t begin = sylar::GetCurrentUS();
+    size_t total = 0;
+    for(int i = 0; i < loops; i++) {
+        parser.reset();
+        total += parser.execute(req.c_str(), req.size(), request);
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "parse " << req.size() << " byte request " << used * 1000.0 / loops
+        << " ns/op " << total / used << " MB/s headers=" << request.getHeaderCount()
+        << " path=" << request.getPath() << " query=" << request.getQuery();
+}
+
+// 服务端的socket要在IOManager的协程里创建，hook才会接管
+void run_server(sylar::IOManager* iom, sylar::http::HttpServer::ptr* out) {
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, iom, iom));
+    auto sd = server->getServletDispatch();
+    sd->addServlet("/hello", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody("hello world");
+        return 0;
+    });
+    sd->addServlet("/echo", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody(req->getBody().data, req->getBody().size);
+        return 0;
+    });
+    sd->addGlobServlet("/static/*", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody("static " + req->getPath().toString());
+        return 0;
+    });
+    server->bind(sylar::IPv4Address::Create("127.0.0.1", 0));
+    server->start();
+    *out = server;
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    bench_parser();
+
+    sylar::IOManager server_iom(2, false, "http");
+    static sylar::http::HttpServer::ptr s_server;
+    server_iom.schedule(std::bind(run_server, &server_iom, &s_server));
+    while(!s_server) {
+        usleep(1000);
+    }
+    sylar::http::HttpServer::ptr server = s_server;
+    sylar::Address::ptr addr = server->getSocks()[0]->getLocalAddress();
+
+    {
+        sylar::IOManager client_iom(1, true, "client");
+        client_iom.schedule([addr, server]() {
+            test_functional(addr);
+            bench(addr, 1);
+            bench(addr, 16);
+            server->stop();
+        });
+    }
+    s_server.reset();
+    return 0;
+}
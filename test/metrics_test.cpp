@@ -0,0 +1,190 @@
+#include "../src/metrics.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/config.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static double find_sample(const std::string& name, const std::string& labels) {
+    for(auto& i : sylar::MetricsMgr::GetInstance()->snapshot()) {
+        if(i.name == name && i.labels == labels) {
+            return i.value;
+        }
+    }
+    return -1;
+}
+
+void test_registry() {
+    sylar::Counter::ptr counter(new sylar::Counter);
+    sylar::Gauge::ptr gauge(new sylar::Gauge);
+    int owner = 0;
+    auto metrics = sylar::MetricsMgr::GetInstance();
+    metrics->add("test_requests_total", {{"path", "/a\"b"}}, "Requests.", counter, &owner);
+    metrics->add("test_inflight", {}, "In flight.", gauge, &owner);
+
+    std::vector<sylar::Thread::ptr> thrs;
+    for(int i = 0; i < 4; i++) {
+        thrs.push_back(std::make_shared<sylar::Thread>([counter]() {
+            for(int j = 0; j < 100000; j++) {
+                counter->add();
+            }
+        }, "counter_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    gauge->set(3);
+    gauge->updateMax(2);
+    SYLAR_ASSERT(gauge->get() == 3);
+    gauge->updateMax(7);
+    SYLAR_ASSERT(counter->get() == 400000 && gauge->get() == 7);
+    SYLAR_ASSERT(find_sample("test_requests_total", "{path=\"/a\\\"b\"}") == 400000);
+    // 同名同标签不能重复注册
+    SYLAR_ASSERT(!metrics->add("test_inflight", {}, "In flight.", std::make_shared<sylar::Gauge>(), &owner));
+
+    std::string text = metrics->toPrometheus();
+    SYLAR_ASSERT(text.find("# TYPE test_requests_total counter\n") != std::string::npos);
+    SYLAR_ASSERT(text.find("test_inflight 7\n") != std::string::npos);
+    metrics->remove(&owner);
+    SYLAR_ASSERT(find_sample("test_inflight", "") == -1);
+}
+
+void test_histogram() {
+    sylar::Histogram::ptr hist(new sylar::Histogram);
+    SYLAR_ASSERT(hist->percentile(0.5) == 0);
+    for(uint64_t i = 1; i <= 1000; i++) {
+        hist->record(i);
+    }
+    hist->record(0);
+    hist->record(UINT64_MAX / 2);
+    SYLAR_ASSERT(hist->getCount() == 1002);
+    // 每个桶的相对误差不超过1/8
+    uint64_t p50 = hist->percentile(0.5);
+    uint64_t p99 = hist->percentile(0.99);
+    SYLAR_LOG_INFO(g_logger) << "p50=" << p50 << " p99=" << p99;
+    SYLAR_ASSERT(p50 >= 500 && p50 <= 500 * 9 / 8);
+    SYLAR_ASSERT(p99 >= 990 && p99 <= 990 * 9 / 8);
+    SYLAR_ASSERT(hist->percentile(0) == 0);
+    SYLAR_ASSERT(hist->percentile(1) >= UINT64_MAX / 2);
+
+    int owner = 0;
+    auto metrics = sylar::MetricsMgr::GetInstance();
+    metrics->add("test_latency", {{"op", "get"}}, "Latency.", hist, &owner);
+    std::string text = metrics->toPrometheus();
+    SYLAR_ASSERT(text.find("# TYPE test_latency histogram\n") != std::string::npos);
+    SYLAR_ASSERT(text.find("test_latency_bucket{op=\"get\",le=\"0\"} 1\n") != std::string::npos);
+    SYLAR_ASSERT(text.find("test_latency_bucket{op=\"get\",le=\"1023\"} 1001\n") != std::string::npos);
+    SYLAR_ASSERT(text.find("test_latency_bucket{op=\"get\",le=\"+Inf\"} 1002\n") != std::string::npos);
+    SYLAR_ASSERT(text.find("test_latency_count{op=\"get\"} 1002\n") != std::string::npos);
+    metrics->remove(&owner);
+}
+
+// 分槽计数器和单个原子变量在多线程下的对比
+void bench_counter(int threads) {
+    static const int loops = 2000000;
+    static std::atomic<uint64_t> s_atomic(0);
+    sylar::Counter counter;
+    for(int k = 0; k < 2; k++) {
+        std::vector<sylar::Thread::ptr> thrs;
+        uint64_t begin = sylar::GetCurrentUS();
+        for(int i = 0; i < threads; i++) {
+            thrs.push_back(std::make_shared<sylar::Thread>([&counter, k]() {
+                for(int j = 0; j < loops; j++) {
+                    if(k == 0) {
+                        s_atomic.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        counter.add();
+                    }
+                }
+            }, "bench_" + std::to_string(i)));
+        }
+        for(auto& i : thrs) {
+            i->join();
+        }
+        uint64_t used = sylar::GetCurrentUS() - begin;
+        SYLAR_LOG_INFO(g_logger) << (k == 0 ? "shared atomic" : "sharded counter")
+            << " threads=" << threads << " " << (double)threads * loops * 1000000.0 / used << " adds/s";
+    }
+}
+
+void test_runtime() {
+    static std::atomic<int> s_done(0);
+    {
+        sylar::IOManager iom(2, false, "metrics");
+        // 同名的调度器靠instance标签区分，不会互相覆盖
+        sylar::IOManager other(1, false, "metrics");
+        for(int i = 0; i < 1000; i++) {
+            iom.schedule([]() {
+                ++s_done;
+            });
+        }
+        for(int i = 0; i < 10; i++) {
+            iom.addTimer(10 + i, []() {
+                ++s_done;
+            });
+        }
+        while(s_done < 1010) {
+            usleep(1000);
+        }
+        usleep(10000);
+        std::string text = sylar::MetricsMgr::GetInstance()->toPrometheus();
+        SYLAR_LOG_INFO(g_logger) << "prometheus:\n" << text;
+
+        const std::string labels = "{instance=\"" + std::to_string(iom.getId()) + "\",scheduler=\"metrics\"}";
+        const std::string other_labels = "{instance=\"" + std::to_string(other.getId()) + "\",scheduler=\"metrics\"}";
+        SYLAR_ASSERT(find_sample("sylar_scheduler_tasks_total", other_labels) == 0);
+        SYLAR_ASSERT(find_sample("sylar_scheduler_tasks_total", labels) >= 1010);
+        SYLAR_ASSERT(find_sample("sylar_scheduler_queue_depth", labels) == 0);
+        SYLAR_ASSERT(find_sample("sylar_iomanager_epoll_wakeups_total", labels) > 0);
+        SYLAR_ASSERT(find_sample("sylar_timers_added_total", labels) == 10);
+        SYLAR_ASSERT(find_sample("sylar_timers_fired_total", labels) == 10);
+        SYLAR_ASSERT(find_sample("sylar_timers", labels) == 0);
+        SYLAR_ASSERT(find_sample("sylar_fibers", "") > 0);
+        SYLAR_ASSERT(find_sample("sylar_scheduler_queue_wait_microseconds", labels) >= 1010);
+        SYLAR_ASSERT(find_sample("sylar_scheduler_run_microseconds", labels) >= 1010);
+    }
+    // 调度器析构后它的指标都摘掉了
+    for(auto& i : sylar::MetricsMgr::GetInstance()->snapshot()) {
+        SYLAR_ASSERT(i.labels.find("scheduler=\"metrics\"") == std::string::npos);
+    }
+}
+
+// 不让出的任务超过阈值会被记下来，打出调用栈
+void busy_task() {
+    uint64_t begin = sylar::GetCurrentMS();
+    while(sylar::GetCurrentMS() - begin < 200) {
+    }
+}
+
+void test_slow_task() {
+    sylar::Config::Lookup<uint64_t>("scheduler.slow_task_threshold")->setValue(50);
+    {
+        sylar::IOManager iom(1, false, "slow");
+        iom.schedule(busy_task);
+        usleep(400 * 1000);
+        const std::string labels = "{instance=\"" + std::to_string(iom.getId()) + "\",scheduler=\"slow\"}";
+        SYLAR_ASSERT(find_sample("sylar_scheduler_slow_tasks_total", labels) == 1);
+        iom.schedule([]() {
+            usleep(200 * 1000);
+        });
+        usleep(300 * 1000);
+        // 挂起等待的不算
+        SYLAR_ASSERT(find_sample("sylar_scheduler_slow_tasks_total", labels) == 1);
+    }
+    sylar::Config::Lookup<uint64_t>("scheduler.slow_task_threshold")->setValue(0);
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    test_registry();
+    test_histogram();
+    bench_counter(1);
+    bench_counter(4);
+    test_runtime();
+    test_slow_task();
+    return 0;
+}
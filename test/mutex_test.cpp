@@ -0,0 +1,251 @@
+#include "../src/thread.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <semaphore.h>
+#include <sstream>
+#include <vector>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_loops = 1000000;
+
+// 多个线程抢同一把锁，临界区只有几次加法
+template<class MutexType>
+void bench(const char* name, MutexType& mutex, int threads) {
+    static volatile long s_count = 0;
+    s_count = 0;
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < threads; i++) {
+        thrs.push_back(std::make_shared<sylar::Thread>([&mutex]() {
+            for(int j = 0; j < s_loops; j++) {
+                typename MutexType::Lock lock(mutex);
+                s_count = s_count + 1;
+            }
+        }, "mutex_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(s_count == (long)threads * s_loops);
+    SYLAR_LOG_INFO(g_logger) << name << " threads=" << threads << " "
+        << (double)threads * s_loops * 1000000.0 / used << " ops/s";
+}
+
+void test_adaptive() {
+    sylar::AdaptiveMutex mutex;
+    SYLAR_ASSERT(mutex.tryLock());
+    SYLAR_ASSERT(!mutex.tryLock());
+    mutex.unlock();
+    SYLAR_LOG_INFO(g_logger) << "max spins=" << sylar::AdaptiveMutex::GetMaxSpins();
+
+    sylar::LockStats stats("bench");
+    for(int threads : {1, 2, 4}) {
+        sylar::Mutex m;
+        bench("pthread mutex", m, threads);
+        sylar::Spinlock s;
+        bench("spinlock", s, threads);
+        sylar::AdaptiveMutex a(&stats);
+        stats.reset();
+        bench("adaptive", a, threads);
+        sylar::LockStats::Snapshot snap = stats.snapshot();
+        SYLAR_ASSERT(snap.acquisitions == (uint64_t)threads * s_loops);
+        std::stringstream ss;
+        stats.dump(ss);
+        SYLAR_LOG_INFO(g_logger) << ss.str();
+    }
+}
+
+// 只加读锁，临界区读一个共享变量
+template<class RWMutexType>
+void bench_read(const char* name, RWMutexType& mutex, int threads) {
+    static const int loops = 200000;
+    static long s_value = 1;
+    static std::atomic<long> s_sum(0);
+    s_sum = 0;
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < threads; i++) {
+        thrs.push_back(std::make_shared<sylar::Thread>([&mutex]() {
+            long sum = 0;
+            for(int j = 0; j < loops; j++) {
+                typename RWMutexType::ReadLock lock(mutex);
+                sum += s_value;
+            }
+            s_sum += sum;
+        }, "rw_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(s_sum == (long)threads * loops);
+    SYLAR_LOG_INFO(g_logger) << name << " read threads=" << threads << " "
+        << (double)threads * loops * 1000000.0 / used << " ops/s";
+}
+
+void test_sharded_rwmutex() {
+    // 写者改两个值，读者看到的必须一致
+    static sylar::ShardedRWMutex s_mutex;
+    static long s_a = 0, s_b = 0;
+    static std::atomic<bool> s_stop(false);
+    SYLAR_LOG_INFO(g_logger) << "sharded rwmutex slots=" << s_mutex.getSlotCount();
+    std::vector<sylar::Thread::ptr> thrs;
+    for(int i = 0; i < 4; i++) {
+        thrs.push_back(std::make_shared<sylar::Thread>([]() {
+            while(!s_stop) {
+                sylar::ShardedRWMutex::ReadLock lock(s_mutex);
+                SYLAR_ASSERT(s_a == s_b);
+            }
+        }, "reader_" + std::to_string(i)));
+    }
+    for(int i = 0; i < 2; i++) {
+        thrs.push_back(std::make_shared<sylar::Thread>([]() {
+            for(int j = 0; j < 20000; j++) {
+                sylar::ShardedRWMutex::WriteLock lock(s_mutex);
+                ++s_a;
+                ++s_b;
+            }
+        }, "writer_" + std::to_string(i)));
+    }
+    thrs[4]->join();
+    thrs[5]->join();
+    s_stop = true;
+    for(int i = 0; i < 4; i++) {
+        thrs[i]->join();
+    }
+    SYLAR_ASSERT(s_a == 40000 && s_b == 40000);
+
+    for(int threads : {1, 2, 4, 8, 16, 32, 64}) {
+        sylar::RWMutex rw;
+        bench_read("pthread rwlock", rw, threads);
+        sylar::ShardedRWMutex sharded;
+        bench_read("sharded rwmutex", sharded, threads);
+    }
+}
+
+// 两个线程用一对信号量来回交接
+void test_semaphore() {
+    sylar::Semaphore sem;
+    SYLAR_ASSERT(!sem.tryWait());
+    uint64_t begin = sylar::GetCurrentMS();
+    SYLAR_ASSERT(!sem.waitFor(20));
+    uint64_t used = sylar::GetCurrentMS() - begin;
+    SYLAR_ASSERT(used >= 19);
+    sem.notify();
+    SYLAR_ASSERT(sem.waitFor(20));
+    SYLAR_LOG_INFO(g_logger) << "semaphore waitFor timeout used=" << used << "ms";
+
+    static const int loops = 100000;
+    static sylar::Semaphore s_ping, s_pong;
+    begin = sylar::GetCurrentUS();
+    sylar::Thread thr([]() {
+        for(int i = 0; i < loops; i++) {
+            s_ping.wait();
+            s_pong.notify();
+        }
+    }, "pong");
+    for(int i = 0; i < loops; i++) {
+        s_ping.notify();
+        s_pong.wait();
+    }
+    thr.join();
+    used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "futex semaphore ping-pong " << loops * 1000000.0 / used << " round/s";
+
+    static sem_t s_sping, s_spong;
+    sem_init(&s_sping, 0, 0);
+    sem_init(&s_spong, 0, 0);
+    begin = sylar::GetCurrentUS();
+    sylar::Thread thr2([]() {
+        for(int i = 0; i < loops; i++) {
+            sem_wait(&s_sping);
+            sem_post(&s_spong);
+        }
+    }, "spong");
+    for(int i = 0; i < loops; i++) {
+        sem_post(&s_sping);
+        sem_wait(&s_spong);
+    }
+    thr2.join();
+    used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "sem_t ping-pong " << loops * 1000000.0 / used << " round/s";
+    sem_destroy(&s_sping);
+    sem_destroy(&s_spong);
+
+    // 一个个握手启动和一起启动的耗时
+    for(int n : {4, 16, 64}) {
+        std::vector<sylar::Thread::ptr> thrs;
+        begin = sylar::GetCurrentUS();
+        for(int i = 0; i < n; i++) {
+            thrs.push_back(std::make_shared<sylar::Thread>([]() {}, "seq_" + std::to_string(i)));
+        }
+        uint64_t seq = sylar::GetCurrentUS() - begin;
+        for(auto& i : thrs) {
+            i->join();
+        }
+        thrs.clear();
+
+        sylar::Semaphore started;
+        begin = sylar::GetCurrentUS();
+        for(int i = 0; i < n; i++) {
+            thrs.push_back(std::make_shared<sylar::Thread>([]() {}, "batch_" + std::to_string(i), &started));
+        }
+        for(int i = 0; i < n; i++) {
+            started.wait();
+        }
+        uint64_t batch = sylar::GetCurrentUS() - begin;
+        for(auto& i : thrs) {
+            SYLAR_ASSERT(i->getId() > 0);
+            i->join();
+        }
+        SYLAR_LOG_INFO(g_logger) << "start " << n << " threads sequential=" << seq
+            << "us batched=" << batch << "us";
+    }
+}
+
+// 调度器和fd上的锁在真实负载下的竞争情况
+void test_iomanager() {
+    static std::atomic<int> s_done(0);
+    {
+        sylar::IOManager iom(4, false, "lock");
+        for(int i = 0; i < 10000; i++) {
+            iom.schedule([]() {
+                ++s_done;
+            });
+        }
+        // 同一个fd上触发后再注册，走addEvent和triggerEvent的加锁
+        static int s_fds[2];
+        SYLAR_ASSERT(pipe(s_fds) == 0);
+        static std::function<void()> s_cb = []() {
+            if(++s_done < 11000) {
+                sylar::IOManager::GetThis()->addEvent(s_fds[1], sylar::IOManager::WRITE, s_cb);
+            }
+        };
+        iom.schedule([]() {
+            sylar::IOManager::GetThis()->addEvent(s_fds[1], sylar::IOManager::WRITE, s_cb);
+        });
+        while(s_done < 11000) {
+            usleep(1000);
+        }
+        close(s_fds[0]);
+        close(s_fds[1]);
+    }
+    std::stringstream ss;
+    sylar::LockStats::DumpAll(ss);
+    SYLAR_LOG_INFO(g_logger) << "lock stats:\n" << ss.str();
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    test_adaptive();
+    test_sharded_rwmutex();
+    test_semaphore();
+    test_iomanager();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "../src/profiler.h"
+#include "../src/IOManager.h"
+#include "../src/fiber_sync.h"
+#include "../src/log.h"
+#include "../src/config.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <signal.h>
+#include <sstream>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static sylar::FiberMutex s_mutex;
+static std::atomic<int> s_parked(0);
+
+void sleeper() {
+    ++s_parked;
+    sleep(1);
+}
+
+void locker() {
+    ++s_parked;
+    sylar::FiberMutex::Lock lock(s_mutex);
+}
+
+void test_dump() {
+    sylar::IOManager iom(1, false, "dump");
+    s_mutex.lock();
+    iom.schedule(sleeper);
+    iom.schedule(locker);
+    while(s_parked < 2) {
+        usleep(1000);
+    }
+    usleep(20000);
+
+    std::stringstream ss;
+    sylar::Fiber::DumpAll(ss);
+    std::string text = ss.str();
+    SYLAR_LOG_INFO(g_logger) << "fibers:\n" << text;
+    SYLAR_ASSERT(text.find("entry=sleeper() parked=timer timeout=1000ms") != std::string::npos);
+    SYLAR_ASSERT(text.find("entry=locker() parked=lock") != std::string::npos);
+    SYLAR_ASSERT(text.find("last_yield=sylar::FiberMutex::lock") != std::string::npos);
+    s_mutex.unlock();
+
+    // 信号触发的dump在后台线程里打日志
+    sylar::Config::Lookup<int>("fiber.dump_signal")->setValue(SIGUSR2);
+    raise(SIGUSR2);
+    usleep(20000);
+    sylar::Config::Lookup<int>("fiber.dump_signal")->setValue(0);
+}
+
+// 两个函数分开算，火焰图上能看出比例
+static volatile uint64_t s_sink = 0;
+
+void __attribute__((noinline)) spin_a(uint64_t ms) {
+    uint64_t begin = sylar::GetCurrentMS();
+    while(sylar::GetCurrentMS() - begin < ms) {
+        for(int i = 0; i < 1000; i++) {
+            s_sink = s_sink + i;
+        }
+    }
+}
+
+void __attribute__((noinline)) spin_b(uint64_t ms) {
+    spin_a(ms);
+}
+
+void test_profiler() {
+    static std::atomic<int> s_done(0);
+    SYLAR_ASSERT(sylar::FiberProfiler::Stop().empty());
+    SYLAR_ASSERT(sylar::FiberProfiler::Start(500));
+    SYLAR_ASSERT(!sylar::FiberProfiler::Start(500));
+    {
+        sylar::IOManager iom(2, false, "prof");
+        iom.schedule([]() {
+            spin_b(300);
+            ++s_done;
+        });
+        iom.schedule([]() {
+            spin_a(300);
+            ++s_done;
+        });
+        while(s_done < 2) {
+            usleep(1000);
+        }
+    }
+    // 主线程不在协程上，这段不会被采到
+    spin_a(100);
+    std::string folded = sylar::FiberProfiler::Stop();
+    sylar::FiberProfiler::Stats stats = sylar::FiberProfiler::GetLastStats();
+    SYLAR_LOG_INFO(g_logger) << "samples=" << stats.samples << " skipped=" << stats.skipped
+        << " dropped=" << stats.dropped << " folded:\n" << folded;
+    SYLAR_ASSERT(!sylar::FiberProfiler::IsRunning());
+    SYLAR_ASSERT(stats.samples > 50 && stats.skipped > 0);
+    SYLAR_ASSERT(folded.find("sylar::Fiber::MainFunc();") != std::string::npos);
+    SYLAR_ASSERT(folded.find(";spin_b(unsigned long);spin_a(unsigned long)") != std::string::npos);
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    test_dump();
+    test_profiler();
+    return 0;
+}
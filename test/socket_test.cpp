@@ -0,0 +1,148 @@
+#include "../src/socket.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const size_t s_chunk_size = 64 * 1024;
+static const size_t s_total_size = 128 * 1024 * 1024;
+
+// 收满s_total_size之后关闭
+void run_sink(sylar::Socket::ptr listener) {
+    sylar::Socket::ptr client = listener->accept();
+    if(!client) {
+        return;
+    }
+    std::string buf(s_chunk_size, '\0');
+    size_t total = 0;
+    while(total < s_total_size) {
+        int rt = client->recv(&buf[0], buf.size());
+        if(rt <= 0) {
+            break;
+        }
+        total += rt;
+    }
+    client->close();
+}
+
+// mode: 0 send, 1 sendv, 2 MSG_ZEROCOPY
+void bench_loopback(int mode) {
+    sylar::Socket::ptr listener = sylar::Socket::CreateTCPSocket();
+    listener->bind(sylar::IPv4Address::Create("127.0.0.1", 0));
+    listener->listen();
+    sylar::IOManager::GetThis()->schedule(std::bind(run_sink, listener));
+
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(listener->getLocalAddress());
+    if(mode == 2 && !sock->setZeroCopy(true)) {
+        SYLAR_LOG_INFO(g_logger) << "SO_ZEROCOPY not supported, fall back to send";
+    }
+    if(!sock->connect(listener->getLocalAddress())) {
+        return;
+    }
+
+    static std::string data(s_chunk_size, 'x');
+    iovec iov[4];
+    for(int i = 0; i < 4; i++) {
+        iov[i].iov_base = &data[i * s_chunk_size / 4];
+        iov[i].iov_len = s_chunk_size / 4;
+    }
+
+    uint64_t begin = sylar::GetCurrentUS();
+    size_t total = 0;
+    while(total < s_total_size) {
+        int rt = 0;
+        if(mode == 0) {
+            rt = sock->send(data.c_str(), data.size());
+        } else if(mode == 1) {
+            rt = sock->sendv(iov, 4);
+        } else {
+            // 短写之后剩下的部分下一轮从头重发，只统计实际写出的字节
+            rt = sock->sendZeroCopy(data.c_str(), data.size());
+            sock->reapZeroCopy();
+        }
+        if(rt <= 0) {
+            SYLAR_LOG_ERROR(g_logger) << "send rt=" << rt << " errno=" << strerror(errno);
+            break;
+        }
+        total += rt;
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    // 等剩下的零拷贝完成通知
+    for(int i = 0; i < 100 && sock->getZeroCopyPending(); i++) {
+        usleep(1000);
+        sock->reapZeroCopy();
+    }
+    static const char *names[] = {"send", "sendv", "zerocopy"};
+    SYLAR_LOG_INFO(g_logger) << names[mode] << " " << total / 1024 / 1024 << "MB "
+        << total * 1.0 / used << " MB/s"
+        << (mode == 2 ? " zc_pending=" + std::to_string(sock->getZeroCopyPending())
+                        + " zc_copied=" + std::to_string(sock->getZeroCopyCopied()) : "");
+    sock->close();
+    listener->close();
+}
+
+void test_unix_udp() {
+    sylar::UnixAddress::ptr uaddr(new sylar::UnixAddress("/tmp/sylar_socket_test.sock"));
+    sylar::Socket::ptr listener = sylar::Socket::CreateUnixTCPSocket();
+    listener->bind(uaddr);
+    listener->listen();
+    sylar::IOManager::GetThis()->schedule([listener](){
+        sylar::Socket::ptr client = listener->accept();
+        char buf[64];
+        iovec iov[2] = {{buf, 3}, {buf + 3, sizeof(buf) - 3}};
+        int rt = client->recvv(iov, 2);
+        client->send(buf, rt);
+    });
+    sylar::Socket::ptr sock = sylar::Socket::CreateUnixTCPSocket();
+    sock->connect(uaddr);
+    sock->send("hello unix", 10);
+    char buf[64] = {0};
+    sock->recv(buf, sizeof(buf));
+    SYLAR_LOG_INFO(g_logger) << "unix echo: " << buf << " " << *sock;
+    unlink("/tmp/sylar_socket_test.sock");
+
+    sylar::Socket::ptr server = sylar::Socket::CreateUDPSocket();
+    server->bind(sylar::IPv4Address::Create("127.0.0.1", 0));
+    sylar::Socket::ptr udp = sylar::Socket::CreateUDPSocket();
+    udp->sendTo("hello udp", 9, server->getLocalAddress());
+    sylar::Address::ptr from(new sylar::IPv4Address);
+    memset(buf, 0, sizeof(buf));
+    server->recvFrom(buf, sizeof(buf), from);
+    SYLAR_LOG_INFO(g_logger) << "udp recv: " << buf << " from " << *from;
+}
+
+// 另一个协程cancelRead之后，挂在recv上的协程被唤醒返回错误
+void test_cancel() {
+    sylar::Socket::ptr listener = sylar::Socket::CreateTCPSocket();
+    listener->bind(sylar::IPv4Address::Create("127.0.0.1", 0));
+    listener->listen();
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(listener->getLocalAddress());
+    sock->connect(listener->getLocalAddress());
+    sylar::Socket::ptr peer = listener->accept();
+
+    sylar::IOManager::GetThis()->schedule([sock](){
+        usleep(20 * 1000);
+        SYLAR_LOG_INFO(g_logger) << "cancelRead rt=" << sock->cancelRead();
+    });
+    char buf[16];
+    uint64_t begin = sylar::GetCurrentMS();
+    int rt = sock->recv(buf, sizeof(buf));
+    SYLAR_LOG_INFO(g_logger) << "recv after cancel rt=" << rt << " used="
+        << sylar::GetCurrentMS() - begin << "ms";
+}
+
+void run_all() {
+    bench_loopback(0);
+    bench_loopback(1);
+    bench_loopback(2);
+    test_unix_udp();
+    test_cancel();
+}
+
+int main(int argc, char** argv) {
+    sylar::IOManager iom(1);
+    iom.schedule(run_all);
+    return 0;
+}
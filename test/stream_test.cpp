@@ -0,0 +1,152 @@
+#include "../src/socket_stream.h"
+#include "../src/file_stream.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_records = 20000;
+static const size_t s_body_size = 28;
+
+// 每条记录分两次写: 4字节长度头 + body，是最常见的小写入模式
+static int write_record(sylar::Stream::ptr stream, uint32_t seq) {
+    char body[s_body_size];
+    memset(body, 'a' + seq % 26, sizeof(body));
+    uint32_t len = sizeof(body);
+    if(stream->writeFixSize(&len, sizeof(len)) <= 0) {
+        return -1;
+    }
+    return stream->writeFixSize(body, sizeof(body));
+}
+
+static int read_record(sylar::Stream::ptr stream, uint32_t seq) {
+    uint32_t len = 0;
+    if(stream->readFixSize(&len, sizeof(len)) <= 0) {
+        return -1;
+    }
+    char body[s_body_size];
+    SYLAR_ASSERT(len == sizeof(body));
+    int rt = stream->readFixSize(body, len);
+    SYLAR_ASSERT(rt <= 0 || body[0] == (char)('a' + seq % 26));
+    return rt;
+}
+
+static void setup(sylar::BufferedStream::ptr stream, bool buffered) {
+    if(!buffered) {
+        stream->setReadBufferSize(0);
+        stream->setWriteBufferSize(0);
+    }
+}
+
+// pingpong为true时一问一答，否则客户端把所有记录流水线发完
+void bench_socket(bool buffered, bool pingpong) {
+    sylar::Socket::ptr listener = sylar::Socket::CreateTCPSocket();
+    listener->bind(sylar::IPv4Address::Create("127.0.0.1", 0));
+    listener->listen();
+
+    static sylar::SocketStream::ptr s_server;
+    sylar::IOManager::GetThis()->schedule([listener, buffered, pingpong]() {
+        sylar::SocketStream::ptr stream(new sylar::SocketStream(listener->accept()));
+        setup(stream, buffered);
+        for(int i = 0; i < s_records; i++) {
+            if(read_record(stream, i) <= 0) {
+                break;
+            }
+            if(pingpong && write_record(stream, i) <= 0) {
+                break;
+            }
+        }
+        stream->flush();
+        s_server = stream;
+    });
+
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(listener->getLocalAddress());
+    sock->connect(listener->getLocalAddress());
+    sylar::SocketStream::ptr stream(new sylar::SocketStream(sock));
+    setup(stream, buffered);
+
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < s_records; i++) {
+        write_record(stream, i);
+        if(pingpong) {
+            read_record(stream, i);
+        }
+    }
+    stream->flush();
+    while(!s_server) {
+        usleep(1000);
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << (pingpong ? "pingpong" : "pipeline") << " buffered=" << buffered
+        << " records=" << s_records << " used=" << used / 1000 << "ms"
+        << " client read/write syscalls=" << stream->getReadSyscalls() << "/" << stream->getWriteSyscalls()
+        << " server read/write syscalls=" << s_server->getReadSyscalls() << "/" << s_server->getWriteSyscalls();
+    s_server.reset();
+}
+
+void bench_file(bool buffered) {
+    std::string path = "/tmp/sylar_stream_test.dat";
+    uint64_t begin = sylar::GetCurrentUS();
+    sylar::FileStream::ptr out(new sylar::FileStream(path, O_WRONLY | O_CREAT | O_TRUNC));
+    setup(out, buffered);
+    for(int i = 0; i < s_records; i++) {
+        write_record(out, i);
+    }
+    out->close();
+
+    sylar::FileStream::ptr in(new sylar::FileStream(path));
+    setup(in, buffered);
+    int n = 0;
+    while(n < s_records && read_record(in, n) > 0) {
+        ++n;
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "file buffered=" << buffered << " records=" << n
+        << " used=" << used / 1000 << "ms"
+        << " write syscalls=" << out->getWriteSyscalls() << " read syscalls=" << in->getReadSyscalls();
+    unlink(path.c_str());
+}
+
+// ByteArray直接进出流，读写都走iovec
+void test_bytearray() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    sylar::FileStream::ptr out(new sylar::FileStream(fds[0]));
+    sylar::FileStream::ptr in(new sylar::FileStream(fds[1]));
+
+    sylar::ByteArray::ptr ba(new sylar::ByteArray(16));
+    for(int i = 0; i < 100; i++) {
+        ba->writeUint32(i * 1000);
+    }
+    size_t size = ba->getSize();
+    ba->setPosition(0);
+    out->writeFixSize(ba, size);
+    out->flush();
+
+    sylar::ByteArray::ptr rba(new sylar::ByteArray(16));
+    in->readFixSize(rba, size);
+    rba->setPosition(0);
+    for(int i = 0; i < 100; i++) {
+        SYLAR_ASSERT(rba->readUint32() == (uint32_t)(i * 1000));
+    }
+    SYLAR_LOG_INFO(g_logger) << "bytearray through stream ok size=" << size;
+}
+
+void run() {
+    test_bytearray();
+    bench_socket(false, false);
+    bench_socket(true, false);
+    bench_socket(false, true);
+    bench_socket(true, true);
+    bench_file(false);
+    bench_file(true);
+}
+
+int main(int argc, char** argv) {
+    sylar::IOManager iom(1);
+    iom.schedule(run);
+    return 0;
+}
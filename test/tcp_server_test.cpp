@@ -0,0 +1,87 @@
+#include "../src/tcp_server.h"
+#include "../src/IOManager.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_clients = 8;
+static const int s_conns_per_client = 500;
+
+// 收到连接后直接关闭，压测只看accept和分发的开销
+class CloseServer : public sylar::TcpServer {
+public:
+    typedef std::shared_ptr<CloseServer> ptr;
+    CloseServer(sylar::IOManager* worker, sylar::IOManager* accept_worker)
+        :TcpServer(worker, accept_worker) {
+    }
+protected:
+    void handleClient(sylar::Socket::ptr client) override {
+        client->close();
+    }
+};
+
+static std::atomic<int> s_done(0);
+static std::atomic<int> s_fails(0);
+
+void run_client(sylar::Address::ptr addr) {
+    char buf[16];
+    for(int i = 0; i < s_conns_per_client; i++) {
+        sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+        if(!sock->connect(addr)) {
+            ++s_fails;
+            continue;
+        }
+        // 等服务端关闭，保证这条连接已经被accept并处理过
+        while(sock->recv(buf, sizeof(buf)) > 0);
+        sock->close();
+    }
+    ++s_done;
+}
+
+void bench(sylar::IOManager* server_iom, bool reuseport, uint32_t batch) {
+    CloseServer::ptr server(new CloseServer(server_iom, server_iom));
+    server->setReusePort(reuseport);
+    server->setAcceptBatch(batch);
+    server->setName("bench");
+    if(!server->bind(sylar::IPv4Address::Create("127.0.0.1", 0))) {
+        SYLAR_LOG_ERROR(g_logger) << "bind fail";
+        return;
+    }
+    server->start();
+    sylar::Address::ptr addr = server->getSocks()[0]->getLocalAddress();
+
+    s_done = 0;
+    s_fails = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < s_clients; i++) {
+        sylar::IOManager::GetThis()->schedule(std::bind(run_client, addr));
+    }
+    while(s_done < s_clients) {
+        usleep(1000);
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    int conns = s_clients * s_conns_per_client - s_fails;
+    SYLAR_LOG_INFO(g_logger) << "reuseport=" << reuseport << " listeners=" << server->getSocks().size()
+        << " batch=" << batch << " conns=" << conns << " accepted=" << server->getAcceptCount()
+        << " fails=" << s_fails << " " << conns * 1000000.0 / used << " conns/s";
+    server->stop();
+}
+
+int main(int argc, char** argv) {
+    sylar::Logger::ptr system_logger = SYLAR_LOG_NAME("system");
+    system_logger->setLevel(sylar::LogLevel::ERROR);
+
+    sylar::IOManager server_iom(2, false, "server");
+    {
+        sylar::IOManager client_iom(1, true, "client");
+        client_iom.schedule([&server_iom]() {
+            bench(&server_iom, false, 1);
+            bench(&server_iom, false, 16);
+            bench(&server_iom, true, 1);
+            bench(&server_iom, true, 16);
+        });
+    }
+    return 0;
+}